@@ -13,6 +13,7 @@
 #include <time.h>       // For logging timestamp
 #include "include/cpm.h" // Main CPM public API
 #include "include/cpm_config.h" // Configuration management
+#include "include/cpm_registry.h" // Shared registry HTTP client
 
 // Global CPM configuration instance
 static CPM_Config* global_cpm_config = NULL;
@@ -113,6 +114,9 @@ void cpm_terminate(void) {
         return;
     }
 
+    // Drain and close the shared registry client's connections
+    cpm_registry_client_shutdown();
+
     // Terminate PMLL system
     pmll_shutdown_global_system();
 
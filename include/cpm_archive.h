@@ -0,0 +1,46 @@
+/*
+ * File: include/cpm_archive.h
+ * Description: Streaming package archive extraction for CPM.
+ * A .tgz is unpacked as its bytes arrive (e.g. from a curl write callback):
+ * gzip is inflated with zlib and tar entries are written straight into the
+ * destination directory, while the compressed bytes are hashed for integrity
+ * checks. Nothing is staged on disk but the extracted files themselves.
+ * Entries that would land outside the destination (absolute paths, "..",
+ * links pointing out of the tree) are rejected: every entry is resolved from
+ * the destination one component at a time without following symlinks, and
+ * symlinks themselves are only created once all other entries are written.
+ * Author: Dr. Q Josef Kurk Edwards
+ */
+
+#ifndef CPM_ARCHIVE_H
+#define CPM_ARCHIVE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "cpm_types.h"
+#include "cpm_digest.h"
+
+// --- Streaming Extraction ---
+typedef struct CPM_ArchiveStream CPM_ArchiveStream;
+
+// dest_dir is created if missing.
+CPM_ArchiveStream* cpm_archive_stream_create(const char* dest_dir);
+// Feeds the next chunk of compressed archive. After the first error every
+// further call returns it again without doing work.
+CPM_Result cpm_archive_stream_write(CPM_ArchiveStream* stream, const void* data, size_t size);
+// Checks the archive ended cleanly, creates its symlinks and yields the
+// SHA-256 of every byte written.
+CPM_Result cpm_archive_stream_finish(CPM_ArchiveStream* stream, unsigned char digest[CPM_SHA256_DIGEST_SIZE]);
+// False once the first bytes show the input isn't gzip (e.g. a JSON error page).
+bool cpm_archive_stream_is_archive(const CPM_ArchiveStream* stream);
+// Files written so far and the uncompressed bytes they hold
+size_t cpm_archive_stream_file_count(const CPM_ArchiveStream* stream);
+uint64_t cpm_archive_stream_unpacked_bytes(const CPM_ArchiveStream* stream);
+void cpm_archive_stream_free(CPM_ArchiveStream* stream);
+
+// --- Whole Files ---
+// Unpacks a .tgz on disk through the same stream.
+CPM_Result cpm_archive_extract_file(const char* archive, const char* dest_dir);
+
+#endif // CPM_ARCHIVE_H
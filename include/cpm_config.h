@@ -41,8 +41,11 @@ typedef struct CPM_Config {
     
     // Advanced settings
     int max_concurrent_downloads;
+    int download_chunk_mb;      // Archives larger than this download in parallel chunks; 0 = never
     bool use_package_lock;
     bool auto_install_deps;
+    int metadata_ttl;           // Seconds cached registry metadata is used without revalidation
+    bool offline;               // Resolve only from the metadata cache (--offline)
 } CPM_Config;
 
 // --- Configuration Loading ---
@@ -12,6 +12,7 @@
 #include "cpm_types.h"
 #include "cpm_semver.h"
 #include "cpm_package.h"
+#include "cpm_config.h"
 
 // --- Dependency Structure ---
 typedef struct Dependency {
@@ -21,43 +22,92 @@ typedef struct Dependency {
     struct Dependency* next;
 } Dependency;
 
-// --- Dependency Tree Node ---
+// --- Dependency Graph Node ---
+// In a resolution, nodes are interned: each name@version exists once and
+// `children` point at shared nodes, so the graph may contain cycles.
 typedef struct DepNode {
     char* name;
     SemVer* version;
     char* resolved_url;
+    char* integrity;            // e.g. "sha256-<base64>"; NULL if the registry gave none
     Dependency* dependencies;
     struct DepNode** children;
     size_t child_count;
     bool installed;
+    bool mocked;                // Versions or metadata were offline stand-ins, not registry data
+    int level;                  // Install level: 0 = depends on nothing, installs first
+    size_t graph_index;         // Position in DepResolution.nodes
 } DepNode;
 
 // --- Dependency Resolution Result ---
 typedef struct {
     DepNode* root;
+    DepNode** nodes;            // Every node of the graph, root first; owns them
+    size_t node_count;
+    
+    // Topological install order (root excluded): dependencies before dependents.
+    // Packages in one level don't depend on each other and may install in parallel;
+    // level l is install_order[level_offsets[l] .. level_offsets[l + 1]).
     DepNode** install_order;
     size_t install_count;
+    size_t* level_offsets;
+    size_t level_count;
+    
     char** conflicts;
     size_t conflict_count;
+    char** cycles;              // One "a -> b -> a" line per dependency cycle broken
+    size_t cycle_count;
 } DepResolution;
 
 // --- Dependency Operations ---
 Dependency* cpm_dependency_create(const char* name, const char* constraint_str);
+// Parses a spec entry, "name@constraint" or "name"
+Dependency* cpm_dependency_parse_spec(const char* spec);
 void cpm_dependency_free(Dependency* dep);
 void cpm_dependency_list_free(Dependency* head);
 
 // --- Dependency Tree Operations ---
 DepNode* cpm_depnode_create(const char* name, const SemVer* version);
+// Frees a standalone tree, children included. Resolution graphs share nodes
+// and are freed with cpm_resolution_free instead.
 void cpm_depnode_free(DepNode* node);
 CPM_Result cpm_depnode_add_child(DepNode* parent, DepNode* child);
 
 // --- Dependency Resolution ---
+// Prefetches registry data level by level (concurrently within a level), then
+// picks one version per package with the conflict-driven solver (cpm_solver.h).
+// On failure install_count is 0 and conflicts explain why. Packages the
+// registry could not be asked about resolve against stand-in versions and are
+// marked `mocked`; see cpm_resolution_is_mocked.
 DepResolution* cpm_resolve_dependencies(const Package* root_package, const char* registry_url);
+// As above, using config's registry_url, max_concurrent_downloads and timeout_seconds.
+DepResolution* cpm_resolve_dependencies_with_config(const Package* root_package, const CPM_Config* config);
+// Re-resolves after a spec change. Packages reachable through unchanged
+// dependencies keep their version from previous (e.g. cpm.lock) without registry
+// requests; the rest is solved again, preferring previous versions where they
+// still fit. Falls back to a full solve if the change conflicts with those pins.
+DepResolution* cpm_resolve_dependencies_incremental(const Package* root_package, const CPM_Config* config,
+                                                    const DepResolution* previous);
 void cpm_resolution_free(DepResolution* resolution);
+// True if any node came from stand-in data; such a resolution must not be pinned.
+bool cpm_resolution_is_mocked(const DepResolution* resolution);
 
 // --- Dependency Installation ---
+// Installs into target_dir/cpm_modules through a download -> verify -> extract ->
+// build pipeline (lib/core/cpm_install.c): stages overlap across packages, each
+// with its own worker pool, and builds follow the dependency order.
 CPM_Result cpm_install_dependencies(const DepResolution* resolution, const char* target_dir);
+// As above, sharing archives and unpacked trees through the store under
+// config's cache_dir (cpm_store.h); without a config nothing is shared.
+CPM_Result cpm_install_dependencies_with_config(const DepResolution* resolution, const char* target_dir,
+                                                const CPM_Config* config);
+// Runs the same stages for one package, into modules_dir/<name>.
 CPM_Result cpm_install_dependency(const DepNode* dep, const char* target_dir);
+// Installs only packages not already present at their resolved version, and
+// removes those previous (may be NULL) had that resolution no longer does.
+// config (may be NULL) selects the store as for the _with_config variant.
+CPM_Result cpm_install_dependencies_incremental(const DepResolution* resolution, const DepResolution* previous,
+                                                const char* target_dir, const CPM_Config* config);
 
 // --- Dependency Utilities ---
 bool cpm_dependency_is_satisfied(const char* name, const SemVer* installed_version, const VersionConstraint* constraint);
@@ -65,10 +115,13 @@ DepNode* cpm_find_installed_dependency(const char* name, const char* modules_dir
 SemVer** cpm_get_available_versions(const char* package_name, const char* registry_url, size_t* count);
 
 // --- Conflict Detection ---
+// True when resolution failed; the conflicts hold the solver's explanation.
 bool cpm_detect_dependency_conflicts(const DepResolution* resolution);
+// Copies of the explanation lines. Caller frees each string and the array.
 char** cpm_get_conflict_descriptions(const DepResolution* resolution, size_t* count);
 
 // --- Dependency Graph Utilities ---
+// Shared subtrees print once; repeats are marked (deduped) and back edges (circular).
 void cpm_print_dependency_tree(const DepNode* root, int depth);
 bool cpm_dependency_has_circular_reference(const DepNode* root);
 
@@ -0,0 +1,93 @@
+/*
+ * File: include/cpm_digest.h
+ * Description: Content digests for CPM.
+ * SHA-256 and SHA-512 plus helpers for Subresource-Integrity strings
+ * ("sha256-<base64>", "sha512-<base64>"), the form registries use to pin
+ * package archives. SHA-256 compresses blocks with the x86 SHA extensions
+ * when the CPU has them and falls back to portable C otherwise; the choice is
+ * made once, on first use.
+ * Author: Dr. Q Josef Kurk Edwards
+ */
+
+#ifndef CPM_DIGEST_H
+#define CPM_DIGEST_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define CPM_SHA256_DIGEST_SIZE 32
+#define CPM_SHA256_BLOCK_SIZE 64
+#define CPM_SHA512_DIGEST_SIZE 64
+#define CPM_SHA512_BLOCK_SIZE 128
+#define CPM_DIGEST_MAX_SIZE CPM_SHA512_DIGEST_SIZE
+
+// --- SHA-256 ---
+typedef struct {
+    uint32_t state[8];
+    uint64_t length;                        // Bytes hashed so far
+    unsigned char block[CPM_SHA256_BLOCK_SIZE];
+    size_t block_used;
+} CPM_SHA256;
+
+void cpm_sha256_init(CPM_SHA256* ctx);
+void cpm_sha256_update(CPM_SHA256* ctx, const void* data, size_t size);
+void cpm_sha256_final(CPM_SHA256* ctx, unsigned char digest[CPM_SHA256_DIGEST_SIZE]);
+void cpm_sha256(const void* data, size_t size, unsigned char digest[CPM_SHA256_DIGEST_SIZE]);
+bool cpm_sha256_file(const char* path, unsigned char digest[CPM_SHA256_DIGEST_SIZE]);
+
+typedef enum {
+    CPM_SHA256_IMPL_PORTABLE,
+    CPM_SHA256_IMPL_SHANI               // x86 SHA extensions (SHA-NI)
+} CPM_SHA256Impl;
+
+// The block function every SHA-256 context uses
+CPM_SHA256Impl cpm_sha256_implementation(void);
+const char* cpm_sha256_implementation_name(CPM_SHA256Impl impl);
+// Overrides the CPU-based choice (benchmarks, tests); false if this CPU can't run it.
+bool cpm_sha256_select(CPM_SHA256Impl impl);
+
+// --- SHA-512 ---
+typedef struct {
+    uint64_t state[8];
+    uint64_t length;                        // Bytes hashed so far
+    unsigned char block[CPM_SHA512_BLOCK_SIZE];
+    size_t block_used;
+} CPM_SHA512;
+
+void cpm_sha512_init(CPM_SHA512* ctx);
+void cpm_sha512_update(CPM_SHA512* ctx, const void* data, size_t size);
+void cpm_sha512_final(CPM_SHA512* ctx, unsigned char digest[CPM_SHA512_DIGEST_SIZE]);
+void cpm_sha512(const void* data, size_t size, unsigned char digest[CPM_SHA512_DIGEST_SIZE]);
+
+// --- Encodings ---
+// Lowercase hex / standard base64 of a digest. Caller frees.
+char* cpm_digest_to_hex(const unsigned char* digest, size_t size);
+char* cpm_digest_to_base64(const unsigned char* digest, size_t size);
+
+// --- Subresource Integrity ---
+typedef enum {
+    CPM_INTEGRITY_NONE,
+    CPM_INTEGRITY_SHA256,
+    CPM_INTEGRITY_SHA512
+} CPM_IntegrityAlgorithm;
+
+typedef struct {
+    CPM_IntegrityAlgorithm algorithm;
+    unsigned char digest[CPM_DIGEST_MAX_SIZE];
+    size_t size;
+} CPM_IntegrityHash;
+
+// "sha256-<base64>" for a file's contents, NULL if it can't be read. Caller frees.
+char* cpm_integrity_of_file(const char* path);
+// True if the file matches the integrity string. Unsupported algorithms never match.
+bool cpm_integrity_check_file(const char* path, const char* integrity);
+// True if integrity names an algorithm cpm_integrity_check_file understands
+bool cpm_integrity_supported(const char* integrity);
+// The strongest hash of a (possibly space-separated) SRI string; false if
+// none of its entries is a well-formed sha256 or sha512 one.
+bool cpm_integrity_parse(const char* integrity, CPM_IntegrityHash* hash);
+// Digest carried by the sha256 entry of an SRI string; false if there is none.
+bool cpm_integrity_sha256(const char* integrity, unsigned char digest[CPM_SHA256_DIGEST_SIZE]);
+
+#endif // CPM_DIGEST_H
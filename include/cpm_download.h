@@ -0,0 +1,56 @@
+/*
+ * File: include/cpm_download.h
+ * Description: Resumable, range-request downloads for CPM.
+ * A download hands the resource's bytes to a sink strictly in order, once. A
+ * transfer that drops mid-way is resumed with a Range request from the last
+ * byte delivered rather than restarted. Given a partial directory, a resource
+ * larger than one chunk is fetched as ranged chunks in parallel into files
+ * there; they outlive a failed run, so the next one fetches only the missing
+ * bytes, with If-Range making sure the resource has not changed meanwhile.
+ * Author: Dr. Q Josef Kurk Edwards
+ */
+
+#ifndef CPM_DOWNLOAD_H
+#define CPM_DOWNLOAD_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <curl/curl.h>
+
+#define CPM_DOWNLOAD_DEFAULT_ATTEMPTS 3
+
+// --- Sinks ---
+// Receives the next bytes of the resource; false aborts the download.
+typedef bool (*CPM_DownloadSink)(const void* data, size_t size, void* ctx);
+// The server sent the resource from byte 0 again (it ignored a Range, or the
+// resource changed): the sink must drop everything it was given so far.
+typedef bool (*CPM_DownloadReset)(void* ctx);
+
+// --- Downloads ---
+typedef struct {
+    const char* url;
+    long timeout_seconds;       // Per transfer
+    int max_attempts;           // Transfers in a row that may fail without progress; 0 = default
+    const char* partial_dir;    // NULL: resume within this call only, never chunk
+    uint64_t chunk_size;        // Bytes per chunk; 0 = never chunk
+    int max_parallel;           // Chunk transfers in flight
+} CPM_DownloadOptions;
+
+typedef struct {
+    CURLcode result;
+    long status;                // HTTP status of the last response
+    uint64_t size;              // Bytes delivered to the sink
+    uint64_t transferred;       // Bytes received over the network by this call
+    uint64_t reused;            // Bytes taken from chunks an earlier run left behind
+    size_t chunks;              // Chunks the resource was split into (0 = one stream)
+    size_t resumes;             // Transfers continued from mid-resource with a Range
+} CPM_DownloadResult;
+
+// True once every byte reached the sink. A partial directory is removed when
+// its bytes have been delivered or turn out to be unusable, and kept after a
+// network failure so the next attempt can resume it.
+bool cpm_download(const CPM_DownloadOptions* options, CPM_DownloadSink sink, CPM_DownloadReset reset,
+                  void* ctx, CPM_DownloadResult* result);
+
+#endif // CPM_DOWNLOAD_H
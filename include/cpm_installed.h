@@ -0,0 +1,76 @@
+/*
+ * File: include/cpm_installed.h
+ * Description: Index of the packages installed in a modules directory.
+ * One record per package (name, version, path and a summary of its spec),
+ * kept in <modules_dir>/.cpm_installed/index and updated by install and
+ * uninstall, so lookups and local search never walk the directory. The index
+ * records the directory's mtime: a change it did not make (a package removed
+ * by hand, an interrupted install) costs one rescan the next time it is
+ * opened. Each record also stamps its spec file, and a lookup re-reads a
+ * package whose spec was edited, replaced or deleted since. A long-lived
+ * process can follow changes through inotify instead.
+ * Author: Dr. Q Josef Kurk Edwards
+ */
+
+#ifndef CPM_INSTALLED_H
+#define CPM_INSTALLED_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include "cpm_types.h"
+
+#define CPM_INSTALLED_DIR ".cpm_installed"
+
+// --- Installed Package ---
+typedef struct {
+    char* name;                 // Directory name under modules_dir
+    char* version;              // "" when the package has no spec
+    char* path;                 // <modules_dir>/<name>
+    char* description;
+    char* author;
+    char* license;
+    char** dependencies;        // Spec entries, "name@constraint"
+    size_t dep_count;
+    uint64_t spec_ino;          // The spec file as read: inode, size and mtime, all 0 without one
+    int64_t spec_size;
+    struct timespec spec_mtime;
+} CPM_InstalledPackage;
+
+typedef struct CPM_InstalledIndex CPM_InstalledIndex;
+
+// --- Index Access ---
+// Loads modules_dir's index, rescanning the directory first if it changed
+// behind the index's back (and saving the result where it may write). A
+// missing directory gives an empty index; NULL only when out of memory.
+CPM_InstalledIndex* cpm_installed_open(const char* modules_dir);
+void cpm_installed_close(CPM_InstalledIndex* index);
+
+// Packages are kept sorted by name.
+size_t cpm_installed_count(const CPM_InstalledIndex* index);
+const CPM_InstalledPackage* cpm_installed_get(const CPM_InstalledIndex* index, size_t i);
+// Checks the package's spec against its record first (one stat) and re-reads
+// it if the spec changed.
+const CPM_InstalledPackage* cpm_installed_find(CPM_InstalledIndex* index, const char* name);
+// Packages whose name or description contains query, ignoring case. Fills up
+// to max of them into out and returns how many matched in all.
+size_t cpm_installed_search(CPM_InstalledIndex* index, const char* query, const CPM_InstalledPackage** out,
+                            size_t max);
+
+// --- Updates ---
+// Re-reads the specs of `installed` and drops `removed` from modules_dir's
+// index, serialized with other cpm processes updating it.
+CPM_Result cpm_installed_update(const char* modules_dir, const char* const* installed, size_t installed_count,
+                                const char* const* removed, size_t removed_count);
+
+// --- Watching ---
+// Follows later changes to the directory through inotify (Linux only): find
+// and search apply pending events first. False if watching is unavailable.
+bool cpm_installed_watch(CPM_InstalledIndex* index);
+// Readable when events are pending, for a caller's poll loop; -1 if not watching.
+int cpm_installed_watch_fd(const CPM_InstalledIndex* index);
+// Applies pending events now.
+void cpm_installed_refresh(CPM_InstalledIndex* index);
+
+#endif // CPM_INSTALLED_H
@@ -0,0 +1,62 @@
+/*
+ * File: include/cpm_journal.h
+ * Description: Write-ahead journal for PMLL hardened queues.
+ * Append-only, checksummed record of which keyed operations began, committed
+ * or aborted, so an interrupted run can skip committed work and replay the rest.
+ * Author: Dr. Q Josef Kurk Edwards
+ */
+
+#ifndef CPM_JOURNAL_H
+#define CPM_JOURNAL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// --- Journal Types ---
+typedef struct PMLL_Journal PMLL_Journal;
+
+typedef enum {
+    PMLL_JOURNAL_UNKNOWN = 0,   // Never recorded
+    PMLL_JOURNAL_BEGUN,         // Started but never finished (interrupted)
+    PMLL_JOURNAL_COMMITTED,
+    PMLL_JOURNAL_ABORTED
+} PMLL_JournalStatus;
+
+// --- Group Commit Defaults ---
+#define PMLL_JOURNAL_DEFAULT_BATCH_RECORDS  32
+#define PMLL_JOURNAL_DEFAULT_BATCH_DELAY_MS 50
+
+// --- Journal Lifecycle ---
+// Opens (or creates) the journal and replays it; a torn tail is truncated away.
+PMLL_Journal* pmll_journal_open(const char* path);
+void pmll_journal_close(PMLL_Journal* journal);
+// Journal path for a PMLL resource: $CPM_JOURNAL_DIR (default /tmp/cpm/journal)/<resource>.journal
+char* pmll_journal_path_for_resource(const char* resource_id);
+
+// --- Group Commit ---
+// Records are written immediately but fsync'd once `max_records` are pending or
+// `max_delay_ms` has elapsed since the oldest unsynced record. A crash can lose at
+// most one unsynced group; those operations are then replayed.
+void pmll_journal_set_batching(PMLL_Journal* journal, size_t max_records, unsigned int max_delay_ms);
+bool pmll_journal_sync(PMLL_Journal* journal);
+// Syncs the pending group only if it is due by the rules above; otherwise it is left
+// for a later append, flush or close.
+bool pmll_journal_flush(PMLL_Journal* journal);
+
+// --- Recording ---
+bool pmll_journal_begin(PMLL_Journal* journal, const char* op_key);
+bool pmll_journal_commit(PMLL_Journal* journal, const char* op_key);
+bool pmll_journal_abort(PMLL_Journal* journal, const char* op_key);
+// Discards all records, e.g. once the whole batch of work has completed.
+bool pmll_journal_truncate(PMLL_Journal* journal);
+
+// Re-reads the file, picking up records appended by other processes sharing it.
+// Only safe while holding the cross-process lock that serializes those writers.
+bool pmll_journal_refresh(PMLL_Journal* journal);
+
+// --- Recovery Queries ---
+PMLL_JournalStatus pmll_journal_status(PMLL_Journal* journal, const char* op_key);
+// Keys that began but never committed or aborted. Caller frees each key and the array.
+char** pmll_journal_uncommitted_keys(PMLL_Journal* journal, size_t* count);
+
+#endif // CPM_JOURNAL_H
@@ -0,0 +1,87 @@
+/*
+ * File: include/cpm_json.h
+ * Description: Streaming JSON tokenizer for CPM.
+ * A pull (SAX-style) reader: each call returns the next token of the
+ * document, in order, in one pass. Tokens point into the caller's buffer;
+ * strings are handed out raw (between the quotes) and decoded only when a
+ * caller asks for a copy. String bodies are scanned 16 bytes at a time with
+ * SSE2 where available. The reader holds documents to RFC 8259: number
+ * grammar, escape letters, \u hex digits and surrogate pairs are checked, and
+ * raw control bytes in strings are errors. Used for cpm_package.spec files
+ * and registry responses alike.
+ * Author: Dr. Q Josef Kurk Edwards
+ */
+
+#ifndef CPM_JSON_H
+#define CPM_JSON_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define CPM_JSON_MAX_DEPTH 64
+
+// --- Tokens ---
+typedef enum {
+    CPM_JSON_OBJECT_START,
+    CPM_JSON_OBJECT_END,
+    CPM_JSON_ARRAY_START,
+    CPM_JSON_ARRAY_END,
+    CPM_JSON_KEY,               // An object member's name; its value is the next token
+    CPM_JSON_STRING,
+    CPM_JSON_NUMBER,
+    CPM_JSON_TRUE,
+    CPM_JSON_FALSE,
+    CPM_JSON_NULL,
+    CPM_JSON_END,               // The document is complete
+    CPM_JSON_ERROR              // Malformed input at `start`; the reader stays in this state
+} CPM_JsonTokenType;
+
+typedef struct {
+    CPM_JsonTokenType type;
+    const char* start;          // Keys and strings: the bytes between the quotes, escapes undecoded
+    size_t length;
+    bool escaped;               // Keys and strings: contains backslash escapes
+    int depth;                  // Containers the token is inside (0 for the root value)
+} CPM_JsonToken;
+
+// --- Reader ---
+typedef struct {
+    const char* data;
+    size_t size;
+    size_t pos;
+    int depth;
+    int state;
+    char stack[CPM_JSON_MAX_DEPTH];     // '{' or '[' per open container
+} CPM_JsonReader;
+
+// data need not be NUL-terminated; the reader never looks past size bytes.
+void cpm_json_reader_init(CPM_JsonReader* reader, const char* data, size_t size);
+// Fills token and returns true, or returns false (token END or ERROR) once
+// the document is complete or found malformed.
+bool cpm_json_next(CPM_JsonReader* reader, CPM_JsonToken* token);
+// After an OBJECT_START or ARRAY_START, skips through the matching end; after
+// a KEY, skips its value. Other tokens are complete already. False on error.
+bool cpm_json_skip(CPM_JsonReader* reader, const CPM_JsonToken* token);
+
+// At least as many as the keys and strings in data: half its quote characters.
+size_t cpm_json_string_bound(const char* data, size_t size);
+
+// --- Token Values ---
+// Decoded copy of a key or string (\uXXXX becomes UTF-8). Caller frees.
+char* cpm_json_string_dup(const CPM_JsonToken* token);
+// Writes the decoded key or string and a NUL to out (at most length + 1
+// bytes) and returns its length. out may lie at or before token->start in
+// the same buffer: decoding never writes ahead of what it has read.
+size_t cpm_json_string_decode(const CPM_JsonToken* token, char* out);
+// Whether a key or string decodes to text.
+bool cpm_json_string_equals(const CPM_JsonToken* token, const char* text);
+// Integer value of a NUMBER token; false if it is not an integer in range.
+bool cpm_json_int64(const CPM_JsonToken* token, int64_t* value);
+
+// --- Writing ---
+// Writes text as a quoted JSON string: quotes, backslashes and control bytes are escaped.
+void cpm_json_write_string(FILE* f, const char* text);
+
+#endif // CPM_JSON_H
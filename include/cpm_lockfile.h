@@ -0,0 +1,67 @@
+/*
+ * File: include/cpm_lockfile.h
+ * Description: Lockfile support for CPM.
+ * cpm.lock records the exact outcome of a resolution (versions, resolved URLs,
+ * integrity hashes, install levels) in a reviewable text form that belongs in
+ * version control. A compact binary image of it is kept next to the installed
+ * modules and mmap'd on load, so an install whose spec still matches the lock
+ * starts without parsing or resolving anything.
+ * Author: Dr. Q Josef Kurk Edwards
+ */
+
+#ifndef CPM_LOCKFILE_H
+#define CPM_LOCKFILE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "cpm_types.h"
+#include "cpm_package.h"
+#include "cpm_deps.h"
+
+// --- Lockfile Locations ---
+#define CPM_LOCKFILE_NAME "cpm.lock"
+// Binary image, rebuilt from cpm.lock whenever it is missing or stale
+#define CPM_LOCKFILE_BINARY_NAME ".cpm_lock.bin"
+#define CPM_LOCKFILE_FORMAT_VERSION 1
+
+typedef struct CPM_Lockfile CPM_Lockfile;
+
+// One locked package; strings point into the lockfile image
+typedef struct {
+    const char* name;
+    const char* version;
+    const char* resolved;
+    const char* integrity;          // "" if unknown
+    uint32_t level;                 // Install level (0 installs first)
+    const uint32_t* dependencies;   // Indices of the packages it depends on
+    uint32_t dependency_count;
+} CPM_LockEntry;
+
+// --- Writing ---
+// Writes cpm.lock and its binary image for a successful resolution of root_package.
+// Refuses (CPM_RESULT_ERROR_NETWORK) a resolution with mocked nodes.
+CPM_Result cpm_lockfile_write(const DepResolution* resolution, const Package* root_package,
+                              const char* lock_path, const char* binary_path);
+
+// --- Loading ---
+// Maps the binary image if it matches cpm.lock, otherwise parses cpm.lock and
+// refreshes the image (binary_path may be NULL to skip it). NULL if there is no lock.
+CPM_Lockfile* cpm_lockfile_load(const char* lock_path, const char* binary_path);
+void cpm_lockfile_close(CPM_Lockfile* lock);
+
+// Fingerprint of the spec's dependency list; order of declaration doesn't matter.
+uint64_t cpm_lockfile_spec_hash(const Package* package);
+// True if the lock was written for the spec's current dependency list.
+bool cpm_lockfile_matches(const CPM_Lockfile* lock, const Package* package);
+
+// --- Queries ---
+size_t cpm_lockfile_package_count(const CPM_Lockfile* lock);
+// Packages are indexed in name order.
+bool cpm_lockfile_entry(const CPM_Lockfile* lock, size_t index, CPM_LockEntry* entry);
+bool cpm_lockfile_find(const CPM_Lockfile* lock, const char* name, CPM_LockEntry* entry);
+
+// Rebuilds the resolution the lock was written from, install plan included.
+DepResolution* cpm_lockfile_to_resolution(const CPM_Lockfile* lock);
+
+#endif // CPM_LOCKFILE_H
@@ -0,0 +1,31 @@
+/*
+ * File: include/cpm_metacache.h
+ * Description: On-disk cache of registry metadata for CPM.
+ * Documents live under <cache_dir>/metadata/<package>/<document>.json together
+ * with the ETag they were served with; the file's mtime is the time they were
+ * last fetched or revalidated.
+ * Author: Dr. Q Josef Kurk Edwards
+ */
+
+#ifndef CPM_METACACHE_H
+#define CPM_METACACHE_H
+
+#include <stdbool.h>
+#include <time.h>
+
+// --- Defaults ---
+#define CPM_METADATA_DEFAULT_TTL 300   // Seconds a cached document is used without revalidation
+
+// --- Cache Paths ---
+// Caller frees. `document` is e.g. "versions" or a version string.
+char* cpm_metacache_path(const char* cache_dir, const char* package_name, const char* document);
+
+// --- Cache Access ---
+// Loads a cached document; *etag may be NULL if the registry sent none. Caller frees both.
+bool cpm_metacache_load(const char* path, char** body, char** etag, time_t* fetched_at);
+// Atomically replaces the cached document.
+bool cpm_metacache_store(const char* path, const char* body, const char* etag);
+// Marks a cached document as just revalidated (HTTP 304).
+void cpm_metacache_touch(const char* path);
+
+#endif // CPM_METACACHE_H
@@ -13,6 +13,9 @@
 #include "cpm_promise.h"
 
 // --- Package Structure ---
+// A Package owns a single allocation holding its strings and arrays (parsed
+// ones point into a copy of the spec text), so fields are never freed or
+// replaced individually: cpm_free_package releases everything at once.
 typedef struct {
     char* name;
     char* version;
@@ -36,9 +39,19 @@ typedef struct {
 
 // --- Package Operations ---
 Package* cpm_parse_package_file(const char* filepath);
+// Parses spec text without printing; NULL if it is not a JSON object. Object-
+// valued dependencies and scripts read as "name@constraint" / "name: command".
+Package* cpm_parse_package_spec(const char* content, size_t length);
+// Parses a spec file without printing; NULL if it is unreadable or malformed.
+Package* cpm_read_package_spec(const char* filepath);
 void cpm_free_package(Package* pkg);
 CPM_Result cpm_save_package_file(const Package* pkg, const char* filepath);
 
+// --- Spec Field Helpers ---
+// Value of "key": "..." / "key": ["...", ...] in a spec-style document. Caller frees.
+char* extract_json_string_value(const char* json, const char* key);
+char** extract_json_array_values(const char* json, const char* key, size_t* count);
+
 // --- Package Resolution ---
 Package* cpm_package_resolve_remote(const char* package_spec, const char* registry_url);
 Promise* cpm_package_install_async(const Package* pkg, const char* install_dir);
@@ -47,5 +60,9 @@ Promise* cpm_package_build_async(const Package* pkg, const char* package_dir);
 // --- Package Validation ---
 bool cpm_package_validate(const Package* pkg);
 bool cpm_package_spec_exists(const char* directory);
+// Whether name can be a single directory entry under cpm_modules: not empty,
+// not "." or "..", and without '/'. Names from registries and lockfiles are
+// checked before anything is created or removed under them.
+bool cpm_package_name_is_safe(const char* name);
 
 #endif // CPM_PACKAGE_H
\ No newline at end of file
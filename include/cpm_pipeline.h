@@ -0,0 +1,58 @@
+/*
+ * File: include/cpm_pipeline.h
+ * Description: Staged work pipeline for CPM.
+ * Items (e.g. packages) pass through a fixed sequence of stages; each stage has
+ * its own bounded pool of worker threads, so different items occupy different
+ * stages at the same time. A stage can be ordered by prerequisites: an item
+ * enters it only once all of its prerequisites have completed that stage.
+ * Author: Dr. Q Josef Kurk Edwards
+ */
+
+#ifndef CPM_PIPELINE_H
+#define CPM_PIPELINE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "cpm_types.h"
+
+#define CPM_PIPELINE_MAX_STAGES 8
+
+// --- Stages ---
+// Runs one stage for one item, on a worker thread of that stage.
+typedef CPM_Result (*CPM_PipelineStageFn)(void* context, size_t item);
+
+typedef struct {
+    const char* name;
+    CPM_PipelineStageFn run;
+    size_t workers;             // Pool size; 0 = 1
+    bool ordered;               // Wait for prerequisites to complete this stage
+} CPM_PipelineStage;
+
+// --- Statistics ---
+typedef struct {
+    uint64_t busy_ns;           // Summed over workers
+    uint64_t max_item_ns;
+    size_t completed;
+    size_t max_queued;
+} CPM_PipelineStageStats;
+
+typedef struct {
+    uint64_t wall_ns;
+    CPM_PipelineStageStats stages[CPM_PIPELINE_MAX_STAGES];
+    size_t failed_item;         // First item that failed, if the run failed
+} CPM_PipelineStats;
+
+// --- Pipeline ---
+typedef struct CPM_Pipeline CPM_Pipeline;
+
+CPM_Pipeline* cpm_pipeline_create(const CPM_PipelineStage* stages, size_t stage_count,
+                                  size_t item_count, void* context);
+// item's ordered stages wait for prerequisite; edges must not form a cycle.
+CPM_Result cpm_pipeline_add_prerequisite(CPM_Pipeline* pipeline, size_t item, size_t prerequisite);
+// Feeds items in index order and blocks until all have passed every stage, or
+// until the first failure has drained (no new work starts after a failure).
+CPM_Result cpm_pipeline_run(CPM_Pipeline* pipeline, CPM_PipelineStats* stats);
+void cpm_pipeline_free(CPM_Pipeline* pipeline);
+
+#endif // CPM_PIPELINE_H
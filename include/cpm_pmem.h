@@ -0,0 +1,55 @@
+/*
+ * File: include/cpm_pmem.h
+ * Description: Persistent memory contexts for PMLL.
+ * Backs PMEMContextHandle with an mmap'd region (regular file, tmpfs or DAX mount)
+ * holding the settled state of persistent promises so it survives a crash.
+ * Processes mapping the same region serialize slot claims, settlements, resets and
+ * recovery with an flock on the region file.
+ * Author: Dr. Q Josef Kurk Edwards
+ */
+
+#ifndef CPM_PMEM_H
+#define CPM_PMEM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "cpm_promise.h"
+
+// --- Region Geometry ---
+#define PMEM_CACHE_LINE        64
+#define PMEM_SLOT_KEY_MAX      96
+#define PMEM_SLOT_VALUE_MAX    400
+#define PMEM_DEFAULT_SLOT_COUNT 1024
+
+// --- Context Lifecycle ---
+// Opens (or creates) the region at `path` and runs the recovery pass over it.
+PMEMContextHandle pmem_context_open(const char* path, size_t slot_count);
+void pmem_context_close(PMEMContextHandle ctx);
+// Discards every slot, e.g. once the work the region was tracking has completed.
+void pmem_context_reset(PMEMContextHandle ctx);
+// Number of settled slots found intact by the recovery pass.
+size_t pmem_context_recovered_count(PMEMContextHandle ctx);
+// Region path for a PMLL resource: $CPM_PMEM_DIR (default /tmp/cpm/pmem)/<resource>.pmem
+char* pmem_context_path_for_resource(const char* resource_id);
+
+// --- Slot Access ---
+// Slots are keyed by the identity of the work they track (e.g. a PMLL op_key), so a rerun finds
+// the same slot again; acquiring an existing key reattaches to its recovered state. Keys of
+// PMEM_SLOT_KEY_MAX bytes or more are stored as their SHA-256.
+int pmem_context_acquire_slot(PMEMContextHandle ctx, const char* key);
+// Returns the slot for key to pending so its work can be settled again (e.g. retrying a rejection).
+bool pmem_context_rearm_slot(PMEMContextHandle ctx, const char* key);
+// Records length bytes of value (NULL for no value). Values longer than PMEM_SLOT_VALUE_MAX are
+// refused rather than truncated, and the slot stays pending.
+bool pmem_context_store_settlement(PMEMContextHandle ctx, int slot, PromiseState state,
+                                   const void* value, size_t length);
+// Returns true if the slot holds a settled state; *value is a fresh heap copy of *length bytes
+// plus a terminating NUL (or NULL), owned by the caller.
+bool pmem_context_load_settlement(PMEMContextHandle ctx, int slot, PromiseState* state,
+                                  void** value, size_t* length);
+
+// --- Persistence Primitives ---
+// Flushes the cache lines covering [addr, addr+len) and fences; msyncs when the region is not DAX-mapped.
+void pmem_persist(PMEMContextHandle ctx, const void* addr, size_t len);
+
+#endif // CPM_PMEM_H
@@ -9,29 +9,177 @@
 #define CPM_PMLL_H
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <pthread.h>
 #include "cpm_promise.h"
+#include "cpm_journal.h"
+#include "cpm_proclock.h"
 
 // --- PMLL Hardened Resource Queue ---
+// Operations wait in a pending list. Whichever submitter finds the queue idle
+// becomes its drainer and runs everything queued so far as one batch, outside
+// the lock; submissions made meanwhile (including re-entrant ones from inside
+// an operation) join the next batch.
+typedef struct PMLL_HardenedOp PMLL_HardenedOp;
+typedef struct PMLL_SpaceWaiter PMLL_SpaceWaiter;
+
+// Log2 latency histograms: bucket i counts samples in [2^i, 2^(i+1)) ns
+#define PMLL_HISTOGRAM_BUCKETS 40
+
 typedef struct {
     const char* resource_id;
-    Promise* operation_queue_promise;
     PMLL_Lock queue_lock;
     PMEMContextHandle pmem_queue_ctx;
+    PMLL_Journal* journal;
+    PMLL_HardenedOp* pending_head;
+    PMLL_HardenedOp* pending_tail;
+    size_t pending_count;
+    bool draining;
+    int batch_depth;            // > 0 while pmll_queue_begin_batch() holds the queue
+    PromiseValue last_result;   // Passed as prev_result to the next operation
+    size_t coalesced_count;
+    pthread_t drainer;
+    // Admission control: `depth` counts admitted operations not yet settled
+    size_t capacity;            // 0 = unbounded
+    size_t depth;
+    size_t max_depth;
+    pthread_cond_t space_available;
+    PMLL_SpaceWaiter* space_waiters;
+    uint64_t rejected_count;
+    uint64_t admission_waits;
+    uint64_t admission_wait_ns;
+    uint64_t max_admission_wait_ns;
+    // Statistics (see pmll_dump_stats)
+    uint64_t enqueued_count;
+    uint64_t completed_count;
+    uint64_t failed_count;
+    uint64_t batch_count;
+    size_t max_batch_size;
+    uint64_t total_wait_ns;     // Enqueue to start of execution
+    uint64_t total_exec_ns;
+    uint64_t wait_histogram[PMLL_HISTOGRAM_BUCKETS];
+    uint64_t exec_histogram[PMLL_HISTOGRAM_BUCKETS];
+    uint64_t expired_count;
+    PMLL_ProcessLock* process_lock;  // Cross-process mode (NULL = this process only)
 } PMLL_HardenedResourceQueue;
 
+// --- Queue Metrics ---
+typedef struct {
+    size_t depth;                   // Admitted operations not yet settled
+    size_t max_depth;
+    size_t capacity;
+    size_t coalesced;
+    uint64_t rejected;              // pmll_try_execute() calls refused for lack of space
+    uint64_t admission_waits;       // Blocking submissions that had to wait for space
+    uint64_t admission_wait_ns;     // Total time spent waiting
+    uint64_t max_admission_wait_ns;
+    uint64_t enqueued;
+    uint64_t completed;
+    uint64_t failed;
+    uint64_t batches;
+    uint64_t expired;               // Rejected because their deadline passed while pending
+    size_t max_batch_size;
+    uint64_t total_wait_ns;
+    uint64_t total_exec_ns;
+    uint64_t wait_histogram[PMLL_HISTOGRAM_BUCKETS];
+    uint64_t exec_histogram[PMLL_HISTOGRAM_BUCKETS];
+} PMLL_QueueMetrics;
+
+// --- Per-Operation Options ---
+// Scheduling priorities: pending operations run highest priority first,
+// then earliest deadline, then in submission order. Execution stays serialized;
+// only operations that have not started are reordered.
+#define PMLL_PRIORITY_BACKGROUND  (-10)
+#define PMLL_PRIORITY_NORMAL      0
+#define PMLL_PRIORITY_INTERACTIVE 10
+
+typedef struct {
+    // Stable identity of the operation in the queue's journal and PMEM region. Keyed operations
+    // already committed by an earlier run are skipped; uncommitted ones are replayed.
+    const char* op_key;
+    // Called with (NULL, op_user_data) before replaying an operation that was
+    // interrupted mid-flight, to roll back its partial effects.
+    on_rejected_callback undo_fn;
+    // Pending operations with the same coalesce key collapse into the newest one
+    // (last writer wins); the superseded ones settle with its outcome.
+    const char* coalesce_key;
+    // Releases op_user_data for an operation that is skipped or coalesced away
+    // instead of executed.
+    void (*discard_fn)(void* op_user_data);
+    int priority;               // PMLL_PRIORITY_*; zero-initialized options are NORMAL
+    // Milliseconds from submission by which the operation must start (0 = none).
+    // An operation still pending past its deadline is rejected without running.
+    unsigned int deadline_ms;
+} PMLL_OperationOptions;
+
 // --- PMLL Queue Operations ---
+// Persistent queues keep the settlement of each operation with an op_key in a PMEM region
+// (see cpm_pmem.h). After a crash, re-submitting an operation that already completed skips it:
+// its operation_fn is not called again and op_user_data goes to its discard_fn. Operations that
+// were rejected run again. Once a journal is enabled it alone decides what completed: a PMEM
+// settlement without a COMMITTED journal record is treated as stale and the operation runs.
 PMLL_HardenedResourceQueue* pmll_queue_create(const char* resource_id, bool persistent_queue);
 Promise* pmll_execute_hardened_operation(
     PMLL_HardenedResourceQueue* hq,
     on_fulfilled_callback operation_fn,
     on_rejected_callback error_fn,
     void* op_user_data);
+Promise* pmll_execute_hardened_operation_ex(
+    PMLL_HardenedResourceQueue* hq,
+    const PMLL_OperationOptions* options,
+    on_fulfilled_callback operation_fn,
+    on_rejected_callback error_fn,
+    void* op_user_data);
+// Non-blocking variant: returns NULL without queuing (or calling discard_fn)
+// when the queue is at capacity. The blocking variants above wait for space
+// instead, unless called from the queue's own drainer or inside an open batch,
+// where the operation is admitted over capacity rather than deadlocking.
+Promise* pmll_try_execute(
+    PMLL_HardenedResourceQueue* hq,
+    const PMLL_OperationOptions* options,
+    on_fulfilled_callback operation_fn,
+    on_rejected_callback error_fn,
+    void* op_user_data);
+// Called from inside an operation_fn: the operation's promise is rejected with
+// `reason` instead of resolved, and a journaled operation is recorded as aborted.
+void pmll_operation_fail(PromiseValue reason);
 void pmll_queue_free(PMLL_HardenedResourceQueue* hq);
+// Holds execution while a group of related operations is enqueued; the group
+// runs (and coalesces) as one batch at the matching end_batch. Calls nest.
+void pmll_queue_begin_batch(PMLL_HardenedResourceQueue* hq);
+void pmll_queue_end_batch(PMLL_HardenedResourceQueue* hq);
+// --- Capacity & Backpressure ---
+// Bounds the number of admitted-but-unsettled operations (0 = unbounded, the default).
+void pmll_queue_set_capacity(PMLL_HardenedResourceQueue* hq, size_t capacity);
+// Resolves (with NULL) once the queue has room; immediately if it already does.
+Promise* pmll_queue_when_space_available(PMLL_HardenedResourceQueue* hq);
+size_t pmll_queue_get_depth(PMLL_HardenedResourceQueue* hq);
+void pmll_queue_get_metrics(PMLL_HardenedResourceQueue* hq, PMLL_QueueMetrics* metrics);
+// --- PMLL Write-Ahead Journal ---
+// journal_path may be NULL for the per-resource default (see cpm_journal.h).
+bool pmll_queue_enable_journal(PMLL_HardenedResourceQueue* hq, const char* journal_path);
+// Backs a queue created without persistence with the PMEM region at region_path. Give it
+// the same scope as the queue's cross-process lock: a checkpoint resets the whole region.
+bool pmll_queue_enable_pmem(PMLL_HardenedResourceQueue* hq, const char* region_path);
+bool pmll_queue_is_committed(PMLL_HardenedResourceQueue* hq, const char* op_key);
+// --- Cross-Process Mode ---
+// Serializes the queue's batches with every other process using the same
+// lock_key (NULL = resource id) through a robust shared-memory mutex; with a
+// journal enabled, work committed by another process is skipped and work a
+// crashed process left half-done is rolled back and replayed. Pass e.g. an
+// absolute directory path so unrelated trees don't contend.
+bool pmll_queue_enable_cross_process(PMLL_HardenedResourceQueue* hq, const char* lock_key);
+// Marks the queue's recorded work (PMEM region and journal) as complete so the next run starts fresh.
+void pmll_queue_checkpoint(PMLL_HardenedResourceQueue* hq);
 
 // --- Global PMLL Management ---
 bool pmll_init_global_system(void);
 void pmll_shutdown_global_system(void);
 PMLL_HardenedResourceQueue* pmll_get_default_file_queue(void);
+// Prints per-resource counters and wait/execution latency for every live queue,
+// naming the one callers spent longest serialized behind. Also printed at
+// shutdown when CPM_PMLL_STATS=1.
+void pmll_dump_stats(void);
 
 #endif // CPM_PMLL_H
\ No newline at end of file
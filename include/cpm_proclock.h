@@ -0,0 +1,35 @@
+/*
+ * File: include/cpm_proclock.h
+ * Description: Cross-process PMLL locks.
+ * A robust, process-shared mutex living in a POSIX shared-memory segment named
+ * after a resource key, so separate cpm processes (e.g. parallel CI jobs) can
+ * serialize work on the same modules or cache directory. A lock whose owner
+ * died is recovered by the next acquirer.
+ * Author: Dr. Q Josef Kurk Edwards
+ */
+
+#ifndef CPM_PROCLOCK_H
+#define CPM_PROCLOCK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct PMLL_ProcessLock PMLL_ProcessLock;
+
+// --- Lock Lifecycle ---
+// Handles are shared per key within a process; each open needs a matching close.
+PMLL_ProcessLock* pmll_process_lock_open(const char* key);
+void pmll_process_lock_close(PMLL_ProcessLock* lock);
+
+// --- Locking ---
+// Recursive for the owning thread. Sets *owner_died (if non-NULL) when the
+// previous owner exited while holding the lock: whatever it protected may be
+// half-updated and should be checked or replayed by the caller.
+bool pmll_process_lock_acquire(PMLL_ProcessLock* lock, bool* owner_died);
+void pmll_process_lock_release(PMLL_ProcessLock* lock);
+
+// --- Diagnostics ---
+// Times this lock has been recovered from a dead owner, across all processes.
+uint64_t pmll_process_lock_recoveries(PMLL_ProcessLock* lock);
+
+#endif // CPM_PROCLOCK_H
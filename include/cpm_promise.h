@@ -39,7 +39,12 @@ typedef pthread_mutex_t PMLL_Lock;
 
 // --- Promise API ---
 Promise* promise_create(void);
+// Persistent promises settle with NULL or NUL-terminated string values. Only keyed ones are
+// recorded in the PMEM region: an unkeyed promise could not be found again by a later run.
 Promise* promise_create_persistent(PMEMContextHandle pmem_ctx, PMLL_Lock* lock);
+// Reattaches to `key` in the PMEM region: the promise is returned already settled if a previous run
+// settled it, and the recovered value is freed by promise_free.
+Promise* promise_create_persistent_keyed(PMEMContextHandle pmem_ctx, PMLL_Lock* lock, const char* key);
 void promise_resolve(Promise* p, PromiseValue value);
 void promise_reject(Promise* p, PromiseValue reason);
 Promise* promise_then(Promise* p, on_fulfilled_callback on_fulfilled, 
@@ -49,6 +54,7 @@ void promise_free(Promise* p);
 // --- Q.defer() API ---
 PromiseDeferred* promise_defer_create(void);
 PromiseDeferred* promise_defer_create_persistent(PMEMContextHandle pmem_ctx, PMLL_Lock* lock);
+PromiseDeferred* promise_defer_create_persistent_keyed(PMEMContextHandle pmem_ctx, PMLL_Lock* lock, const char* key);
 void promise_defer_resolve(PromiseDeferred* deferred, PromiseValue value);
 void promise_defer_reject(PromiseDeferred* deferred, PromiseValue reason);
 void promise_defer_free(PromiseDeferred* deferred);
@@ -0,0 +1,73 @@
+/*
+ * File: include/cpm_registry.h
+ * Description: Shared registry HTTP client for CPM.
+ * One client per process keeps a CURLSH (DNS cache, TLS sessions and the
+ * connection pool) so registry traffic reuses connections instead of paying a
+ * TCP/TLS handshake per request, and negotiates HTTP/2 over TLS so concurrent
+ * requests to one registry multiplex onto a single connection.
+ * Synchronous callers borrow preconfigured easy handles; asynchronous GETs run
+ * on the client's own thread (one curl multi handle) and settle a Promise.
+ * Author: Dr. Q Josef Kurk Edwards
+ */
+
+#ifndef CPM_REGISTRY_H
+#define CPM_REGISTRY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <curl/curl.h>
+#include "cpm_promise.h"
+
+#define CPM_REGISTRY_DEFAULT_TIMEOUT 30L
+#define CPM_REGISTRY_USER_AGENT "CPM/1.0"
+
+// --- Responses ---
+typedef struct {
+    CURLcode result;            // CURLE_OK once an HTTP response arrived
+    long status;                // HTTP status, 0 without a response
+    char* body;                 // NUL-terminated, NULL if empty
+    size_t size;
+    char* etag;                 // ETag response header, if any
+} CPM_RegistryResponse;
+
+void cpm_registry_response_free(CPM_RegistryResponse* response);
+
+typedef struct {
+    const char* const* headers; // NULL-terminated extra request headers; may be NULL
+    long timeout_seconds;       // 0 = CPM_REGISTRY_DEFAULT_TIMEOUT
+} CPM_RegistryRequestOptions;
+
+// --- Async Requests ---
+// Queues a GET on the shared client. The promise is fulfilled with a
+// CPM_RegistryResponse* once a response arrives (whatever its status) and
+// rejected with one carrying the curl error if the transfer fails. Callbacks
+// attached with promise_then run on the client thread. The caller owns the
+// promise and the response.
+Promise* registry_get_async(const char* url, const CPM_RegistryRequestOptions* options);
+// Blocks until the promise settles and returns its response either way.
+CPM_RegistryResponse* registry_await(Promise* promise);
+
+// --- Synchronous Transfers ---
+// An easy handle attached to the shared caches, with the client's defaults
+// (user agent, HTTP/2, keep-alive) set; everything else is the caller's.
+CURL* cpm_registry_handle_acquire(void);
+// Counts the transfer the handle made, if any, and returns it to the pool; its
+// options are reset, its connections kept.
+void cpm_registry_handle_release(CURL* curl);
+
+// --- Statistics ---
+typedef struct {
+    size_t requests;            // Transfers finished, sync and async
+    size_t connections;         // New connections they needed
+    size_t http2;               // Transfers that went over HTTP/2 (or later)
+} CPM_RegistryStats;
+
+void cpm_registry_stats(CPM_RegistryStats* stats);
+
+// --- Lifecycle ---
+// The client starts on first use; this waits for in-flight requests and
+// releases it (a later request starts a fresh one). No acquired handle may be
+// outstanding.
+void cpm_registry_client_shutdown(void);
+
+#endif // CPM_REGISTRY_H
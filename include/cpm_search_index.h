@@ -0,0 +1,66 @@
+/*
+ * File: include/cpm_search_index.h
+ * Description: Full-text package search index for CPM.
+ * An inverted index over package name, description and author, written once
+ * to a file and queried straight from an mmap of it. Queries are tokenized
+ * the same way documents are (lowercased runs of letters and digits); each
+ * query token matches its exact term, terms it is a prefix of, and terms
+ * that contain it or are one typo away (via trigrams of the vocabulary).
+ * Matches are ranked with BM25F, name hits weighing most.
+ * Author: Dr. Q Josef Kurk Edwards
+ */
+
+#ifndef CPM_SEARCH_INDEX_H
+#define CPM_SEARCH_INDEX_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "cpm_types.h"
+
+#define CPM_SEARCH_INDEX_SUFFIX ".idx"
+
+// --- Documents ---
+typedef struct {
+    const char* name;
+    const char* version;
+    const char* description;
+    const char* author;
+    const char* homepage;
+    uint64_t downloads;
+} CPM_SearchDocument;
+
+// --- Building ---
+typedef struct CPM_SearchIndexBuilder CPM_SearchIndexBuilder;
+
+CPM_SearchIndexBuilder* cpm_search_index_builder_create(void);
+// Copies the document; NULL fields are stored as "".
+bool cpm_search_index_builder_add(CPM_SearchIndexBuilder* builder, const CPM_SearchDocument* document);
+// Writes the index to path atomically (temp file + rename). stamp is opaque
+// to the index: callers record what the index was built from, to tell later
+// whether it is stale.
+CPM_Result cpm_search_index_builder_write(CPM_SearchIndexBuilder* builder, const char* path, uint64_t stamp);
+void cpm_search_index_builder_free(CPM_SearchIndexBuilder* builder);
+
+// --- Querying ---
+typedef struct CPM_SearchIndex CPM_SearchIndex;
+
+typedef struct {
+    CPM_SearchDocument document;    // Strings point into the index; valid until it is closed
+    double score;
+} CPM_SearchHit;
+
+// NULL if the file is missing, truncated, or not an index this build writes.
+CPM_SearchIndex* cpm_search_index_open(const char* path);
+void cpm_search_index_close(CPM_SearchIndex* index);
+uint64_t cpm_search_index_stamp(const CPM_SearchIndex* index);
+size_t cpm_search_index_document_count(const CPM_SearchIndex* index);
+
+// Fills hits with the best `limit` matches, best first, and returns how many
+// it filled; *total (if given) receives the number of matching documents. A
+// query without tokens matches everything, most downloaded first. Safe to
+// call from several threads on one index.
+size_t cpm_search_index_query(const CPM_SearchIndex* index, const char* query, CPM_SearchHit* hits, size_t limit,
+                              size_t* total);
+
+#endif // CPM_SEARCH_INDEX_H
@@ -53,6 +53,8 @@ bool semver_less(const SemVer* a, const SemVer* b);
 VersionConstraint* semver_parse_constraint(const char* constraint_string);
 void semver_free_constraint(VersionConstraint* constraint);
 bool semver_satisfies(const SemVer* version, const VersionConstraint* constraint);
+// Canonical text form of a constraint (e.g. "^1.2.0"). Caller frees.
+char* semver_constraint_to_string(const VersionConstraint* constraint);
 
 // --- Version Utilities ---
 bool semver_is_valid(const char* version_string);
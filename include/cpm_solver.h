@@ -0,0 +1,57 @@
+/*
+ * File: include/cpm_solver.h
+ * Description: Conflict-driven version solver for CPM (PubGrub-style).
+ * Picks one version per package so every dependency constraint holds, learning
+ * an incompatibility from each conflict and backjumping instead of retrying
+ * combinations, and explains unsatisfiable graphs in plain sentences.
+ * Author: Dr. Q Josef Kurk Edwards
+ */
+
+#ifndef CPM_SOLVER_H
+#define CPM_SOLVER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "cpm_semver.h"
+#include "cpm_deps.h"
+
+// --- Package Provider ---
+// The solver asks for data only as it needs it; results are borrowed and must
+// stay valid until cpm_solver_result_free.
+typedef struct {
+    void* context;
+    // Every known version of a package, newest first. NULL/0 if it doesn't exist.
+    SemVer** (*get_versions)(void* context, const char* name, size_t* count);
+    // Dependencies of name@version.
+    const Dependency* (*get_dependencies)(void* context, const char* name, const SemVer* version);
+    // Optional: version to try before the newest one (e.g. a lockfile pin); NULL = newest.
+    const SemVer* (*preferred_version)(void* context, const char* name);
+} SolverProvider;
+
+// --- Solver Result ---
+typedef struct {
+    const char* name;           // Owned by the result
+    const SemVer* version;      // Borrowed from the provider
+} SolverAssignment;
+
+typedef struct {
+    bool success;
+    SolverAssignment* assignments;  // Sorted by name; the root package is not included
+    size_t assignment_count;
+    char** explanation;             // Why solving failed, one derivation step per line
+    size_t explanation_count;
+
+    // Search statistics
+    size_t decisions;
+    size_t conflicts;
+    size_t learned;
+} SolverResult;
+
+// --- Solving ---
+SolverResult* cpm_solver_solve(const char* root_name, const SemVer* root_version,
+                               const Dependency* root_dependencies, const SolverProvider* provider);
+// Selected version of a package, or NULL if it isn't part of the solution.
+const SemVer* cpm_solver_result_find(const SolverResult* result, const char* name);
+void cpm_solver_result_free(SolverResult* result);
+
+#endif // CPM_SOLVER_H
@@ -0,0 +1,90 @@
+/*
+ * File: include/cpm_store.h
+ * Description: Content-addressable package store for CPM.
+ * One store under <cache_dir>/store is shared by every project on the machine,
+ * keyed by the SHA-256 of the package archive:
+ *   trees/<sha256>/         the archive unpacked (archives themselves are never
+ *                           kept: they are extracted as they download)
+ *   tmp/                    staging; trees appear above only via rename()
+ *   partial/<sha256>/       chunks of an archive whose download was cut off
+ *   aliases/sha512-<hex>    symlink to the key of the archive with that SHA-512,
+ *                           for packages pinned by a sha512 integrity
+ * A project's cpm_modules/<name> is materialized from a tree by reflink
+ * (FICLONE) where the filesystem supports it, else by hardlink, else by copy,
+ * so installing a package that is already stored costs almost no disk or I/O.
+ * Hardlinked files are shared with the store, so packages that run a build or
+ * install command are materialized as private copies (reflink or copy, never
+ * hardlink): whatever their build writes in place stays in the project.
+ * Author: Dr. Q Josef Kurk Edwards
+ */
+
+#ifndef CPM_STORE_H
+#define CPM_STORE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "cpm_types.h"
+
+// --- Store ---
+typedef struct CPM_Store CPM_Store;
+
+typedef enum {
+    CPM_STORE_LINK_REFLINK,
+    CPM_STORE_LINK_HARDLINK,
+    CPM_STORE_LINK_COPY
+} CPM_StoreLinkMethod;
+
+typedef struct {
+    size_t reflinked;
+    size_t hardlinked;
+    size_t copied;
+    uint64_t copied_bytes;
+} CPM_StoreLinkStats;
+
+// Opens (creating if needed) the store under cache_dir. NULL if it can't be created.
+CPM_Store* cpm_store_open(const char* cache_dir);
+void cpm_store_close(CPM_Store* store);
+
+// --- Keys ---
+// Keys are the lowercase hex SHA-256 of an archive. Caller frees.
+// NULL unless integrity is a well-formed "sha256-<base64>" string.
+char* cpm_store_key_from_integrity(const char* integrity);
+char* cpm_store_key_of_file(const char* path);
+// Like cpm_store_key_from_integrity, but a sha512 integrity is also resolved
+// through the aliases an earlier install recorded. NULL if the key is unknown.
+char* cpm_store_lookup_integrity(const CPM_Store* store, const char* integrity);
+// Records that the archive stored under key matched integrity, so the next
+// cpm_store_lookup_integrity finds it. Nothing to do for sha256 integrities.
+bool cpm_store_add_alias(CPM_Store* store, const char* integrity, const char* key);
+
+// --- Entries ---
+// Caller frees the returned paths.
+char* cpm_store_tree_path(const CPM_Store* store, const char* key);
+// Unique path in the store's staging area, on the store's filesystem.
+char* cpm_store_temp_path(CPM_Store* store, const char* hint);
+// Where an interrupted download of the archive with this key keeps its chunks
+// (cpm_download.h), so a later install resumes it.
+char* cpm_store_partial_path(const CPM_Store* store, const char* key);
+bool cpm_store_has_tree(const CPM_Store* store, const char* key);
+
+// Moves a directory unpacked from the archive with this key (ideally staged at
+// a cpm_store_temp_path) to trees/<key>. If another install got there first,
+// staged_dir is removed instead; either way the tree is then in the store.
+CPM_Result cpm_store_add_tree(CPM_Store* store, const char* key, const char* staged_dir);
+
+// --- Materializing ---
+// Recreates trees/<key> at dest_dir (which must not exist yet), linking files
+// with the cheapest method that works. A method that fails with "not supported
+// here" is not tried again for the rest of the store's lifetime. With
+// private_copy no file is hardlinked, so dest_dir may be modified in place.
+CPM_Result cpm_store_materialize(CPM_Store* store, const char* key, const char* dest_dir, bool private_copy,
+                                 CPM_StoreLinkStats* stats);
+
+// --- Removal ---
+// Deletes path and everything below it, walking with nftw and never following
+// symlinks. Any tree may be given, not only store entries. A missing path is
+// not an error.
+bool cpm_store_remove_tree(const char* path);
+
+#endif // CPM_STORE_H
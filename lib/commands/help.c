@@ -21,11 +21,12 @@ static const CommandHelp command_help[] = {
     {
         .command = "install",
         .usage = "cpm install [package-name[@version]] [...]",
-        .description = "Install one or more packages and their dependencies",
+        .description = "Install one or more packages and their dependencies; with no packages,\n"
+                       "  install the dependencies of ./cpm_package.spec as pinned in cpm.lock",
         .examples = {
+            "cpm install",
             "cpm install libmath",
-            "cpm install libmath@1.2.3",
-            "cpm install libmath libutils libnetwork"
+            "cpm install libmath@1.2.3"
         }
     },
     {
@@ -100,6 +101,7 @@ static void display_general_help(void) {
     printf("  --verbose      Enable verbose output\n");
     printf("  --quiet        Suppress non-error output\n");
     printf("  --registry     Specify alternate registry URL\n");
+    printf("  --offline      Use only cached registry metadata\n");
     
     printf("\nConfiguration:\n");
     printf("  CPM uses configuration files similar to npm:\n");
@@ -142,7 +144,8 @@ static void display_command_help(const char* command_name) {
                 printf("  --save-dev     Save to dev dependencies\n");
                 printf("  --global       Install globally\n");
                 printf("  --force        Force reinstall\n");
-                printf("  --no-deps      Skip dependency installation\n\n");
+                printf("  --no-deps      Skip dependency installation\n");
+                printf("  --offline      Resolve from the metadata cache only\n\n");
                 
                 printf("Package Specification:\n");
                 printf("  package-name              # Latest version\n");
@@ -22,25 +22,26 @@ static void read_input(const char* prompt, const char* default_value, char* buff
     }
     printf(": ");
     
-    if (fgets(buffer, buffer_size, stdin)) {
-        // Remove newline
-        buffer[strcspn(buffer, "\n")] = 0;
-        
-        // Use default if empty input
-        if (strlen(buffer) == 0 && default_value) {
-            strncpy(buffer, default_value, buffer_size - 1);
-            buffer[buffer_size - 1] = 0;
-        }
+    // At end of input the answer is empty, as if Enter had been pressed
+    if (!fgets(buffer, buffer_size, stdin)) buffer[0] = '\0';
+    
+    // Remove newline
+    buffer[strcspn(buffer, "\n")] = 0;
+    
+    // Use default if empty input
+    if (strlen(buffer) == 0 && default_value) {
+        strncpy(buffer, default_value, buffer_size - 1);
+        buffer[buffer_size - 1] = 0;
     }
 }
 
 static void read_multiline_input(const char* prompt, char* buffer, size_t buffer_size) {
     printf("%s: ", prompt);
     
-    if (fgets(buffer, buffer_size, stdin)) {
-        // Remove newline
-        buffer[strcspn(buffer, "\n")] = 0;
-    }
+    if (!fgets(buffer, buffer_size, stdin)) buffer[0] = '\0';
+    
+    // Remove newline
+    buffer[strcspn(buffer, "\n")] = 0;
 }
 
 // --- Directory Helper Functions ---
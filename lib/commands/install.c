@@ -9,6 +9,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <limits.h>
 #include <sys/stat.h>
 #include <unistd.h>
 #include "cpm.h"
@@ -16,7 +17,15 @@
 #include "cpm_promise.h"
 #include "cpm_pmll.h"
 #include "cpm_deps.h"
+#include "cpm_installed.h"
 #include "cpm_semver.h"
+#include "cpm_lockfile.h"
+#include "cpm_store.h"
+#include <time.h>
+
+// Project-local install location, relative to the working directory
+#define CPM_LOCAL_MODULES_DIR "cpm_modules"
+#define CPM_LOCAL_SPEC_FILE "cpm_package.spec"
 
 // --- Install Operation Data ---
 typedef struct {
@@ -25,6 +34,25 @@ typedef struct {
     PromiseDeferred* deferred;
 } InstallOpData;
 
+static void install_op_data_free(InstallOpData* data) {
+    free(data->package_name);
+    free(data->modules_dir);
+    if (data->deferred) {
+        promise_free(promise_defer_get_promise(data->deferred));
+        promise_defer_free(data->deferred);
+    }
+    free(data);
+}
+
+// The queue skipped the operation (e.g. completed by an earlier run): it never runs
+static void discard_package_operation(void* user_data) {
+    InstallOpData* data = (InstallOpData*)user_data;
+    char* reason = strdup("Install operation discarded");
+    promise_defer_reject(data->deferred, reason);
+    install_op_data_free(data);
+    free(reason);
+}
+
 PromiseValue download_package_operation(PromiseValue prev_result, void* user_data) {
     InstallOpData* data = (InstallOpData*)user_data;
     
@@ -41,10 +69,9 @@ PromiseValue download_package_operation(PromiseValue prev_result, void* user_dat
     
     if (mkdir(path, 0755) == -1) {
         char* error = strdup("Failed to create package directory");
+        pmll_operation_fail(error);
         promise_defer_reject(data->deferred, error);
-        free(data->package_name);
-        free(data->modules_dir);
-        free(data);
+        install_op_data_free(data);
         return error;
     }
     
@@ -66,16 +93,53 @@ PromiseValue download_package_operation(PromiseValue prev_result, void* user_dat
         fclose(fp);
     }
     
+    const char* installed[] = { data->package_name };
+    cpm_installed_update(data->modules_dir, installed, 1, NULL, 0);
+    
     char* result = strdup("Package downloaded successfully");
     promise_defer_resolve(data->deferred, result);
     
-    free(data->package_name);
-    free(data->modules_dir);
-    free(data);
+    install_op_data_free(data);
     return result;
 }
 
+// Rolls back a download interrupted mid-flight by a previous run
+PromiseValue rollback_package_operation(PromiseValue reason, void* user_data) {
+    (void)reason;
+    InstallOpData* data = (InstallOpData*)user_data;
+    
+    char package_dir[1024];
+    snprintf(package_dir, sizeof(package_dir), "%s/%s", data->modules_dir, data->package_name);
+    cpm_store_remove_tree(package_dir);
+    
+    const char* removed[] = { data->package_name };
+    cpm_installed_update(data->modules_dir, NULL, 0, removed, 1);
+    return NULL;
+}
+
 Promise* cpm_install_package(const char* package_name, const char* modules_dir) {
+    if (!cpm_package_name_is_safe(package_name)) {
+        printf("[CPM Install] '%s' is not a valid package name\n", package_name ? package_name : "");
+        return NULL;
+    }
+    
+    // Keyed by the absolute install path, so the key names the same tree from any working directory
+    char modules_path[PATH_MAX];
+    if (!realpath(modules_dir, modules_path)) {
+        snprintf(modules_path, sizeof(modules_path), "%s", modules_dir);
+    }
+    char op_key[PATH_MAX + 512];
+    snprintf(op_key, sizeof(op_key), "install:%s/%s", modules_path, package_name);
+    
+    PMLL_HardenedResourceQueue* file_queue = pmll_get_default_file_queue();
+    if (file_queue && pmll_queue_is_committed(file_queue, op_key)) {
+        // Completed by an interrupted earlier run
+        printf("[CPM Install] %s already installed by a previous run, skipping\n", package_name);
+        Promise* done = promise_create();
+        promise_resolve(done, strdup("Package already installed"));
+        return done;
+    }
+    
     InstallOpData* data = (InstallOpData*)malloc(sizeof(InstallOpData));
     if (!data) {
         return NULL;
@@ -85,25 +149,20 @@ Promise* cpm_install_package(const char* package_name, const char* modules_dir)
     data->modules_dir = strdup(modules_dir);
     data->deferred = promise_defer_create();
     
-    if (!data->package_name || !data->modules_dir || !data->deferred) {
-        free(data->package_name);
-        free(data->modules_dir);
-        if (data->deferred) promise_defer_free(data->deferred);
-        free(data);
+    if (!data->package_name || !data->modules_dir || !data->deferred || !file_queue) {
+        install_op_data_free(data);
         return NULL;
     }
     
-    PMLL_HardenedResourceQueue* file_queue = pmll_get_default_file_queue();
-    if (!file_queue) {
-        free(data->package_name);
-        free(data->modules_dir);
-        promise_defer_free(data->deferred);
-        free(data);
-        return NULL;
-    }
+    PMLL_OperationOptions options = {
+        .op_key = op_key,
+        .undo_fn = rollback_package_operation,
+        .discard_fn = discard_package_operation
+    };
     
-    return pmll_execute_hardened_operation(
+    return pmll_execute_hardened_operation_ex(
         file_queue,
+        &options,
         download_package_operation,
         NULL,
         data
@@ -183,16 +242,124 @@ Promise* install_resolve_dependencies(Package* pkg, const char* modules_dir) {
     return promise_defer_get_promise(data->deferred);
 }
 
+// --- Project Install (cpm_package.spec + cpm.lock) ---
+static double install_elapsed_ms(const struct timespec* start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - start->tv_sec) * 1000.0 + (double)(now.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+// Installs the project's dependencies. A cpm.lock written for the current spec
+// is installed as-is; otherwise the spec is re-resolved from the lock (only what
+// the change reaches) and the lock rewritten. Either way only packages whose
+// version changed are touched in cpm_modules.
+static CPM_Result install_from_spec(const CPM_Config* config) {
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    
+    Package* pkg = cpm_parse_package_file(CPM_LOCAL_SPEC_FILE);
+    if (!pkg) {
+        printf("Error: could not read %s\n", CPM_LOCAL_SPEC_FILE);
+        return CPM_RESULT_ERROR_PACKAGE_PARSE;
+    }
+    
+    char binary_path[512];
+    snprintf(binary_path, sizeof(binary_path), "%s/%s", CPM_LOCAL_MODULES_DIR, CPM_LOCKFILE_BINARY_NAME);
+    mkdir(CPM_LOCAL_MODULES_DIR, 0755);
+    
+    DepResolution* resolution = NULL;
+    DepResolution* previous = NULL;     // What the lock had, when the spec moved on
+    bool use_lock = !config || config->use_package_lock;
+    
+    if (use_lock) {
+        CPM_Lockfile* lock = cpm_lockfile_load(CPM_LOCKFILE_NAME, binary_path);
+        if (lock && cpm_lockfile_matches(lock, pkg)) {
+            resolution = cpm_lockfile_to_resolution(lock);
+            if (resolution) {
+                printf("[CPM Install] Using %s: %zu packages, loaded in %.2f ms\n",
+                       CPM_LOCKFILE_NAME, resolution->install_count, install_elapsed_ms(&start));
+            }
+        } else if (lock) {
+            printf("[CPM Install] %s is out of date with %s, resolving the change\n", CPM_LOCKFILE_NAME, CPM_LOCAL_SPEC_FILE);
+            previous = cpm_lockfile_to_resolution(lock);
+        }
+        cpm_lockfile_close(lock);
+    }
+    
+    if (!resolution) {
+        resolution = previous && config ? cpm_resolve_dependencies_incremental(pkg, config, previous)
+                                        : cpm_resolve_dependencies_with_config(pkg, config);
+        if (!resolution || cpm_detect_dependency_conflicts(resolution)) {
+            printf("[CPM Install] Could not resolve the dependencies of %s\n", pkg->name ? pkg->name : CPM_LOCAL_SPEC_FILE);
+            cpm_resolution_free(resolution);
+            cpm_resolution_free(previous);
+            cpm_free_package(pkg);
+            return CPM_RESULT_ERROR_DEPENDENCY_RESOLUTION;
+        }
+        
+        if (use_lock && cpm_lockfile_write(resolution, pkg, CPM_LOCKFILE_NAME, binary_path) != CPM_RESULT_SUCCESS) {
+            printf("[CPM Install] Warning: could not write %s\n", CPM_LOCKFILE_NAME);
+        }
+    }
+    
+    CPM_Result result = cpm_install_dependencies_incremental(resolution, previous, ".", config);
+    cpm_resolution_free(resolution);
+    cpm_resolution_free(previous);
+    cpm_free_package(pkg);
+    return result;
+}
+
 // --- Main Install Command Handler ---
 CPM_Result cpm_handle_install_command(int argc, char* argv[], const CPM_Config* config) {
     printf("[CPM Install] Starting install command\n");
     
+    // Options (e.g. --offline) were already applied to config; the rest are package names
+    int package_count = 0;
+    for (int i = 0; i < argc; i++) {
+        if (strncmp(argv[i], "--", 2) != 0) argv[package_count++] = argv[i];
+    }
+    argc = package_count;
+    
     if (argc < 1) {
+        // Bare "cpm install" installs the project described by cpm_package.spec
+        if (access(CPM_LOCAL_SPEC_FILE, F_OK) == 0) {
+            return install_from_spec(config);
+        }
         printf("Error: install command requires at least one package name.\n");
         printf("Usage: cpm install <package1> [package2...]\n");
         return CPM_RESULT_ERROR_INVALID_ARGS;
     }
     
+    const char* modules_dir = CPM_LOCAL_MODULES_DIR;
+    
+    // Journal each package install so an interrupted run resumes where it stopped
+    mkdir(modules_dir, 0755);
+    char journal_path[512];
+    snprintf(journal_path, sizeof(journal_path), "%s/.cpm_journal", modules_dir);
+    PMLL_HardenedResourceQueue* file_queue = pmll_get_default_file_queue();
+    if (!pmll_queue_enable_journal(file_queue, journal_path)) {
+        printf("[CPM Install] Warning: install journal unavailable, installs will not be resumable\n");
+    }
+    
+    // The PMEM region lives beside the journal, so it goes when the directory does and
+    // shares the scope of the cross-process lock below
+    char region_path[512];
+    snprintf(region_path, sizeof(region_path), "%s/.cpm_pmem", modules_dir);
+    if (!pmll_queue_enable_pmem(file_queue, region_path)) {
+        printf("[CPM Install] Warning: persistent memory region unavailable for %s\n", modules_dir);
+    }
+    
+    // Other cpm processes (e.g. parallel CI jobs) may be installing into the same directory
+    char modules_path[PATH_MAX];
+    if (!realpath(modules_dir, modules_path) || !pmll_queue_enable_cross_process(file_queue, modules_path)) {
+        printf("[CPM Install] Warning: could not lock %s against concurrent cpm processes\n", modules_dir);
+    }
+    
+    // Bound the install fan-out: producers wait once this many operations are in flight
+    if (config && config->max_concurrent_downloads > 0) {
+        pmll_queue_set_capacity(file_queue, (size_t)config->max_concurrent_downloads);
+    }
+    
     // Create promises for all package installations
     Promise** install_promises = (Promise**)malloc(argc * sizeof(Promise*));
     if (!install_promises) {
@@ -202,7 +369,7 @@ CPM_Result cpm_handle_install_command(int argc, char* argv[], const CPM_Config*
     for (int i = 0; i < argc; i++) {
         printf("[CPM Install] Initiating install for: %s\n", argv[i]);
         
-        install_promises[i] = cpm_install_package(argv[i], config->modules_directory);
+        install_promises[i] = cpm_install_package(argv[i], modules_dir);
         if (!install_promises[i]) {
             printf("[CPM Install] Failed to create install promise for: %s\n", argv[i]);
             
@@ -252,16 +419,19 @@ CPM_Result cpm_handle_install_command(int argc, char* argv[], const CPM_Config*
     if (promise_get_state(all_promise) == PROMISE_FULFILLED) {
         printf("[CPM Install] All packages installed successfully!\n");
         
+        // Everything landed: the next install starts with a clean journal
+        pmll_queue_checkpoint(file_queue);
+        
         // Try to resolve dependencies for installed packages
         for (int i = 0; i < argc; i++) {
             char pkg_path[512];
             snprintf(pkg_path, sizeof(pkg_path), "%s/%s/cpm_package.spec", 
-                    config->modules_directory, argv[i]);
+                    modules_dir, argv[i]);
             
             Package* pkg = cpm_parse_package_file(pkg_path);
             if (pkg && pkg->dep_count > 0) {
                 printf("[CPM Install] Resolving dependencies for %s...\n", argv[i]);
-                Promise* dep_promise = install_resolve_dependencies(pkg, config->modules_directory);
+                Promise* dep_promise = install_resolve_dependencies(pkg, modules_dir);
                 if (dep_promise) {
                     // In a real implementation, would properly wait for this
                     printf("[CPM Install] Dependency resolution initiated for %s\n", argv[i]);
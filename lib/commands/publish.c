@@ -16,6 +16,7 @@
 #include "cpm_package.h"
 #include "cpm_promise.h"
 #include "cpm_pmll.h"
+#include "cpm_registry.h"
 
 // --- HTTP Response Structure ---
 typedef struct {
@@ -64,7 +65,7 @@ static bool upload_to_registry(const char* package_name, const char* version, co
     HTTPResponse response = {0};
     bool success = false;
     
-    curl = curl_easy_init();
+    curl = cpm_registry_handle_acquire();
     if (!curl) {
         printf("[CPM Publish] Failed to initialize CURL\n");
         return false;
@@ -119,8 +120,8 @@ static bool upload_to_registry(const char* package_name, const char* version, co
     }
     
     // Cleanup
+    cpm_registry_handle_release(curl);
     curl_mime_free(form);
-    curl_easy_cleanup(curl);
     if (response.data) free(response.data);
     
     return success;
@@ -181,9 +182,6 @@ CPM_Result cpm_handle_publish_command(int argc, char* argv[], const CPM_Config*
         return CPM_RESULT_ERROR_COMMAND_FAILED;
     }
     
-    // Initialize curl
-    curl_global_init(CURL_GLOBAL_DEFAULT);
-    
     // Parse package spec to get name and version
     char spec_file[512];
     snprintf(spec_file, sizeof(spec_file), "%s/cpm_package.spec", package_path);
@@ -191,7 +189,6 @@ CPM_Result cpm_handle_publish_command(int argc, char* argv[], const CPM_Config*
     Package* pkg = cpm_parse_package_file(spec_file);
     if (!pkg) {
         printf("[CPM Publish] Error: Failed to parse package specification\n");
-        curl_global_cleanup();
         return CPM_RESULT_ERROR_COMMAND_FAILED;
     }
     
@@ -202,7 +199,6 @@ CPM_Result cpm_handle_publish_command(int argc, char* argv[], const CPM_Config*
     if (!create_package_archive(package_path, archive_file)) {
         printf("[CPM Publish] Error: Failed to create package archive\n");
         cpm_free_package(pkg);
-        curl_global_cleanup();
         return CPM_RESULT_ERROR_COMMAND_FAILED;
     }
     
@@ -214,7 +210,6 @@ CPM_Result cpm_handle_publish_command(int argc, char* argv[], const CPM_Config*
     // Cleanup
     unlink(archive_file); // Remove temporary archive
     cpm_free_package(pkg);
-    curl_global_cleanup();
     
     if (upload_success) {
         printf("[CPM Publish] Package published successfully!\n");
@@ -13,6 +13,7 @@
 #include <unistd.h>
 #include "cpm.h"
 #include "cpm_package.h"
+#include "cpm_json.h"
 
 // --- Script Execution ---
 static bool execute_script(const char* script_command, const char* script_name) {
@@ -30,60 +31,115 @@ static bool execute_script(const char* script_command, const char* script_name)
 }
 
 // --- Parse Scripts from Package Spec ---
-static char* find_script_in_spec(const char* script_name, const char* spec_content) {
-    // Simple JSON-like parsing for scripts section
-    // In a real implementation, you'd use a proper JSON parser
-    
-    char* scripts_start = strstr(spec_content, "\"scripts\":");
-    if (!scripts_start) {
-        return NULL;
-    }
-    
-    // Find the opening brace for scripts object
-    char* brace_start = strchr(scripts_start, '{');
-    if (!brace_start) {
-        return NULL;
-    }
-    
-    // Find the closing brace for scripts object
-    char* brace_end = strchr(brace_start + 1, '}');
-    if (!brace_end) {
-        return NULL;
+typedef struct {
+    char** names;
+    char** commands;
+    size_t count;
+} ScriptList;
+
+static void free_script_list(ScriptList* scripts) {
+    for (size_t i = 0; i < scripts->count; i++) {
+        free(scripts->names[i]);
+        free(scripts->commands[i]);
+    }
+    free(scripts->names);
+    free(scripts->commands);
+    memset(scripts, 0, sizeof(*scripts));
+}
+
+static bool script_list_add(ScriptList* scripts, char* name, char* command, size_t* capacity) {
+    if (!name || !command) {
+        free(name);
+        free(command);
+        return false;
     }
-    
-    // Search for the script name within the scripts object
-    char search_pattern[256];
-    snprintf(search_pattern, sizeof(search_pattern), "\"%s\":", script_name);
-    
-    char* script_line = strstr(brace_start, search_pattern);
-    if (!script_line || script_line > brace_end) {
-        return NULL;
+    if (scripts->count == *capacity) {
+        size_t grown_capacity = *capacity ? *capacity * 2 : 8;
+        char** names = realloc(scripts->names, grown_capacity * sizeof(char*));
+        if (names) scripts->names = names;
+        char** commands = names ? realloc(scripts->commands, grown_capacity * sizeof(char*)) : NULL;
+        if (!commands) {
+            free(name);
+            free(command);
+            return false;
+        }
+        scripts->commands = commands;
+        *capacity = grown_capacity;
     }
-    
-    // Find the start of the script command (after the colon and quote)
-    char* command_start = strchr(script_line + strlen(search_pattern), '"');
-    if (!command_start) {
-        return NULL;
+    scripts->names[scripts->count] = name;
+    scripts->commands[scripts->count] = command;
+    scripts->count++;
+    return true;
+}
+
+// Reads the top-level "scripts" member, either {"name": "command", ...} or
+// ["name: command", ...]. False if the spec is malformed or has no scripts.
+static bool parse_scripts(const char* spec_content, ScriptList* scripts) {
+    CPM_JsonReader reader;
+    CPM_JsonToken token;
+    memset(scripts, 0, sizeof(*scripts));
+    cpm_json_reader_init(&reader, spec_content, strlen(spec_content));
+    if (!cpm_json_next(&reader, &token) || token.type != CPM_JSON_OBJECT_START) {
+        return false;
     }
-    command_start++; // Skip the opening quote
     
-    // Find the end of the script command
-    char* command_end = strchr(command_start, '"');
-    if (!command_end) {
-        return NULL;
+    while (cpm_json_next(&reader, &token) && token.type == CPM_JSON_KEY) {
+        if (!cpm_json_string_equals(&token, "scripts")) {
+            cpm_json_skip(&reader, &token);
+            continue;
+        }
+        
+        CPM_JsonToken open;
+        if (!cpm_json_next(&reader, &open) || (open.type != CPM_JSON_OBJECT_START && open.type != CPM_JSON_ARRAY_START)) {
+            return false;
+        }
+        
+        size_t capacity = 0;
+        CPM_JsonToken key = { 0 };
+        while (cpm_json_next(&reader, &token) && token.depth > open.depth) {
+            if (token.type == CPM_JSON_KEY) {
+                key = token;
+                continue;
+            }
+            if (token.type != CPM_JSON_STRING) {
+                cpm_json_skip(&reader, &token);
+                continue;
+            }
+            
+            char* name;
+            char* command;
+            if (open.type == CPM_JSON_OBJECT_START) {
+                name = cpm_json_string_dup(&key);
+                command = cpm_json_string_dup(&token);
+            } else {
+                // "name: command"; entries without a colon are skipped
+                char* entry = cpm_json_string_dup(&token);
+                char* colon = entry ? strchr(entry, ':') : NULL;
+                if (!colon) {
+                    free(entry);
+                    continue;
+                }
+                const char* text = colon + 1;
+                while (*text == ' ') text++;
+                command = strdup(text);
+                *colon = '\0';
+                name = entry;
+            }
+            if (!script_list_add(scripts, name, command, &capacity)) break;
+        }
+        return true;
     }
     
-    // Extract the command
-    size_t command_length = command_end - command_start;
-    char* command = malloc(command_length + 1);
-    if (!command) {
-        return NULL;
+    return false;
+}
+
+static const char* find_script(const ScriptList* scripts, const char* script_name) {
+    for (size_t i = 0; i < scripts->count; i++) {
+        if (strcmp(scripts->names[i], script_name) == 0) {
+            return scripts->commands[i];
+        }
     }
-    
-    strncpy(command, command_start, command_length);
-    command[command_length] = '\0';
-    
-    return command;
+    return NULL;
 }
 
 // --- Load and Parse Package Spec ---
@@ -121,78 +177,19 @@ static char* load_package_spec(void) {
 }
 
 // --- List Available Scripts ---
-static void list_available_scripts(const char* spec_content) {
+static void list_available_scripts(const ScriptList* scripts, bool has_scripts) {
     printf("[CPM Run-Script] Available scripts:\n");
     
-    char* scripts_start = strstr(spec_content, "\"scripts\":");
-    if (!scripts_start) {
+    if (!has_scripts) {
         printf("  No scripts defined in cpm_package.spec\n");
         return;
     }
     
-    // Find the opening brace for scripts object
-    char* brace_start = strchr(scripts_start, '{');
-    if (!brace_start) {
-        printf("  Invalid scripts section in cpm_package.spec\n");
-        return;
+    for (size_t i = 0; i < scripts->count; i++) {
+        printf("  %-15s %s\n", scripts->names[i], scripts->commands[i]);
     }
     
-    // Find the closing brace for scripts object
-    char* brace_end = strchr(brace_start + 1, '}');
-    if (!brace_end) {
-        printf("  Invalid scripts section in cpm_package.spec\n");
-        return;
-    }
-    
-    // Parse script entries (simple approach)
-    char* current = brace_start + 1;
-    bool found_any = false;
-    
-    while (current < brace_end) {
-        // Find next quote
-        char* quote_start = strchr(current, '"');
-        if (!quote_start || quote_start >= brace_end) {
-            break;
-        }
-        
-        // Find end of script name
-        char* quote_end = strchr(quote_start + 1, '"');
-        if (!quote_end || quote_end >= brace_end) {
-            break;
-        }
-        
-        // Extract script name
-        size_t name_length = quote_end - quote_start - 1;
-        char script_name[256];
-        if (name_length < sizeof(script_name)) {
-            strncpy(script_name, quote_start + 1, name_length);
-            script_name[name_length] = '\0';
-            
-            // Find the command
-            char* colon = strchr(quote_end, ':');
-            if (colon && colon < brace_end) {
-                char* cmd_quote_start = strchr(colon, '"');
-                if (cmd_quote_start && cmd_quote_start < brace_end) {
-                    char* cmd_quote_end = strchr(cmd_quote_start + 1, '"');
-                    if (cmd_quote_end && cmd_quote_end < brace_end) {
-                        size_t cmd_length = cmd_quote_end - cmd_quote_start - 1;
-                        char command[512];
-                        if (cmd_length < sizeof(command)) {
-                            strncpy(command, cmd_quote_start + 1, cmd_length);
-                            command[cmd_length] = '\0';
-                            
-                            printf("  %-15s %s\n", script_name, command);
-                            found_any = true;
-                        }
-                    }
-                }
-            }
-        }
-        
-        current = quote_end + 1;
-    }
-    
-    if (!found_any) {
+    if (scripts->count == 0) {
         printf("  No valid scripts found in cpm_package.spec\n");
     }
     
@@ -209,10 +206,14 @@ CPM_Result cpm_handle_run_script_command(int argc, char* argv[], const CPM_Confi
         return CPM_RESULT_ERROR_COMMAND_FAILED;
     }
     
+    ScriptList scripts;
+    bool has_scripts = parse_scripts(spec_content, &scripts);
+    free(spec_content);
+    
     // If no script name provided, list available scripts
     if (argc == 0 || !argv[0] || strlen(argv[0]) == 0) {
-        list_available_scripts(spec_content);
-        free(spec_content);
+        list_available_scripts(&scripts, has_scripts);
+        free_script_list(&scripts);
         return CPM_RESULT_SUCCESS;
     }
     
@@ -220,13 +221,13 @@ CPM_Result cpm_handle_run_script_command(int argc, char* argv[], const CPM_Confi
     printf("[CPM Run-Script] Looking for script: %s\n", script_name);
     
     // Find the script in the package spec
-    char* script_command = find_script_in_spec(script_name, spec_content);
+    const char* script_command = find_script(&scripts, script_name);
     
     if (!script_command) {
         printf("[CPM Run-Script] Error: Script '%s' not found in cpm_package.spec\n", script_name);
         printf("[CPM Run-Script] \n");
-        list_available_scripts(spec_content);
-        free(spec_content);
+        list_available_scripts(&scripts, has_scripts);
+        free_script_list(&scripts);
         return CPM_RESULT_ERROR_COMMAND_FAILED;
     }
     
@@ -234,8 +235,7 @@ CPM_Result cpm_handle_run_script_command(int argc, char* argv[], const CPM_Confi
     bool success = execute_script(script_command, script_name);
     
     // Cleanup
-    free(script_command);
-    free(spec_content);
+    free_script_list(&scripts);
     
     return success ? CPM_RESULT_SUCCESS : CPM_RESULT_ERROR_COMMAND_FAILED;
-}
\ No newline at end of file
+}
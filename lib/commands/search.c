@@ -9,16 +9,14 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <curl/curl.h>
 #include "cpm.h"
+#include "cpm_installed.h"
+#include "cpm_json.h"
 #include "cpm_package.h"
 #include "cpm_promise.h"
-
-// --- HTTP Response Structure ---
-typedef struct {
-    char* data;
-    size_t size;
-} HTTPResponse;
+#include "cpm_registry.h"
 
 // --- Search Result Structure ---
 typedef struct {
@@ -27,63 +25,116 @@ typedef struct {
     char* description;
     char* author;
     char* homepage;
-    int downloads;
+    long long downloads;
 } SearchResult;
 
-// --- HTTP Write Callback ---
-static size_t http_write_callback(void* contents, size_t size, size_t nmemb, HTTPResponse* response) {
-    size_t total_size = size * nmemb;
-    
-    response->data = realloc(response->data, response->size + total_size + 1);
-    if (response->data == NULL) {
-        printf("[CPM Search] Memory allocation failed\n");
-        return 0;
+// --- Parse Search Response ---
+static void free_search_result_fields(SearchResult* results, int count) {
+    for (int i = 0; i < count; i++) {
+        free(results[i].name);
+        free(results[i].version);
+        free(results[i].description);
+        free(results[i].author);
+        free(results[i].homepage);
     }
-    
-    memcpy(&(response->data[response->size]), contents, total_size);
-    response->size += total_size;
-    response->data[response->size] = 0;
-    
-    return total_size;
 }
 
-// --- Parse Search Response (JSON-like) ---
-static SearchResult* parse_search_results(const char* response_data, int* result_count) {
+// Fills result from the entry object whose start was just read; unknown
+// members are skipped
+static bool parse_search_result(CPM_JsonReader* reader, SearchResult* result) {
+    CPM_JsonToken token;
+    while (cpm_json_next(reader, &token) && token.type == CPM_JSON_KEY) {
+        CPM_JsonToken key = token;
+        if (!cpm_json_next(reader, &token)) return false;
+        
+        char** field = NULL;
+        if (cpm_json_string_equals(&key, "name")) field = &result->name;
+        else if (cpm_json_string_equals(&key, "version")) field = &result->version;
+        else if (cpm_json_string_equals(&key, "description")) field = &result->description;
+        else if (cpm_json_string_equals(&key, "author")) field = &result->author;
+        else if (cpm_json_string_equals(&key, "homepage")) field = &result->homepage;
+        
+        int64_t downloads;
+        if (field && token.type == CPM_JSON_STRING) {
+            free(*field);
+            *field = cpm_json_string_dup(&token);
+            if (!*field) return false;
+        } else if (cpm_json_string_equals(&key, "downloads") && cpm_json_int64(&token, &downloads)) {
+            result->downloads = downloads;
+        } else if (!cpm_json_skip(reader, &token)) {
+            return false;
+        }
+    }
+    return token.type == CPM_JSON_OBJECT_END;
+}
+
+// {"query": ..., "packages": [{...}, ...], "total": n}; *total_count gets
+// "total", which a server that caps its answer reports beyond what it sent
+static SearchResult* parse_search_results(const char* response_data, size_t response_size, int* result_count,
+                                          long* total_count) {
     *result_count = 0;
+    *total_count = 0;
     
     if (!response_data) {
         return NULL;
     }
     
-    // For now, create mock results since we don't have a full JSON parser
-    // In a real implementation, you'd use a JSON parsing library like cJSON
+    CPM_JsonReader reader;
+    CPM_JsonToken token;
+    cpm_json_reader_init(&reader, response_data, response_size);
+    if (!cpm_json_next(&reader, &token) || token.type != CPM_JSON_OBJECT_START) return NULL;
     
-    SearchResult* results = calloc(3, sizeof(SearchResult));
-    if (!results) return NULL;
-    
-    // Mock search results for demonstration
-    results[0].name = strdup("libmath");
-    results[0].version = strdup("1.2.3");
-    results[0].description = strdup("Mathematical library for C");
-    results[0].author = strdup("Math Developers");
-    results[0].homepage = strdup("https://github.com/mathdev/libmath");
-    results[0].downloads = 1500;
-    
-    results[1].name = strdup("libutils");
-    results[1].version = strdup("2.0.1");
-    results[1].description = strdup("Utility functions for C development");
-    results[1].author = strdup("Utils Team");
-    results[1].homepage = strdup("https://github.com/utilsteam/libutils");
-    results[1].downloads = 2300;
+    SearchResult* results = calloc(1, sizeof(SearchResult));
+    int capacity = 1;
+    bool has_total = false;
+    bool ok = results != NULL;
+    while (ok && cpm_json_next(&reader, &token) && token.type == CPM_JSON_KEY) {
+        CPM_JsonToken key = token;
+        ok = cpm_json_next(&reader, &token);
+        if (!ok) break;
+        
+        int64_t total;
+        if (cpm_json_string_equals(&key, "packages") && token.type == CPM_JSON_ARRAY_START) {
+            while (ok && cpm_json_next(&reader, &token) && token.type == CPM_JSON_OBJECT_START) {
+                if (*result_count == capacity) {
+                    SearchResult* grown = realloc(results, (size_t)capacity * 2 * sizeof(SearchResult));
+                    if (!grown) {
+                        ok = false;
+                        break;
+                    }
+                    results = grown;
+                    capacity *= 2;
+                }
+                SearchResult* result = &results[*result_count];
+                memset(result, 0, sizeof(*result));
+                (*result_count)++;
+                ok = parse_search_result(&reader, result);
+            }
+            ok = ok && token.type == CPM_JSON_ARRAY_END;
+        } else if (cpm_json_string_equals(&key, "total") && cpm_json_int64(&token, &total) && total >= 0) {
+            *total_count = (long)total;
+            has_total = true;
+        } else {
+            ok = cpm_json_skip(&reader, &token);
+        }
+    }
     
-    results[2].name = strdup("libnetwork");
-    results[2].version = strdup("0.9.5");
-    results[2].description = strdup("Network programming utilities");
-    results[2].author = strdup("Network Group");
-    results[2].homepage = strdup("https://github.com/netgroup/libnetwork");
-    results[2].downloads = 890;
+    if (!ok || token.type != CPM_JSON_OBJECT_END) {
+        if (results) free_search_result_fields(results, *result_count);
+        free(results);
+        *result_count = 0;
+        return NULL;
+    }
     
-    *result_count = 3;
+    // Fields a server left out print as empty
+    for (int i = 0; i < *result_count; i++) {
+        char** fields[] = { &results[i].name, &results[i].version, &results[i].description,
+                            &results[i].author, &results[i].homepage };
+        for (size_t f = 0; f < sizeof(fields) / sizeof(fields[0]); f++) {
+            if (!*fields[f]) *fields[f] = strdup("");
+        }
+    }
+    if (!has_total || *total_count < *result_count) *total_count = *result_count;
     return results;
 }
 
@@ -91,29 +142,27 @@ static SearchResult* parse_search_results(const char* response_data, int* result
 static void free_search_results(SearchResult* results, int count) {
     if (!results) return;
     
-    for (int i = 0; i < count; i++) {
-        free(results[i].name);
-        free(results[i].version);
-        free(results[i].description);
-        free(results[i].author);
-        free(results[i].homepage);
-    }
+    free_search_result_fields(results, count);
     free(results);
 }
 
 // --- Display Search Results ---
-static void display_search_results(const SearchResult* results, int count, const char* query) {
+static void display_search_results(const SearchResult* results, int count, long total, const char* query) {
     if (count == 0) {
         printf("[CPM Search] No packages found matching '%s'\n", query);
         return;
     }
     
-    printf("\n[CPM Search] Found %d package(s) matching '%s':\n\n", count, query);
+    if (total > count) {
+        printf("\n[CPM Search] Found %ld package(s) matching '%s', showing the best %d:\n\n", total, query, count);
+    } else {
+        printf("\n[CPM Search] Found %d package(s) matching '%s':\n\n", count, query);
+    }
     printf("%-20s %-10s %-40s %-15s %s\n", "NAME", "VERSION", "DESCRIPTION", "DOWNLOADS", "AUTHOR");
     printf("%-20s %-10s %-40s %-15s %s\n", "----", "-------", "-----------", "---------", "------");
     
     for (int i = 0; i < count; i++) {
-        printf("%-20s %-10s %-40.40s %-15d %s\n",
+        printf("%-20s %-10s %-40.40s %-15lld %s\n",
                results[i].name,
                results[i].version,
                results[i].description,
@@ -129,66 +178,57 @@ static void display_search_results(const SearchResult* results, int count, const
 
 // --- Search Registry ---
 static bool search_registry(const char* query, const char* registry_url) {
-    CURL* curl;
-    CURLcode res;
-    HTTPResponse response = {0};
     bool success = false;
     
-    curl = curl_easy_init();
-    if (!curl) {
-        printf("[CPM Search] Failed to initialize CURL\n");
-        return false;
-    }
-    
     // Build search URL
     char search_url[1024];
-    char* encoded_query = curl_easy_escape(curl, query, 0);
+    char* encoded_query = curl_easy_escape(NULL, query, 0);
+    if (!encoded_query) {
+        printf("[CPM Search] Memory allocation failed\n");
+        return false;
+    }
     snprintf(search_url, sizeof(search_url), "%s/packages/search?q=%s", registry_url, encoded_query);
     curl_free(encoded_query);
     
-    curl_easy_setopt(curl, CURLOPT_URL, search_url);
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, http_write_callback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-    curl_easy_setopt(curl, CURLOPT_USERAGENT, "CPM/1.0");
-    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 30L);
-    
     printf("[CPM Search] Searching registry: %s\n", registry_url);
-    res = curl_easy_perform(curl);
+    Promise* request = registry_get_async(search_url, NULL);
+    CPM_RegistryResponse* response = registry_await(request);
+    promise_free(request);
+    if (!response) {
+        printf("[CPM Search] Failed to start search request\n");
+        return false;
+    }
     
-    if (res == CURLE_OK) {
-        long response_code;
-        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response_code);
-        
-        if (response_code == 200) {
+    if (response->result == CURLE_OK) {
+        if (response->status == 200) {
             // Parse and display results
             int result_count;
-            SearchResult* results = parse_search_results(response.data, &result_count);
+            long total_count;
+            SearchResult* results = parse_search_results(response->body, response->size, &result_count, &total_count);
             
             if (results) {
-                display_search_results(results, result_count, query);
+                display_search_results(results, result_count, total_count, query);
                 free_search_results(results, result_count);
                 success = true;
             } else {
                 printf("[CPM Search] Failed to parse search results\n");
             }
         } else {
-            printf("[CPM Search] Search failed with HTTP code: %ld\n", response_code);
-            if (response.data) {
-                printf("[CPM Search] Server response: %s\n", response.data);
+            printf("[CPM Search] Search failed with HTTP code: %ld\n", response->status);
+            if (response->body) {
+                printf("[CPM Search] Server response: %s\n", response->body);
             }
         }
     } else {
-        printf("[CPM Search] Search request failed: %s\n", curl_easy_strerror(res));
+        printf("[CPM Search] Search request failed: %s\n", curl_easy_strerror(response->result));
     }
     
-    // Cleanup
-    curl_easy_cleanup(curl);
-    if (response.data) free(response.data);
-    
+    cpm_registry_response_free(response);
     return success;
 }
 
 // --- Local Package Search ---
+// Answered from each location's installed-package index (cpm_installed.h)
 static void search_local_packages(const char* query) {
     printf("[CPM Search] Searching local packages for: %s\n", query);
     
@@ -203,23 +243,19 @@ static void search_local_packages(const char* query) {
     bool found_any = false;
     
     for (int i = 0; search_paths[i] != NULL; i++) {
-        char command[512];
-        snprintf(command, sizeof(command), "find \"%s\" -name \"*%s*\" -type d 2>/dev/null", 
-                search_paths[i], query);
-        
-        FILE* fp = popen(command, "r");
-        if (fp) {
-            char line[256];
-            while (fgets(line, sizeof(line), fp)) {
-                // Remove newline
-                line[strcspn(line, "\n")] = 0;
-                if (strlen(line) > 0) {
-                    printf("  Found locally: %s\n", line);
-                    found_any = true;
-                }
+        CPM_InstalledIndex* index = cpm_installed_open(search_paths[i]);
+        size_t count = cpm_installed_search(index, query, NULL, 0);
+        const CPM_InstalledPackage** matches = count ? malloc(count * sizeof(*matches)) : NULL;
+        if (matches) {
+            cpm_installed_search(index, query, matches, count);
+            for (size_t m = 0; m < count; m++) {
+                printf("  Found locally: %s%s%s (%s)\n", matches[m]->name, *matches[m]->version ? "@" : "",
+                       matches[m]->version, matches[m]->path);
             }
-            pclose(fp);
+            found_any = true;
+            free(matches);
         }
+        cpm_installed_close(index);
     }
     
     if (!found_any) {
@@ -238,9 +274,6 @@ CPM_Result cpm_handle_search_command(int argc, char* argv[], const CPM_Config* c
     const char* query = argv[0];
     printf("[CPM Search] Searching for: %s\n", query);
     
-    // Initialize curl
-    curl_global_init(CURL_GLOBAL_DEFAULT);
-    
     // Search registry
     const char* registry_url = (config && config->registry_url) ? 
                               config->registry_url : "http://localhost:8080";
@@ -251,9 +284,6 @@ CPM_Result cpm_handle_search_command(int argc, char* argv[], const CPM_Config* c
     printf("\n");
     search_local_packages(query);
     
-    // Cleanup
-    curl_global_cleanup();
-    
     if (registry_success) {
         return CPM_RESULT_SUCCESS;
     } else {
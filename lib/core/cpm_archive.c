@@ -0,0 +1,638 @@
+/*
+ * File: lib/core/cpm_archive.c
+ * Description: Streaming package archive extraction for CPM.
+ * Compressed input goes through SHA-256 and zlib's inflate; the inflated bytes
+ * drive a small tar state machine (512-byte headers, entry data, padding).
+ * Understands ustar/GNU headers, pax "path"/"linkpath" records and GNU long
+ * names, which covers what tar(1) produces for `cpm publish`.
+ * Author: Dr. Q Josef Kurk Edwards
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <zlib.h>
+#ifdef SYS_openat2
+#include <linux/openat2.h>
+#endif
+#include "cpm_archive.h"
+
+#define TAR_BLOCK_SIZE 512
+#define ARCHIVE_INFLATE_CHUNK 65536
+#define ARCHIVE_MAX_METADATA (1024 * 1024)     // Largest pax header / GNU long name accepted
+
+typedef enum {
+    TAR_HEADER,
+    TAR_DATA,
+    TAR_PADDING,
+    TAR_END
+} TarState;
+
+typedef enum {
+    ENTRY_FILE,                 // Data goes to fd
+    ENTRY_METADATA,             // Data is a pax header or GNU long name, kept in metadata
+    ENTRY_SKIP                  // Data is ignored
+} EntryKind;
+
+// A symlink entry, created once every other entry is on disk
+typedef struct {
+    char* path;
+    char* target;
+} ArchiveLink;
+
+struct CPM_ArchiveStream {
+    char* dest;
+    int dest_fd;                // Every entry is resolved from here, one component at a time
+    CPM_Result error;
+    CPM_SHA256 hash;
+    unsigned char magic[2];
+    size_t magic_seen;
+    
+    z_stream zlib;
+    bool zlib_ready;
+    bool zlib_ended;            // Current gzip member is complete
+    unsigned char inflated[ARCHIVE_INFLATE_CHUNK];
+    
+    TarState state;
+    unsigned char header[TAR_BLOCK_SIZE];
+    size_t header_used;
+    uint64_t remaining;         // Data bytes left in the current entry
+    uint64_t padding;           // Zero bytes after the data, up to the next block
+    EntryKind kind;
+    char type;                  // Typeflag of the entry being read
+    int fd;
+    
+    char* metadata;
+    size_t metadata_used;
+    char* next_path;            // From pax / GNU headers, for the next entry only
+    char* next_link;
+    
+    ArchiveLink* links;
+    size_t link_count;
+    size_t link_capacity;
+    
+    size_t file_count;
+    uint64_t unpacked_bytes;
+};
+
+// --- Internal Helper Functions ---
+static void archive_fail(CPM_ArchiveStream* stream, CPM_Result error) {
+    if (stream->error == CPM_RESULT_SUCCESS) stream->error = error;
+}
+
+static uint64_t tar_number(const unsigned char* field, size_t size) {
+    // GNU base-256 for values that don't fit the octal field
+    if (field[0] & 0x80) {
+        uint64_t value = field[0] & 0x7f;
+        for (size_t i = 1; i < size; i++) value = value << 8 | field[i];
+        return value;
+    }
+    
+    uint64_t value = 0;
+    size_t i = 0;
+    while (i < size && (field[i] == ' ' || field[i] == '\0')) i++;
+    for (; i < size && field[i] >= '0' && field[i] <= '7'; i++) value = value * 8 + (uint64_t)(field[i] - '0');
+    return value;
+}
+
+static bool tar_checksum_valid(const unsigned char* header) {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < TAR_BLOCK_SIZE; i++) sum += (i >= 148 && i < 156) ? ' ' : header[i];
+    return sum == tar_number(header + 148, 8);
+}
+
+static char* tar_string(const unsigned char* field, size_t size) {
+    return strndup((const char*)field, size);
+}
+
+// Archive path with "." components dropped, or NULL if it is absolute or
+// climbs out of the tree. "" names the root itself.
+static char* archive_safe_path(const char* name) {
+    if (!name || name[0] == '/') return NULL;
+    
+    char* out = malloc(strlen(name) + 1);
+    if (!out) return NULL;
+    
+    size_t used = 0;
+    const char* p = name;
+    while (*p) {
+        const char* end = strchr(p, '/');
+        size_t length = end ? (size_t)(end - p) : strlen(p);
+        if (length == 2 && p[0] == '.' && p[1] == '.') {
+            free(out);
+            return NULL;
+        }
+        if (length > 0 && !(length == 1 && p[0] == '.')) {
+            if (used > 0) out[used++] = '/';
+            memcpy(out + used, p, length);
+            used += length;
+        }
+        p += length;
+        if (*p == '/') p++;
+    }
+    out[used] = '\0';
+    return out;
+}
+
+// A symlink at path may point anywhere inside the tree, but not out of it
+static bool archive_link_target_safe(const char* path, const char* target) {
+    if (!target || target[0] == '/') return false;
+    
+    int depth = 0;
+    for (const char* p = path; *p; p++) {
+        if (*p == '/') depth++;
+    }
+    
+    const char* p = target;
+    while (*p) {
+        const char* end = strchr(p, '/');
+        size_t length = end ? (size_t)(end - p) : strlen(p);
+        if (length == 2 && p[0] == '.' && p[1] == '.') {
+            if (--depth < 0) return false;
+        } else if (length > 0 && !(length == 1 && p[0] == '.')) {
+            depth++;
+        }
+        p += length;
+        if (*p == '/') p++;
+    }
+    return true;
+}
+
+static bool make_directory(const char* path, mode_t mode) {
+    if (mkdir(path, mode) == 0) return true;
+    struct stat st;
+    return errno == EEXIST && stat(path, &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+// Opens the directory that holds relative's last component, walking down
+// from dest one component at a time and never following a symlink, so no
+// entry can be written through a link an earlier entry (or anything already
+// in dest) planted. Missing directories are created when create is set.
+// *leaf is set to the last component; -1 if the walk is refused.
+static int archive_open_parent(const CPM_ArchiveStream* stream, const char* relative, bool create, const char** leaf) {
+    int dir = fcntl(stream->dest_fd, F_DUPFD_CLOEXEC, 0);
+    const char* p = relative;
+    const char* slash;
+    
+    while (dir >= 0 && (slash = strchr(p, '/')) != NULL) {
+        char component[NAME_MAX + 1];
+        size_t length = (size_t)(slash - p);
+        if (length == 0 || length > NAME_MAX) {
+            close(dir);
+            return -1;
+        }
+        memcpy(component, p, length);
+        component[length] = '\0';
+        
+        int next = openat(dir, component, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+        if (next < 0 && errno == ENOENT && create && (mkdirat(dir, component, 0755) == 0 || errno == EEXIST)) {
+            next = openat(dir, component, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+        }
+        close(dir);
+        dir = next;
+        p = slash + 1;
+    }
+    *leaf = p;
+    return dir;
+}
+
+// Whether the symlink at relative, now on disk, resolves without leaving
+// dest (a target may go through other links the text check can't see)
+static bool archive_link_resolves_beneath(const CPM_ArchiveStream* stream, const char* relative) {
+#ifdef SYS_openat2
+    struct open_how how = { .flags = O_PATH | O_CLOEXEC, .resolve = RESOLVE_BENEATH };
+    int fd = (int)syscall(SYS_openat2, stream->dest_fd, relative, &how, sizeof(how));
+    if (fd >= 0) {
+        close(fd);
+        return true;
+    }
+    // Dangling inside the tree is fine; ENOSYS/EPERM: kernel or sandbox without openat2
+    return errno == ENOENT || errno == ENOSYS || errno == EPERM;
+#else
+    (void)stream;
+    (void)relative;
+    return true;
+#endif
+}
+
+static void archive_defer_link(CPM_ArchiveStream* stream, const char* relative, const char* target) {
+    if (stream->link_count == stream->link_capacity) {
+        size_t capacity = stream->link_capacity ? stream->link_capacity * 2 : 16;
+        ArchiveLink* links = realloc(stream->links, capacity * sizeof(ArchiveLink));
+        if (!links) {
+            archive_fail(stream, CPM_RESULT_ERROR_MEMORY_ALLOCATION);
+            return;
+        }
+        stream->links = links;
+        stream->link_capacity = capacity;
+    }
+    ArchiveLink* link = &stream->links[stream->link_count];
+    link->path = strdup(relative);
+    link->target = strdup(target);
+    if (!link->path || !link->target) {
+        free(link->path);
+        free(link->target);
+        archive_fail(stream, CPM_RESULT_ERROR_MEMORY_ALLOCATION);
+        return;
+    }
+    stream->link_count++;
+}
+
+// Symlinks go in last, in archive order, so none of them can redirect a
+// file or directory entry. Their parents are walked like any entry's, which
+// refuses a link placed through another link.
+static void archive_create_links(CPM_ArchiveStream* stream) {
+    for (size_t i = 0; i < stream->link_count && stream->error == CPM_RESULT_SUCCESS; i++) {
+        const ArchiveLink* link = &stream->links[i];
+        const char* leaf;
+        int dir = archive_open_parent(stream, link->path, true, &leaf);
+        bool ok = dir >= 0;
+        if (ok) {
+            unlinkat(dir, leaf, 0);
+            ok = symlinkat(link->target, dir, leaf) == 0;
+        }
+        if (ok && !archive_link_resolves_beneath(stream, link->path)) {
+            unlinkat(dir, leaf, 0);
+            ok = false;
+        }
+        if (dir >= 0) close(dir);
+        if (!ok) archive_fail(stream, CPM_RESULT_ERROR_FILE_OPERATION);
+    }
+}
+
+// --- Tar Entries ---
+static void archive_parse_pax(CPM_ArchiveStream* stream) {
+    // Records are "<length> <key>=<value>\n", length counting the whole record
+    size_t offset = 0;
+    while (offset < stream->metadata_used) {
+        char* record = stream->metadata + offset;
+        char* space = memchr(record, ' ', stream->metadata_used - offset);
+        size_t length = (size_t)strtoul(record, NULL, 10);
+        if (!space || length == 0 || length > stream->metadata_used - offset) break;
+        
+        char* key = space + 1;
+        char* equals = memchr(key, '=', (size_t)(record + length - key));
+        if (equals && record[length - 1] == '\n') {
+            char* value = strndup(equals + 1, (size_t)(record + length - 1 - (equals + 1)));
+            if (strncmp(key, "path=", 5) == 0) {
+                free(stream->next_path);
+                stream->next_path = value;
+            } else if (strncmp(key, "linkpath=", 9) == 0) {
+                free(stream->next_link);
+                stream->next_link = value;
+            } else {
+                free(value);
+            }
+        }
+        offset += length;
+    }
+}
+
+static void archive_end_entry(CPM_ArchiveStream* stream) {
+    if (stream->kind == ENTRY_FILE && stream->fd >= 0) {
+        if (close(stream->fd) != 0) archive_fail(stream, CPM_RESULT_ERROR_FILE_OPERATION);
+        stream->fd = -1;
+    } else if (stream->kind == ENTRY_METADATA) {
+        if (stream->type == 'x') {
+            archive_parse_pax(stream);
+        } else {
+            char* value = strndup(stream->metadata, stream->metadata_used);
+            char** slot = stream->type == 'L' ? &stream->next_path : &stream->next_link;
+            free(*slot);
+            *slot = value;
+        }
+        free(stream->metadata);
+        stream->metadata = NULL;
+        stream->metadata_used = 0;
+    }
+}
+
+static void archive_create_entry(CPM_ArchiveStream* stream, const char* relative, const char* link_name, mode_t mode) {
+    if (stream->type == '2') {
+        if (archive_link_target_safe(relative, link_name)) {
+            archive_defer_link(stream, relative, link_name);
+        } else {
+            archive_fail(stream, CPM_RESULT_ERROR_FILE_OPERATION);
+        }
+        return;
+    }
+    
+    const char* leaf;
+    int dir = archive_open_parent(stream, relative, true, &leaf);
+    if (dir < 0) {
+        archive_fail(stream, CPM_RESULT_ERROR_FILE_OPERATION);
+        return;
+    }
+    
+    bool ok = true;
+    switch (stream->type) {
+        case '5': {
+            struct stat st;
+            ok = mkdirat(dir, leaf, (mode & 07777) | 0700) == 0 ||
+                 (errno == EEXIST && fstatat(dir, leaf, &st, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(st.st_mode));
+            break;
+        }
+        case '1': {
+            // The target is resolved the same way: it must already be a
+            // regular entry of this tree
+            char* safe_link = archive_safe_path(link_name);
+            const char* target_leaf = NULL;
+            int target_dir = safe_link && safe_link[0] ? archive_open_parent(stream, safe_link, false, &target_leaf) : -1;
+            unlinkat(dir, leaf, 0);
+            ok = target_dir >= 0 && linkat(target_dir, target_leaf, dir, leaf, 0) == 0;
+            if (target_dir >= 0) close(target_dir);
+            free(safe_link);
+            break;
+        }
+        default:
+            // Never write through whatever an earlier entry left at this path
+            unlinkat(dir, leaf, 0);
+            stream->fd = openat(dir, leaf, O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, mode & 07777);
+            ok = stream->fd >= 0;
+            if (ok) {
+                stream->kind = ENTRY_FILE;
+                stream->file_count++;
+            }
+            break;
+    }
+    close(dir);
+    if (!ok) archive_fail(stream, CPM_RESULT_ERROR_FILE_OPERATION);
+}
+
+static void archive_begin_entry(CPM_ArchiveStream* stream) {
+    const unsigned char* header = stream->header;
+    
+    bool zero = true;
+    for (size_t i = 0; i < TAR_BLOCK_SIZE && zero; i++) zero = header[i] == 0;
+    if (zero) {
+        stream->state = TAR_END;
+        return;
+    }
+    if (!tar_checksum_valid(header)) {
+        archive_fail(stream, CPM_RESULT_ERROR_PACKAGE_PARSE);
+        return;
+    }
+    
+    stream->type = (char)header[156];
+    stream->remaining = tar_number(header + 124, 12);
+    stream->padding = (TAR_BLOCK_SIZE - stream->remaining % TAR_BLOCK_SIZE) % TAR_BLOCK_SIZE;
+    stream->kind = ENTRY_SKIP;
+    stream->fd = -1;
+    
+    switch (stream->type) {
+        case 'x':
+        case 'L':
+        case 'K':
+            if (stream->remaining > ARCHIVE_MAX_METADATA) {
+                archive_fail(stream, CPM_RESULT_ERROR_PACKAGE_PARSE);
+                return;
+            }
+            stream->kind = ENTRY_METADATA;
+            stream->metadata = malloc(stream->remaining + 1);
+            stream->metadata_used = 0;
+            if (!stream->metadata) archive_fail(stream, CPM_RESULT_ERROR_MEMORY_ALLOCATION);
+            break;
+        case '\0': case '0': case '7':
+        case '1': case '2': case '5': {
+            char* name = stream->next_path;
+            char* link_name = stream->next_link;
+            stream->next_path = NULL;
+            stream->next_link = NULL;
+            
+            if (!name) {
+                // ustar splits long names into prefix "/" name
+                char* base = tar_string(header, 100);
+                char* prefix = memcmp(header + 257, "ustar", 5) == 0 ? tar_string(header + 345, 155) : NULL;
+                if (prefix && prefix[0] && base && asprintf(&name, "%s/%s", prefix, base) < 0) name = NULL;
+                if (!name && base) name = strdup(base);
+                free(base);
+                free(prefix);
+            }
+            if (!link_name) link_name = tar_string(header + 157, 100);
+            
+            char* relative = archive_safe_path(name);
+            if (!relative || !link_name) {
+                archive_fail(stream, CPM_RESULT_ERROR_PACKAGE_PARSE);
+            } else if (relative[0]) {
+                archive_create_entry(stream, relative, link_name, (mode_t)tar_number(header + 100, 8));
+            }
+            free(relative);
+            free(name);
+            free(link_name);
+            break;
+        }
+        default:
+            // Devices, FIFOs, global pax headers: nothing to unpack
+            break;
+    }
+    
+    if (stream->remaining == 0) {
+        archive_end_entry(stream);
+        stream->state = stream->padding > 0 ? TAR_PADDING : TAR_HEADER;
+    } else {
+        stream->state = TAR_DATA;
+    }
+}
+
+static void archive_entry_data(CPM_ArchiveStream* stream, const unsigned char* data, size_t size) {
+    if (stream->kind == ENTRY_FILE) {
+        while (size > 0) {
+            ssize_t written = write(stream->fd, data, size);
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                archive_fail(stream, CPM_RESULT_ERROR_FILE_OPERATION);
+                return;
+            }
+            data += written;
+            size -= (size_t)written;
+            stream->unpacked_bytes += (uint64_t)written;
+        }
+    } else if (stream->kind == ENTRY_METADATA) {
+        memcpy(stream->metadata + stream->metadata_used, data, size);
+        stream->metadata_used += size;
+    }
+}
+
+static void archive_tar_feed(CPM_ArchiveStream* stream, const unsigned char* data, size_t size) {
+    while (size > 0 && stream->error == CPM_RESULT_SUCCESS) {
+        size_t take;
+        switch (stream->state) {
+            case TAR_HEADER:
+                take = TAR_BLOCK_SIZE - stream->header_used;
+                if (take > size) take = size;
+                memcpy(stream->header + stream->header_used, data, take);
+                stream->header_used += take;
+                if (stream->header_used == TAR_BLOCK_SIZE) {
+                    stream->header_used = 0;
+                    archive_begin_entry(stream);
+                }
+                break;
+            case TAR_DATA:
+                take = stream->remaining < size ? (size_t)stream->remaining : size;
+                archive_entry_data(stream, data, take);
+                stream->remaining -= take;
+                if (stream->remaining == 0) {
+                    archive_end_entry(stream);
+                    stream->state = stream->padding > 0 ? TAR_PADDING : TAR_HEADER;
+                }
+                break;
+            case TAR_PADDING:
+                take = stream->padding < size ? (size_t)stream->padding : size;
+                stream->padding -= take;
+                if (stream->padding == 0) stream->state = TAR_HEADER;
+                break;
+            case TAR_END:
+            default:
+                // Trailing blocks after the end-of-archive marker
+                return;
+        }
+        data += take;
+        size -= take;
+    }
+}
+
+// --- Streaming Extraction ---
+CPM_ArchiveStream* cpm_archive_stream_create(const char* dest_dir) {
+    if (!dest_dir) return NULL;
+    
+    CPM_ArchiveStream* stream = calloc(1, sizeof(CPM_ArchiveStream));
+    if (!stream) return NULL;
+    
+    stream->dest = strdup(dest_dir);
+    stream->fd = -1;
+    stream->dest_fd = -1;
+    cpm_sha256_init(&stream->hash);
+    
+    // 16 + MAX_WBITS: expect a gzip wrapper
+    stream->zlib_ready = inflateInit2(&stream->zlib, 16 + MAX_WBITS) == Z_OK;
+    if (stream->dest && make_directory(dest_dir, 0755)) {
+        stream->dest_fd = open(dest_dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    }
+    if (!stream->dest || !stream->zlib_ready || stream->dest_fd < 0) {
+        cpm_archive_stream_free(stream);
+        return NULL;
+    }
+    return stream;
+}
+
+void cpm_archive_stream_free(CPM_ArchiveStream* stream) {
+    if (!stream) return;
+    
+    if (stream->fd >= 0) close(stream->fd);
+    if (stream->dest_fd >= 0) close(stream->dest_fd);
+    if (stream->zlib_ready) inflateEnd(&stream->zlib);
+    for (size_t i = 0; i < stream->link_count; i++) {
+        free(stream->links[i].path);
+        free(stream->links[i].target);
+    }
+    free(stream->links);
+    free(stream->metadata);
+    free(stream->next_path);
+    free(stream->next_link);
+    free(stream->dest);
+    free(stream);
+}
+
+bool cpm_archive_stream_is_archive(const CPM_ArchiveStream* stream) {
+    if (!stream) return false;
+    if (stream->magic_seen >= 1 && stream->magic[0] != 0x1f) return false;
+    return stream->magic_seen < 2 || stream->magic[1] == 0x8b;
+}
+
+size_t cpm_archive_stream_file_count(const CPM_ArchiveStream* stream) {
+    return stream ? stream->file_count : 0;
+}
+
+uint64_t cpm_archive_stream_unpacked_bytes(const CPM_ArchiveStream* stream) {
+    return stream ? stream->unpacked_bytes : 0;
+}
+
+CPM_Result cpm_archive_stream_write(CPM_ArchiveStream* stream, const void* data, size_t size) {
+    if (!stream || (!data && size > 0)) return CPM_RESULT_ERROR_INVALID_ARGS;
+    if (stream->error != CPM_RESULT_SUCCESS) return stream->error;
+    
+    cpm_sha256_update(&stream->hash, data, size);
+    for (size_t i = 0; i < size && stream->magic_seen < 2; i++) stream->magic[stream->magic_seen++] = ((const unsigned char*)data)[i];
+    if (!cpm_archive_stream_is_archive(stream)) {
+        archive_fail(stream, CPM_RESULT_ERROR_PACKAGE_PARSE);
+        return stream->error;
+    }
+    
+    z_stream* zlib = &stream->zlib;
+    zlib->next_in = (unsigned char*)data;
+    zlib->avail_in = (uInt)size;
+    
+    while (stream->error == CPM_RESULT_SUCCESS && stream->state != TAR_END) {
+        if (stream->zlib_ended) {
+            if (zlib->avail_in == 0) break;
+            // Another gzip member follows; concatenated members are one stream
+            inflateReset(zlib);
+            stream->zlib_ended = false;
+        }
+        
+        zlib->next_out = stream->inflated;
+        zlib->avail_out = sizeof(stream->inflated);
+        int z = inflate(zlib, Z_NO_FLUSH);
+        if (z == Z_STREAM_END) {
+            stream->zlib_ended = true;
+        } else if (z != Z_OK && z != Z_BUF_ERROR) {
+            archive_fail(stream, CPM_RESULT_ERROR_PACKAGE_PARSE);
+            break;
+        }
+        
+        archive_tar_feed(stream, stream->inflated, sizeof(stream->inflated) - zlib->avail_out);
+        if (!stream->zlib_ended && zlib->avail_in == 0 && zlib->avail_out != 0) break;
+    }
+    return stream->error;
+}
+
+CPM_Result cpm_archive_stream_finish(CPM_ArchiveStream* stream, unsigned char digest[CPM_SHA256_DIGEST_SIZE]) {
+    if (!stream) return CPM_RESULT_ERROR_INVALID_ARGS;
+    if (stream->error != CPM_RESULT_SUCCESS) return stream->error;
+    
+    // Truncated mid-entry, or gzip data cut short
+    bool complete = stream->state == TAR_END || (stream->state == TAR_HEADER && stream->header_used == 0);
+    if (!complete || (!stream->zlib_ended && stream->state != TAR_END) || stream->magic_seen < 2) {
+        archive_fail(stream, CPM_RESULT_ERROR_PACKAGE_PARSE);
+        return stream->error;
+    }
+    
+    archive_create_links(stream);
+    if (stream->error != CPM_RESULT_SUCCESS) return stream->error;
+    
+    if (digest) cpm_sha256_final(&stream->hash, digest);
+    return CPM_RESULT_SUCCESS;
+}
+
+// --- Whole Files ---
+CPM_Result cpm_archive_extract_file(const char* archive, const char* dest_dir) {
+    if (!archive || !dest_dir) return CPM_RESULT_ERROR_INVALID_ARGS;
+    
+    FILE* f = fopen(archive, "rb");
+    if (!f) return CPM_RESULT_ERROR_FILE_OPERATION;
+    
+    CPM_ArchiveStream* stream = cpm_archive_stream_create(dest_dir);
+    if (!stream) {
+        fclose(f);
+        return CPM_RESULT_ERROR_FILE_OPERATION;
+    }
+    
+    unsigned char buffer[65536];
+    size_t n;
+    CPM_Result result = CPM_RESULT_SUCCESS;
+    while (result == CPM_RESULT_SUCCESS && (n = fread(buffer, 1, sizeof(buffer), f)) > 0) {
+        result = cpm_archive_stream_write(stream, buffer, n);
+    }
+    if (result == CPM_RESULT_SUCCESS) result = ferror(f) ? CPM_RESULT_ERROR_FILE_OPERATION : cpm_archive_stream_finish(stream, NULL);
+    
+    fclose(f);
+    cpm_archive_stream_free(stream);
+    return result;
+}
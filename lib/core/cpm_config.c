@@ -12,6 +12,7 @@
 #include <sys/stat.h>
 #include <pwd.h>
 #include "cpm_config.h"
+#include "cpm_metacache.h"
 
 // --- Internal Helper Functions ---
 static char* strdup_safe(const char* str) {
@@ -82,8 +83,11 @@ CPM_Config* cpm_config_create_default(void) {
     
     // Advanced settings
     config->max_concurrent_downloads = 4;
+    config->download_chunk_mb = 8;
     config->use_package_lock = true;
     config->auto_install_deps = true;
+    config->metadata_ttl = CPM_METADATA_DEFAULT_TTL;
+    config->offline = false;
     
     return config;
 }
@@ -194,10 +198,16 @@ static void parse_config_line(CPM_Config* config, const char* line) {
         config->default_license = strdup(value_copy);
     } else if (strcmp(key, "max_concurrent_downloads") == 0) {
         config->max_concurrent_downloads = atoi(value_copy);
+    } else if (strcmp(key, "download_chunk_mb") == 0) {
+        config->download_chunk_mb = atoi(value_copy);
     } else if (strcmp(key, "use_package_lock") == 0) {
         config->use_package_lock = (strcmp(value_copy, "true") == 0 || strcmp(value_copy, "1") == 0);
     } else if (strcmp(key, "auto_install_deps") == 0) {
         config->auto_install_deps = (strcmp(value_copy, "true") == 0 || strcmp(value_copy, "1") == 0);
+    } else if (strcmp(key, "metadata_ttl") == 0) {
+        config->metadata_ttl = atoi(value_copy);
+    } else if (strcmp(key, "offline") == 0) {
+        config->offline = (strcmp(value_copy, "true") == 0 || strcmp(value_copy, "1") == 0);
     }
     
     free(key);
@@ -300,8 +310,11 @@ CPM_Result cpm_config_save_to_file(const CPM_Config* config, const char* config_
     
     fprintf(f, "# Advanced settings\n");
     fprintf(f, "max_concurrent_downloads=%d\n", config->max_concurrent_downloads);
+    fprintf(f, "download_chunk_mb=%d\n", config->download_chunk_mb);
     fprintf(f, "use_package_lock=%s\n", config->use_package_lock ? "true" : "false");
     fprintf(f, "auto_install_deps=%s\n", config->auto_install_deps ? "true" : "false");
+    fprintf(f, "metadata_ttl=%d\n", config->metadata_ttl);
+    fprintf(f, "offline=%s\n", config->offline ? "true" : "false");
     
     fclose(f);
     return CPM_RESULT_SUCCESS;
@@ -397,6 +410,10 @@ CPM_Config* cpm_config_merge_with_env(const CPM_Config* base_config) {
         config->quiet = (strcmp(env_value, "true") == 0 || strcmp(env_value, "1") == 0);
     }
     
+    if ((env_value = getenv("CPM_OFFLINE")) != NULL) {
+        config->offline = (strcmp(env_value, "true") == 0 || strcmp(env_value, "1") == 0);
+    }
+    
     return config;
 }
 
@@ -416,6 +433,8 @@ void cpm_config_apply_command_line_args(CPM_Config* config, int argc, char* argv
             config->registry_url = strdup(argv[i] + 11);
         } else if (strncmp(argv[i], "--timeout=", 10) == 0) {
             config->timeout_seconds = atoi(argv[i] + 10);
+        } else if (strcmp(argv[i], "--offline") == 0) {
+            config->offline = true;
         }
     }
 }
\ No newline at end of file
@@ -8,8 +8,15 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <time.h>
 #include <curl/curl.h>
 #include "cpm_deps.h"
+#include "cpm_json.h"
+#include "cpm_metacache.h"
+#include "cpm_solver.h"
+#include "cpm_registry.h"
 
 // --- Internal Helper Functions ---
 static char* strdup_safe(const char* str) {
@@ -23,21 +30,6 @@ typedef struct {
     size_t size;
 } HTTPResponse;
 
-static size_t http_write_callback(void* contents, size_t size, size_t nmemb, HTTPResponse* response) {
-    size_t total_size = size * nmemb;
-    
-    response->data = realloc(response->data, response->size + total_size + 1);
-    if (response->data == NULL) {
-        return 0;
-    }
-    
-    memcpy(&(response->data[response->size]), contents, total_size);
-    response->size += total_size;
-    response->data[response->size] = 0;
-    
-    return total_size;
-}
-
 // --- Dependency Operations ---
 Dependency* cpm_dependency_create(const char* name, const char* constraint_str) {
     if (!name) return NULL;
@@ -64,6 +56,25 @@ Dependency* cpm_dependency_create(const char* name, const char* constraint_str)
     return dep;
 }
 
+// "name@constraint" (or just "name", meaning any version)
+Dependency* cpm_dependency_parse_spec(const char* spec) {
+    if (!spec) return NULL;
+    
+    char* name = strdup(spec);
+    if (!name) return NULL;
+    
+    char* at_sign = strchr(name, '@');
+    const char* constraint = NULL;
+    if (at_sign) {
+        *at_sign = '\0';
+        constraint = at_sign + 1;
+    }
+    
+    Dependency* dep = cpm_dependency_create(name, constraint);
+    free(name);
+    return dep;
+}
+
 void cpm_dependency_free(Dependency* dep) {
     if (!dep) return;
     
@@ -108,6 +119,7 @@ void cpm_depnode_free(DepNode* node) {
     free(node->name);
     semver_free(node->version);
     free(node->resolved_url);
+    free(node->integrity);
     cpm_dependency_list_free(node->dependencies);
     
     if (node->children) {
@@ -133,51 +145,381 @@ CPM_Result cpm_depnode_add_child(DepNode* parent, DepNode* child) {
 }
 
 // --- Registry Communication ---
-static SemVer** fetch_package_versions(const char* package_name, const char* registry_url, size_t* count) {
-    *count = 0;
+// How a batch of registry GETs is performed
+typedef struct {
+    int max_concurrent;
+    long timeout_seconds;
+    long cache_ttl;          // Seconds a cached document is served without revalidation
+    bool offline;            // Serve only from the metadata cache
+} RegistryFetchPolicy;
+
+// One registry GET, performed concurrently with others on the shared registry client
+typedef struct {
+    char* url;
+    char* cache_path;        // NULL = not cached
+    HTTPResponse response;
+    long http_status;
+    CURLcode result;
+    
+    // Metadata cache state
+    char* cached_body;
+    char* cached_etag;
+    char* response_etag;
+    bool settled;            // Served without a network transfer
+    bool offline_miss;
+} RegistryFetch;
+
+// Counts for the per-resolution summary line
+typedef struct {
+    size_t network;
+    size_t cache_hits;
+    size_t revalidated;
+    size_t stale;            // Served from an expired cached copy because the registry failed
+    size_t connections;      // New connections the network requests opened
+} RegistryFetchStats;
+
+static void registry_fetch_init(RegistryFetch* fetch, const char* url, char* cache_path) {
+    memset(fetch, 0, sizeof(*fetch));
+    fetch->url = strdup_safe(url);
+    fetch->cache_path = cache_path;
+    fetch->result = CURLE_FAILED_INIT;
+}
+
+static void registry_fetch_cleanup(RegistryFetch* fetch) {
+    free(fetch->url);
+    free(fetch->cache_path);
+    free(fetch->response.data);
+    free(fetch->cached_body);
+    free(fetch->cached_etag);
+    free(fetch->response_etag);
+}
+
+static bool registry_fetch_ok(const RegistryFetch* fetch) {
+    return fetch->result == CURLE_OK && fetch->http_status < 400 && fetch->response.data;
+}
+
+// Queues the GET on the shared client, revalidating a stale cached copy
+// instead of downloading it again
+static Promise* registry_fetch_start(RegistryFetch* fetch, const RegistryFetchPolicy* policy) {
+    char header[512];
+    const char* headers[2] = { NULL, NULL };
+    if (fetch->cache_path && fetch->cached_etag) {
+        snprintf(header, sizeof(header), "If-None-Match: %s", fetch->cached_etag);
+        headers[0] = header;
+    }
     
-    CURL* curl = curl_easy_init();
-    if (!curl) return NULL;
+    CPM_RegistryRequestOptions options = { .headers = headers, .timeout_seconds = policy->timeout_seconds };
+    return registry_get_async(fetch->url, &options);
+}
+
+// Waits for the GET and takes over its response
+static void registry_fetch_complete(RegistryFetch* fetch, Promise* promise) {
+    CPM_RegistryResponse* response = registry_await(promise);
+    promise_free(promise);
+    if (!response) return;
+    
+    fetch->result = response->result;
+    fetch->http_status = response->status;
+    free(fetch->response.data);
+    fetch->response.data = response->body;
+    fetch->response.size = response->size;
+    if (fetch->cache_path) {
+        free(fetch->response_etag);
+        fetch->response_etag = response->etag;
+        response->etag = NULL;
+    }
+    response->body = NULL;
+    cpm_registry_response_free(response);
+}
+
+// Serves a fetch from its cached copy
+static void registry_fetch_use_cache(RegistryFetch* fetch) {
+    free(fetch->response.data);
+    fetch->response.data = fetch->cached_body;
+    fetch->response.size = strlen(fetch->cached_body);
+    fetch->cached_body = NULL;
+    fetch->result = CURLE_OK;
+    fetch->http_status = 200;
+}
+
+// Consults the metadata cache; returns true if the fetch needs no network transfer
+static bool registry_fetch_from_cache(RegistryFetch* fetch, const RegistryFetchPolicy* policy, RegistryFetchStats* stats) {
+    if (!fetch->cache_path) return false;
+    
+    time_t fetched_at = 0;
+    bool cached = cpm_metacache_load(fetch->cache_path, &fetch->cached_body, &fetch->cached_etag, &fetched_at);
+    
+    if (cached && (policy->offline || time(NULL) - fetched_at < policy->cache_ttl)) {
+        registry_fetch_use_cache(fetch);
+        fetch->settled = true;
+        if (stats) stats->cache_hits++;
+        return true;
+    }
     
-    char url[1024];
-    snprintf(url, sizeof(url), "%s/packages/%s/versions", registry_url, package_name);
+    if (policy->offline) {
+        fetch->result = CURLE_COULDNT_CONNECT;
+        fetch->offline_miss = true;
+        fetch->settled = true;
+        return true;
+    }
+    return false;
+}
+
+// Applies the outcome of a network transfer to the metadata cache. When the
+// registry can't be reached (or fails server-side) an expired cached copy is
+// still real data, so it is served before anything falls back to stand-ins
+static void registry_fetch_finish(RegistryFetch* fetch, RegistryFetchStats* stats) {
+    if (!fetch->cache_path) return;
+    if (fetch->result != CURLE_OK || fetch->http_status >= 500) {
+        if (!fetch->cached_body) return;
+        printf("[CPM Deps] Registry unavailable for %s; using the cached copy\n", fetch->url);
+        registry_fetch_use_cache(fetch);
+        if (stats) stats->stale++;
+        return;
+    }
+    
+    if (fetch->http_status == 304 && fetch->cached_body) {
+        registry_fetch_use_cache(fetch);
+        cpm_metacache_touch(fetch->cache_path);
+        if (stats) stats->revalidated++;
+    } else if (fetch->http_status == 200 && fetch->response.data) {
+        cpm_metacache_store(fetch->cache_path, fetch->response.data, fetch->response_etag);
+    }
+}
+
+// Runs every fetch, keeping at most `max_concurrent` requests in flight. The
+// shared client multiplexes them onto as few connections as the registry allows.
+static void registry_fetch_all(RegistryFetch* fetches, size_t count, const RegistryFetchPolicy* policy, RegistryFetchStats* stats) {
+    if (count == 0) return;
+    size_t max_concurrent = policy->max_concurrent < 1 ? 1 : (size_t)policy->max_concurrent;
+    
+    for (size_t i = 0; i < count; i++) {
+        registry_fetch_from_cache(&fetches[i], policy, stats);
+    }
+    
+    Promise** promises = calloc(count, sizeof(Promise*));
+    if (!promises) return;
+    
+    CPM_RegistryStats before;
+    cpm_registry_stats(&before);
+    
+    // Completions are taken in order; the window refills as each one lands
+    size_t next = 0;
+    size_t active = 0;
+    for (size_t done = 0; done < count; done++) {
+        while (active < max_concurrent && next < count) {
+            RegistryFetch* fetch = &fetches[next];
+            if (!fetch->settled) {
+                promises[next] = registry_fetch_start(fetch, policy);
+                if (promises[next]) {
+                    active++;
+                    if (stats) stats->network++;
+                }
+            }
+            next++;
+        }
+        
+        if (!promises[done]) continue;
+        registry_fetch_complete(&fetches[done], promises[done]);
+        registry_fetch_finish(&fetches[done], stats);
+        active--;
+    }
+    free(promises);
     
-    HTTPResponse response = {0};
+    if (stats) {
+        CPM_RegistryStats after;
+        cpm_registry_stats(&after);
+        // The client restarts from zero if it was shut down in between
+        if (after.connections >= before.connections) stats->connections += after.connections - before.connections;
+    }
+}
+
+// --- Registry Response Parsing ---
+static void semver_list_free(SemVer** versions, size_t count) {
+    if (!versions) return;
+    for (size_t i = 0; i < count; i++) {
+        semver_free(versions[i]);
+    }
+    free(versions);
+}
+
+// {"package": ..., "versions": [{"version": "1.0.0", ...}, ...]}; bare
+// version strings in the list are accepted too
+static SemVer** parse_versions_response(const char* json, size_t length, size_t* count) {
+    *count = 0;
     
-    curl_easy_setopt(curl, CURLOPT_URL, url);
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, http_write_callback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 30L);
+    CPM_JsonReader reader;
+    CPM_JsonToken token;
+    cpm_json_reader_init(&reader, json, length);
+    if (!cpm_json_next(&reader, &token) || token.type != CPM_JSON_OBJECT_START) return NULL;
+    
+    // Find the top-level "versions" array
+    bool found = false;
+    while (!found && cpm_json_next(&reader, &token) && token.type == CPM_JSON_KEY) {
+        if (cpm_json_string_equals(&token, "versions")) {
+            found = cpm_json_next(&reader, &token) && token.type == CPM_JSON_ARRAY_START;
+            if (!found) return NULL;
+        } else {
+            cpm_json_skip(&reader, &token);
+        }
+    }
+    if (!found) return NULL;
     
-    CURLcode res = curl_easy_perform(curl);
-    curl_easy_cleanup(curl);
+    SemVer** versions = NULL;
+    size_t capacity = 0;
     
-    if (res != CURLE_OK || !response.data) {
-        // Return mock versions for demonstration
-        SemVer** versions = malloc(3 * sizeof(SemVer*));
-        if (versions) {
-            versions[0] = semver_parse("1.0.0");
-            versions[1] = semver_parse("1.1.0");
-            versions[2] = semver_parse("2.0.0");
-            *count = 3;
+    // Inside the array, version strings are elements or the "version" member
+    // of an element; every other member is skipped with its key
+    while (cpm_json_next(&reader, &token) && token.depth > 1) {
+        if (token.type == CPM_JSON_KEY) {
+            if (!cpm_json_string_equals(&token, "version")) cpm_json_skip(&reader, &token);
+            continue;
+        }
+        if (token.type != CPM_JSON_STRING) {
+            // Element objects are entered rather than skipped
+            if (token.type != CPM_JSON_OBJECT_START || token.depth != 2) cpm_json_skip(&reader, &token);
+            continue;
+        }
+        
+        char* version_str = cpm_json_string_dup(&token);
+        SemVer* version = version_str ? semver_parse(version_str) : NULL;
+        free(version_str);
+        if (!version) continue;
+        
+        if (*count == capacity) {
+            capacity = capacity ? capacity * 2 : 8;
+            SemVer** grown = realloc(versions, capacity * sizeof(SemVer*));
+            if (!grown) {
+                semver_free(version);
+                break;
+            }
+            versions = grown;
         }
-        free(response.data);
-        return versions;
+        versions[(*count)++] = version;
     }
     
-    // Parse version response (simplified)
-    // In real implementation, use proper JSON parser
-    free(response.data);
+    return versions;
+}
+
+// Appends a dependency to a node's list, preserving declaration order
+static void dependency_list_append(Dependency** head, Dependency* dep) {
+    while (*head) head = &(*head)->next;
+    *head = dep;
+}
+
+// Reads the "dependencies" value whose start is in open: an object
+// {"name": "constraint"} or an array ["name@constraint"]
+static Dependency* parse_dependencies_value(CPM_JsonReader* reader, const CPM_JsonToken* open) {
+    Dependency* head = NULL;
+    CPM_JsonToken token;
+    CPM_JsonToken key = { 0 };
+    
+    while (cpm_json_next(reader, &token) && token.depth > open->depth) {
+        if (token.type == CPM_JSON_KEY) {
+            key = token;
+            continue;
+        }
+        if (token.type != CPM_JSON_STRING) {
+            cpm_json_skip(reader, &token);
+            continue;
+        }
+        
+        char* name;
+        char* constraint = NULL;
+        if (open->type == CPM_JSON_OBJECT_START) {
+            name = cpm_json_string_dup(&key);
+            constraint = cpm_json_string_dup(&token);
+        } else {
+            name = cpm_json_string_dup(&token);
+            char* at_sign = name ? strchr(name, '@') : NULL;
+            if (at_sign && at_sign != name) {
+                *at_sign = '\0';
+                constraint = strdup(at_sign + 1);
+            }
+        }
+        
+        Dependency* dep = name ? cpm_dependency_create(name, constraint) : NULL;
+        if (dep) dependency_list_append(&head, dep);
+        free(name);
+        free(constraint);
+    }
     
-    // Mock response for now
+    return head;
+}
+
+// Package metadata: {"download_url": ..., "integrity": ..., "dependencies": ...},
+// read in one pass over the top-level members
+static void parse_metadata_response(const char* json, size_t length, char** download_url, char** integrity,
+                                    Dependency** dependencies) {
+    CPM_JsonReader reader;
+    CPM_JsonToken token;
+    *download_url = *integrity = NULL;
+    *dependencies = NULL;
+    cpm_json_reader_init(&reader, json, length);
+    if (!cpm_json_next(&reader, &token) || token.type != CPM_JSON_OBJECT_START) return;
+    
+    while (cpm_json_next(&reader, &token) && token.type == CPM_JSON_KEY) {
+        CPM_JsonToken key = token;
+        if (!cpm_json_next(&reader, &token)) break;
+        
+        if (token.type == CPM_JSON_STRING && cpm_json_string_equals(&key, "download_url") && !*download_url) {
+            *download_url = cpm_json_string_dup(&token);
+        } else if (token.type == CPM_JSON_STRING && cpm_json_string_equals(&key, "integrity") && !*integrity) {
+            *integrity = cpm_json_string_dup(&token);
+        } else if ((token.type == CPM_JSON_OBJECT_START || token.type == CPM_JSON_ARRAY_START) &&
+                   cpm_json_string_equals(&key, "dependencies") && !*dependencies) {
+            *dependencies = parse_dependencies_value(&reader, &token);
+        } else {
+            cpm_json_skip(&reader, &token);
+        }
+    }
+}
+
+// Versions the registry could not be asked about (offline demo mode)
+static SemVer** mock_package_versions(size_t* count) {
     SemVer** versions = malloc(3 * sizeof(SemVer*));
+    *count = 0;
     if (versions) {
         versions[0] = semver_parse("1.0.0");
         versions[1] = semver_parse("1.1.0");
         versions[2] = semver_parse("2.0.0");
         *count = 3;
     }
+    return versions;
+}
+
+// Dependencies used when a package's metadata can't be fetched (offline demo mode)
+static Dependency* mock_package_dependencies(const char* package_name) {
+    if (strcmp(package_name, "libmath") == 0) {
+        return cpm_dependency_create("libutils", "^1.0.0");
+    }
+    return NULL;
+}
+
+static SemVer** versions_from_fetch(const RegistryFetch* fetch, size_t* count, bool* mocked) {
+    *count = 0;
+    if (mocked) *mocked = false;
+    if (fetch->offline_miss) return NULL;
+    if (fetch->result != CURLE_OK || !fetch->response.data) {
+        // Registry unreachable: fall back to demonstration versions
+        if (mocked) *mocked = true;
+        return mock_package_versions(count);
+    }
+    if (fetch->http_status >= 400) return NULL;
+    return parse_versions_response(fetch->response.data, fetch->response.size, count);
+}
+
+static SemVer** fetch_package_versions(const char* package_name, const char* registry_url, size_t* count) {
+    char url[1024];
+    snprintf(url, sizeof(url), "%s/packages/%s/versions", registry_url, package_name);
+    
+    RegistryFetch fetch;
+    RegistryFetchPolicy policy = { 1, 30L, 0, false };
+    registry_fetch_init(&fetch, url, NULL);
+    registry_fetch_all(&fetch, 1, &policy, NULL);
     
+    SemVer** versions = versions_from_fetch(&fetch, count, NULL);
+    registry_fetch_cleanup(&fetch);
     return versions;
 }
 
@@ -186,76 +528,703 @@ SemVer** cpm_get_available_versions(const char* package_name, const char* regist
 }
 
 // --- Dependency Resolution Algorithm ---
-static DepNode* resolve_single_dependency(const Dependency* dep, const char* registry_url) {
-    if (!dep || !dep->name) return NULL;
-    
-    // Get available versions
+// Resolution runs in three phases:
+//  1. Prefetch: walk the graph breadth-first along the newest matching versions,
+//     fetching each level's version lists, then each level's package metadata,
+//     concurrently. This covers everything the solver needs in the common case
+//     at two round-trip batches per level of depth.
+//  2. Solve: the conflict-driven solver (cpm_solver.h) picks one version per
+//     package; anything it needs beyond the prefetched data (e.g. an older
+//     version after backtracking) is fetched on demand.
+//  3. Build: the dependency tree and install order are laid out from the solution.
+#define DEPS_DEFAULT_CONCURRENCY 4
+#define DEPS_DEFAULT_TIMEOUT 30L
+
+// Per-resolution memo table (open addressing). Keyed by package name it holds
+// the version list, fetched once and kept sorted newest first; keyed by
+// "name@version" it holds that version's metadata.
+typedef struct {
+    char* key;
+    SemVer** versions;
     size_t version_count;
-    SemVer** available_versions = cpm_get_available_versions(dep->name, registry_url, &version_count);
+    Dependency* dependencies;
+    char* download_url;
+    char* integrity;         // Subresource-integrity string from the metadata, if any
+    bool mocked;             // Versions or dependencies are offline stand-ins
+    DepNode* node;           // Interned graph node, when building the graph
+} MemoEntry;
+
+typedef struct {
+    MemoEntry* entries;
+    size_t count;
+    size_t capacity;        // Power of two
+} MemoTable;
+
+static uint64_t memo_hash(const char* key) {
+    uint64_t hash = 1469598103934665603ULL;
+    for (const unsigned char* p = (const unsigned char*)key; *p; p++) {
+        hash ^= *p;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static MemoEntry* memo_slot(MemoEntry* entries, size_t capacity, const char* key) {
+    size_t i = (size_t)memo_hash(key) & (capacity - 1);
+    while (entries[i].key && strcmp(entries[i].key, key) != 0) {
+        i = (i + 1) & (capacity - 1);
+    }
+    return &entries[i];
+}
+
+static MemoEntry* memo_find(const MemoTable* table, const char* key) {
+    if (!table->entries) return NULL;
+    MemoEntry* entry = memo_slot(table->entries, table->capacity, key);
+    return entry->key ? entry : NULL;
+}
+
+static bool memo_grow(MemoTable* table) {
+    size_t capacity = table->capacity ? table->capacity * 2 : 64;
+    MemoEntry* entries = calloc(capacity, sizeof(MemoEntry));
+    if (!entries) return false;
+    
+    for (size_t i = 0; i < table->capacity; i++) {
+        if (table->entries[i].key) {
+            *memo_slot(entries, capacity, table->entries[i].key) = table->entries[i];
+        }
+    }
+    free(table->entries);
+    table->entries = entries;
+    table->capacity = capacity;
+    return true;
+}
+
+// Returns the entry for key, inserting an empty one if needed; *inserted tells which
+static MemoEntry* memo_insert(MemoTable* table, const char* key, bool* inserted) {
+    *inserted = false;
+    MemoEntry* entry = memo_find(table, key);
+    if (entry) return entry;
+    
+    // Keep the load factor under 3/4
+    if ((table->count + 1) * 4 > table->capacity * 3 && !memo_grow(table)) return NULL;
+    
+    entry = memo_slot(table->entries, table->capacity, key);
+    entry->key = strdup(key);
+    if (!entry->key) return NULL;
+    table->count++;
+    *inserted = true;
+    return entry;
+}
+
+static void memo_free(MemoTable* table) {
+    for (size_t i = 0; i < table->capacity; i++) {
+        if (!table->entries[i].key) continue;
+        free(table->entries[i].key);
+        semver_list_free(table->entries[i].versions, table->entries[i].version_count);
+        cpm_dependency_list_free(table->entries[i].dependencies);
+        free(table->entries[i].download_url);
+        free(table->entries[i].integrity);
+    }
+    free(table->entries);
+    memset(table, 0, sizeof(*table));
+}
+
+static int semver_compare_descending(const void* a, const void* b) {
+    return semver_compare(*(const SemVer* const*)b, *(const SemVer* const*)a);
+}
+
+typedef struct {
+    const char* registry_url;
+    const char* cache_dir;   // NULL = no metadata cache
+    RegistryFetchPolicy policy;
+    RegistryFetchStats stats;
+    
+    MemoTable versions;      // name -> version list, sorted newest first
+    MemoTable metadata;      // "name@version" -> dependencies and download URL
+    MemoTable pins;          // name -> node of a previous resolution (versions to prefer)
+    bool tentative;          // A failed solve is retried by the caller, so it isn't reported
+} Resolver;
+
+static void resolver_init(Resolver* resolver, const CPM_Config* config) {
+    memset(resolver, 0, sizeof(*resolver));
+    resolver->registry_url = config->registry_url;
+    resolver->cache_dir = config->cache_dir;
+    resolver->policy.max_concurrent = config->max_concurrent_downloads > 0 ? config->max_concurrent_downloads : DEPS_DEFAULT_CONCURRENCY;
+    resolver->policy.timeout_seconds = config->timeout_seconds > 0 ? config->timeout_seconds : DEPS_DEFAULT_TIMEOUT;
+    resolver->policy.cache_ttl = config->metadata_ttl;
+    resolver->policy.offline = config->offline;
+}
+
+static void resolver_cleanup(Resolver* resolver) {
+    memo_free(&resolver->versions);
+    memo_free(&resolver->metadata);
+    memo_free(&resolver->pins);
+}
+
+// Version a previous resolution picked for name, if any
+static const SemVer* resolver_pinned_version(const Resolver* resolver, const char* name) {
+    const MemoEntry* pin = memo_find(&resolver->pins, name);
+    return pin && pin->node ? pin->node->version : NULL;
+}
+
+static void metadata_key(char* key, size_t size, const char* name, const SemVer* version) {
+    char* version_str = semver_to_string(version);
+    snprintf(key, size, "%s@%s", name, version_str ? version_str : "");
+    free(version_str);
+}
+
+// Fetches version lists for every name not seen before
+static void resolver_fetch_versions(Resolver* resolver, const char* const* names, size_t count) {
+    RegistryFetch* fetches = calloc(count ? count : 1, sizeof(RegistryFetch));
+    const char** fetched = calloc(count ? count : 1, sizeof(char*));
+    size_t fetch_count = 0;
+    
+    if (!fetches || !fetched) {
+        free(fetches);
+        free(fetched);
+        return;
+    }
     
-    if (!available_versions || version_count == 0) {
-        printf("[CPM Deps] Warning: No versions found for package '%s'\n", dep->name);
-        return NULL;
+    for (size_t i = 0; i < count; i++) {
+        // Reserving the memo entry now also dedupes names within the batch
+        bool inserted = false;
+        if (!memo_insert(&resolver->versions, names[i], &inserted) || !inserted) continue;
+        
+        char url[1024];
+        snprintf(url, sizeof(url), "%s/packages/%s/versions", resolver->registry_url, names[i]);
+        registry_fetch_init(&fetches[fetch_count], url,
+                            cpm_metacache_path(resolver->cache_dir, names[i], "versions"));
+        fetched[fetch_count++] = names[i];
+    }
+    
+    registry_fetch_all(fetches, fetch_count, &resolver->policy, &resolver->stats);
+    
+    for (size_t i = 0; i < fetch_count; i++) {
+        if (fetches[i].offline_miss) {
+            printf("[CPM Deps] Offline: no cached versions for package '%s'\n", fetched[i]);
+        }
+        
+        MemoEntry* entry = memo_find(&resolver->versions, fetched[i]);
+        entry->versions = versions_from_fetch(&fetches[i], &entry->version_count, &entry->mocked);
+        if (entry->version_count > 1) {
+            qsort(entry->versions, entry->version_count, sizeof(SemVer*), semver_compare_descending);
+        }
+        registry_fetch_cleanup(&fetches[i]);
+    }
+    
+    free(fetches);
+    free(fetched);
+}
+
+// Fetches metadata (dependencies, download URL) for every name@version not seen before
+static void resolver_fetch_metadata(Resolver* resolver, const char* const* names, const SemVer* const* versions, size_t count) {
+    RegistryFetch* fetches = calloc(count ? count : 1, sizeof(RegistryFetch));
+    char** keys = calloc(count ? count : 1, sizeof(char*));
+    size_t fetch_count = 0;
+    
+    if (!fetches || !keys) {
+        free(fetches);
+        free(keys);
+        return;
+    }
+    
+    for (size_t i = 0; i < count; i++) {
+        char key[512];
+        metadata_key(key, sizeof(key), names[i], versions[i]);
+        
+        bool inserted = false;
+        MemoEntry* entry = memo_insert(&resolver->metadata, key, &inserted);
+        if (!entry || !inserted) continue;
+        
+        char* version_str = semver_to_string(versions[i]);
+        char url[1024];
+        snprintf(url, sizeof(url), "%s/packages/%s/%s", resolver->registry_url, names[i], version_str ? version_str : "");
+        // Until metadata says otherwise, the package is fetched from its metadata URL
+        entry->download_url = strdup(url);
+        registry_fetch_init(&fetches[fetch_count], url,
+                            cpm_metacache_path(resolver->cache_dir, names[i], version_str ? version_str : "unknown"));
+        free(version_str);
+        keys[fetch_count++] = entry->key;
+    }
+    
+    registry_fetch_all(fetches, fetch_count, &resolver->policy, &resolver->stats);
+    
+    for (size_t i = 0; i < fetch_count; i++) {
+        // Entries may have moved if the table grew while reserving
+        MemoEntry* entry = memo_find(&resolver->metadata, keys[i]);
+        
+        if (registry_fetch_ok(&fetches[i])) {
+            char* download_url;
+            parse_metadata_response(fetches[i].response.data, fetches[i].response.size, &download_url,
+                                    &entry->integrity, &entry->dependencies);
+            if (download_url) {
+                free(entry->download_url);
+                if (download_url[0] == '/') {
+                    size_t len = strlen(resolver->registry_url) + strlen(download_url) + 1;
+                    entry->download_url = malloc(len);
+                    if (entry->download_url) snprintf(entry->download_url, len, "%s%s", resolver->registry_url, download_url);
+                    free(download_url);
+                } else {
+                    entry->download_url = download_url;
+                }
+            }
+        } else if (!fetches[i].offline_miss) {
+            char* at_sign = strrchr(entry->key, '@');
+            if (at_sign) *at_sign = '\0';
+            entry->dependencies = mock_package_dependencies(entry->key);
+            entry->mocked = true;
+            if (at_sign) *at_sign = '@';
+        }
+        
+        registry_fetch_cleanup(&fetches[i]);
+    }
+    
+    free(fetches);
+    free(keys);
+}
+
+// Version the solver will try first for dep: its pin if that still satisfies
+// the constraint, otherwise the newest match from the memoized list
+static const SemVer* resolver_newest_match(const Resolver* resolver, const Dependency* dep) {
+    const MemoEntry* entry = memo_find(&resolver->versions, dep->name);
+    if (!entry) return NULL;
+    
+    const SemVer* pinned = resolver_pinned_version(resolver, dep->name);
+    for (size_t i = 0; pinned && i < entry->version_count; i++) {
+        if (semver_equals(entry->versions[i], pinned) && semver_satisfies(pinned, dep->constraint)) return entry->versions[i];
+    }
+    
+    for (size_t i = 0; i < entry->version_count; i++) {
+        if (semver_satisfies(entry->versions[i], dep->constraint)) return entry->versions[i];
+    }
+    return NULL;
+}
+
+// Phase 1: fetches the graph the newest matching versions span, one level at a time
+static void resolver_prefetch(Resolver* resolver, const Dependency* root_dependencies) {
+    const Dependency** frontier = NULL;
+    size_t frontier_count = 0;
+    size_t frontier_capacity = 0;
+    
+    for (const Dependency* dep = root_dependencies; dep; dep = dep->next) {
+        if (frontier_count == frontier_capacity) {
+            frontier_capacity = frontier_capacity ? frontier_capacity * 2 : 16;
+            const Dependency** grown = realloc(frontier, frontier_capacity * sizeof(Dependency*));
+            if (!grown) break;
+            frontier = grown;
+        }
+        frontier[frontier_count++] = dep;
+    }
+    
+    for (int depth = 1; frontier_count > 0; depth++) {
+        printf("[CPM Deps] Resolving level %d: %zu dependenc%s\n",
+               depth, frontier_count, frontier_count == 1 ? "y" : "ies");
+        
+        const char** names = calloc(frontier_count, sizeof(char*));
+        const SemVer** versions = calloc(frontier_count, sizeof(SemVer*));
+        if (!names || !versions) {
+            free(names);
+            free(versions);
+            break;
+        }
+        
+        for (size_t i = 0; i < frontier_count; i++) names[i] = frontier[i]->name;
+        resolver_fetch_versions(resolver, names, frontier_count);
+        
+        // Metadata for each newest match not fetched on an earlier level
+        size_t level_size = 0;
+        for (size_t i = 0; i < frontier_count; i++) {
+            const SemVer* version = resolver_newest_match(resolver, frontier[i]);
+            if (!version) continue;
+            
+            char key[512];
+            metadata_key(key, sizeof(key), frontier[i]->name, version);
+            if (memo_find(&resolver->metadata, key)) continue;
+            
+            bool duplicate = false;
+            for (size_t j = 0; j < level_size && !duplicate; j++) {
+                duplicate = strcmp(names[j], frontier[i]->name) == 0 && semver_equals(versions[j], version);
+            }
+            if (duplicate) continue;
+            
+            names[level_size] = frontier[i]->name;
+            versions[level_size++] = version;
+        }
+        resolver_fetch_metadata(resolver, names, versions, level_size);
+        
+        // Next frontier: dependencies of this level's packages
+        const Dependency** next = NULL;
+        size_t next_count = 0;
+        size_t next_capacity = 0;
+        for (size_t i = 0; i < level_size; i++) {
+            char key[512];
+            metadata_key(key, sizeof(key), names[i], versions[i]);
+            const MemoEntry* entry = memo_find(&resolver->metadata, key);
+            
+            for (const Dependency* dep = entry ? entry->dependencies : NULL; dep; dep = dep->next) {
+                if (dep->is_dev_dependency) continue;
+                if (next_count == next_capacity) {
+                    next_capacity = next_capacity ? next_capacity * 2 : 16;
+                    const Dependency** grown = realloc(next, next_capacity * sizeof(Dependency*));
+                    if (!grown) break;
+                    next = grown;
+                }
+                next[next_count++] = dep;
+            }
+        }
+        
+        free(names);
+        free(versions);
+        free(frontier);
+        frontier = next;
+        frontier_count = next_count;
     }
     
-    // Find best matching version
-    SemVer* best_version = semver_resolve_latest_compatible((const SemVer**)available_versions, version_count, dep->constraint);
+    free(frontier);
+}
+
+// --- Solver Provider ---
+// Serves the solver from the memo tables, fetching whatever the prefetch missed
+static SemVer** resolver_provide_versions(void* context, const char* name, size_t* count) {
+    Resolver* resolver = context;
+    MemoEntry* entry = memo_find(&resolver->versions, name);
+    if (!entry) {
+        resolver_fetch_versions(resolver, &name, 1);
+        entry = memo_find(&resolver->versions, name);
+    }
     
-    // Clean up available versions
-    for (size_t i = 0; i < version_count; i++) {
-        semver_free(available_versions[i]);
+    *count = entry ? entry->version_count : 0;
+    return entry ? entry->versions : NULL;
+}
+
+static const Dependency* resolver_provide_dependencies(void* context, const char* name, const SemVer* version) {
+    Resolver* resolver = context;
+    char key[512];
+    metadata_key(key, sizeof(key), name, version);
+    
+    MemoEntry* entry = memo_find(&resolver->metadata, key);
+    if (!entry) {
+        resolver_fetch_metadata(resolver, &name, &version, 1);
+        entry = memo_find(&resolver->metadata, key);
+    }
+    return entry ? entry->dependencies : NULL;
+}
+
+static const SemVer* resolver_provide_preferred(void* context, const char* name) {
+    return resolver_pinned_version(context, name);
+}
+
+static Dependency* dependency_list_copy(const Dependency* head) {
+    Dependency* copy = NULL;
+    for (const Dependency* dep = head; dep; dep = dep->next) {
+        char* constraint = semver_constraint_to_string(dep->constraint);
+        Dependency* dup = cpm_dependency_create(dep->name, constraint);
+        free(constraint);
+        if (!dup) continue;
+        dup->is_dev_dependency = dep->is_dev_dependency;
+        dependency_list_append(&copy, dup);
+    }
+    return copy;
+}
+
+// Phase 3: lays the solution out as a graph with one node per package, the
+// root first. Nodes are interned by name (the solution has one version per
+// name), so shared dependencies are a single node with several parents.
+static void resolver_build_graph(Resolver* resolver, const SolverResult* solution, DepResolution* resolution) {
+    size_t capacity = solution->assignment_count + 1;
+    DepNode** nodes = realloc(resolution->nodes, capacity * sizeof(DepNode*));
+    if (!nodes) return;
+    resolution->nodes = nodes;
+    
+    MemoTable interned = {0};
+    
+    // Breadth-first: the node array doubles as the work queue
+    for (size_t head = 0; head < resolution->node_count; head++) {
+        DepNode* parent = resolution->nodes[head];
+        
+        for (const Dependency* dep = parent->dependencies; dep; dep = dep->next) {
+            if (parent != resolution->root && dep->is_dev_dependency) continue;
+            
+            const SemVer* version = cpm_solver_result_find(solution, dep->name);
+            if (!version) continue;
+            
+            bool inserted = false;
+            MemoEntry* slot = memo_insert(&interned, dep->name, &inserted);
+            if (!slot) continue;
+            
+            if (inserted) {
+                if (resolution->node_count == capacity) continue;
+                
+                char key[512];
+                metadata_key(key, sizeof(key), dep->name, version);
+                const MemoEntry* entry = memo_find(&resolver->metadata, key);
+                const MemoEntry* listed = memo_find(&resolver->versions, dep->name);
+                
+                DepNode* node = cpm_depnode_create(dep->name, version);
+                if (!node) continue;
+                node->resolved_url = entry ? strdup_safe(entry->download_url) : NULL;
+                node->integrity = entry ? strdup_safe(entry->integrity) : NULL;
+                node->mocked = (entry && entry->mocked) || (listed && listed->mocked);
+                node->dependencies = entry ? dependency_list_copy(entry->dependencies) : NULL;
+                node->graph_index = resolution->node_count;
+                resolution->nodes[resolution->node_count++] = node;
+                slot->node = node;
+            }
+            
+            // A package listed twice is still one edge
+            DepNode* child = slot->node;
+            bool linked = child == NULL;
+            for (size_t i = 0; i < parent->child_count && !linked; i++) {
+                linked = parent->children[i] == child;
+            }
+            if (!linked) cpm_depnode_add_child(parent, child);
+        }
     }
-    free(available_versions);
     
-    if (!best_version) {
-        printf("[CPM Deps] No compatible version found for package '%s'\n", dep->name);
+    memo_free(&interned);
+}
+
+// Describes one cycle through the strongly connected component `scc`, found
+// breadth-first from its first member back to itself: "a -> b -> a"
+static char* describe_cycle(const DepResolution* resolution, const size_t* scc_of, size_t scc, const DepNode* start) {
+    size_t n = resolution->node_count;
+    size_t* previous = malloc(n * sizeof(size_t));
+    size_t* queue = malloc(n * sizeof(size_t));
+    if (!previous || !queue) {
+        free(previous);
+        free(queue);
         return NULL;
     }
+    for (size_t i = 0; i < n; i++) previous[i] = SIZE_MAX;
     
-    // Create dependency node
-    DepNode* node = cpm_depnode_create(dep->name, best_version);
-    semver_free(best_version);
+    size_t head = 0;
+    size_t tail = 0;
+    size_t last = SIZE_MAX;
+    queue[tail++] = start->graph_index;
     
-    if (node) {
-        // Set resolved URL
-        char url[512];
-        char* version_str = semver_to_string(node->version);
-        snprintf(url, sizeof(url), "%s/packages/%s/%s", registry_url, dep->name, version_str);
-        node->resolved_url = strdup(url);
-        free(version_str);
+    while (head < tail && last == SIZE_MAX) {
+        const DepNode* node = resolution->nodes[queue[head++]];
+        for (size_t i = 0; i < node->child_count; i++) {
+            size_t child = node->children[i]->graph_index;
+            if (scc_of[child] != scc) continue;
+            if (child == start->graph_index) {
+                last = node->graph_index;
+                break;
+            }
+            if (previous[child] != SIZE_MAX) continue;
+            previous[child] = node->graph_index;
+            queue[tail++] = child;
+        }
     }
     
-    return node;
+    // Walk back from the node closing the cycle, then print it forwards
+    size_t length = 0;
+    for (size_t i = last; i != SIZE_MAX && i != start->graph_index; i = previous[i]) queue[length++] = i;
+    
+    size_t size = strlen(start->name) * 2 + 8;
+    for (size_t i = 0; i < length; i++) size += strlen(resolution->nodes[queue[i]]->name) + 4;
+    
+    char* text = malloc(size);
+    if (text) {
+        size_t used = (size_t)snprintf(text, size, "%s", start->name);
+        for (size_t i = length; i-- > 0;) {
+            used += (size_t)snprintf(text + used, size - used, " -> %s", resolution->nodes[queue[i]]->name);
+        }
+        snprintf(text + used, size - used, " -> %s", start->name);
+    }
+    
+    free(previous);
+    free(queue);
+    return text;
 }
 
-static CPM_Result resolve_dependencies_recursive(DepNode* node, const char* registry_url, int depth) {
-    if (!node || depth > 10) { // Prevent infinite recursion
-        return CPM_RESULT_ERROR_DEPENDENCY_RESOLUTION;
+// Plans the install: strongly connected components (Tarjan) collapse every
+// dependency cycle into one unit, then Kahn's algorithm peels the condensed
+// graph in waves. A wave holds every unit whose dependencies are all installed,
+// so its packages can install in parallel; a unit's level is its wave.
+static void resolution_plan_install(DepResolution* resolution) {
+    size_t n = resolution->node_count;
+    if (n == 0) return;
+    
+    size_t edge_count = 0;
+    for (size_t i = 0; i < n; i++) edge_count += resolution->nodes[i]->child_count;
+    
+    size_t* index = malloc(n * sizeof(size_t));
+    size_t* low = malloc(n * sizeof(size_t));
+    bool* on_stack = calloc(n, sizeof(bool));
+    size_t* stack = malloc(n * sizeof(size_t));
+    size_t* frames = malloc(n * sizeof(size_t));        // Call stack of node indices
+    size_t* next_child = calloc(n, sizeof(size_t));
+    size_t* scc_of = malloc(n * sizeof(size_t));
+    size_t* members = malloc(n * sizeof(size_t));       // Grouped by component
+    size_t* scc_start = malloc((n + 1) * sizeof(size_t));
+    size_t* pending = calloc(n, sizeof(size_t));        // Per component: edges to uninstalled components
+    size_t* parent_start = calloc(n + 1, sizeof(size_t));
+    size_t* parents = malloc((edge_count ? edge_count : 1) * sizeof(size_t));
+    size_t* wave = malloc(n * sizeof(size_t));
+    
+    resolution->install_order = malloc(n * sizeof(DepNode*));
+    resolution->level_offsets = malloc((n + 1) * sizeof(size_t));
+    
+    if (!index || !low || !on_stack || !stack || !frames || !next_child || !scc_of || !members ||
+        !scc_start || !pending || !parent_start || !parents || !wave ||
+        !resolution->install_order || !resolution->level_offsets) {
+        goto cleanup;
     }
     
-    printf("[CPM Deps] Resolving dependencies for %s@%s (depth %d)\n", 
-           node->name, 
-           node->version ? semver_to_string(node->version) : "unknown",
-           depth);
+    // --- Strongly connected components (iterative Tarjan) ---
+    for (size_t i = 0; i < n; i++) index[i] = SIZE_MAX;
+    size_t counter = 0;
+    size_t stack_size = 0;
+    size_t scc_count = 0;
+    size_t member_count = 0;
     
-    // For demonstration, create mock dependencies
-    // In real implementation, fetch package.json from registry
-    if (strcmp(node->name, "libmath") == 0) {
-        Dependency* dep = cpm_dependency_create("libutils", "^1.0.0");
-        if (dep) {
-            DepNode* child = resolve_single_dependency(dep, registry_url);
-            if (child) {
-                cpm_depnode_add_child(node, child);
-                resolve_dependencies_recursive(child, registry_url, depth + 1);
+    for (size_t s = 0; s < n; s++) {
+        if (index[s] != SIZE_MAX) continue;
+        
+        size_t depth = 0;
+        frames[depth++] = s;
+        index[s] = low[s] = counter++;
+        stack[stack_size++] = s;
+        on_stack[s] = true;
+        
+        while (depth > 0) {
+            size_t v = frames[depth - 1];
+            const DepNode* node = resolution->nodes[v];
+            
+            if (next_child[v] < node->child_count) {
+                size_t w = node->children[next_child[v]++]->graph_index;
+                if (index[w] == SIZE_MAX) {
+                    index[w] = low[w] = counter++;
+                    stack[stack_size++] = w;
+                    on_stack[w] = true;
+                    frames[depth++] = w;
+                } else if (on_stack[w] && index[w] < low[v]) {
+                    low[v] = index[w];
+                }
+                continue;
+            }
+            
+            if (low[v] == index[v]) {
+                // v roots a component: everything above it on the stack belongs to it
+                scc_start[scc_count] = member_count;
+                size_t w;
+                do {
+                    w = stack[--stack_size];
+                    on_stack[w] = false;
+                    scc_of[w] = scc_count;
+                    members[member_count++] = w;
+                } while (w != v);
+                scc_count++;
+            }
+            
+            depth--;
+            if (depth > 0) {
+                size_t u = frames[depth - 1];
+                if (low[v] < low[u]) low[u] = low[v];
             }
-            cpm_dependency_free(dep);
         }
     }
+    scc_start[scc_count] = member_count;
+    
+    // --- Cycles ---
+    for (size_t c = 0; c < scc_count; c++) {
+        const DepNode* first = resolution->nodes[members[scc_start[c]]];
+        bool cyclic = scc_start[c + 1] - scc_start[c] > 1;
+        for (size_t i = 0; i < first->child_count && !cyclic; i++) cyclic = first->children[i] == first;
+        if (!cyclic) continue;
+        
+        char* cycle = describe_cycle(resolution, scc_of, c, first);
+        char** grown = cycle ? realloc(resolution->cycles, (resolution->cycle_count + 1) * sizeof(char*)) : NULL;
+        if (!grown) {
+            free(cycle);
+            continue;
+        }
+        resolution->cycles = grown;
+        resolution->cycles[resolution->cycle_count++] = cycle;
+    }
     
-    return CPM_RESULT_SUCCESS;
+    // --- Condensed graph: component edges, counted per dependent ---
+    for (size_t u = 0; u < n; u++) {
+        const DepNode* node = resolution->nodes[u];
+        for (size_t i = 0; i < node->child_count; i++) {
+            size_t v = node->children[i]->graph_index;
+            if (scc_of[u] == scc_of[v]) continue;
+            pending[scc_of[u]]++;
+            parent_start[scc_of[v] + 1]++;
+        }
+    }
+    for (size_t c = 0; c < scc_count; c++) parent_start[c + 1] += parent_start[c];
+    memset(next_child, 0, n * sizeof(size_t));    // Reused as a fill cursor per component
+    for (size_t u = 0; u < n; u++) {
+        const DepNode* node = resolution->nodes[u];
+        for (size_t i = 0; i < node->child_count; i++) {
+            size_t v = node->children[i]->graph_index;
+            if (scc_of[u] == scc_of[v]) continue;
+            parents[parent_start[scc_of[v]] + next_child[scc_of[v]]++] = scc_of[u];
+        }
+    }
+    
+    // --- Kahn's algorithm, one wave per level ---
+    size_t wave_size = 0;
+    for (size_t c = 0; c < scc_count; c++) {
+        if (pending[c] == 0) wave[wave_size++] = c;
+    }
+    
+    resolution->install_count = 0;
+    resolution->level_count = 0;
+    for (int level = 0; wave_size > 0; level++) {
+        size_t level_start = resolution->install_count;
+        for (size_t w = 0; w < wave_size; w++) {
+            size_t c = wave[w];
+            for (size_t m = scc_start[c]; m < scc_start[c + 1]; m++) {
+                DepNode* node = resolution->nodes[members[m]];
+                node->level = level;
+                if (node != resolution->root) resolution->install_order[resolution->install_count++] = node;
+            }
+        }
+        if (resolution->install_count > level_start) {
+            resolution->level_offsets[resolution->level_count++] = level_start;
+        }
+        
+        size_t next_size = 0;
+        for (size_t w = 0; w < wave_size; w++) {
+            size_t c = wave[w];
+            for (size_t p = parent_start[c]; p < parent_start[c + 1]; p++) {
+                if (--pending[parents[p]] == 0) wave[wave_size + next_size++] = parents[p];
+            }
+        }
+        memmove(wave, wave + wave_size, next_size * sizeof(size_t));
+        wave_size = next_size;
+    }
+    resolution->level_offsets[resolution->level_count] = resolution->install_count;
+    
+cleanup:
+    free(index);
+    free(low);
+    free(on_stack);
+    free(stack);
+    free(frames);
+    free(next_child);
+    free(scc_of);
+    free(members);
+    free(scc_start);
+    free(pending);
+    free(parent_start);
+    free(parents);
+    free(wave);
 }
 
-DepResolution* cpm_resolve_dependencies(const Package* root_package, const char* registry_url) {
+static Dependency* root_dependencies_parse(const Package* root_package) {
+    Dependency* head = NULL;
+    for (size_t i = 0; root_package->dependencies && i < root_package->dep_count; i++) {
+        Dependency* dep = cpm_dependency_parse_spec(root_package->dependencies[i]);
+        if (dep) dependency_list_append(&head, dep);
+    }
+    return head;
+}
+
+static DepResolution* resolve_dependencies(const Package* root_package, Resolver* resolver) {
     if (!root_package) return NULL;
     
     DepResolution* resolution = calloc(1, sizeof(DepResolution));
@@ -264,66 +1233,246 @@ DepResolution* cpm_resolve_dependencies(const Package* root_package, const char*
     // Create root node
     SemVer* root_version = semver_parse(root_package->version ? root_package->version : "1.0.0");
     resolution->root = cpm_depnode_create(root_package->name, root_version);
-    semver_free(root_version);
+    resolution->nodes = malloc(sizeof(DepNode*));
     
-    if (!resolution->root) {
+    if (!resolution->root || !resolution->nodes) {
+        cpm_depnode_free(resolution->root);
+        free(resolution->nodes);
+        semver_free(root_version);
         free(resolution);
         return NULL;
     }
+    resolution->nodes[resolution->node_count++] = resolution->root;
     
     printf("[CPM Deps] Starting dependency resolution for %s\n", root_package->name);
     
-    // Parse dependencies from package
-    if (root_package->dependencies) {
-        for (size_t i = 0; i < root_package->dep_count; i++) {
-            // Parse dependency string (format: "name@version")
-            char* dep_str = strdup(root_package->dependencies[i]);
-            if (!dep_str) continue;
-            
-            char* at_sign = strchr(dep_str, '@');
-            char* version_constraint = NULL;
-            
-            if (at_sign) {
-                *at_sign = '\0';
-                version_constraint = at_sign + 1;
-            }
-            
-            Dependency* dep = cpm_dependency_create(dep_str, version_constraint);
-            if (dep) {
-                DepNode* child = resolve_single_dependency(dep, registry_url);
-                if (child) {
-                    cpm_depnode_add_child(resolution->root, child);
-                    resolve_dependencies_recursive(child, registry_url, 1);
-                }
-                cpm_dependency_free(dep);
+    // Parse dependencies from package (format: "name@version")
+    resolution->root->dependencies = root_dependencies_parse(root_package);
+    
+    resolver_prefetch(resolver, resolution->root->dependencies);
+    
+    SolverProvider provider = {
+        .context = resolver,
+        .get_versions = resolver_provide_versions,
+        .get_dependencies = resolver_provide_dependencies,
+        .preferred_version = resolver->pins.count > 0 ? resolver_provide_preferred : NULL
+    };
+    SolverResult* solution = cpm_solver_solve(root_package->name, root_version, resolution->root->dependencies, &provider);
+    semver_free(root_version);
+    
+    if (solution && solution->success) {
+        printf("[CPM Deps] Solved in %zu decisions, %zu conflicts (%zu learned)\n",
+               solution->decisions, solution->conflicts, solution->learned);
+        resolver_build_graph(resolver, solution, resolution);
+        resolution_plan_install(resolution);
+        
+        for (size_t i = 0; i < resolution->cycle_count; i++) {
+            printf("[CPM Deps] Warning: dependency cycle %s; its packages install together\n", resolution->cycles[i]);
+        }
+        
+        size_t widest = 0;
+        for (size_t l = 0; l < resolution->level_count; l++) {
+            size_t width = resolution->level_offsets[l + 1] - resolution->level_offsets[l];
+            if (width > widest) widest = width;
+        }
+        printf("[CPM Deps] Dependency resolution complete. %zu packages to install in %zu level%s (up to %zu in parallel).\n",
+               resolution->install_count, resolution->level_count, resolution->level_count == 1 ? "" : "s", widest);
+    } else if (solution) {
+        // The explanation becomes the resolution's conflict list
+        if (resolver->tentative) {
+            printf("[CPM Deps] Locked pin no longer satisfiable, re-resolving\n");
+        } else {
+            printf("[CPM Deps] Version solving failed:\n");
+            for (size_t i = 0; i < solution->explanation_count; i++) {
+                printf("[CPM Deps]   %s\n", solution->explanation[i]);
             }
-            
-            free(dep_str);
         }
+        resolution->conflicts = solution->explanation;
+        resolution->conflict_count = solution->explanation_count;
+        solution->explanation = NULL;
+        solution->explanation_count = 0;
     }
+    cpm_solver_result_free(solution);
     
-    // Build install order (topological sort)
-    // For simplicity, just do a depth-first traversal
-    resolution->install_order = malloc(64 * sizeof(DepNode*)); // Max 64 dependencies
-    resolution->install_count = 0;
+    printf("[CPM Deps] Registry requests: %zu network, %zu cached, %zu revalidated, %zu stale (%zu new connection%s)\n",
+           resolver->stats.network, resolver->stats.cache_hits, resolver->stats.revalidated, resolver->stats.stale,
+           resolver->stats.connections, resolver->stats.connections == 1 ? "" : "s");
     
-    // Add children first (dependencies), then root
-    for (size_t i = 0; i < resolution->root->child_count; i++) {
-        if (resolution->install_count < 64) {
-            resolution->install_order[resolution->install_count++] = resolution->root->children[i];
+    return resolution;
+}
+
+DepResolution* cpm_resolve_dependencies(const Package* root_package, const char* registry_url) {
+    Resolver resolver = {0};
+    resolver.registry_url = registry_url;
+    resolver.policy.max_concurrent = DEPS_DEFAULT_CONCURRENCY;
+    resolver.policy.timeout_seconds = DEPS_DEFAULT_TIMEOUT;
+    
+    DepResolution* resolution = resolve_dependencies(root_package, &resolver);
+    resolver_cleanup(&resolver);
+    return resolution;
+}
+
+DepResolution* cpm_resolve_dependencies_with_config(const Package* root_package, const CPM_Config* config) {
+    if (!config) return NULL;
+    
+    Resolver resolver;
+    resolver_init(&resolver, config);
+    
+    DepResolution* resolution = resolve_dependencies(root_package, &resolver);
+    resolver_cleanup(&resolver);
+    return resolution;
+}
+
+// --- Incremental Resolution ---
+static bool dependency_same_constraint(const Dependency* a, const Dependency* b) {
+    char* a_str = semver_constraint_to_string(a->constraint);
+    char* b_str = semver_constraint_to_string(b->constraint);
+    bool same = a_str && b_str && strcmp(a_str, b_str) == 0;
+    free(a_str);
+    free(b_str);
+    return same;
+}
+
+// Every package of previous becomes a preferred version
+static void resolver_pin(Resolver* resolver, const DepResolution* previous) {
+    for (size_t i = 0; i < previous->node_count; i++) {
+        const DepNode* node = previous->nodes[i];
+        if (node == previous->root || !node->version) continue;
+        
+        bool inserted = false;
+        MemoEntry* pin = memo_insert(&resolver->pins, node->name, &inserted);
+        if (pin) pin->node = (DepNode*)node;
+    }
+}
+
+// Seeds the memo with the locked graph reachable from root dependencies whose
+// spec is unchanged: one version per package, with its locked dependencies as
+// exact constraints. The solver then treats that subgraph as settled and the
+// registry is only asked about what the change reaches. Returns the number kept.
+static size_t resolver_keep_unchanged(Resolver* resolver, const Package* root_package, const DepResolution* previous) {
+    bool* kept = calloc(previous->node_count ? previous->node_count : 1, sizeof(bool));
+    const DepNode** stack = malloc((previous->node_count ? previous->node_count : 1) * sizeof(DepNode*));
+    Dependency* current = root_dependencies_parse(root_package);
+    size_t stack_count = 0;
+    size_t kept_count = 0;
+    
+    if (!kept || !stack) {
+        free(kept);
+        free(stack);
+        cpm_dependency_list_free(current);
+        return 0;
+    }
+    
+    for (const Dependency* dep = current; dep; dep = dep->next) {
+        const Dependency* locked = NULL;
+        for (const Dependency* old = previous->root->dependencies; old && !locked; old = old->next) {
+            if (strcmp(old->name, dep->name) == 0) locked = old;
+        }
+        if (!locked || !dependency_same_constraint(dep, locked)) continue;
+        
+        for (size_t c = 0; c < previous->root->child_count; c++) {
+            const DepNode* child = previous->root->children[c];
+            if (strcmp(child->name, dep->name) != 0 || kept[child->graph_index]) continue;
+            kept[child->graph_index] = true;
+            stack[stack_count++] = child;
         }
     }
     
-    printf("[CPM Deps] Dependency resolution complete. %zu packages to install.\n", resolution->install_count);
+    while (stack_count > 0) {
+        const DepNode* node = stack[--stack_count];
+        for (size_t c = 0; c < node->child_count; c++) {
+            const DepNode* child = node->children[c];
+            if (kept[child->graph_index]) continue;
+            kept[child->graph_index] = true;
+            stack[stack_count++] = child;
+        }
+    }
     
+    for (size_t i = 0; i < previous->node_count; i++) {
+        const DepNode* node = previous->nodes[i];
+        if (!kept[i] || !node->version) continue;
+        
+        bool inserted = false;
+        MemoEntry* entry = memo_insert(&resolver->versions, node->name, &inserted);
+        if (!entry || !inserted) continue;
+        char* version_str = semver_to_string(node->version);
+        entry->versions = malloc(sizeof(SemVer*));
+        if (entry->versions) {
+            entry->versions[0] = semver_parse(version_str);
+            entry->version_count = entry->versions[0] ? 1 : 0;
+        }
+        entry->mocked = node->mocked;
+        free(version_str);
+        
+        char key[512];
+        metadata_key(key, sizeof(key), node->name, node->version);
+        entry = memo_insert(&resolver->metadata, key, &inserted);
+        if (!entry || !inserted) continue;
+        entry->download_url = strdup_safe(node->resolved_url);
+        entry->integrity = strdup_safe(node->integrity);
+        entry->mocked = node->mocked;
+        for (size_t c = 0; c < node->child_count; c++) {
+            char* child_version = node->children[c]->version ? semver_to_string(node->children[c]->version) : NULL;
+            Dependency* dep = cpm_dependency_create(node->children[c]->name, child_version);
+            free(child_version);
+            if (dep) dependency_list_append(&entry->dependencies, dep);
+        }
+        kept_count++;
+    }
+    
+    free(kept);
+    free(stack);
+    cpm_dependency_list_free(current);
+    return kept_count;
+}
+
+DepResolution* cpm_resolve_dependencies_incremental(const Package* root_package, const CPM_Config* config,
+                                                    const DepResolution* previous) {
+    if (!config) return NULL;
+    if (!previous || !previous->root) return cpm_resolve_dependencies_with_config(root_package, config);
+    
+    Resolver resolver;
+    resolver_init(&resolver, config);
+    resolver_pin(&resolver, previous);
+    size_t kept = resolver_keep_unchanged(&resolver, root_package, previous);
+    printf("[CPM Deps] Incremental resolution: %zu of %zu locked packages unaffected by the change\n",
+           kept, previous->install_count);
+    
+    // With packages kept at their locked versions a conflict only means the full solve below runs
+    resolver.tentative = kept > 0;
+    DepResolution* resolution = resolve_dependencies(root_package, &resolver);
+    resolver_cleanup(&resolver);
+    
+    // The change needs a version a settled package was pinned away from
+    if (kept > 0 && resolution && resolution->conflict_count > 0) {
+        cpm_resolution_free(resolution);
+        
+        resolver_init(&resolver, config);
+        resolver_pin(&resolver, previous);
+        resolution = resolve_dependencies(root_package, &resolver);
+        resolver_cleanup(&resolver);
+    }
     return resolution;
 }
 
 void cpm_resolution_free(DepResolution* resolution) {
     if (!resolution) return;
     
-    cpm_depnode_free(resolution->root);
+    // Graph nodes are shared between parents: free each once, without recursing
+    for (size_t i = 0; i < resolution->node_count; i++) {
+        free(resolution->nodes[i]->children);
+        resolution->nodes[i]->children = NULL;
+        resolution->nodes[i]->child_count = 0;
+        cpm_depnode_free(resolution->nodes[i]);
+    }
+    free(resolution->nodes);
     free(resolution->install_order);
+    free(resolution->level_offsets);
+    
+    for (size_t i = 0; i < resolution->cycle_count; i++) {
+        free(resolution->cycles[i]);
+    }
+    free(resolution->cycles);
     
     if (resolution->conflicts) {
         for (size_t i = 0; i < resolution->conflict_count; i++) {
@@ -335,96 +1484,179 @@ void cpm_resolution_free(DepResolution* resolution) {
     free(resolution);
 }
 
-// --- Dependency Installation ---
-CPM_Result cpm_install_dependency(const DepNode* dep, const char* target_dir) {
-    if (!dep || !target_dir) return CPM_RESULT_ERROR_INVALID_ARGS;
-    
-    printf("[CPM Deps] Installing %s@%s\n", dep->name, 
-           dep->version ? semver_to_string(dep->version) : "unknown");
-    
-    // Create target directory
-    char package_dir[1024];
-    snprintf(package_dir, sizeof(package_dir), "%s/%s", target_dir, dep->name);
-    
-    char mkdir_cmd[1024];
-    snprintf(mkdir_cmd, sizeof(mkdir_cmd), "mkdir -p \"%s\"", package_dir);
-    system(mkdir_cmd);
-    
-    // Download package (mock implementation)
-    printf("[CPM Deps] Downloading from %s\n", dep->resolved_url ? dep->resolved_url : "unknown");
-    
-    // Create a mock package file
-    char spec_file[1024];
-    snprintf(spec_file, sizeof(spec_file), "%s/cpm_package.spec", package_dir);
-    
-    FILE* f = fopen(spec_file, "w");
-    if (f) {
-        char* version_str = dep->version ? semver_to_string(dep->version) : strdup("1.0.0");
-        fprintf(f, "{\n");
-        fprintf(f, "  \"name\": \"%s\",\n", dep->name);
-        fprintf(f, "  \"version\": \"%s\",\n", version_str);
-        fprintf(f, "  \"description\": \"Mock package for %s\",\n", dep->name);
-        fprintf(f, "  \"dependencies\": {}\n");
-        fprintf(f, "}\n");
-        fclose(f);
-        free(version_str);
-        
-        printf("[CPM Deps] Package %s installed successfully\n", dep->name);
-        return CPM_RESULT_SUCCESS;
+bool cpm_resolution_is_mocked(const DepResolution* resolution) {
+    if (!resolution) return false;
+    for (size_t i = 0; i < resolution->node_count; i++) {
+        if (resolution->nodes[i]->mocked) return true;
     }
-    
-    return CPM_RESULT_ERROR_FILE_OPERATION;
+    return false;
 }
 
-CPM_Result cpm_install_dependencies(const DepResolution* resolution, const char* target_dir) {
-    if (!resolution || !target_dir) return CPM_RESULT_ERROR_INVALID_ARGS;
-    
-    printf("[CPM Deps] Installing %zu dependencies to %s\n", resolution->install_count, target_dir);
-    
-    // Create cpm_modules directory
-    char modules_dir[1024];
-    snprintf(modules_dir, sizeof(modules_dir), "%s/cpm_modules", target_dir);
-    
-    char mkdir_cmd[1024];
-    snprintf(mkdir_cmd, sizeof(mkdir_cmd), "mkdir -p \"%s\"", modules_dir);
-    system(mkdir_cmd);
-    
-    // Install each dependency
-    for (size_t i = 0; i < resolution->install_count; i++) {
-        CPM_Result result = cpm_install_dependency(resolution->install_order[i], modules_dir);
-        if (result != CPM_RESULT_SUCCESS) {
-            printf("[CPM Deps] Failed to install %s\n", resolution->install_order[i]->name);
-            return result;
+// --- Utility Functions ---
+// Walk state per node for graph traversals (open addressing keyed by address)
+typedef enum {
+    WALK_UNSEEN = 0,
+    WALK_ON_PATH,
+    WALK_DONE
+} WalkMark;
+
+typedef struct {
+    const DepNode** keys;
+    WalkMark* marks;
+    size_t count;
+    size_t capacity;        // Power of two
+} WalkMarks;
+
+static size_t walk_slot(const DepNode** keys, size_t capacity, const DepNode* node) {
+    size_t i = (size_t)(((uintptr_t)node >> 4) * 11400714819323198485ULL) & (capacity - 1);
+    while (keys[i] && keys[i] != node) i = (i + 1) & (capacity - 1);
+    return i;
+}
+
+// Returns the node's mark, adding it as WALK_UNSEEN if needed; NULL if out of memory
+static WalkMark* walk_mark(WalkMarks* walk, const DepNode* node) {
+    if ((walk->count + 1) * 2 > walk->capacity) {
+        size_t capacity = walk->capacity ? walk->capacity * 2 : 64;
+        const DepNode** keys = calloc(capacity, sizeof(DepNode*));
+        WalkMark* marks = calloc(capacity, sizeof(WalkMark));
+        if (!keys || !marks) {
+            free(keys);
+            free(marks);
+            return NULL;
         }
+        for (size_t i = 0; i < walk->capacity; i++) {
+            if (!walk->keys[i]) continue;
+            size_t slot = walk_slot(keys, capacity, walk->keys[i]);
+            keys[slot] = walk->keys[i];
+            marks[slot] = walk->marks[i];
+        }
+        free(walk->keys);
+        free(walk->marks);
+        walk->keys = keys;
+        walk->marks = marks;
+        walk->capacity = capacity;
     }
     
-    printf("[CPM Deps] All dependencies installed successfully\n");
-    return CPM_RESULT_SUCCESS;
+    size_t slot = walk_slot(walk->keys, walk->capacity, node);
+    if (!walk->keys[slot]) {
+        walk->keys[slot] = node;
+        walk->count++;
+    }
+    return &walk->marks[slot];
 }
 
-// --- Utility Functions ---
-void cpm_print_dependency_tree(const DepNode* root, int depth) {
-    if (!root) return;
-    
+static void walk_marks_free(WalkMarks* walk) {
+    free(walk->keys);
+    free(walk->marks);
+}
+
+static void print_dependency_node(const DepNode* node, int depth, WalkMarks* walk) {
     for (int i = 0; i < depth; i++) {
         printf("  ");
     }
     
-    char* version_str = root->version ? semver_to_string(root->version) : strdup("unknown");
-    printf("%s@%s\n", root->name, version_str);
+    char* version_str = node->version ? semver_to_string(node->version) : strdup("unknown");
+    WalkMark* mark = walk_mark(walk, node);
+    WalkMark state = mark ? *mark : WALK_DONE;
+    
+    if (state == WALK_ON_PATH) {
+        printf("%s@%s (circular)\n", node->name, version_str);
+    } else if (state == WALK_DONE && node->child_count > 0) {
+        printf("%s@%s (deduped)\n", node->name, version_str);
+    } else {
+        printf("%s@%s\n", node->name, version_str);
+    }
     free(version_str);
+    if (state != WALK_UNSEEN) return;
     
-    for (size_t i = 0; i < root->child_count; i++) {
-        cpm_print_dependency_tree(root->children[i], depth + 1);
+    *mark = WALK_ON_PATH;
+    for (size_t i = 0; i < node->child_count; i++) {
+        print_dependency_node(node->children[i], depth + 1, walk);
     }
+    // The table may have grown while printing the children
+    mark = walk_mark(walk, node);
+    if (mark) *mark = WALK_DONE;
+}
+
+void cpm_print_dependency_tree(const DepNode* root, int depth) {
+    if (!root) return;
+    
+    WalkMarks walk = {0};
+    print_dependency_node(root, depth, &walk);
+    walk_marks_free(&walk);
 }
 
+// Iterative depth-first search: reaching a node that is still on the current
+// path means a back edge, i.e. a cycle. Shared nodes are walked only once.
 bool cpm_dependency_has_circular_reference(const DepNode* root) {
-    // Simple cycle detection - in real implementation, use proper graph algorithms
-    return false;
+    if (!root) return false;
+    
+    typedef struct {
+        const DepNode* node;
+        size_t next_child;
+    } Frame;
+    
+    size_t capacity = 64;
+    size_t depth = 0;
+    Frame* frames = malloc(capacity * sizeof(Frame));
+    WalkMarks walk = {0};
+    WalkMark* mark = walk_mark(&walk, root);
+    bool circular = false;
+    
+    if (!frames || !mark) {
+        free(frames);
+        walk_marks_free(&walk);
+        return false;
+    }
+    
+    *mark = WALK_ON_PATH;
+    frames[depth++] = (Frame){ root, 0 };
+    
+    while (depth > 0 && !circular) {
+        Frame* frame = &frames[depth - 1];
+        if (frame->next_child == frame->node->child_count) {
+            mark = walk_mark(&walk, frame->node);
+            if (mark) *mark = WALK_DONE;
+            depth--;
+            continue;
+        }
+        
+        const DepNode* child = frame->node->children[frame->next_child++];
+        mark = walk_mark(&walk, child);
+        if (!mark) break;
+        if (*mark == WALK_ON_PATH) {
+            circular = true;
+        } else if (*mark == WALK_UNSEEN) {
+            if (depth == capacity) {
+                capacity *= 2;
+                Frame* grown = realloc(frames, capacity * sizeof(Frame));
+                if (!grown) break;
+                frames = grown;
+            }
+            *mark = WALK_ON_PATH;
+            frames[depth++] = (Frame){ child, 0 };
+        }
+    }
+    
+    free(frames);
+    walk_marks_free(&walk);
+    return circular;
 }
 
 bool cpm_detect_dependency_conflicts(const DepResolution* resolution) {
-    // Simplified conflict detection
-    return false;
-}
\ No newline at end of file
+    return resolution && resolution->conflict_count > 0;
+}
+
+char** cpm_get_conflict_descriptions(const DepResolution* resolution, size_t* count) {
+    if (count) *count = 0;
+    if (!resolution || !count || resolution->conflict_count == 0) return NULL;
+    
+    char** descriptions = calloc(resolution->conflict_count, sizeof(char*));
+    if (!descriptions) return NULL;
+    
+    for (size_t i = 0; i < resolution->conflict_count; i++) {
+        descriptions[i] = strdup_safe(resolution->conflicts[i]);
+    }
+    *count = resolution->conflict_count;
+    return descriptions;
+}
@@ -0,0 +1,572 @@
+/*
+ * File: lib/core/cpm_digest.c
+ * Description: SHA-256 and SHA-512 (FIPS 180-4) and Subresource-Integrity helpers for CPM.
+ * Author: Dr. Q Josef Kurk Edwards
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "cpm_digest.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define DIGEST_HAVE_SHANI 1
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+// --- SHA-256 ---
+static const uint32_t sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+#define ROTR32(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static void sha256_compress(uint32_t state[8], const unsigned char* block) {
+    uint32_t w[64];
+    for (int i = 0; i < 16; i++) {
+        w[i] = (uint32_t)block[i * 4] << 24 | (uint32_t)block[i * 4 + 1] << 16 |
+               (uint32_t)block[i * 4 + 2] << 8 | (uint32_t)block[i * 4 + 3];
+    }
+    for (int i = 16; i < 64; i++) {
+        uint32_t s0 = ROTR32(w[i - 15], 7) ^ ROTR32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = ROTR32(w[i - 2], 17) ^ ROTR32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+    
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+    
+    for (int i = 0; i < 64; i++) {
+        uint32_t s1 = ROTR32(e, 6) ^ ROTR32(e, 11) ^ ROTR32(e, 25);
+        uint32_t ch = (e & f) ^ (~e & g);
+        uint32_t t1 = h + s1 + ch + sha256_k[i] + w[i];
+        uint32_t s0 = ROTR32(a, 2) ^ ROTR32(a, 13) ^ ROTR32(a, 22);
+        uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+        uint32_t t2 = s0 + maj;
+        
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+    
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+}
+
+static void sha256_blocks_portable(uint32_t state[8], const unsigned char* data, size_t blocks) {
+    for (; blocks > 0; blocks--, data += CPM_SHA256_BLOCK_SIZE) sha256_compress(state, data);
+}
+
+#ifdef DIGEST_HAVE_SHANI
+// Four rounds per step: SHA256RNDS2 does two, on state kept as ABEF/CDGH
+// halves, while SHA256MSG1/MSG2 extend the message schedule four words at a time.
+__attribute__((target("sha,sse4.1")))
+static void sha256_blocks_shani(uint32_t state[8], const unsigned char* data, size_t blocks) {
+    const __m128i byte_swap = _mm_set_epi64x(0x0c0d0e0f08090a0bLL, 0x0405060700010203LL);
+    __m128i dcba = _mm_loadu_si128((const __m128i*)&state[0]);
+    __m128i hgfe = _mm_loadu_si128((const __m128i*)&state[4]);
+    __m128i cdab = _mm_shuffle_epi32(dcba, 0xb1);
+    __m128i efgh = _mm_shuffle_epi32(hgfe, 0x1b);
+    __m128i abef = _mm_alignr_epi8(cdab, efgh, 8);
+    __m128i cdgh = _mm_blend_epi16(efgh, cdab, 0xf0);
+    
+    for (; blocks > 0; blocks--, data += CPM_SHA256_BLOCK_SIZE) {
+        __m128i abef_start = abef;
+        __m128i cdgh_start = cdgh;
+        __m128i w[4];
+        for (int i = 0; i < 4; i++) {
+            w[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + i * 16)), byte_swap);
+        }
+        
+        // w[i & 3] holds words 4i-16..4i-13 until step i replaces them with 4i..4i+3
+#pragma GCC unroll 16
+        for (int i = 0; i < 16; i++) {
+            if (i >= 4) {
+                __m128i next = _mm_sha256msg1_epu32(w[i & 3], w[(i + 1) & 3]);
+                next = _mm_add_epi32(next, _mm_alignr_epi8(w[(i + 3) & 3], w[(i + 2) & 3], 4));
+                w[i & 3] = _mm_sha256msg2_epu32(next, w[(i + 3) & 3]);
+            }
+            __m128i message = _mm_add_epi32(w[i & 3], _mm_loadu_si128((const __m128i*)&sha256_k[i * 4]));
+            cdgh = _mm_sha256rnds2_epu32(cdgh, abef, message);
+            abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(message, 0x0e));
+        }
+        
+        abef = _mm_add_epi32(abef, abef_start);
+        cdgh = _mm_add_epi32(cdgh, cdgh_start);
+    }
+    
+    __m128i feba = _mm_shuffle_epi32(abef, 0x1b);
+    __m128i dchg = _mm_shuffle_epi32(cdgh, 0xb1);
+    _mm_storeu_si128((__m128i*)&state[0], _mm_blend_epi16(feba, dchg, 0xf0));
+    _mm_storeu_si128((__m128i*)&state[4], _mm_alignr_epi8(dchg, feba, 8));
+}
+
+static bool sha256_cpu_has_shani(void) {
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) return false;
+    bool sse41 = (ecx & bit_SSE4_1) != 0;
+    bool ssse3 = (ecx & bit_SSSE3) != 0;
+    if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) return false;
+    return sse41 && ssse3 && (ebx & bit_SHA) != 0;
+}
+#endif
+
+// --- Implementation Choice ---
+typedef void (*Sha256Blocks)(uint32_t state[8], const unsigned char* data, size_t blocks);
+
+static Sha256Blocks sha256_blocks = sha256_blocks_portable;
+static CPM_SHA256Impl sha256_impl = CPM_SHA256_IMPL_PORTABLE;
+static pthread_once_t sha256_detect_once = PTHREAD_ONCE_INIT;
+
+static void sha256_detect(void) {
+#ifdef DIGEST_HAVE_SHANI
+    if (sha256_cpu_has_shani()) {
+        sha256_blocks = sha256_blocks_shani;
+        sha256_impl = CPM_SHA256_IMPL_SHANI;
+    }
+#endif
+}
+
+CPM_SHA256Impl cpm_sha256_implementation(void) {
+    pthread_once(&sha256_detect_once, sha256_detect);
+    return sha256_impl;
+}
+
+const char* cpm_sha256_implementation_name(CPM_SHA256Impl impl) {
+    return impl == CPM_SHA256_IMPL_SHANI ? "sha-ni" : "portable";
+}
+
+bool cpm_sha256_select(CPM_SHA256Impl impl) {
+    pthread_once(&sha256_detect_once, sha256_detect);
+    if (impl == CPM_SHA256_IMPL_PORTABLE) {
+        sha256_blocks = sha256_blocks_portable;
+        sha256_impl = impl;
+        return true;
+    }
+#ifdef DIGEST_HAVE_SHANI
+    if (impl == CPM_SHA256_IMPL_SHANI && sha256_cpu_has_shani()) {
+        sha256_blocks = sha256_blocks_shani;
+        sha256_impl = impl;
+        return true;
+    }
+#endif
+    return false;
+}
+
+void cpm_sha256_init(CPM_SHA256* ctx) {
+    static const uint32_t initial[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+    pthread_once(&sha256_detect_once, sha256_detect);
+    memcpy(ctx->state, initial, sizeof(initial));
+    ctx->length = 0;
+    ctx->block_used = 0;
+}
+
+void cpm_sha256_update(CPM_SHA256* ctx, const void* data, size_t size) {
+    const unsigned char* p = data;
+    ctx->length += size;
+    
+    if (ctx->block_used > 0) {
+        size_t take = CPM_SHA256_BLOCK_SIZE - ctx->block_used;
+        if (take > size) take = size;
+        memcpy(ctx->block + ctx->block_used, p, take);
+        ctx->block_used += take;
+        p += take;
+        size -= take;
+        if (ctx->block_used < CPM_SHA256_BLOCK_SIZE) return;
+        sha256_blocks(ctx->state, ctx->block, 1);
+        ctx->block_used = 0;
+    }
+    
+    // Whole blocks straight from the caller's buffer
+    size_t blocks = size / CPM_SHA256_BLOCK_SIZE;
+    if (blocks > 0) {
+        sha256_blocks(ctx->state, p, blocks);
+        p += blocks * CPM_SHA256_BLOCK_SIZE;
+        size -= blocks * CPM_SHA256_BLOCK_SIZE;
+    }
+    
+    memcpy(ctx->block, p, size);
+    ctx->block_used = size;
+}
+
+void cpm_sha256_final(CPM_SHA256* ctx, unsigned char digest[CPM_SHA256_DIGEST_SIZE]) {
+    uint64_t bit_length = ctx->length * 8;
+    
+    ctx->block[ctx->block_used++] = 0x80;
+    if (ctx->block_used > CPM_SHA256_BLOCK_SIZE - 8) {
+        memset(ctx->block + ctx->block_used, 0, CPM_SHA256_BLOCK_SIZE - ctx->block_used);
+        sha256_blocks(ctx->state, ctx->block, 1);
+        ctx->block_used = 0;
+    }
+    memset(ctx->block + ctx->block_used, 0, CPM_SHA256_BLOCK_SIZE - 8 - ctx->block_used);
+    for (int i = 0; i < 8; i++) {
+        ctx->block[CPM_SHA256_BLOCK_SIZE - 1 - i] = (unsigned char)(bit_length >> (i * 8));
+    }
+    sha256_blocks(ctx->state, ctx->block, 1);
+    
+    for (int i = 0; i < 8; i++) {
+        digest[i * 4] = (unsigned char)(ctx->state[i] >> 24);
+        digest[i * 4 + 1] = (unsigned char)(ctx->state[i] >> 16);
+        digest[i * 4 + 2] = (unsigned char)(ctx->state[i] >> 8);
+        digest[i * 4 + 3] = (unsigned char)ctx->state[i];
+    }
+}
+
+void cpm_sha256(const void* data, size_t size, unsigned char digest[CPM_SHA256_DIGEST_SIZE]) {
+    CPM_SHA256 ctx;
+    cpm_sha256_init(&ctx);
+    cpm_sha256_update(&ctx, data, size);
+    cpm_sha256_final(&ctx, digest);
+}
+
+// --- SHA-512 ---
+static const uint64_t sha512_k[80] = {
+    0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL, 0xb5c0fbcfec4d3b2fULL, 0xe9b5dba58189dbbcULL,
+    0x3956c25bf348b538ULL, 0x59f111f1b605d019ULL, 0x923f82a4af194f9bULL, 0xab1c5ed5da6d8118ULL,
+    0xd807aa98a3030242ULL, 0x12835b0145706fbeULL, 0x243185be4ee4b28cULL, 0x550c7dc3d5ffb4e2ULL,
+    0x72be5d74f27b896fULL, 0x80deb1fe3b1696b1ULL, 0x9bdc06a725c71235ULL, 0xc19bf174cf692694ULL,
+    0xe49b69c19ef14ad2ULL, 0xefbe4786384f25e3ULL, 0x0fc19dc68b8cd5b5ULL, 0x240ca1cc77ac9c65ULL,
+    0x2de92c6f592b0275ULL, 0x4a7484aa6ea6e483ULL, 0x5cb0a9dcbd41fbd4ULL, 0x76f988da831153b5ULL,
+    0x983e5152ee66dfabULL, 0xa831c66d2db43210ULL, 0xb00327c898fb213fULL, 0xbf597fc7beef0ee4ULL,
+    0xc6e00bf33da88fc2ULL, 0xd5a79147930aa725ULL, 0x06ca6351e003826fULL, 0x142929670a0e6e70ULL,
+    0x27b70a8546d22ffcULL, 0x2e1b21385c26c926ULL, 0x4d2c6dfc5ac42aedULL, 0x53380d139d95b3dfULL,
+    0x650a73548baf63deULL, 0x766a0abb3c77b2a8ULL, 0x81c2c92e47edaee6ULL, 0x92722c851482353bULL,
+    0xa2bfe8a14cf10364ULL, 0xa81a664bbc423001ULL, 0xc24b8b70d0f89791ULL, 0xc76c51a30654be30ULL,
+    0xd192e819d6ef5218ULL, 0xd69906245565a910ULL, 0xf40e35855771202aULL, 0x106aa07032bbd1b8ULL,
+    0x19a4c116b8d2d0c8ULL, 0x1e376c085141ab53ULL, 0x2748774cdf8eeb99ULL, 0x34b0bcb5e19b48a8ULL,
+    0x391c0cb3c5c95a63ULL, 0x4ed8aa4ae3418acbULL, 0x5b9cca4f7763e373ULL, 0x682e6ff3d6b2b8a3ULL,
+    0x748f82ee5defb2fcULL, 0x78a5636f43172f60ULL, 0x84c87814a1f0ab72ULL, 0x8cc702081a6439ecULL,
+    0x90befffa23631e28ULL, 0xa4506cebde82bde9ULL, 0xbef9a3f7b2c67915ULL, 0xc67178f2e372532bULL,
+    0xca273eceea26619cULL, 0xd186b8c721c0c207ULL, 0xeada7dd6cde0eb1eULL, 0xf57d4f7fee6ed178ULL,
+    0x06f067aa72176fbaULL, 0x0a637dc5a2c898a6ULL, 0x113f9804bef90daeULL, 0x1b710b35131c471bULL,
+    0x28db77f523047d84ULL, 0x32caab7b40c72493ULL, 0x3c9ebe0a15c9bebcULL, 0x431d67c49c100d4cULL,
+    0x4cc5d4becb3e42b6ULL, 0x597f299cfc657e2aULL, 0x5fcb6fab3ad6faecULL, 0x6c44198c4a475817ULL
+};
+
+#define ROTR64(x, n) (((x) >> (n)) | ((x) << (64 - (n))))
+
+static void sha512_compress(uint64_t state[8], const unsigned char* block) {
+    uint64_t w[80];
+    for (int i = 0; i < 16; i++) {
+        w[i] = 0;
+        for (int j = 0; j < 8; j++) w[i] = w[i] << 8 | block[i * 8 + j];
+    }
+    for (int i = 16; i < 80; i++) {
+        uint64_t s0 = ROTR64(w[i - 15], 1) ^ ROTR64(w[i - 15], 8) ^ (w[i - 15] >> 7);
+        uint64_t s1 = ROTR64(w[i - 2], 19) ^ ROTR64(w[i - 2], 61) ^ (w[i - 2] >> 6);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+    
+    uint64_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint64_t e = state[4], f = state[5], g = state[6], h = state[7];
+    
+    for (int i = 0; i < 80; i++) {
+        uint64_t s1 = ROTR64(e, 14) ^ ROTR64(e, 18) ^ ROTR64(e, 41);
+        uint64_t ch = (e & f) ^ (~e & g);
+        uint64_t t1 = h + s1 + ch + sha512_k[i] + w[i];
+        uint64_t s0 = ROTR64(a, 28) ^ ROTR64(a, 34) ^ ROTR64(a, 39);
+        uint64_t maj = (a & b) ^ (a & c) ^ (b & c);
+        uint64_t t2 = s0 + maj;
+        
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+    
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+}
+
+void cpm_sha512_init(CPM_SHA512* ctx) {
+    static const uint64_t initial[8] = {
+        0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL, 0x3c6ef372fe94f82bULL, 0xa54ff53a5f1d36f1ULL,
+        0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL, 0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL
+    };
+    memcpy(ctx->state, initial, sizeof(initial));
+    ctx->length = 0;
+    ctx->block_used = 0;
+}
+
+void cpm_sha512_update(CPM_SHA512* ctx, const void* data, size_t size) {
+    const unsigned char* p = data;
+    ctx->length += size;
+    
+    if (ctx->block_used > 0) {
+        size_t take = CPM_SHA512_BLOCK_SIZE - ctx->block_used;
+        if (take > size) take = size;
+        memcpy(ctx->block + ctx->block_used, p, take);
+        ctx->block_used += take;
+        p += take;
+        size -= take;
+        if (ctx->block_used < CPM_SHA512_BLOCK_SIZE) return;
+        sha512_compress(ctx->state, ctx->block);
+        ctx->block_used = 0;
+    }
+    
+    for (; size >= CPM_SHA512_BLOCK_SIZE; p += CPM_SHA512_BLOCK_SIZE, size -= CPM_SHA512_BLOCK_SIZE) {
+        sha512_compress(ctx->state, p);
+    }
+    
+    memcpy(ctx->block, p, size);
+    ctx->block_used = size;
+}
+
+void cpm_sha512_final(CPM_SHA512* ctx, unsigned char digest[CPM_SHA512_DIGEST_SIZE]) {
+    uint64_t bit_length = ctx->length * 8;
+    
+    // The length field is 128 bits; archives never need the upper half
+    ctx->block[ctx->block_used++] = 0x80;
+    if (ctx->block_used > CPM_SHA512_BLOCK_SIZE - 16) {
+        memset(ctx->block + ctx->block_used, 0, CPM_SHA512_BLOCK_SIZE - ctx->block_used);
+        sha512_compress(ctx->state, ctx->block);
+        ctx->block_used = 0;
+    }
+    memset(ctx->block + ctx->block_used, 0, CPM_SHA512_BLOCK_SIZE - 8 - ctx->block_used);
+    for (int i = 0; i < 8; i++) {
+        ctx->block[CPM_SHA512_BLOCK_SIZE - 1 - i] = (unsigned char)(bit_length >> (i * 8));
+    }
+    sha512_compress(ctx->state, ctx->block);
+    
+    for (int i = 0; i < 8; i++) {
+        for (int j = 0; j < 8; j++) digest[i * 8 + j] = (unsigned char)(ctx->state[i] >> (56 - j * 8));
+    }
+}
+
+void cpm_sha512(const void* data, size_t size, unsigned char digest[CPM_SHA512_DIGEST_SIZE]) {
+    CPM_SHA512 ctx;
+    cpm_sha512_init(&ctx);
+    cpm_sha512_update(&ctx, data, size);
+    cpm_sha512_final(&ctx, digest);
+}
+
+// --- Encodings ---
+char* cpm_digest_to_hex(const unsigned char* digest, size_t size) {
+    static const char hex[] = "0123456789abcdef";
+    char* out = malloc(size * 2 + 1);
+    if (!out) return NULL;
+    
+    for (size_t i = 0; i < size; i++) {
+        out[i * 2] = hex[digest[i] >> 4];
+        out[i * 2 + 1] = hex[digest[i] & 0x0f];
+    }
+    out[size * 2] = '\0';
+    return out;
+}
+
+char* cpm_digest_to_base64(const unsigned char* digest, size_t size) {
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    char* out = malloc((size + 2) / 3 * 4 + 1);
+    if (!out) return NULL;
+    
+    size_t o = 0;
+    for (size_t i = 0; i < size; i += 3) {
+        uint32_t chunk = (uint32_t)digest[i] << 16;
+        if (i + 1 < size) chunk |= (uint32_t)digest[i + 1] << 8;
+        if (i + 2 < size) chunk |= digest[i + 2];
+        
+        out[o++] = alphabet[(chunk >> 18) & 0x3f];
+        out[o++] = alphabet[(chunk >> 12) & 0x3f];
+        out[o++] = i + 1 < size ? alphabet[(chunk >> 6) & 0x3f] : '=';
+        out[o++] = i + 2 < size ? alphabet[chunk & 0x3f] : '=';
+    }
+    out[o] = '\0';
+    return out;
+}
+
+// --- Subresource Integrity ---
+#define SRI_SHA256_PREFIX "sha256-"
+#define SRI_SHA512_PREFIX "sha512-"
+
+bool cpm_sha256_file(const char* path, unsigned char digest[CPM_SHA256_DIGEST_SIZE]) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return false;
+    
+    CPM_SHA256 ctx;
+    cpm_sha256_init(&ctx);
+    
+    unsigned char buffer[65536];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0) {
+        cpm_sha256_update(&ctx, buffer, n);
+    }
+    
+    bool ok = !ferror(f);
+    fclose(f);
+    if (ok) cpm_sha256_final(&ctx, digest);
+    return ok;
+}
+
+char* cpm_integrity_of_file(const char* path) {
+    unsigned char digest[CPM_SHA256_DIGEST_SIZE];
+    if (!path || !cpm_sha256_file(path, digest)) return NULL;
+    
+    char* encoded = cpm_digest_to_base64(digest, sizeof(digest));
+    if (!encoded) return NULL;
+    
+    char* integrity = NULL;
+    if (asprintf(&integrity, "%s%s", SRI_SHA256_PREFIX, encoded) < 0) integrity = NULL;
+    free(encoded);
+    return integrity;
+}
+
+static int base64_value(char c) {
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == '+') return 62;
+    if (c == '/') return 63;
+    return -1;
+}
+
+// Decodes exactly size bytes of padded base64 from text[0..length); false if
+// the text is anything else
+static bool base64_decode_digest(const char* text, size_t length, unsigned char* digest, size_t size) {
+    size_t padding = (3 - size % 3) % 3;
+    size_t chars = (size + 2) / 3 * 4;
+    if (length != chars) return false;
+    for (size_t i = chars - padding; i < chars; i++) {
+        if (text[i] != '=') return false;
+    }
+    
+    uint32_t bits = 0;
+    int bit_count = 0;
+    size_t out = 0;
+    for (size_t i = 0; i < chars - padding; i++) {
+        int value = base64_value(text[i]);
+        if (value < 0) return false;
+        bits = bits << 6 | (uint32_t)value;
+        bit_count += 6;
+        if (bit_count >= 8) {
+            bit_count -= 8;
+            if (out < size) digest[out++] = (unsigned char)(bits >> bit_count);
+        }
+    }
+    return out == size;
+}
+
+// One "<algorithm>-<base64>[?options]" entry of an SRI string
+static bool integrity_parse_entry(const char* entry, size_t length, CPM_IntegrityHash* hash) {
+    static const struct {
+        const char* prefix;
+        CPM_IntegrityAlgorithm algorithm;
+        size_t size;
+    } algorithms[] = {
+        { SRI_SHA256_PREFIX, CPM_INTEGRITY_SHA256, CPM_SHA256_DIGEST_SIZE },
+        { SRI_SHA512_PREFIX, CPM_INTEGRITY_SHA512, CPM_SHA512_DIGEST_SIZE },
+    };
+    
+    const char* options = memchr(entry, '?', length);
+    if (options) length = (size_t)(options - entry);
+    for (size_t i = 0; i < sizeof(algorithms) / sizeof(algorithms[0]); i++) {
+        size_t prefix = strlen(algorithms[i].prefix);
+        if (length < prefix || strncmp(entry, algorithms[i].prefix, prefix) != 0) continue;
+        if (!base64_decode_digest(entry + prefix, length - prefix, hash->digest, algorithms[i].size)) return false;
+        hash->algorithm = algorithms[i].algorithm;
+        hash->size = algorithms[i].size;
+        return true;
+    }
+    return false;
+}
+
+bool cpm_integrity_parse(const char* integrity, CPM_IntegrityHash* hash) {
+    hash->algorithm = CPM_INTEGRITY_NONE;
+    hash->size = 0;
+    if (!integrity) return false;
+    
+    // Entries are whitespace-separated; the strongest well-formed one wins
+    const char* p = integrity;
+    while (*p) {
+        while (*p == ' ' || *p == '\t' || *p == '\n') p++;
+        const char* end = p;
+        while (*end && *end != ' ' && *end != '\t' && *end != '\n') end++;
+        
+        CPM_IntegrityHash entry;
+        if (end > p && integrity_parse_entry(p, (size_t)(end - p), &entry) && entry.algorithm > hash->algorithm) {
+            *hash = entry;
+        }
+        p = end;
+    }
+    return hash->algorithm != CPM_INTEGRITY_NONE;
+}
+
+bool cpm_integrity_supported(const char* integrity) {
+    CPM_IntegrityHash hash;
+    return cpm_integrity_parse(integrity, &hash);
+}
+
+bool cpm_integrity_sha256(const char* integrity, unsigned char digest[CPM_SHA256_DIGEST_SIZE]) {
+    if (!integrity) return false;
+    
+    for (const char* p = strstr(integrity, SRI_SHA256_PREFIX); p; p = strstr(p + 1, SRI_SHA256_PREFIX)) {
+        if (p != integrity && p[-1] != ' ' && p[-1] != '\t' && p[-1] != '\n') continue;
+        size_t length = strcspn(p, " \t\n");
+        CPM_IntegrityHash hash;
+        if (integrity_parse_entry(p, length, &hash) && hash.algorithm == CPM_INTEGRITY_SHA256) {
+            memcpy(digest, hash.digest, CPM_SHA256_DIGEST_SIZE);
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool sha512_file(const char* path, unsigned char digest[CPM_SHA512_DIGEST_SIZE]) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return false;
+    
+    CPM_SHA512 ctx;
+    cpm_sha512_init(&ctx);
+    
+    unsigned char buffer[65536];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0) {
+        cpm_sha512_update(&ctx, buffer, n);
+    }
+    
+    bool ok = !ferror(f);
+    fclose(f);
+    if (ok) cpm_sha512_final(&ctx, digest);
+    return ok;
+}
+
+bool cpm_integrity_check_file(const char* path, const char* integrity) {
+    CPM_IntegrityHash expected;
+    if (!cpm_integrity_parse(integrity, &expected)) return false;
+    
+    unsigned char actual[CPM_DIGEST_MAX_SIZE];
+    bool hashed = expected.algorithm == CPM_INTEGRITY_SHA512 ? sha512_file(path, actual) : cpm_sha256_file(path, actual);
+    return hashed && memcmp(actual, expected.digest, expected.size) == 0;
+}
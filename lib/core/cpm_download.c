@@ -0,0 +1,665 @@
+/*
+ * File: lib/core/cpm_download.c
+ * Description: Resumable, range-request downloads for CPM.
+ * The first request asks for the first chunk only (when chunking is allowed).
+ * A 206 that reveals a larger resource turns the download into a chunked one:
+ * that response becomes chunk 0 and the rest are fetched as parallel ranges on
+ * one curl multi handle. Otherwise the bytes go straight to the sink, and a
+ * dropped transfer continues with "Range: bytes=<delivered>-".
+ * A partial directory holds:
+ *   meta                    "CPMPART1 <total> <chunk size> <validator>"
+ *   lock                    flock()ed by the process using the directory
+ *   <n>.part                chunk n, always a prefix of its byte range
+ * Author: Dr. Q Josef Kurk Edwards
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include "cpm_download.h"
+#include "cpm_registry.h"
+#include "cpm_store.h"
+
+#define DOWNLOAD_MAGIC "CPMPART1"
+#define DOWNLOAD_META_FILE "meta"
+#define DOWNLOAD_LOCK_FILE "lock"
+#define DOWNLOAD_VALIDATOR_MAX 256
+#define DOWNLOAD_MAX_RESUMES 32
+#define DOWNLOAD_RETRY_DELAY_US 200000
+#define DOWNLOAD_READ_BUFFER 65536
+
+// --- Response Headers ---
+typedef struct {
+    long status;
+    bool ranged;                // Carried a parsable Content-Range
+    uint64_t range_start;
+    uint64_t range_total;
+    char etag[DOWNLOAD_VALIDATOR_MAX];
+    char last_modified[DOWNLOAD_VALIDATOR_MAX];
+} ResponseHead;
+
+static bool header_value(const char* line, size_t len, const char* name, char* out, size_t out_size) {
+    size_t name_len = strlen(name);
+    if (len <= name_len || strncasecmp(line, name, name_len) != 0 || line[name_len] != ':') return false;
+    
+    const char* value = line + name_len + 1;
+    const char* end = line + len;
+    while (value < end && (*value == ' ' || *value == '\t')) value++;
+    while (end > value && (end[-1] == '\r' || end[-1] == '\n' || end[-1] == ' ')) end--;
+    
+    size_t n = (size_t)(end - value);
+    if (n >= out_size) n = out_size - 1;
+    memcpy(out, value, n);
+    out[n] = '\0';
+    return true;
+}
+
+static size_t download_header(char* buffer, size_t size, size_t nitems, void* userdata) {
+    ResponseHead* head = userdata;
+    size_t len = size * nitems;
+    char value[DOWNLOAD_VALIDATOR_MAX];
+    
+    if (len > 5 && strncmp(buffer, "HTTP/", 5) == 0) {
+        // Each response (after a redirect, say) starts over
+        memset(head, 0, sizeof(*head));
+        const char* space = memchr(buffer, ' ', len);
+        if (space) head->status = strtol(space + 1, NULL, 10);
+    } else if (header_value(buffer, len, "Content-Range", value, sizeof(value))) {
+        unsigned long long start, end, total;
+        if (sscanf(value, "bytes %llu-%llu/%llu", &start, &end, &total) == 3 && start <= end && end < total) {
+            head->ranged = true;
+            head->range_start = start;
+            head->range_total = total;
+        }
+    } else if (!header_value(buffer, len, "ETag", head->etag, sizeof(head->etag))) {
+        header_value(buffer, len, "Last-Modified", head->last_modified, sizeof(head->last_modified));
+    }
+    return len;
+}
+
+// If-Range needs a strong validator: a strong ETag, else Last-Modified
+static const char* head_validator(const ResponseHead* head) {
+    if (head->etag[0] && strncmp(head->etag, "W/", 2) != 0) return head->etag;
+    return head->last_modified[0] ? head->last_modified : NULL;
+}
+
+static bool download_retryable(CURLcode result, long status) {
+    switch (result) {
+        case CURLE_PARTIAL_FILE:
+        case CURLE_RECV_ERROR:
+        case CURLE_SEND_ERROR:
+        case CURLE_OPERATION_TIMEDOUT:
+        case CURLE_GOT_NOTHING:
+        case CURLE_COULDNT_CONNECT:
+        case CURLE_SSL_CONNECT_ERROR:
+        case CURLE_HTTP2:
+        case CURLE_HTTP2_STREAM:
+            return true;
+        case CURLE_HTTP_RETURNED_ERROR:
+            return status >= 500 || status == 429;
+        default:
+            return false;
+    }
+}
+
+static bool write_all(int fd, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+// --- Download State ---
+typedef struct {
+    const CPM_DownloadOptions* options;
+    CPM_DownloadSink sink;
+    CPM_DownloadReset reset;
+    void* ctx;
+    CPM_DownloadResult* result;
+    int max_attempts;
+    
+    uint64_t delivered;         // Bytes handed to the sink
+    uint64_t total;             // 0 = not known
+    char validator[DOWNLOAD_VALIDATOR_MAX];
+    bool sink_failed;
+    int lock_fd;                // Holds the partial directory; -1 = not ours
+} Download;
+
+// --- Partial Directory ---
+static void partial_path(const Download* download, const char* file, char* path, size_t size) {
+    snprintf(path, size, "%s/%s", download->options->partial_dir, file);
+}
+
+static void chunk_path(const Download* download, size_t index, char* path, size_t size) {
+    snprintf(path, size, "%s/%zu.part", download->options->partial_dir, index);
+}
+
+// Claims the partial directory; false if it is missing (and not to be
+// created) or another install is using it
+static bool partial_lock(Download* download, bool create) {
+    if (download->lock_fd >= 0) return true;
+    if (create && mkdir(download->options->partial_dir, 0755) != 0 && errno != EEXIST) return false;
+    
+    char path[1100];
+    partial_path(download, DOWNLOAD_LOCK_FILE, path, sizeof(path));
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) return false;
+    if (flock(fd, LOCK_EX | LOCK_NB) != 0) {
+        close(fd);
+        return false;
+    }
+    download->lock_fd = fd;
+    return true;
+}
+
+static void partial_unlock(Download* download) {
+    if (download->lock_fd < 0) return;
+    close(download->lock_fd);
+    download->lock_fd = -1;
+}
+
+static void partial_discard(Download* download) {
+    if (download->lock_fd < 0) return;
+    cpm_store_remove_tree(download->options->partial_dir);
+    partial_unlock(download);
+}
+
+static bool partial_write_meta(const Download* download) {
+    char path[1100];
+    char temp[1108];
+    partial_path(download, DOWNLOAD_META_FILE, path, sizeof(path));
+    snprintf(temp, sizeof(temp), "%s.tmp", path);
+    
+    FILE* f = fopen(temp, "w");
+    if (!f) return false;
+    fprintf(f, "%s %" PRIu64 " %" PRIu64 " %s\n", DOWNLOAD_MAGIC, download->total, download->options->chunk_size, download->validator);
+    bool ok = fclose(f) == 0 && rename(temp, path) == 0;
+    if (!ok) unlink(temp);
+    return ok;
+}
+
+// Picks up a chunked download an earlier run left; false if there is none
+// this one can continue
+static bool partial_read_meta(Download* download) {
+    char path[1100];
+    partial_path(download, DOWNLOAD_META_FILE, path, sizeof(path));
+    FILE* f = fopen(path, "r");
+    if (!f) return false;
+    
+    char line[DOWNLOAD_VALIDATOR_MAX + 128];
+    char magic[16] = "";
+    unsigned long long total = 0;
+    unsigned long long chunk_size = 0;
+    int offset = 0;
+    bool ok = fgets(line, sizeof(line), f) &&
+              sscanf(line, "%15s %llu %llu %n", magic, &total, &chunk_size, &offset) == 3 &&
+              strcmp(magic, DOWNLOAD_MAGIC) == 0 && chunk_size == download->options->chunk_size && total > chunk_size;
+    fclose(f);
+    if (!ok) return false;
+    
+    line[strcspn(line, "\n")] = '\0';
+    snprintf(download->validator, sizeof(download->validator), "%s", line + offset);
+    download->total = total;
+    return true;
+}
+
+// Turns the download into a chunked one whose chunk 0 is being received
+static int partial_begin(Download* download) {
+    if (!partial_lock(download, true)) return -1;
+    if (!partial_write_meta(download)) {
+        partial_discard(download);
+        return -1;
+    }
+    
+    char path[1100];
+    chunk_path(download, 0, path, sizeof(path));
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) partial_discard(download);
+    return fd;
+}
+
+// --- Single Stream ---
+typedef struct {
+    Download* download;
+    CURL* curl;
+    ResponseHead head;
+    bool body_started;
+    bool range_mismatch;
+    int chunk_fd;               // >= 0: the body is chunk 0 of a chunked download
+    uint64_t received;
+} StreamTransfer;
+
+static bool stream_begin_body(StreamTransfer* transfer) {
+    Download* download = transfer->download;
+    const CPM_DownloadOptions* options = download->options;
+    const ResponseHead* head = &transfer->head;
+    
+    if (head->status == 206) {
+        if (!head->ranged || head->range_start != download->delivered) {
+            transfer->range_mismatch = true;
+            return false;
+        }
+        download->total = head->range_total;
+    } else {
+        // The whole resource from byte 0: a server without ranges, or one whose copy changed
+        if (download->delivered > 0) {
+            if (!download->reset || !download->reset(download->ctx)) {
+                download->sink_failed = true;
+                return false;
+            }
+            download->delivered = 0;
+        }
+        curl_off_t length = -1;
+        curl_easy_getinfo(transfer->curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &length);
+        download->total = length > 0 ? (uint64_t)length : 0;
+    }
+    
+    if (download->delivered == 0) {
+        const char* validator = head_validator(head);
+        snprintf(download->validator, sizeof(download->validator), "%s", validator ? validator : "");
+        
+        // Too large for one stream: continue in chunks, if the partial directory is free
+        if (head->status == 206 && options->partial_dir && options->chunk_size && download->total > options->chunk_size) {
+            transfer->chunk_fd = partial_begin(download);
+        }
+    }
+    return true;
+}
+
+static size_t stream_write(char* data, size_t size, size_t nmemb, void* userdata) {
+    StreamTransfer* transfer = userdata;
+    Download* download = transfer->download;
+    size_t len = size * nmemb;
+    
+    if (!transfer->body_started) {
+        transfer->body_started = true;
+        if (!stream_begin_body(transfer)) return 0;
+    }
+    transfer->received += len;
+    download->result->transferred += len;
+    
+    if (transfer->chunk_fd >= 0) return write_all(transfer->chunk_fd, data, len) ? len : 0;
+    
+    if (!download->sink(data, len, download->ctx)) {
+        download->sink_failed = true;
+        return 0;
+    }
+    download->delivered += len;
+    return len;
+}
+
+// Streams the resource into the sink, resuming dropped transfers. Stops early,
+// setting *chunked, once the resource turns out to need chunking.
+static bool download_stream(Download* download, bool* chunked) {
+    const CPM_DownloadOptions* options = download->options;
+    CPM_DownloadResult* result = download->result;
+    int failures = 0;
+    
+    for (;;) {
+        StreamTransfer transfer = { .download = download, .chunk_fd = -1 };
+        transfer.curl = cpm_registry_handle_acquire();
+        if (!transfer.curl) {
+            result->result = CURLE_FAILED_INIT;
+            return false;
+        }
+        
+        // The first request asks for one chunk, so the response tells whether to split
+        char range[64] = "";
+        if (download->delivered > 0) {
+            snprintf(range, sizeof(range), "%" PRIu64 "-", download->delivered);
+        } else if (options->partial_dir && options->chunk_size) {
+            snprintf(range, sizeof(range), "0-%" PRIu64, options->chunk_size - 1);
+        }
+        struct curl_slist* headers = NULL;
+        if (download->delivered > 0 && download->validator[0]) {
+            char if_range[DOWNLOAD_VALIDATOR_MAX + 16];
+            snprintf(if_range, sizeof(if_range), "If-Range: %s", download->validator);
+            headers = curl_slist_append(NULL, if_range);
+        }
+        
+        CURL* curl = transfer.curl;
+        curl_easy_setopt(curl, CURLOPT_URL, options->url);
+        curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+        curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1L);
+        curl_easy_setopt(curl, CURLOPT_TIMEOUT, options->timeout_seconds);
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, stream_write);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &transfer);
+        curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, download_header);
+        curl_easy_setopt(curl, CURLOPT_HEADERDATA, &transfer.head);
+        if (range[0]) curl_easy_setopt(curl, CURLOPT_RANGE, range);
+        if (headers) curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+        
+        CURLcode res = curl_easy_perform(curl);
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &result->status);
+        cpm_registry_handle_release(curl);
+        curl_slist_free_all(headers);
+        result->result = res;
+        
+        if (transfer.chunk_fd >= 0) {
+            // Chunk 0 is on disk, complete or not; the chunked fetch takes it from here
+            close(transfer.chunk_fd);
+            *chunked = true;
+            return false;
+        }
+        if (download->sink_failed) return false;
+        if (transfer.range_mismatch) {
+            result->result = CURLE_RANGE_ERROR;
+            return false;
+        }
+        if (res == CURLE_OK && (result->status != 206 || download->delivered == download->total)) return true;
+        
+        // A short 206 (the first chunk of a resource not being chunked) just continues
+        bool retryable = res == CURLE_OK || download_retryable(res, result->status);
+        if (!retryable) return false;
+        if (transfer.received > 0 && download->delivered > 0) {
+            if (res != CURLE_OK && ++result->resumes > DOWNLOAD_MAX_RESUMES) return false;
+            failures = 0;
+        } else {
+            if (++failures >= download->max_attempts) return false;
+            usleep(DOWNLOAD_RETRY_DELAY_US * (useconds_t)failures);
+        }
+    }
+}
+
+// --- Chunks ---
+typedef struct {
+    Download* download;
+    CURL* curl;
+    struct curl_slist* headers;
+    ResponseHead head;
+    uint64_t next;              // Next offset this chunk needs
+    uint64_t end;               // One past its last byte
+    int fd;
+    bool body_started;
+    bool stale;                 // The response does not continue this resource
+} ChunkTransfer;
+
+typedef enum {
+    CHUNKS_DONE,
+    CHUNKS_FAILED,              // Network trouble; the partial directory is kept
+    CHUNKS_STALE                // The resource changed; the partial directory is gone
+} ChunksOutcome;
+
+static size_t chunk_write(char* data, size_t size, size_t nmemb, void* userdata) {
+    ChunkTransfer* chunk = userdata;
+    size_t len = size * nmemb;
+    
+    if (!chunk->body_started) {
+        chunk->body_started = true;
+        // Anything but the exact range of the same resource (a 200 means If-Range failed)
+        const ResponseHead* head = &chunk->head;
+        if (head->status != 206 || !head->ranged || head->range_start != chunk->next ||
+            head->range_total != chunk->download->total) {
+            chunk->stale = true;
+            return 0;
+        }
+    }
+    if (len > chunk->end - chunk->next || !write_all(chunk->fd, data, len)) return 0;
+    chunk->next += len;
+    chunk->download->result->transferred += len;
+    return len;
+}
+
+static bool chunk_start(Download* download, ChunkTransfer* chunk, size_t index, CURLM* multi) {
+    char path[1100];
+    chunk_path(download, index, path, sizeof(path));
+    chunk->fd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    chunk->curl = chunk->fd >= 0 ? cpm_registry_handle_acquire() : NULL;
+    if (!chunk->curl) {
+        if (chunk->fd >= 0) close(chunk->fd);
+        chunk->fd = -1;
+        return false;
+    }
+    chunk->body_started = false;
+    
+    char range[64];
+    snprintf(range, sizeof(range), "%" PRIu64 "-%" PRIu64, chunk->next, chunk->end - 1);
+    chunk->headers = NULL;
+    if (download->validator[0]) {
+        char if_range[DOWNLOAD_VALIDATOR_MAX + 16];
+        snprintf(if_range, sizeof(if_range), "If-Range: %s", download->validator);
+        chunk->headers = curl_slist_append(NULL, if_range);
+    }
+    
+    CURL* curl = chunk->curl;
+    curl_easy_setopt(curl, CURLOPT_URL, download->options->url);
+    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1L);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, download->options->timeout_seconds);
+    curl_easy_setopt(curl, CURLOPT_RANGE, range);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, chunk_write);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, chunk);
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, download_header);
+    curl_easy_setopt(curl, CURLOPT_HEADERDATA, &chunk->head);
+    curl_easy_setopt(curl, CURLOPT_PRIVATE, chunk);
+    if (chunk->headers) curl_easy_setopt(curl, CURLOPT_HTTPHEADER, chunk->headers);
+    
+    if (curl_multi_add_handle(multi, curl) != CURLM_OK) {
+        cpm_registry_handle_release(curl);
+        curl_slist_free_all(chunk->headers);
+        close(chunk->fd);
+        chunk->curl = NULL;
+        chunk->fd = -1;
+        return false;
+    }
+    return true;
+}
+
+static void chunk_finish(ChunkTransfer* chunk, CURLM* multi) {
+    curl_multi_remove_handle(multi, chunk->curl);
+    cpm_registry_handle_release(chunk->curl);
+    curl_slist_free_all(chunk->headers);
+    close(chunk->fd);
+    chunk->curl = NULL;
+    chunk->headers = NULL;
+    chunk->fd = -1;
+}
+
+// Fetches every chunk's missing bytes, max_parallel at a time
+static ChunksOutcome download_chunks(Download* download, bool resumed) {
+    const CPM_DownloadOptions* options = download->options;
+    CPM_DownloadResult* result = download->result;
+    uint64_t chunk_size = options->chunk_size;
+    size_t count = (size_t)((download->total + chunk_size - 1) / chunk_size);
+    int max_parallel = options->max_parallel > 0 ? options->max_parallel : 1;
+    result->chunks = count;
+    
+    ChunkTransfer* chunks = calloc(count, sizeof(ChunkTransfer));
+    CURLM* multi = curl_multi_init();
+    if (!chunks || !multi) {
+        free(chunks);
+        curl_multi_cleanup(multi);
+        result->result = CURLE_OUT_OF_MEMORY;
+        return CHUNKS_FAILED;
+    }
+    
+    // Each chunk file holds a prefix of its range; anything longer is not to be trusted
+    for (size_t i = 0; i < count; i++) {
+        ChunkTransfer* chunk = &chunks[i];
+        uint64_t start = (uint64_t)i * chunk_size;
+        chunk->download = download;
+        chunk->end = start + chunk_size < download->total ? start + chunk_size : download->total;
+        chunk->fd = -1;
+        
+        char path[1100];
+        struct stat st;
+        chunk_path(download, i, path, sizeof(path));
+        uint64_t have = stat(path, &st) == 0 ? (uint64_t)st.st_size : 0;
+        if (have > chunk->end - start) {
+            unlink(path);
+            have = 0;
+        }
+        chunk->next = start + have;
+        if (resumed) result->reused += have;
+    }
+    
+    ChunksOutcome outcome = CHUNKS_FAILED;
+    int failures = 0;
+    for (;;) {
+        // A round gives every unfinished chunk one transfer
+        uint64_t before = result->transferred;
+        CURLcode round_result = CURLE_OK;
+        long round_status = 0;
+        bool stale = false;
+        size_t next = 0;
+        int active = 0;
+        
+        while (next < count || active > 0) {
+            while (active < max_parallel && next < count) {
+                ChunkTransfer* chunk = &chunks[next];
+                if (chunk->next < chunk->end) {
+                    if (chunk_start(download, chunk, next, multi)) {
+                        active++;
+                    } else {
+                        round_result = CURLE_FAILED_INIT;
+                    }
+                }
+                next++;
+            }
+            
+            int running = 0;
+            curl_multi_perform(multi, &running);
+            
+            CURLMsg* msg;
+            int queued;
+            while ((msg = curl_multi_info_read(multi, &queued))) {
+                if (msg->msg != CURLMSG_DONE) continue;
+                ChunkTransfer* chunk = NULL;
+                curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char**)&chunk);
+                long status = 0;
+                curl_easy_getinfo(msg->easy_handle, CURLINFO_RESPONSE_CODE, &status);
+                result->status = status;
+                if (msg->data.result != CURLE_OK) {
+                    round_result = msg->data.result;
+                    round_status = status;
+                }
+                stale = stale || chunk->stale;
+                chunk_finish(chunk, multi);
+                active--;
+            }
+            if (active > 0) curl_multi_poll(multi, NULL, 0, 1000, NULL);
+        }
+        
+        bool complete = true;
+        for (size_t i = 0; i < count && complete; i++) complete = chunks[i].next == chunks[i].end;
+        if (complete) {
+            result->result = CURLE_OK;
+            outcome = CHUNKS_DONE;
+            break;
+        }
+        if (stale) {
+            result->result = CURLE_RANGE_ERROR;
+            outcome = CHUNKS_STALE;
+            break;
+        }
+        
+        result->result = round_result == CURLE_OK ? CURLE_PARTIAL_FILE : round_result;
+        if (round_result != CURLE_OK && !download_retryable(round_result, round_status)) break;
+        if (result->transferred > before) {
+            if (++result->resumes > DOWNLOAD_MAX_RESUMES) break;
+            failures = 0;
+        } else {
+            if (++failures >= download->max_attempts) break;
+            usleep(DOWNLOAD_RETRY_DELAY_US * (useconds_t)failures);
+        }
+    }
+    
+    curl_multi_cleanup(multi);
+    free(chunks);
+    if (outcome == CHUNKS_STALE) {
+        partial_discard(download);
+        result->reused = 0;
+    }
+    return outcome;
+}
+
+// Feeds the finished chunks to the sink in order
+static bool download_deliver_chunks(Download* download) {
+    size_t count = download->result->chunks;
+    char* buffer = malloc(DOWNLOAD_READ_BUFFER);
+    if (!buffer) return false;
+    
+    bool ok = true;
+    for (size_t i = 0; i < count && ok; i++) {
+        char path[1100];
+        chunk_path(download, i, path, sizeof(path));
+        int fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            ok = false;
+            break;
+        }
+        ssize_t n = 0;
+        while (ok && (n = read(fd, buffer, DOWNLOAD_READ_BUFFER)) > 0) {
+            ok = download->sink(buffer, (size_t)n, download->ctx);
+            if (ok) download->delivered += (uint64_t)n;
+        }
+        if (n < 0) ok = false;
+        close(fd);
+    }
+    free(buffer);
+    if (!ok) download->result->result = CURLE_WRITE_ERROR;
+    return ok;
+}
+
+// --- Downloads ---
+bool cpm_download(const CPM_DownloadOptions* options, CPM_DownloadSink sink, CPM_DownloadReset reset,
+                  void* ctx, CPM_DownloadResult* result) {
+    CPM_DownloadResult local;
+    if (!result) result = &local;
+    memset(result, 0, sizeof(*result));
+    result->result = CURLE_FAILED_INIT;
+    if (!options || !options->url || !sink) return false;
+    
+    Download download = {
+        .options = options,
+        .sink = sink,
+        .reset = reset,
+        .ctx = ctx,
+        .result = result,
+        .max_attempts = options->max_attempts > 0 ? options->max_attempts : CPM_DOWNLOAD_DEFAULT_ATTEMPTS,
+        .lock_fd = -1,
+    };
+    bool chunking = options->partial_dir && options->chunk_size > 0;
+    
+    // A resource that changed under its chunks is started over, once
+    bool ok = false;
+    for (int pass = 0; pass < 2; pass++) {
+        bool resumed = false;
+        if (chunking && partial_lock(&download, false)) {
+            resumed = partial_read_meta(&download);
+            if (!resumed) partial_discard(&download);
+        }
+        
+        bool chunked = resumed;
+        if (!chunked) {
+            ok = download_stream(&download, &chunked);
+            if (!chunked) break;
+        }
+        
+        ChunksOutcome outcome = download_chunks(&download, resumed);
+        if (outcome == CHUNKS_STALE) continue;
+        if (outcome == CHUNKS_DONE) {
+            ok = download_deliver_chunks(&download);
+            partial_discard(&download);
+        }
+        break;
+    }
+    
+    partial_unlock(&download);
+    result->size = download.delivered;
+    return ok;
+}
@@ -0,0 +1,619 @@
+/*
+ * File: lib/core/cpm_install.c
+ * Description: Dependency installation for CPM.
+ * Resolved packages flow through a four-stage pipeline (cpm_pipeline.h):
+ *   download -> verify -> extract -> build
+ * Downloads are unpacked as they arrive (cpm_archive.h) into a staging
+ * directory and hashed on the way (SHA-256 always, SHA-512 too when that is
+ * what the integrity pins); verify only compares digests, extract moves or
+ * links the tree into cpm_modules. A dropped transfer resumes with a Range
+ * request, and an archive larger than a chunk is fetched as parallel ranges
+ * kept in the store until all have arrived (cpm_download.h); smaller archives
+ * never touch the disk.
+ * Each stage has its own worker pool, so one package can be downloading while
+ * another is verified and a third built. Only the build stage follows the
+ * dependency graph: a package builds once the packages it depends on have
+ * built (members of a dependency cycle don't wait on each other).
+ * With a store (cpm_store.h), unpacked trees are kept once per machine: a
+ * package whose integrity names a stored tree skips download and verify, and
+ * is linked into cpm_modules instead.
+ * Author: Dr. Q Josef Kurk Edwards
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <curl/curl.h>
+#include "cpm_deps.h"
+#include "cpm_archive.h"
+#include "cpm_digest.h"
+#include "cpm_download.h"
+#include "cpm_installed.h"
+#include "cpm_pipeline.h"
+#include "cpm_registry.h"
+#include "cpm_store.h"
+
+#define INSTALL_DOWNLOAD_WORKERS 4
+#define INSTALL_DOWNLOAD_TIMEOUT 300L
+#define INSTALL_DOWNLOADS_DIR ".cpm_downloads"
+
+typedef struct {
+    const DepNode** packages;
+    size_t count;
+    const char* modules_dir;
+    char** staged;              // Per package: tree unpacked while downloading, NULL if the registry has none
+    unsigned char (*digests)[CPM_SHA256_DIGEST_SIZE];  // Per package: SHA-256 of the downloaded archive
+    unsigned char (*sha512)[CPM_SHA512_DIGEST_SIZE];   // Per package: its SHA-512, if the integrity is one
+    CPM_Store* store;           // NULL: trees are moved straight into cpm_modules
+    char** keys;                // Per package: store key, once known
+    uint64_t chunk_size;        // Archives larger than this download in parallel chunks; 0 = never
+    int chunk_parallel;
+    
+    pthread_mutex_t stats_lock;
+    CPM_StoreLinkStats link_stats;
+    size_t from_store;          // Packages that needed no download
+    uint64_t unpacked_bytes;
+} InstallJob;
+
+static void install_package_dir(const InstallJob* job, size_t item, char* path, size_t size) {
+    snprintf(path, size, "%s/%s", job->modules_dir, job->packages[item]->name);
+}
+
+static void install_remove_tree(const char* path) {
+    if (!cpm_store_remove_tree(path)) printf("[CPM Deps] Warning: could not remove %s\n", path);
+}
+
+// Names become paths under modules_dir, so a registry or lockfile must not pick them freely
+static bool install_names_are_safe(const DepNode* const* packages, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        if (!cpm_package_name_is_safe(packages[i]->name)) {
+            printf("[CPM Deps] Refusing to install '%s': not a valid package name\n",
+                   packages[i]->name ? packages[i]->name : "");
+            return false;
+        }
+    }
+    return true;
+}
+
+// --- Stage: Download ---
+typedef struct {
+    CPM_ArchiveStream* stream;
+    const char* staged;
+    bool hash_sha512;           // The archive stream only computes SHA-256
+    CPM_SHA512 sha512;
+} InstallDownload;
+
+static bool install_archive_sink(const void* data, size_t size, void* ctx) {
+    InstallDownload* download = ctx;
+    if (download->hash_sha512) cpm_sha512_update(&download->sha512, data, size);
+    
+    // A body that isn't an archive (registry metadata) is drained and judged afterwards
+    return cpm_archive_stream_write(download->stream, data, size) == CPM_RESULT_SUCCESS ||
+           !cpm_archive_stream_is_archive(download->stream);
+}
+
+// The server started over from byte 0: so does the extraction
+static bool install_archive_reset(void* ctx) {
+    InstallDownload* download = ctx;
+    cpm_archive_stream_free(download->stream);
+    install_remove_tree(download->staged);
+    if (download->hash_sha512) cpm_sha512_init(&download->sha512);
+    download->stream = cpm_archive_stream_create(download->staged);
+    return download->stream != NULL;
+}
+
+static CPM_Result install_stage_download(void* context, size_t item) {
+    InstallJob* job = context;
+    const DepNode* dep = job->packages[item];
+    
+    const char* url = dep->resolved_url;
+    if (!url || (strncmp(url, "http://", 7) != 0 && strncmp(url, "https://", 8) != 0)) return CPM_RESULT_SUCCESS;
+    
+    if (job->store) {
+        // The integrity names the archive, so a stored tree makes the download moot
+        job->keys[item] = cpm_store_lookup_integrity(job->store, dep->integrity);
+        if (job->keys[item] && cpm_store_has_tree(job->store, job->keys[item])) {
+            pthread_mutex_lock(&job->stats_lock);
+            job->from_store++;
+            pthread_mutex_unlock(&job->stats_lock);
+            return CPM_RESULT_SUCCESS;
+        }
+    }
+    
+    char* version_str = dep->version ? semver_to_string(dep->version) : NULL;
+    char name[512];
+    snprintf(name, sizeof(name), "%s-%s", dep->name, version_str ? version_str : "unknown");
+    free(version_str);
+    
+    // Staged on the filesystem the tree ends up on, so handing it over is a rename
+    char staged[1024];
+    char* store_staging = job->store ? cpm_store_temp_path(job->store, name) : NULL;
+    if (store_staging) {
+        snprintf(staged, sizeof(staged), "%s", store_staging);
+        free(store_staging);
+    } else {
+        snprintf(staged, sizeof(staged), "%s/%s/%s", job->modules_dir, INSTALL_DOWNLOADS_DIR, name);
+        install_remove_tree(staged);
+    }
+    
+    printf("[CPM Deps] Downloading %s from %s\n", dep->name, url);
+    
+    CPM_IntegrityHash pinned;
+    InstallDownload download = { .stream = cpm_archive_stream_create(staged), .staged = staged };
+    if (!download.stream) return CPM_RESULT_ERROR_FILE_OPERATION;
+    download.hash_sha512 = cpm_integrity_parse(dep->integrity, &pinned) && pinned.algorithm == CPM_INTEGRITY_SHA512;
+    if (download.hash_sha512) cpm_sha512_init(&download.sha512);
+    
+    // Archives pinned by a key keep interrupted chunks in the store for the next run
+    char* partial_dir = job->keys[item] ? cpm_store_partial_path(job->store, job->keys[item]) : NULL;
+    CPM_DownloadOptions options = {
+        .url = url,
+        .timeout_seconds = INSTALL_DOWNLOAD_TIMEOUT,
+        .partial_dir = partial_dir,
+        .chunk_size = job->chunk_size,
+        .max_parallel = job->chunk_parallel,
+    };
+    CPM_DownloadResult fetched;
+    bool complete = cpm_download(&options, install_archive_sink, install_archive_reset, &download, &fetched);
+    CURLcode res = fetched.result;
+    free(partial_dir);
+    
+    if (fetched.chunks > 0 || fetched.resumes > 0) {
+        char split[32] = "one stream";
+        if (fetched.chunks > 0) snprintf(split, sizeof(split), "%zu chunks", fetched.chunks);
+        printf("[CPM Deps] %s: %.1f KB in %s, %zu resumed transfer%s, %.1f KB reused from an earlier run\n",
+               dep->name, (double)fetched.size / 1024.0, split,
+               fetched.resumes, fetched.resumes == 1 ? "" : "s", (double)fetched.reused / 1024.0);
+    }
+    
+    bool is_archive = download.stream && cpm_archive_stream_is_archive(download.stream);
+    CPM_Result unpacked = is_archive ? cpm_archive_stream_finish(download.stream, job->digests[item]) : CPM_RESULT_ERROR_PACKAGE_PARSE;
+    uint64_t unpacked_bytes = download.stream ? cpm_archive_stream_unpacked_bytes(download.stream) : 0;
+    cpm_archive_stream_free(download.stream);
+    if (download.hash_sha512) cpm_sha512_final(&download.sha512, job->sha512[item]);
+    
+    if (complete && fetched.status < 300 && unpacked == CPM_RESULT_SUCCESS) {
+        job->staged[item] = strdup(staged);
+        pthread_mutex_lock(&job->stats_lock);
+        job->unpacked_bytes += unpacked_bytes;
+        pthread_mutex_unlock(&job->stats_lock);
+        return job->staged[item] ? CPM_RESULT_SUCCESS : CPM_RESULT_ERROR_MEMORY_ALLOCATION;
+    }
+    install_remove_tree(staged);
+    
+    // Registries without archive hosting answer the tarball URL with metadata; only
+    // such a successful answer makes a metadata-only install, never a failed transfer
+    bool transfer_failed = res != CURLE_OK && res != CURLE_WRITE_ERROR;
+    bool answered = !transfer_failed && fetched.status >= 200 && fetched.status < 300;
+    if (!dep->integrity && answered && !is_archive) {
+        printf("[CPM Deps] No archive available for %s; installing its metadata only\n", dep->name);
+        return CPM_RESULT_SUCCESS;
+    }
+    if (transfer_failed) {
+        printf("[CPM Deps] Could not download %s (%s)\n", dep->name, curl_easy_strerror(res));
+    } else if (!answered) {
+        printf("[CPM Deps] Could not download %s (HTTP %ld)\n", dep->name, fetched.status);
+    } else {
+        printf("[CPM Deps] Could not download %s (%s)\n", dep->name,
+               !is_archive ? "not a package archive" : "archive could not be unpacked");
+    }
+    return answered ? CPM_RESULT_ERROR_PACKAGE_PARSE : CPM_RESULT_ERROR_NETWORK;
+}
+
+// --- Stage: Verify ---
+static CPM_Result install_stage_verify(void* context, size_t item) {
+    InstallJob* job = context;
+    const DepNode* dep = job->packages[item];
+    
+    if (!job->staged[item]) {
+        // Stored trees were verified on the way in; anything else pinned by integrity must have been downloaded
+        if (dep->integrity && !job->keys[item]) {
+            printf("[CPM Deps] %s has an integrity hash but no archive to check it against\n", dep->name);
+            return CPM_RESULT_ERROR_FILE_OPERATION;
+        }
+        return CPM_RESULT_SUCCESS;
+    }
+    
+    if (dep->integrity) {
+        // Both digests were computed while downloading; this is only a comparison
+        CPM_IntegrityHash expected;
+        bool verified = false;
+        if (!cpm_integrity_parse(dep->integrity, &expected)) {
+            printf("[CPM Deps] Cannot verify %s: unsupported integrity algorithm in '%s'\n", dep->name, dep->integrity);
+        } else if (memcmp(expected.digest, expected.algorithm == CPM_INTEGRITY_SHA512 ? job->sha512[item] : job->digests[item],
+                          expected.size) != 0) {
+            printf("[CPM Deps] Integrity check failed for %s: archive does not match %s\n", dep->name, dep->integrity);
+        } else {
+            verified = true;
+        }
+        if (!verified) {
+            install_remove_tree(job->staged[item]);
+            free(job->staged[item]);
+            job->staged[item] = NULL;
+            return CPM_RESULT_ERROR_FILE_OPERATION;
+        }
+    }
+    
+    if (!job->store) return CPM_RESULT_SUCCESS;
+    
+    // Verified trees join the store under the archive's hash
+    if (!job->keys[item]) job->keys[item] = cpm_digest_to_hex(job->digests[item], CPM_SHA256_DIGEST_SIZE);
+    if (!job->keys[item]) return CPM_RESULT_ERROR_MEMORY_ALLOCATION;
+    
+    CPM_Result result = cpm_store_add_tree(job->store, job->keys[item], job->staged[item]);
+    if (result != CPM_RESULT_SUCCESS) install_remove_tree(job->staged[item]);
+    if (result == CPM_RESULT_SUCCESS && dep->integrity) cpm_store_add_alias(job->store, dep->integrity, job->keys[item]);
+    free(job->staged[item]);
+    job->staged[item] = NULL;
+    return result;
+}
+
+// --- Stage: Extract ---
+// Whether the package in dir runs commands after it is extracted, which may
+// write to the files it shipped with
+static bool install_package_builds(const char* dir) {
+    char spec_file[1100];
+    snprintf(spec_file, sizeof(spec_file), "%s/cpm_package.spec", dir);
+    Package* pkg = cpm_read_package_spec(spec_file);
+    bool builds = pkg && (pkg->build_command || pkg->install_command);
+    cpm_free_package(pkg);
+    return builds;
+}
+
+static CPM_Result install_stage_extract(void* context, size_t item) {
+    InstallJob* job = context;
+    const DepNode* dep = job->packages[item];
+    
+    char package_dir[1024];
+    install_package_dir(job, item, package_dir, sizeof(package_dir));
+    
+    // A new version replaces the old one wholesale
+    install_remove_tree(package_dir);
+    
+    if (job->keys[item]) {
+        // Unpacked once per machine, then linked into place; what a build may
+        // change is materialized as a private copy so the store stays intact
+        char* tree = cpm_store_tree_path(job->store, job->keys[item]);
+        bool private_copy = tree && install_package_builds(tree);
+        free(tree);
+        CPM_StoreLinkStats linked = {0};
+        CPM_Result result = cpm_store_materialize(job->store, job->keys[item], package_dir, private_copy, &linked);
+        if (result != CPM_RESULT_SUCCESS) {
+            printf("[CPM Deps] Failed to extract %s\n", dep->name);
+            return result;
+        }
+        
+        pthread_mutex_lock(&job->stats_lock);
+        job->link_stats.reflinked += linked.reflinked;
+        job->link_stats.hardlinked += linked.hardlinked;
+        job->link_stats.copied += linked.copied;
+        job->link_stats.copied_bytes += linked.copied_bytes;
+        pthread_mutex_unlock(&job->stats_lock);
+    } else if (job->staged[item]) {
+        bool moved = rename(job->staged[item], package_dir) == 0;
+        if (!moved) install_remove_tree(job->staged[item]);
+        free(job->staged[item]);
+        job->staged[item] = NULL;
+        if (!moved) {
+            printf("[CPM Deps] Failed to extract %s\n", dep->name);
+            return CPM_RESULT_ERROR_FILE_OPERATION;
+        }
+    } else if (mkdir(package_dir, 0755) != 0) {
+        return CPM_RESULT_ERROR_FILE_OPERATION;
+    }
+    
+    char spec_file[1100];
+    snprintf(spec_file, sizeof(spec_file), "%s/cpm_package.spec", package_dir);
+    if (access(spec_file, F_OK) == 0) return CPM_RESULT_SUCCESS;
+    
+    // No archive (or one without a spec): record what was resolved
+    FILE* f = fopen(spec_file, "w");
+    if (!f) return CPM_RESULT_ERROR_FILE_OPERATION;
+    
+    char* version_str = dep->version ? semver_to_string(dep->version) : strdup("1.0.0");
+    fprintf(f, "{\n");
+    fprintf(f, "  \"name\": \"%s\",\n", dep->name);
+    fprintf(f, "  \"version\": \"%s\",\n", version_str ? version_str : "1.0.0");
+    fprintf(f, "  \"description\": \"Mock package for %s\",\n", dep->name);
+    fprintf(f, "  \"dependencies\": {}\n");
+    fprintf(f, "}\n");
+    free(version_str);
+    return fclose(f) == 0 ? CPM_RESULT_SUCCESS : CPM_RESULT_ERROR_FILE_OPERATION;
+}
+
+// --- Stage: Build ---
+static CPM_Result install_stage_build(void* context, size_t item) {
+    InstallJob* job = context;
+    const DepNode* dep = job->packages[item];
+    
+    char package_dir[1024];
+    install_package_dir(job, item, package_dir, sizeof(package_dir));
+    char spec_file[1100];
+    snprintf(spec_file, sizeof(spec_file), "%s/cpm_package.spec", package_dir);
+    
+    Package* pkg = cpm_parse_package_file(spec_file);
+    CPM_Result result = CPM_RESULT_SUCCESS;
+    if (pkg && pkg->build_command) {
+        printf("[CPM Deps] Building %s\n", dep->name);
+        char build_cmd[2200];
+        snprintf(build_cmd, sizeof(build_cmd), "cd \"%s\" && %s", package_dir, pkg->build_command);
+        if (system(build_cmd) != 0) {
+            printf("[CPM Deps] Build failed for %s\n", dep->name);
+            result = CPM_RESULT_ERROR_SCRIPT_EXECUTION;
+        }
+    }
+    cpm_free_package(pkg);
+    
+    if (result == CPM_RESULT_SUCCESS) {
+        printf("[CPM Deps] Package %s installed successfully\n", dep->name);
+    }
+    return result;
+}
+
+static const CPM_PipelineStage install_stages[] = {
+    { .name = "download", .run = install_stage_download },
+    { .name = "verify",   .run = install_stage_verify },
+    { .name = "extract",  .run = install_stage_extract },
+    { .name = "build",    .run = install_stage_build, .ordered = true }
+};
+#define INSTALL_STAGE_COUNT (sizeof(install_stages) / sizeof(install_stages[0]))
+
+// --- Running a Job ---
+static bool install_job_init(InstallJob* job, size_t count, const char* modules_dir, const CPM_Config* config) {
+    memset(job, 0, sizeof(*job));
+    job->packages = calloc(count ? count : 1, sizeof(DepNode*));
+    job->staged = calloc(count ? count : 1, sizeof(char*));
+    job->digests = calloc(count ? count : 1, sizeof(*job->digests));
+    job->sha512 = calloc(count ? count : 1, sizeof(*job->sha512));
+    job->keys = calloc(count ? count : 1, sizeof(char*));
+    job->modules_dir = modules_dir;
+    pthread_mutex_init(&job->stats_lock, NULL);
+    
+    if (config) {
+        job->chunk_size = config->download_chunk_mb > 0 ? (uint64_t)config->download_chunk_mb << 20 : 0;
+        job->chunk_parallel = config->max_concurrent_downloads > 0 ? config->max_concurrent_downloads : 1;
+    }
+    if (config && config->cache_dir) {
+        job->store = cpm_store_open(config->cache_dir);
+        if (!job->store) printf("[CPM Deps] Warning: package store unavailable under %s\n", config->cache_dir);
+    }
+    
+    // Without a store, downloads are staged next to the trees they become
+    char downloads_dir[1100];
+    snprintf(downloads_dir, sizeof(downloads_dir), "%s/%s", modules_dir, INSTALL_DOWNLOADS_DIR);
+    mkdir(modules_dir, 0755);
+    if (!job->store) mkdir(downloads_dir, 0755);
+    return job->packages && job->staged && job->digests && job->sha512 && job->keys;
+}
+
+static void install_job_cleanup(InstallJob* job) {
+    // Trees left staged by a failed run
+    for (size_t i = 0; job->staged && i < job->count; i++) {
+        if (job->staged[i]) install_remove_tree(job->staged[i]);
+        free(job->staged[i]);
+    }
+    for (size_t i = 0; job->keys && i < job->count; i++) free(job->keys[i]);
+    free(job->staged);
+    free(job->digests);
+    free(job->sha512);
+    free(job->keys);
+    free(job->packages);
+    cpm_store_close(job->store);
+    pthread_mutex_destroy(&job->stats_lock);
+}
+
+static double install_ms(uint64_t ns) {
+    return (double)ns / 1e6;
+}
+
+// Runs the job's packages (given in install order) through the pipeline
+static CPM_Result install_job_run(InstallJob* job, const DepResolution* resolution) {
+    if (job->count == 0) return CPM_RESULT_SUCCESS;
+    
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t local_workers = cpus > 0 ? (size_t)cpus : 1;
+    CPM_PipelineStage stages[INSTALL_STAGE_COUNT];
+    memcpy(stages, install_stages, sizeof(stages));
+    for (size_t s = 0; s < INSTALL_STAGE_COUNT; s++) {
+        size_t workers = s == 0 ? INSTALL_DOWNLOAD_WORKERS : local_workers;
+        stages[s].workers = workers < job->count ? workers : job->count;
+    }
+    
+    CPM_Pipeline* pipeline = cpm_pipeline_create(stages, INSTALL_STAGE_COUNT, job->count, job);
+    size_t* item_of = calloc(resolution->node_count ? resolution->node_count : 1, sizeof(size_t));
+    if (!pipeline || !item_of) {
+        cpm_pipeline_free(pipeline);
+        free(item_of);
+        return CPM_RESULT_ERROR_MEMORY_ALLOCATION;
+    }
+    
+    // Build after the dependencies in this job; a cycle shares one level and isn't ordered
+    for (size_t i = 0; i < resolution->node_count; i++) item_of[i] = SIZE_MAX;
+    for (size_t i = 0; i < job->count; i++) {
+        if (job->packages[i]->graph_index < resolution->node_count) item_of[job->packages[i]->graph_index] = i;
+    }
+    for (size_t i = 0; i < job->count; i++) {
+        const DepNode* dep = job->packages[i];
+        for (size_t c = 0; c < dep->child_count; c++) {
+            const DepNode* child = dep->children[c];
+            if (child->graph_index >= resolution->node_count || child->level >= dep->level) continue;
+            size_t prerequisite = item_of[child->graph_index];
+            if (prerequisite != SIZE_MAX) cpm_pipeline_add_prerequisite(pipeline, i, prerequisite);
+        }
+    }
+    free(item_of);
+    
+    CPM_PipelineStats stats;
+    CPM_Result result = cpm_pipeline_run(pipeline, &stats);
+    cpm_pipeline_free(pipeline);
+    
+    if (result != CPM_RESULT_SUCCESS) {
+        printf("[CPM Deps] Failed to install %s\n", job->packages[stats.failed_item]->name);
+        return result;
+    }
+    
+    printf("[CPM Deps] Installed %zu packages in %.1f ms (busy: download %.1f ms, verify %.1f ms, extract %.1f ms, build %.1f ms)\n",
+           job->count, install_ms(stats.wall_ns), install_ms(stats.stages[0].busy_ns), install_ms(stats.stages[1].busy_ns),
+           install_ms(stats.stages[2].busy_ns), install_ms(stats.stages[3].busy_ns));
+    if (job->store) {
+        printf("[CPM Deps] Store: %zu of %zu packages already stored; files %zu reflinked, %zu hardlinked, %zu copied (%.1f KB)\n",
+               job->from_store, job->count, job->link_stats.reflinked, job->link_stats.hardlinked,
+               job->link_stats.copied, (double)job->link_stats.copied_bytes / 1024.0);
+    }
+    return CPM_RESULT_SUCCESS;
+}
+
+// --- Dependency Installation ---
+// Brings the installed-package index up to date with what a job changed
+static void install_record(const char* modules_dir, const DepNode* const* installed, size_t installed_count,
+                           const char* const* removed, size_t removed_count) {
+    const char** names = calloc(installed_count ? installed_count : 1, sizeof(char*));
+    if (!names) return;
+    for (size_t i = 0; i < installed_count; i++) names[i] = installed[i]->name;
+    if (cpm_installed_update(modules_dir, names, installed_count, removed, removed_count) != CPM_RESULT_SUCCESS) {
+        printf("[CPM Deps] Warning: could not update the installed-package index in %s\n", modules_dir);
+    }
+    free(names);
+}
+
+CPM_Result cpm_install_dependency(const DepNode* dep, const char* target_dir) {
+    if (!dep || !target_dir) return CPM_RESULT_ERROR_INVALID_ARGS;
+    if (!install_names_are_safe(&dep, 1)) return CPM_RESULT_ERROR_PACKAGE_PARSE;
+    
+    char* dep_version = dep->version ? semver_to_string(dep->version) : NULL;
+    printf("[CPM Deps] Installing %s@%s\n", dep->name, dep_version ? dep_version : "unknown");
+    free(dep_version);
+    
+    InstallJob job;
+    if (!install_job_init(&job, 1, target_dir, NULL)) {
+        install_job_cleanup(&job);
+        return CPM_RESULT_ERROR_MEMORY_ALLOCATION;
+    }
+    job.packages[job.count++] = dep;
+    
+    // One package: the stages simply run back to back
+    CPM_Result result = CPM_RESULT_SUCCESS;
+    for (size_t s = 0; s < INSTALL_STAGE_COUNT && result == CPM_RESULT_SUCCESS; s++) {
+        result = install_stages[s].run(&job, 0);
+    }
+    install_job_cleanup(&job);
+    if (result == CPM_RESULT_SUCCESS) install_record(target_dir, &dep, 1, NULL, 0);
+    return result;
+}
+
+CPM_Result cpm_install_dependencies(const DepResolution* resolution, const char* target_dir) {
+    return cpm_install_dependencies_with_config(resolution, target_dir, NULL);
+}
+
+CPM_Result cpm_install_dependencies_with_config(const DepResolution* resolution, const char* target_dir,
+                                                const CPM_Config* config) {
+    if (!resolution || !target_dir) return CPM_RESULT_ERROR_INVALID_ARGS;
+    if (!install_names_are_safe((const DepNode* const*)resolution->install_order, resolution->install_count)) {
+        return CPM_RESULT_ERROR_PACKAGE_PARSE;
+    }
+    
+    printf("[CPM Deps] Installing %zu dependencies to %s\n", resolution->install_count, target_dir);
+    
+    char modules_dir[1024];
+    snprintf(modules_dir, sizeof(modules_dir), "%s/cpm_modules", target_dir);
+    
+    InstallJob job;
+    if (!install_job_init(&job, resolution->install_count, modules_dir, config)) {
+        install_job_cleanup(&job);
+        return CPM_RESULT_ERROR_MEMORY_ALLOCATION;
+    }
+    for (size_t i = 0; i < resolution->install_count; i++) {
+        job.packages[job.count++] = resolution->install_order[i];
+    }
+    
+    CPM_Result result = install_job_run(&job, resolution);
+    if (result == CPM_RESULT_SUCCESS) install_record(modules_dir, job.packages, job.count, NULL, 0);
+    install_job_cleanup(&job);
+    if (result == CPM_RESULT_SUCCESS) printf("[CPM Deps] All dependencies installed successfully\n");
+    return result;
+}
+
+static int install_name_compare(const void* a, const void* b) {
+    return strcmp(*(const char* const*)a, *(const char* const*)b);
+}
+
+CPM_Result cpm_install_dependencies_incremental(const DepResolution* resolution, const DepResolution* previous,
+                                                const char* target_dir, const CPM_Config* config) {
+    if (!resolution || !target_dir) return CPM_RESULT_ERROR_INVALID_ARGS;
+    if (!install_names_are_safe((const DepNode* const*)resolution->install_order, resolution->install_count)) {
+        return CPM_RESULT_ERROR_PACKAGE_PARSE;
+    }
+    
+    char modules_dir[1024];
+    snprintf(modules_dir, sizeof(modules_dir), "%s/cpm_modules", target_dir);
+    
+    InstallJob job;
+    const char** current = calloc(resolution->install_count ? resolution->install_count : 1, sizeof(char*));
+    size_t previous_count = previous ? previous->install_count : 0;
+    const char** removed_names = calloc(previous_count ? previous_count : 1, sizeof(char*));
+    CPM_InstalledIndex* installed_index = cpm_installed_open(modules_dir);
+    if (!install_job_init(&job, resolution->install_count, modules_dir, config) || !current || !removed_names ||
+        !installed_index) {
+        install_job_cleanup(&job);
+        free(current);
+        free(removed_names);
+        cpm_installed_close(installed_index);
+        return CPM_RESULT_ERROR_MEMORY_ALLOCATION;
+    }
+    
+    // Packages the new resolution no longer contains
+    for (size_t i = 0; i < resolution->install_count; i++) current[i] = resolution->install_order[i]->name;
+    qsort(current, resolution->install_count, sizeof(char*), install_name_compare);
+    
+    size_t removed = 0;
+    for (size_t i = 0; previous && i < previous->install_count; i++) {
+        const char* name = previous->install_order[i]->name;
+        if (bsearch(&name, current, resolution->install_count, sizeof(char*), install_name_compare)) continue;
+        if (!cpm_package_name_is_safe(name)) {
+            printf("[CPM Deps] Not removing '%s': not a valid package name\n", name ? name : "");
+            continue;
+        }
+        
+        char package_dir[1100];
+        snprintf(package_dir, sizeof(package_dir), "%s/%s", modules_dir, name);
+        install_remove_tree(package_dir);
+        printf("[CPM Deps] Removed %s\n", name);
+        removed_names[removed++] = name;
+    }
+    free(current);
+    
+    // Install order is kept; packages already installed at their resolved version are skipped
+    size_t unchanged = 0;
+    for (size_t i = 0; i < resolution->install_count; i++) {
+        const DepNode* dep = resolution->install_order[i];
+        const CPM_InstalledPackage* have = cpm_installed_find(installed_index, dep->name);
+        char* want = dep->version ? semver_to_string(dep->version) : NULL;
+        bool current_version = have && want && strcmp(have->version, want) == 0;
+        free(want);
+        
+        if (current_version) {
+            unchanged++;
+        } else {
+            job.packages[job.count++] = dep;
+        }
+    }
+    
+    cpm_installed_close(installed_index);
+    
+    size_t installed = job.count;
+    CPM_Result result = install_job_run(&job, resolution);
+    if (result == CPM_RESULT_SUCCESS && (installed || removed)) {
+        install_record(modules_dir, job.packages, job.count, removed_names, removed);
+    }
+    install_job_cleanup(&job);
+    free(removed_names);
+    if (result != CPM_RESULT_SUCCESS) return result;
+    
+    printf("[CPM Deps] %zu installed, %zu removed, %zu already up to date\n", installed, removed, unchanged);
+    return CPM_RESULT_SUCCESS;
+}
@@ -0,0 +1,700 @@
+/*
+ * File: lib/core/cpm_installed.c
+ * Description: Index of the packages installed in a modules directory.
+ * The index file is a "CPMINST2 <sec> <nsec> <count>" header line (the
+ * mtime of the modules directory the records reflect) followed by one
+ * tab-separated record per package: name, the spec's inode, size, mtime
+ * seconds and nanoseconds, version, description, author, license, then its
+ * dependency entries. Tabs, newlines and backslashes in
+ * fields are backslash-escaped. The file lives in a subdirectory so that
+ * replacing it (temporary file + rename) leaves the modules directory's
+ * mtime alone.
+ * Author: Dr. Q Josef Kurk Edwards
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+#include "cpm_installed.h"
+#include "cpm_deps.h"
+#include "cpm_package.h"
+#include "cpm_proclock.h"
+#include "cpm_semver.h"
+
+#define INSTALLED_MAGIC "CPMINST2"
+#define INSTALLED_FILE "index"
+#define INSTALLED_SPEC_FILE "cpm_package.spec"
+
+typedef struct {
+    int wd;
+    char* name;
+} PackageWatch;
+
+struct CPM_InstalledIndex {
+    char* modules_dir;
+    CPM_InstalledPackage* packages;
+    size_t count;
+    size_t capacity;
+    struct timespec stamp;      // mtime of modules_dir the records reflect
+    ino_t file_ino;             // Index file as loaded or saved, 0 if there is none
+    struct timespec file_mtime;
+    
+    int watch_fd;               // inotify instance, -1 when not watching
+    int dir_watch;
+    PackageWatch* watches;      // One per package directory, for its spec
+    size_t watch_count;
+    size_t watch_capacity;
+};
+
+// --- Records ---
+static void package_clear(CPM_InstalledPackage* pkg) {
+    free(pkg->name);
+    free(pkg->version);
+    free(pkg->path);
+    free(pkg->description);
+    free(pkg->author);
+    free(pkg->license);
+    for (size_t i = 0; i < pkg->dep_count; i++) free(pkg->dependencies[i]);
+    free(pkg->dependencies);
+    memset(pkg, 0, sizeof(*pkg));
+}
+
+static char* join_path(const char* dir, const char* name) {
+    char* path = NULL;
+    return asprintf(&path, "%s/%s", dir, name) >= 0 ? path : NULL;
+}
+
+// Stamp of the spec at spec_path, all zero if there is none
+static void spec_stamp(const char* spec_path, CPM_InstalledPackage* pkg) {
+    struct stat st;
+    if (spec_path && stat(spec_path, &st) == 0) {
+        pkg->spec_ino = (uint64_t)st.st_ino;
+        pkg->spec_size = (int64_t)st.st_size;
+        pkg->spec_mtime = st.st_mtim;
+    } else {
+        pkg->spec_ino = 0;
+        pkg->spec_size = 0;
+        pkg->spec_mtime = (struct timespec){ 0, 0 };
+    }
+}
+
+// Fills pkg from <modules_dir>/<name>; false if that is not a package directory
+static bool package_read(const char* modules_dir, const char* name, CPM_InstalledPackage* pkg) {
+    memset(pkg, 0, sizeof(*pkg));
+    if (name[0] == '.') return false;
+    
+    // Installed packages may be symlinks into the store
+    char* path = join_path(modules_dir, name);
+    struct stat st;
+    if (!path || stat(path, &st) != 0 || !S_ISDIR(st.st_mode)) {
+        free(path);
+        return false;
+    }
+    pkg->name = strdup(name);
+    pkg->path = path;
+    
+    // Stamped before the read: a change during it shows up as stale next time
+    char* spec_path = join_path(path, INSTALLED_SPEC_FILE);
+    spec_stamp(spec_path, pkg);
+    Package* spec = spec_path ? cpm_read_package_spec(spec_path) : NULL;
+    free(spec_path);
+    if (spec) {
+        pkg->version = spec->version ? strdup(spec->version) : NULL;
+        pkg->description = spec->description ? strdup(spec->description) : NULL;
+        pkg->author = spec->author ? strdup(spec->author) : NULL;
+        pkg->license = spec->license ? strdup(spec->license) : NULL;
+        pkg->dependencies = spec->dep_count ? calloc(spec->dep_count, sizeof(char*)) : NULL;
+        for (size_t i = 0; pkg->dependencies && i < spec->dep_count; i++) {
+            pkg->dependencies[pkg->dep_count] = strdup(spec->dependencies[i]);
+            if (pkg->dependencies[pkg->dep_count]) pkg->dep_count++;
+        }
+        cpm_free_package(spec);
+    }
+    
+    // Absent fields read as ""
+    char** fields[] = { &pkg->version, &pkg->description, &pkg->author, &pkg->license };
+    for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+        if (!*fields[i]) *fields[i] = strdup("");
+    }
+    if (!pkg->name || !pkg->version || !pkg->description || !pkg->author || !pkg->license) {
+        package_clear(pkg);
+        return false;
+    }
+    return true;
+}
+
+static int package_compare(const void* a, const void* b) {
+    return strcmp(((const CPM_InstalledPackage*)a)->name, ((const CPM_InstalledPackage*)b)->name);
+}
+
+// Position of name, or where it would be inserted
+static size_t index_position(const CPM_InstalledIndex* index, const char* name, bool* found) {
+    size_t lo = 0, hi = index->count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        int cmp = strcmp(index->packages[mid].name, name);
+        if (cmp == 0) {
+            *found = true;
+            return mid;
+        }
+        if (cmp < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    *found = false;
+    return lo;
+}
+
+static bool index_reserve(CPM_InstalledIndex* index, size_t count) {
+    if (count <= index->capacity) return true;
+    size_t capacity = index->capacity ? index->capacity * 2 : 16;
+    while (capacity < count) capacity *= 2;
+    CPM_InstalledPackage* packages = realloc(index->packages, capacity * sizeof(CPM_InstalledPackage));
+    if (!packages) return false;
+    index->packages = packages;
+    index->capacity = capacity;
+    return true;
+}
+
+// Takes ownership of pkg's fields
+static bool index_put(CPM_InstalledIndex* index, CPM_InstalledPackage* pkg) {
+    bool found;
+    size_t at = index_position(index, pkg->name, &found);
+    if (found) {
+        package_clear(&index->packages[at]);
+    } else {
+        if (!index_reserve(index, index->count + 1)) {
+            package_clear(pkg);
+            return false;
+        }
+        memmove(&index->packages[at + 1], &index->packages[at], (index->count - at) * sizeof(CPM_InstalledPackage));
+        index->count++;
+    }
+    index->packages[at] = *pkg;
+    return true;
+}
+
+static void index_remove(CPM_InstalledIndex* index, const char* name) {
+    bool found;
+    size_t at = index_position(index, name, &found);
+    if (!found) return;
+    package_clear(&index->packages[at]);
+    memmove(&index->packages[at], &index->packages[at + 1], (index->count - at - 1) * sizeof(CPM_InstalledPackage));
+    index->count--;
+}
+
+// Re-reads one package: updated if it is still a package directory, dropped if not
+static void index_reload(CPM_InstalledIndex* index, const char* name) {
+    CPM_InstalledPackage pkg;
+    if (package_read(index->modules_dir, name, &pkg)) {
+        index_put(index, &pkg);
+    } else {
+        index_remove(index, name);
+    }
+}
+
+static void index_clear(CPM_InstalledIndex* index) {
+    for (size_t i = 0; i < index->count; i++) package_clear(&index->packages[i]);
+    index->count = 0;
+}
+
+// The walk the index exists to avoid: every package directory, one level deep
+static void index_scan(CPM_InstalledIndex* index) {
+    index_clear(index);
+    DIR* dir = opendir(index->modules_dir);
+    if (!dir) return;
+    
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        CPM_InstalledPackage pkg;
+        if (!package_read(index->modules_dir, entry->d_name, &pkg)) continue;
+        if (!index_reserve(index, index->count + 1)) {
+            package_clear(&pkg);
+            break;
+        }
+        index->packages[index->count++] = pkg;
+    }
+    closedir(dir);
+    qsort(index->packages, index->count, sizeof(CPM_InstalledPackage), package_compare);
+}
+
+// --- Index File ---
+static char* index_file_path(const char* modules_dir) {
+    char* path = NULL;
+    return asprintf(&path, "%s/%s/%s", modules_dir, CPM_INSTALLED_DIR, INSTALLED_FILE) >= 0 ? path : NULL;
+}
+
+static void write_escaped(FILE* f, const char* value) {
+    for (const char* p = value; *p; p++) {
+        switch (*p) {
+            case '\t': fputs("\\t", f); break;
+            case '\n': fputs("\\n", f); break;
+            case '\\': fputs("\\\\", f); break;
+            default: fputc(*p, f); break;
+        }
+    }
+}
+
+static void write_field(FILE* f, const char* value) {
+    fputc('\t', f);
+    write_escaped(f, value);
+}
+
+// Splits the next tab-separated field off *line and unescapes it in place
+static char* read_field(char** line) {
+    char* field = *line;
+    if (!field) return NULL;
+    char* tab = strchr(field, '\t');
+    if (tab) {
+        *tab = '\0';
+        *line = tab + 1;
+    } else {
+        *line = NULL;
+    }
+    
+    char* out = field;
+    for (char* p = field; *p; p++) {
+        if (*p == '\\' && p[1]) {
+            p++;
+            *out++ = *p == 't' ? '\t' : *p == 'n' ? '\n' : *p;
+        } else {
+            *out++ = *p;
+        }
+    }
+    *out = '\0';
+    return strdup(field);
+}
+
+static bool index_load(CPM_InstalledIndex* index) {
+    char* path = index_file_path(index->modules_dir);
+    FILE* f = path ? fopen(path, "r") : NULL;
+    free(path);
+    if (!f) return false;
+    
+    struct stat st;
+    long long sec, nsec;
+    size_t count;
+    char magic[16];
+    if (fstat(fileno(f), &st) != 0 || fscanf(f, "%15s %lld %lld %zu\n", magic, &sec, &nsec, &count) != 4 ||
+        strcmp(magic, INSTALLED_MAGIC) != 0) {
+        fclose(f);
+        return false;
+    }
+    
+    index_clear(index);
+    char* line = NULL;
+    size_t line_capacity = 0;
+    ssize_t length;
+    bool ok = true;
+    while (ok && (length = getline(&line, &line_capacity, f)) > 0) {
+        if (line[length - 1] == '\n') line[length - 1] = '\0';
+        char* rest = line;
+        CPM_InstalledPackage pkg = {0};
+        pkg.name = read_field(&rest);
+        unsigned long long ino = 0;
+        long long size = 0, mtime_sec = 0, mtime_nsec = 0;
+        bool stamped = rest && sscanf(rest, "%llu\t%lld\t%lld\t%lld\t", &ino, &size, &mtime_sec, &mtime_nsec) == 4;
+        for (int i = 0; i < 4 && rest; i++) {
+            char* tab = strchr(rest, '\t');
+            rest = tab ? tab + 1 : NULL;
+        }
+        pkg.spec_ino = ino;
+        pkg.spec_size = size;
+        pkg.spec_mtime = (struct timespec){ (time_t)mtime_sec, (long)mtime_nsec };
+        pkg.version = stamped ? read_field(&rest) : NULL;
+        pkg.description = read_field(&rest);
+        pkg.author = read_field(&rest);
+        pkg.license = read_field(&rest);
+        pkg.path = pkg.name ? join_path(index->modules_dir, pkg.name) : NULL;
+        while (rest) {
+            char** grown = realloc(pkg.dependencies, (pkg.dep_count + 1) * sizeof(char*));
+            if (!grown) break;
+            pkg.dependencies = grown;
+            if (!(pkg.dependencies[pkg.dep_count] = read_field(&rest))) break;
+            pkg.dep_count++;
+        }
+        ok = pkg.name && pkg.version && pkg.description && pkg.author && pkg.license && pkg.path && !rest &&
+             index_reserve(index, index->count + 1);
+        if (ok) {
+            index->packages[index->count++] = pkg;
+        } else {
+            package_clear(&pkg);
+        }
+    }
+    free(line);
+    fclose(f);
+    
+    // Records are written sorted; anything else is not a file this code wrote
+    for (size_t i = 1; ok && i < index->count; i++) ok = strcmp(index->packages[i - 1].name, index->packages[i].name) < 0;
+    if (!ok || index->count != count) {
+        index_clear(index);
+        return false;
+    }
+    index->stamp = (struct timespec){ (time_t)sec, (long)nsec };
+    index->file_ino = st.st_ino;
+    index->file_mtime = st.st_mtim;
+    return true;
+}
+
+static bool index_save(CPM_InstalledIndex* index) {
+    char* path = index_file_path(index->modules_dir);
+    char* temp = NULL;
+    if (!path || asprintf(&temp, "%s.%ld.tmp", path, (long)getpid()) < 0) {
+        free(path);
+        return false;
+    }
+    
+    FILE* f = fopen(temp, "w");
+    bool ok = f != NULL;
+    if (f) {
+        fprintf(f, "%s %lld %lld %zu\n", INSTALLED_MAGIC, (long long)index->stamp.tv_sec,
+                (long long)index->stamp.tv_nsec, index->count);
+        for (size_t i = 0; i < index->count; i++) {
+            const CPM_InstalledPackage* pkg = &index->packages[i];
+            write_escaped(f, pkg->name);
+            fprintf(f, "\t%llu\t%lld\t%lld\t%lld", (unsigned long long)pkg->spec_ino, (long long)pkg->spec_size,
+                    (long long)pkg->spec_mtime.tv_sec, (long long)pkg->spec_mtime.tv_nsec);
+            write_field(f, pkg->version);
+            write_field(f, pkg->description);
+            write_field(f, pkg->author);
+            write_field(f, pkg->license);
+            for (size_t d = 0; d < pkg->dep_count; d++) write_field(f, pkg->dependencies[d]);
+            fputc('\n', f);
+        }
+        ok = fclose(f) == 0 && ok;
+    }
+    
+    struct stat st;
+    if (ok && rename(temp, path) == 0 && stat(path, &st) == 0) {
+        index->file_ino = st.st_ino;
+        index->file_mtime = st.st_mtim;
+    } else {
+        ok = false;
+        unlink(temp);
+    }
+    free(temp);
+    free(path);
+    return ok;
+}
+
+static bool same_time(struct timespec a, struct timespec b) {
+    return a.tv_sec == b.tv_sec && a.tv_nsec == b.tv_nsec;
+}
+
+// Loads the index file, or rescans if the directory changed since it was written
+static void index_load_current(CPM_InstalledIndex* index) {
+    char* index_dir = join_path(index->modules_dir, CPM_INSTALLED_DIR);
+    if (index_dir) mkdir(index_dir, 0755);
+    free(index_dir);
+    
+    struct stat st;
+    if (stat(index->modules_dir, &st) != 0) {
+        index_clear(index);
+        index->stamp = (struct timespec){ 0, 0 };
+        return;
+    }
+    if (index_load(index) && same_time(index->stamp, st.st_mtim)) return;
+    
+    // Stamped before the walk: a change during it shows up as stale next time
+    index->stamp = st.st_mtim;
+    index_scan(index);
+    index_save(index);
+}
+
+// --- Index Access ---
+CPM_InstalledIndex* cpm_installed_open(const char* modules_dir) {
+    if (!modules_dir) return NULL;
+    CPM_InstalledIndex* index = calloc(1, sizeof(CPM_InstalledIndex));
+    if (!index) return NULL;
+    index->modules_dir = strdup(modules_dir);
+    index->watch_fd = -1;
+    index->dir_watch = -1;
+    if (!index->modules_dir) {
+        free(index);
+        return NULL;
+    }
+    index_load_current(index);
+    return index;
+}
+
+static void watch_clear(CPM_InstalledIndex* index) {
+    for (size_t i = 0; i < index->watch_count; i++) free(index->watches[i].name);
+    index->watch_count = 0;
+}
+
+void cpm_installed_close(CPM_InstalledIndex* index) {
+    if (!index) return;
+    index_clear(index);
+    free(index->packages);
+    watch_clear(index);
+    free(index->watches);
+    if (index->watch_fd >= 0) close(index->watch_fd);
+    free(index->modules_dir);
+    free(index);
+}
+
+size_t cpm_installed_count(const CPM_InstalledIndex* index) {
+    return index ? index->count : 0;
+}
+
+const CPM_InstalledPackage* cpm_installed_get(const CPM_InstalledIndex* index, size_t i) {
+    return index && i < index->count ? &index->packages[i] : NULL;
+}
+
+// Whether the spec on disk is still the one the record was read from
+static bool package_spec_unchanged(const CPM_InstalledPackage* pkg) {
+    char* spec_path = join_path(pkg->path, INSTALLED_SPEC_FILE);
+    CPM_InstalledPackage now;
+    spec_stamp(spec_path, &now);
+    free(spec_path);
+    return now.spec_ino == pkg->spec_ino && now.spec_size == pkg->spec_size &&
+           same_time(now.spec_mtime, pkg->spec_mtime);
+}
+
+const CPM_InstalledPackage* cpm_installed_find(CPM_InstalledIndex* index, const char* name) {
+    if (!index || !name) return NULL;
+    cpm_installed_refresh(index);
+    bool found;
+    size_t at = index_position(index, name, &found);
+    if (found && !package_spec_unchanged(&index->packages[at])) {
+        // Edited or damaged behind the index's back (the directory's mtime doesn't see it)
+        index_reload(index, name);
+        at = index_position(index, name, &found);
+    }
+    return found ? &index->packages[at] : NULL;
+}
+
+size_t cpm_installed_search(CPM_InstalledIndex* index, const char* query, const CPM_InstalledPackage** out,
+                            size_t max) {
+    if (!index) return 0;
+    cpm_installed_refresh(index);
+    size_t matched = 0;
+    for (size_t i = 0; i < index->count; i++) {
+        const CPM_InstalledPackage* pkg = &index->packages[i];
+        if (query && *query && !strcasestr(pkg->name, query) && !strcasestr(pkg->description, query)) continue;
+        if (out && matched < max) out[matched] = pkg;
+        matched++;
+    }
+    return matched;
+}
+
+// --- Updates ---
+CPM_Result cpm_installed_update(const char* modules_dir, const char* const* installed, size_t installed_count,
+                                const char* const* removed, size_t removed_count) {
+    if (!modules_dir) return CPM_RESULT_ERROR_INVALID_ARGS;
+    
+    // Keyed by the real path: every spelling of the directory shares one lock
+    char real[PATH_MAX];
+    char* key = NULL;
+    if (!realpath(modules_dir, real) || asprintf(&key, "installed:%s", real) < 0) {
+        return CPM_RESULT_ERROR_FILE_OPERATION;
+    }
+    PMLL_ProcessLock* lock = pmll_process_lock_open(key);
+    free(key);
+    bool locked = lock && pmll_process_lock_acquire(lock, NULL);
+    
+    CPM_Result result = CPM_RESULT_ERROR_MEMORY_ALLOCATION;
+    CPM_InstalledIndex* index = cpm_installed_open(modules_dir);
+    if (index) {
+        for (size_t i = 0; i < removed_count; i++) index_remove(index, removed[i]);
+        for (size_t i = 0; i < installed_count; i++) index_reload(index, installed[i]);
+        
+        // The changes being recorded are what moved the directory's mtime
+        struct stat st;
+        if (stat(modules_dir, &st) == 0) index->stamp = st.st_mtim;
+        result = index_save(index) ? CPM_RESULT_SUCCESS : CPM_RESULT_ERROR_FILE_OPERATION;
+        cpm_installed_close(index);
+    }
+    
+    if (locked) pmll_process_lock_release(lock);
+    pmll_process_lock_close(lock);
+    return result;
+}
+
+// --- Watching ---
+#ifdef __linux__
+#define INSTALLED_DIR_EVENTS (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR)
+#define INSTALLED_PACKAGE_EVENTS (IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE | IN_MOVED_FROM | IN_ONLYDIR)
+
+static void watch_package(CPM_InstalledIndex* index, const char* name) {
+    if (name[0] == '.') return;
+    for (size_t i = 0; i < index->watch_count; i++) {
+        if (strcmp(index->watches[i].name, name) == 0) return;
+    }
+    char* path = join_path(index->modules_dir, name);
+    int wd = path ? inotify_add_watch(index->watch_fd, path, INSTALLED_PACKAGE_EVENTS) : -1;
+    free(path);
+    if (wd < 0) return;
+    
+    if (index->watch_count == index->watch_capacity) {
+        size_t capacity = index->watch_capacity ? index->watch_capacity * 2 : 16;
+        PackageWatch* grown = realloc(index->watches, capacity * sizeof(PackageWatch));
+        if (!grown) return;
+        index->watches = grown;
+        index->watch_capacity = capacity;
+    }
+    char* copy = strdup(name);
+    if (!copy) return;
+    index->watches[index->watch_count++] = (PackageWatch){ wd, copy };
+}
+
+static void watch_forget(CPM_InstalledIndex* index, int wd, const char* name) {
+    for (size_t i = 0; i < index->watch_count; i++) {
+        if (wd >= 0 ? index->watches[i].wd != wd : strcmp(index->watches[i].name, name) != 0) continue;
+        if (wd < 0) inotify_rm_watch(index->watch_fd, index->watches[i].wd);
+        free(index->watches[i].name);
+        index->watches[i] = index->watches[--index->watch_count];
+        return;
+    }
+}
+
+// Watch first, then read: a spec written in between still raises an event
+static void watch_rescan(CPM_InstalledIndex* index) {
+    for (size_t i = 0; i < index->watch_count; i++) inotify_rm_watch(index->watch_fd, index->watches[i].wd);
+    watch_clear(index);
+    DIR* dir = opendir(index->modules_dir);
+    if (dir) {
+        struct dirent* entry;
+        while ((entry = readdir(dir)) != NULL) watch_package(index, entry->d_name);
+        closedir(dir);
+    }
+    index_scan(index);
+}
+
+bool cpm_installed_watch(CPM_InstalledIndex* index) {
+    if (!index) return false;
+    if (index->watch_fd >= 0) return true;
+    index->watch_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (index->watch_fd < 0) return false;
+    index->dir_watch = inotify_add_watch(index->watch_fd, index->modules_dir, INSTALLED_DIR_EVENTS);
+    if (index->dir_watch < 0) {
+        close(index->watch_fd);
+        index->watch_fd = -1;
+        return false;
+    }
+    watch_rescan(index);
+    return true;
+}
+
+void cpm_installed_refresh(CPM_InstalledIndex* index) {
+    if (!index || index->watch_fd < 0) return;
+    
+    char buffer[16384] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t length;
+    while ((length = read(index->watch_fd, buffer, sizeof(buffer))) > 0) {
+        for (char* p = buffer; p < buffer + length;) {
+            const struct inotify_event* event = (const struct inotify_event*)p;
+            p += sizeof(struct inotify_event) + event->len;
+            const char* name = event->len ? event->name : "";
+            
+            if (event->mask & IN_Q_OVERFLOW) {
+                watch_rescan(index);
+            } else if (event->wd == index->dir_watch) {
+                if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF)) {
+                    index_clear(index);
+                } else if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+                    watch_package(index, name);
+                    index_reload(index, name);
+                } else if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                    watch_forget(index, -1, name);
+                    index_remove(index, name);
+                }
+            } else if (event->mask & IN_IGNORED) {
+                watch_forget(index, event->wd, NULL);
+            } else if (strcmp(name, INSTALLED_SPEC_FILE) == 0) {
+                for (size_t i = 0; i < index->watch_count; i++) {
+                    if (index->watches[i].wd == event->wd) {
+                        index_reload(index, index->watches[i].name);
+                        break;
+                    }
+                }
+            }
+        }
+    }
+}
+#else
+bool cpm_installed_watch(CPM_InstalledIndex* index) {
+    (void)index;
+    return false;
+}
+
+void cpm_installed_refresh(CPM_InstalledIndex* index) {
+    (void)index;
+}
+#endif
+
+int cpm_installed_watch_fd(const CPM_InstalledIndex* index) {
+    return index ? index->watch_fd : -1;
+}
+
+// --- Dependency Lookups ---
+// Indexes opened for lookups stay loaded; each lookup costs two stat()s to
+// confirm that neither the directory nor the index file changed since.
+static CPM_InstalledIndex** lookup_indexes = NULL;
+static size_t lookup_count = 0;
+static pthread_mutex_t lookup_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static bool index_is_current(const CPM_InstalledIndex* index) {
+    struct stat st;
+    if (stat(index->modules_dir, &st) != 0) return index->count == 0;
+    if (!same_time(index->stamp, st.st_mtim)) return false;
+    
+    char* path = index_file_path(index->modules_dir);
+    bool exists = path && stat(path, &st) == 0;
+    free(path);
+    if (!exists) return index->file_ino == 0;
+    return st.st_ino == index->file_ino && same_time(st.st_mtim, index->file_mtime);
+}
+
+// Caller holds lookup_lock
+static CPM_InstalledIndex* lookup_index(const char* modules_dir) {
+    for (size_t i = 0; i < lookup_count; i++) {
+        CPM_InstalledIndex* index = lookup_indexes[i];
+        if (strcmp(index->modules_dir, modules_dir) != 0) continue;
+        if (!index_is_current(index)) index_load_current(index);
+        return index;
+    }
+    
+    CPM_InstalledIndex** grown = realloc(lookup_indexes, (lookup_count + 1) * sizeof(CPM_InstalledIndex*));
+    if (!grown) return NULL;
+    lookup_indexes = grown;
+    CPM_InstalledIndex* index = cpm_installed_open(modules_dir);
+    if (index) lookup_indexes[lookup_count++] = index;
+    return index;
+}
+
+DepNode* cpm_find_installed_dependency(const char* name, const char* modules_dir) {
+    if (!name || !modules_dir) return NULL;
+    
+    pthread_mutex_lock(&lookup_lock);
+    CPM_InstalledIndex* index = lookup_index(modules_dir);
+    const CPM_InstalledPackage* pkg = index ? cpm_installed_find(index, name) : NULL;
+    DepNode* node = pkg ? cpm_depnode_create(pkg->name, NULL) : NULL;
+    if (node) {
+        node->version = *pkg->version ? semver_parse(pkg->version) : NULL;
+        node->installed = true;
+        Dependency** tail = &node->dependencies;
+        for (size_t i = 0; i < pkg->dep_count; i++) {
+            Dependency* dep = cpm_dependency_parse_spec(pkg->dependencies[i]);
+            if (!dep) continue;
+            *tail = dep;
+            tail = &dep->next;
+        }
+    }
+    pthread_mutex_unlock(&lookup_lock);
+    return node;
+}
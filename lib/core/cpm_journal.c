@@ -0,0 +1,459 @@
+/*
+ * File: lib/core/cpm_journal.c
+ * Description: Write-ahead journal for PMLL hardened queues.
+ * Records are appended as {header, key} with a CRC32 over both; fsync is
+ * batched (group commit). Opening a journal replays it into an in-memory
+ * status table and truncates any torn tail left by a crash.
+ * Author: Dr. Q Josef Kurk Edwards
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "cpm_journal.h"
+
+// --- On-Disk Format ---
+#define JOURNAL_FILE_MAGIC   "CPMJRNL1"
+#define JOURNAL_RECORD_MAGIC 0x4345524au /* "JREC" */
+#define JOURNAL_KEY_MAX      1024
+
+typedef enum {
+    JOURNAL_RECORD_BEGIN = 1,
+    JOURNAL_RECORD_COMMIT = 2,
+    JOURNAL_RECORD_ABORT = 3
+} JournalRecordType;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t crc;        // CRC32 over the rest of the header and the key bytes
+    uint32_t type;
+    uint32_t key_len;
+    uint64_t sequence;
+} JournalRecordHeader;
+
+// --- Status Table (open addressing, keyed by op key) ---
+typedef struct {
+    char* key;
+    PMLL_JournalStatus status;
+} JournalEntry;
+
+struct PMLL_Journal {
+    char* path;
+    int fd;
+    uint64_t next_sequence;
+
+    JournalEntry* entries;
+    size_t entry_count;
+    size_t entry_capacity;
+
+    // Group commit state
+    size_t batch_max_records;
+    unsigned int batch_max_delay_ms;
+    size_t unsynced_records;
+    struct timespec oldest_unsynced;
+
+    pthread_mutex_t lock;
+};
+
+// --- Internal Helper Functions ---
+static uint32_t crc32_table[256];
+static pthread_once_t crc32_once = PTHREAD_ONCE_INIT;
+
+static void crc32_init_table(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) {
+            c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        }
+        crc32_table[i] = c;
+    }
+}
+
+static uint32_t crc32_update(uint32_t crc, const void* data, size_t len) {
+    const unsigned char* p = (const unsigned char*)data;
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++) {
+        crc = crc32_table[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+static uint32_t record_crc(const JournalRecordHeader* header, const char* key) {
+    uint32_t crc = crc32_update(0, &header->type, sizeof(JournalRecordHeader) - offsetof(JournalRecordHeader, type));
+    return crc32_update(crc, key, header->key_len);
+}
+
+static uint64_t key_hash(const char* key) {
+    uint64_t hash = 1469598103934665603ULL;
+    for (const unsigned char* p = (const unsigned char*)key; *p; p++) {
+        hash = (hash ^ *p) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+static JournalEntry* table_find_slot(JournalEntry* entries, size_t capacity, const char* key) {
+    size_t index = key_hash(key) & (capacity - 1);
+    while (entries[index].key && strcmp(entries[index].key, key) != 0) {
+        index = (index + 1) & (capacity - 1);
+    }
+    return &entries[index];
+}
+
+static bool table_grow(PMLL_Journal* journal) {
+    size_t new_capacity = journal->entry_capacity ? journal->entry_capacity * 2 : 64;
+    JournalEntry* new_entries = calloc(new_capacity, sizeof(JournalEntry));
+    if (!new_entries) return false;
+
+    for (size_t i = 0; i < journal->entry_capacity; i++) {
+        if (journal->entries[i].key) {
+            *table_find_slot(new_entries, new_capacity, journal->entries[i].key) = journal->entries[i];
+        }
+    }
+
+    free(journal->entries);
+    journal->entries = new_entries;
+    journal->entry_capacity = new_capacity;
+    return true;
+}
+
+static void table_set(PMLL_Journal* journal, const char* key, PMLL_JournalStatus status) {
+    if ((journal->entry_count + 1) * 10 > journal->entry_capacity * 7 && !table_grow(journal)) {
+        return;
+    }
+
+    JournalEntry* entry = table_find_slot(journal->entries, journal->entry_capacity, key);
+    if (!entry->key) {
+        entry->key = strdup(key);
+        if (!entry->key) return;
+        journal->entry_count++;
+    }
+    entry->status = status;
+}
+
+static void table_clear(PMLL_Journal* journal) {
+    for (size_t i = 0; i < journal->entry_capacity; i++) {
+        free(journal->entries[i].key);
+    }
+    free(journal->entries);
+    journal->entries = NULL;
+    journal->entry_count = 0;
+    journal->entry_capacity = 0;
+}
+
+static long elapsed_ms_since(const struct timespec* start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1000L + (now.tv_nsec - start->tv_nsec) / 1000000L;
+}
+
+static bool make_parent_directories(const char* path) {
+    char buffer[1024];
+    snprintf(buffer, sizeof(buffer), "%s", path);
+
+    char* last_slash = strrchr(buffer, '/');
+    if (!last_slash || last_slash == buffer) return true;
+    *last_slash = '\0';
+
+    for (char* p = buffer + 1; *p; p++) {
+        if (*p == '/') {
+            *p = '\0';
+            if (mkdir(buffer, 0755) == -1 && errno != EEXIST) return false;
+            *p = '/';
+        }
+    }
+    return mkdir(buffer, 0755) == 0 || errno == EEXIST;
+}
+
+// --- Replay ---
+static bool journal_replay(PMLL_Journal* journal, bool verbose) {
+    char magic[8];
+    ssize_t n = pread(journal->fd, magic, sizeof(magic), 0);
+
+    if (n == 0) {
+        // Fresh journal
+        if (pwrite(journal->fd, JOURNAL_FILE_MAGIC, 8, 0) != 8) return false;
+        fsync(journal->fd);
+        lseek(journal->fd, 8, SEEK_SET);
+        return true;
+    }
+    if (n != 8 || memcmp(magic, JOURNAL_FILE_MAGIC, 8) != 0) {
+        printf("[PMLL] %s is not a PMLL journal\n", journal->path);
+        return false;
+    }
+
+    off_t offset = 8;
+    size_t records = 0;
+    char key[JOURNAL_KEY_MAX + 1];
+
+    for (;;) {
+        JournalRecordHeader header;
+        if (pread(journal->fd, &header, sizeof(header), offset) != (ssize_t)sizeof(header)) break;
+        if (header.magic != JOURNAL_RECORD_MAGIC || header.key_len == 0 || header.key_len > JOURNAL_KEY_MAX) break;
+        if (pread(journal->fd, key, header.key_len, offset + (off_t)sizeof(header)) != (ssize_t)header.key_len) break;
+        if (record_crc(&header, key) != header.crc) break;
+        key[header.key_len] = '\0';
+
+        switch (header.type) {
+            case JOURNAL_RECORD_BEGIN:  table_set(journal, key, PMLL_JOURNAL_BEGUN); break;
+            case JOURNAL_RECORD_COMMIT: table_set(journal, key, PMLL_JOURNAL_COMMITTED); break;
+            case JOURNAL_RECORD_ABORT:  table_set(journal, key, PMLL_JOURNAL_ABORTED); break;
+            default: break;
+        }
+
+        journal->next_sequence = header.sequence + 1;
+        offset += (off_t)(sizeof(header) + header.key_len);
+        records++;
+    }
+
+    // Anything past the last valid record is a torn write from a crash
+    struct stat st;
+    if (fstat(journal->fd, &st) == 0 && st.st_size > offset) {
+        printf("[PMLL] Truncating torn journal tail in %s (%lld bytes)\n",
+               journal->path, (long long)(st.st_size - offset));
+        if (ftruncate(journal->fd, offset) != 0) return false;
+        fsync(journal->fd);
+    }
+    lseek(journal->fd, offset, SEEK_SET);
+
+    if (verbose && records > 0) {
+        size_t uncommitted = 0;
+        for (size_t i = 0; i < journal->entry_capacity; i++) {
+            if (journal->entries[i].key && journal->entries[i].status == PMLL_JOURNAL_BEGUN) uncommitted++;
+        }
+        printf("[PMLL] Replayed %zu journal record(s) from %s: %zu operation(s), %zu uncommitted\n",
+               records, journal->path, journal->entry_count, uncommitted);
+    }
+    return true;
+}
+
+// --- Journal Lifecycle ---
+PMLL_Journal* pmll_journal_open(const char* path) {
+    if (!path) return NULL;
+
+    pthread_once(&crc32_once, crc32_init_table);
+
+    PMLL_Journal* journal = calloc(1, sizeof(PMLL_Journal));
+    if (!journal) {
+        perror("Failed to allocate PMLL_Journal");
+        return NULL;
+    }
+
+    journal->path = strdup(path);
+    journal->batch_max_records = PMLL_JOURNAL_DEFAULT_BATCH_RECORDS;
+    journal->batch_max_delay_ms = PMLL_JOURNAL_DEFAULT_BATCH_DELAY_MS;
+
+    make_parent_directories(path);
+    journal->fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (!journal->path || journal->fd < 0) {
+        printf("[PMLL] Could not open journal %s: %s\n", path, strerror(errno));
+        free(journal->path);
+        if (journal->fd >= 0) close(journal->fd);
+        free(journal);
+        return NULL;
+    }
+
+    pthread_mutex_init(&journal->lock, NULL);
+
+    if (!journal_replay(journal, true)) {
+        pmll_journal_close(journal);
+        return NULL;
+    }
+
+    return journal;
+}
+
+void pmll_journal_close(PMLL_Journal* journal) {
+    if (!journal) return;
+
+    pmll_journal_sync(journal);
+    close(journal->fd);
+    table_clear(journal);
+    pthread_mutex_destroy(&journal->lock);
+    free(journal->path);
+    free(journal);
+}
+
+char* pmll_journal_path_for_resource(const char* resource_id) {
+    if (!resource_id) return NULL;
+
+    const char* dir = getenv("CPM_JOURNAL_DIR");
+    if (!dir || dir[0] == '\0') dir = "/tmp/cpm/journal";
+
+    char safe_id[256];
+    size_t i = 0;
+    for (; resource_id[i] && i < sizeof(safe_id) - 1; i++) {
+        char c = resource_id[i];
+        bool ok = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+                  (c >= '0' && c <= '9') || c == '.' || c == '-' || c == '_';
+        safe_id[i] = ok ? c : '_';
+    }
+    safe_id[i] = '\0';
+
+    size_t len = strlen(dir) + strlen(safe_id) + 10;
+    char* path = malloc(len);
+    if (path) snprintf(path, len, "%s/%s.journal", dir, safe_id);
+    return path;
+}
+
+// --- Group Commit ---
+void pmll_journal_set_batching(PMLL_Journal* journal, size_t max_records, unsigned int max_delay_ms) {
+    if (!journal) return;
+
+    pthread_mutex_lock(&journal->lock);
+    journal->batch_max_records = max_records > 0 ? max_records : 1;
+    journal->batch_max_delay_ms = max_delay_ms;
+    pthread_mutex_unlock(&journal->lock);
+}
+
+// The pending group is due once it is full or its oldest record has waited max_delay_ms
+static bool journal_group_due_locked(PMLL_Journal* journal) {
+    return journal->unsynced_records >= journal->batch_max_records ||
+           elapsed_ms_since(&journal->oldest_unsynced) >= (long)journal->batch_max_delay_ms;
+}
+
+static bool journal_sync_locked(PMLL_Journal* journal) {
+    if (journal->unsynced_records == 0) return true;
+
+    if (fdatasync(journal->fd) != 0) {
+        printf("[PMLL] Journal sync failed for %s: %s\n", journal->path, strerror(errno));
+        return false;
+    }
+    journal->unsynced_records = 0;
+    return true;
+}
+
+bool pmll_journal_sync(PMLL_Journal* journal) {
+    if (!journal) return false;
+
+    pthread_mutex_lock(&journal->lock);
+    bool ok = journal_sync_locked(journal);
+    pthread_mutex_unlock(&journal->lock);
+    return ok;
+}
+
+bool pmll_journal_flush(PMLL_Journal* journal) {
+    if (!journal) return false;
+
+    pthread_mutex_lock(&journal->lock);
+    bool ok = journal->unsynced_records == 0 || !journal_group_due_locked(journal) ||
+              journal_sync_locked(journal);
+    pthread_mutex_unlock(&journal->lock);
+    return ok;
+}
+
+// --- Recording ---
+static bool journal_append(PMLL_Journal* journal, JournalRecordType type, const char* op_key) {
+    if (!journal || !op_key) return false;
+
+    size_t key_len = strlen(op_key);
+    if (key_len == 0 || key_len > JOURNAL_KEY_MAX) return false;
+
+    pthread_mutex_lock(&journal->lock);
+
+    char buffer[sizeof(JournalRecordHeader) + JOURNAL_KEY_MAX];
+    JournalRecordHeader header = {
+        .magic = JOURNAL_RECORD_MAGIC,
+        .type = (uint32_t)type,
+        .key_len = (uint32_t)key_len,
+        .sequence = journal->next_sequence++
+    };
+    header.crc = record_crc(&header, op_key);
+    memcpy(buffer, &header, sizeof(header));
+    memcpy(buffer + sizeof(header), op_key, key_len);
+
+    // One write() per record keeps records contiguous; fsync is deferred to the group boundary
+    size_t total = sizeof(header) + key_len;
+    if (write(journal->fd, buffer, total) != (ssize_t)total) {
+        printf("[PMLL] Journal append failed for %s: %s\n", journal->path, strerror(errno));
+        pthread_mutex_unlock(&journal->lock);
+        return false;
+    }
+
+    if (journal->unsynced_records++ == 0) {
+        clock_gettime(CLOCK_MONOTONIC, &journal->oldest_unsynced);
+    }
+
+    table_set(journal, op_key,
+              type == JOURNAL_RECORD_BEGIN ? PMLL_JOURNAL_BEGUN :
+              type == JOURNAL_RECORD_COMMIT ? PMLL_JOURNAL_COMMITTED : PMLL_JOURNAL_ABORTED);
+
+    bool ok = !journal_group_due_locked(journal) || journal_sync_locked(journal);
+
+    pthread_mutex_unlock(&journal->lock);
+    return ok;
+}
+
+bool pmll_journal_begin(PMLL_Journal* journal, const char* op_key) {
+    return journal_append(journal, JOURNAL_RECORD_BEGIN, op_key);
+}
+
+bool pmll_journal_commit(PMLL_Journal* journal, const char* op_key) {
+    return journal_append(journal, JOURNAL_RECORD_COMMIT, op_key);
+}
+
+bool pmll_journal_abort(PMLL_Journal* journal, const char* op_key) {
+    return journal_append(journal, JOURNAL_RECORD_ABORT, op_key);
+}
+
+bool pmll_journal_truncate(PMLL_Journal* journal) {
+    if (!journal) return false;
+
+    pthread_mutex_lock(&journal->lock);
+    bool ok = ftruncate(journal->fd, 8) == 0 && fsync(journal->fd) == 0;
+    lseek(journal->fd, 8, SEEK_SET);
+    table_clear(journal);
+    journal->unsynced_records = 0;
+    journal->next_sequence = 0;
+    pthread_mutex_unlock(&journal->lock);
+    return ok;
+}
+
+bool pmll_journal_refresh(PMLL_Journal* journal) {
+    if (!journal) return false;
+
+    pthread_mutex_lock(&journal->lock);
+    table_clear(journal);
+    journal->next_sequence = 0;
+    bool ok = journal_replay(journal, false);
+    pthread_mutex_unlock(&journal->lock);
+    return ok;
+}
+
+// --- Recovery Queries ---
+PMLL_JournalStatus pmll_journal_status(PMLL_Journal* journal, const char* op_key) {
+    if (!journal || !op_key) return PMLL_JOURNAL_UNKNOWN;
+
+    pthread_mutex_lock(&journal->lock);
+    PMLL_JournalStatus status = PMLL_JOURNAL_UNKNOWN;
+    if (journal->entry_capacity > 0) {
+        JournalEntry* entry = table_find_slot(journal->entries, journal->entry_capacity, op_key);
+        if (entry->key) status = entry->status;
+    }
+    pthread_mutex_unlock(&journal->lock);
+    return status;
+}
+
+char** pmll_journal_uncommitted_keys(PMLL_Journal* journal, size_t* count) {
+    *count = 0;
+    if (!journal) return NULL;
+
+    pthread_mutex_lock(&journal->lock);
+    char** keys = journal->entry_count ? malloc(journal->entry_count * sizeof(char*)) : NULL;
+    if (keys) {
+        for (size_t i = 0; i < journal->entry_capacity; i++) {
+            if (journal->entries[i].key && journal->entries[i].status == PMLL_JOURNAL_BEGUN) {
+                keys[(*count)++] = strdup(journal->entries[i].key);
+            }
+        }
+    }
+    pthread_mutex_unlock(&journal->lock);
+    return keys;
+}
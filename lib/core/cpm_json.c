@@ -0,0 +1,475 @@
+/*
+ * File: lib/core/cpm_json.c
+ * Description: Streaming JSON tokenizer for CPM.
+ * One pass, left to right: the reader keeps a stack of open containers and
+ * what it expects next, so malformed documents stop at the first bad byte
+ * instead of being matched by substring. Nothing is copied until a caller
+ * asks for a decoded string.
+ * Author: Dr. Q Josef Kurk Edwards
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cpm_json.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// --- Reader State ---
+// What the next token may be
+enum {
+    EXPECT_VALUE,               // Root value, after ':' or after ',' in an array
+    EXPECT_FIRST_VALUE,         // After '[': a value or ']'
+    EXPECT_KEY,                 // After ',' in an object
+    EXPECT_FIRST_KEY,           // After '{': a key or '}'
+    EXPECT_COLON,               // After a key
+    EXPECT_NEXT,                // After a value: ',' or the container's end
+    EXPECT_DONE,
+    EXPECT_FAILED
+};
+
+void cpm_json_reader_init(CPM_JsonReader* reader, const char* data, size_t size) {
+    reader->data = data;
+    reader->size = size;
+    reader->pos = 0;
+    reader->depth = 0;
+    reader->state = EXPECT_VALUE;
+}
+
+static void skip_whitespace(CPM_JsonReader* reader) {
+    const char* data = reader->data;
+    size_t pos = reader->pos;
+    while (pos < reader->size && (data[pos] == ' ' || data[pos] == '\n' || data[pos] == '\r' || data[pos] == '\t')) {
+        pos++;
+    }
+    reader->pos = pos;
+}
+
+static bool fail(CPM_JsonReader* reader, CPM_JsonToken* token) {
+    reader->state = EXPECT_FAILED;
+    token->type = CPM_JSON_ERROR;
+    token->start = reader->data + reader->pos;
+    token->length = 0;
+    token->escaped = false;
+    token->depth = reader->depth;
+    return false;
+}
+
+// --- Strings ---
+static bool is_control(char c) {
+    return (unsigned char)c < 0x20;
+}
+
+// Index of the first '"', '\\' or control byte (never valid raw in a string)
+// at or after pos, or size if there is none
+static size_t find_string_special(const char* data, size_t pos, size_t size) {
+#ifdef __SSE2__
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i control_max = _mm_set1_epi8(0x1F);
+    while (pos + 16 <= size) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)(data + pos));
+        // Unsigned byte <= 0x1F exactly when max(byte, 0x1F) is 0x1F
+        __m128i control = _mm_cmpeq_epi8(_mm_max_epu8(chunk, control_max), control_max);
+        __m128i special = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)), control);
+        int mask = _mm_movemask_epi8(special);
+        if (mask) return pos + (size_t)__builtin_ctz((unsigned)mask);
+        pos += 16;
+    }
+#endif
+    while (pos < size && data[pos] != '"' && data[pos] != '\\' && !is_control(data[pos])) pos++;
+    return pos;
+}
+
+static bool read_hex4(const char* p, uint32_t* code);
+
+// Length of the escape at data[pos] (a backslash), or 0 if it is not valid
+// JSON. A \u surrogate must come as a high-low pair, taken as one escape.
+static size_t escape_length(const char* data, size_t pos, size_t size) {
+    if (pos + 1 >= size) return 0;
+    switch (data[pos + 1]) {
+        case '"': case '\\': case '/': case 'b': case 'f': case 'n': case 'r': case 't':
+            return 2;
+        case 'u': {
+            uint32_t code;
+            if (size - pos < 6 || !read_hex4(data + pos + 2, &code)) return 0;
+            if (code >= 0xDC00 && code < 0xE000) return 0;
+            if (code < 0xD800 || code >= 0xDC00) return 6;
+            uint32_t low;
+            if (size - pos < 12 || data[pos + 6] != '\\' || data[pos + 7] != 'u' || !read_hex4(data + pos + 8, &low) ||
+                low < 0xDC00 || low >= 0xE000) {
+                return 0;
+            }
+            return 12;
+        }
+        default:
+            return 0;
+    }
+}
+
+size_t cpm_json_string_bound(const char* data, size_t size) {
+    size_t quotes = 0;
+    size_t pos = 0;
+#ifdef __SSE2__
+    const __m128i quote = _mm_set1_epi8('"');
+    for (; pos + 16 <= size; pos += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)(data + pos));
+        quotes += (size_t)__builtin_popcount((unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, quote)));
+    }
+#endif
+    for (; pos < size; pos++) quotes += data[pos] == '"';
+    return quotes / 2;
+}
+
+// Reads the string whose opening quote is at reader->pos into token
+static bool read_string(CPM_JsonReader* reader, CPM_JsonToken* token, CPM_JsonTokenType type) {
+    const char* data = reader->data;
+    size_t start = reader->pos + 1;
+    size_t pos = start;
+    bool escaped = false;
+    
+    for (;;) {
+        pos = find_string_special(data, pos, reader->size);
+        if (pos >= reader->size || is_control(data[pos])) {
+            reader->pos = pos;
+            return fail(reader, token);
+        }
+        if (data[pos] == '"') break;
+        size_t length = escape_length(data, pos, reader->size);
+        if (length == 0) {
+            reader->pos = pos;
+            return fail(reader, token);
+        }
+        escaped = true;
+        pos += length;
+    }
+    
+    token->type = type;
+    token->start = data + start;
+    token->length = pos - start;
+    token->escaped = escaped;
+    token->depth = reader->depth;
+    reader->pos = pos + 1;
+    return true;
+}
+
+// --- Values ---
+static bool read_literal(CPM_JsonReader* reader, CPM_JsonToken* token, const char* word, CPM_JsonTokenType type) {
+    size_t length = strlen(word);
+    if (reader->size - reader->pos < length || memcmp(reader->data + reader->pos, word, length) != 0) {
+        return fail(reader, token);
+    }
+    token->type = type;
+    token->start = reader->data + reader->pos;
+    token->length = length;
+    token->escaped = false;
+    token->depth = reader->depth;
+    reader->pos += length;
+    return true;
+}
+
+static bool is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+// Position after the digits at pos; false if there are none
+static bool skip_digits(const CPM_JsonReader* reader, size_t* pos) {
+    size_t start = *pos;
+    while (*pos < reader->size && is_digit(reader->data[*pos])) (*pos)++;
+    return *pos > start;
+}
+
+// -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)? and nothing else; whatever
+// follows is left for the caller, which accepts only a delimiter there
+static bool read_number(CPM_JsonReader* reader, CPM_JsonToken* token) {
+    const char* data = reader->data;
+    size_t size = reader->size;
+    size_t pos = reader->pos;
+    if (data[pos] == '-') pos++;
+    if (pos < size && data[pos] == '0') {
+        pos++;
+    } else if (!skip_digits(reader, &pos)) {
+        return fail(reader, token);
+    }
+    if (pos < size && data[pos] == '.') {
+        pos++;
+        if (!skip_digits(reader, &pos)) return fail(reader, token);
+    }
+    if (pos < size && (data[pos] == 'e' || data[pos] == 'E')) {
+        pos++;
+        if (pos < size && (data[pos] == '+' || data[pos] == '-')) pos++;
+        if (!skip_digits(reader, &pos)) return fail(reader, token);
+    }
+    token->type = CPM_JSON_NUMBER;
+    token->start = data + reader->pos;
+    token->length = pos - reader->pos;
+    token->escaped = false;
+    token->depth = reader->depth;
+    reader->pos = pos;
+    return true;
+}
+
+static bool open_container(CPM_JsonReader* reader, CPM_JsonToken* token, char c) {
+    if (reader->depth >= CPM_JSON_MAX_DEPTH) return fail(reader, token);
+    token->type = c == '{' ? CPM_JSON_OBJECT_START : CPM_JSON_ARRAY_START;
+    token->start = reader->data + reader->pos;
+    token->length = 1;
+    token->escaped = false;
+    token->depth = reader->depth;
+    reader->stack[reader->depth++] = c;
+    reader->state = c == '{' ? EXPECT_FIRST_KEY : EXPECT_FIRST_VALUE;
+    reader->pos++;
+    return true;
+}
+
+static bool close_container(CPM_JsonReader* reader, CPM_JsonToken* token, char c) {
+    char open = c == '}' ? '{' : '[';
+    if (reader->depth == 0 || reader->stack[reader->depth - 1] != open) return fail(reader, token);
+    reader->depth--;
+    token->type = c == '}' ? CPM_JSON_OBJECT_END : CPM_JSON_ARRAY_END;
+    token->start = reader->data + reader->pos;
+    token->length = 1;
+    token->escaped = false;
+    token->depth = reader->depth;
+    reader->state = EXPECT_NEXT;
+    reader->pos++;
+    return true;
+}
+
+static bool read_value(CPM_JsonReader* reader, CPM_JsonToken* token) {
+    if (reader->pos >= reader->size) return fail(reader, token);
+    char c = reader->data[reader->pos];
+    
+    if (c == '{' || c == '[') return open_container(reader, token, c);
+    
+    bool ok;
+    switch (c) {
+        case '"': ok = read_string(reader, token, CPM_JSON_STRING); break;
+        case 't': ok = read_literal(reader, token, "true", CPM_JSON_TRUE); break;
+        case 'f': ok = read_literal(reader, token, "false", CPM_JSON_FALSE); break;
+        case 'n': ok = read_literal(reader, token, "null", CPM_JSON_NULL); break;
+        default: ok = read_number(reader, token); break;
+    }
+    if (ok) reader->state = EXPECT_NEXT;
+    return ok;
+}
+
+// --- Tokenizer ---
+bool cpm_json_next(CPM_JsonReader* reader, CPM_JsonToken* token) {
+    skip_whitespace(reader);
+    const char* data = reader->data;
+    
+    switch (reader->state) {
+        case EXPECT_VALUE:
+            return read_value(reader, token);
+        
+        case EXPECT_FIRST_VALUE:
+            if (reader->pos < reader->size && data[reader->pos] == ']') return close_container(reader, token, ']');
+            return read_value(reader, token);
+        
+        case EXPECT_FIRST_KEY:
+            if (reader->pos < reader->size && data[reader->pos] == '}') return close_container(reader, token, '}');
+            // Fall through
+        case EXPECT_KEY:
+            if (reader->pos >= reader->size || data[reader->pos] != '"') return fail(reader, token);
+            if (!read_string(reader, token, CPM_JSON_KEY)) return false;
+            reader->state = EXPECT_COLON;
+            return true;
+        
+        case EXPECT_COLON:
+            if (reader->pos >= reader->size || data[reader->pos] != ':') return fail(reader, token);
+            reader->pos++;
+            skip_whitespace(reader);
+            return read_value(reader, token);
+        
+        case EXPECT_NEXT:
+            if (reader->depth == 0) {
+                // Only whitespace may follow the root value
+                if (reader->pos < reader->size) return fail(reader, token);
+                reader->state = EXPECT_DONE;
+                break;
+            }
+            if (reader->pos >= reader->size) return fail(reader, token);
+            if (data[reader->pos] == '}' || data[reader->pos] == ']') {
+                return close_container(reader, token, data[reader->pos]);
+            }
+            if (data[reader->pos] != ',') return fail(reader, token);
+            reader->pos++;
+            reader->state = reader->stack[reader->depth - 1] == '{' ? EXPECT_KEY : EXPECT_VALUE;
+            return cpm_json_next(reader, token);
+        
+        case EXPECT_DONE:
+            break;
+        
+        default:
+            return fail(reader, token);
+    }
+    
+    token->type = CPM_JSON_END;
+    token->start = data + reader->pos;
+    token->length = 0;
+    token->escaped = false;
+    token->depth = 0;
+    return false;
+}
+
+bool cpm_json_skip(CPM_JsonReader* reader, const CPM_JsonToken* token) {
+    CPM_JsonToken next;
+    if (token->type == CPM_JSON_KEY) {
+        if (!cpm_json_next(reader, &next)) return false;
+        return cpm_json_skip(reader, &next);
+    }
+    if (token->type != CPM_JSON_OBJECT_START && token->type != CPM_JSON_ARRAY_START) return true;
+    
+    // Containers are balanced by the reader, so the end is the first one
+    // back at the opening depth
+    while (cpm_json_next(reader, &next)) {
+        if ((next.type == CPM_JSON_OBJECT_END || next.type == CPM_JSON_ARRAY_END) && next.depth == token->depth) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// --- Token Values ---
+static bool read_hex4(const char* p, uint32_t* code) {
+    *code = 0;
+    for (int i = 0; i < 4; i++) {
+        char c = p[i];
+        uint32_t digit;
+        if (c >= '0' && c <= '9') digit = (uint32_t)(c - '0');
+        else if (c >= 'a' && c <= 'f') digit = (uint32_t)(c - 'a' + 10);
+        else if (c >= 'A' && c <= 'F') digit = (uint32_t)(c - 'A' + 10);
+        else return false;
+        *code = *code << 4 | digit;
+    }
+    return true;
+}
+
+static char* utf8_append(char* out, uint32_t code) {
+    unsigned char* o = (unsigned char*)out;
+    if (code < 0x80) {
+        *o++ = (unsigned char)code;
+    } else if (code < 0x800) {
+        *o++ = (unsigned char)(0xC0 | code >> 6);
+        *o++ = (unsigned char)(0x80 | (code & 0x3F));
+    } else if (code < 0x10000) {
+        *o++ = (unsigned char)(0xE0 | code >> 12);
+        *o++ = (unsigned char)(0x80 | (code >> 6 & 0x3F));
+        *o++ = (unsigned char)(0x80 | (code & 0x3F));
+    } else {
+        *o++ = (unsigned char)(0xF0 | code >> 18);
+        *o++ = (unsigned char)(0x80 | (code >> 12 & 0x3F));
+        *o++ = (unsigned char)(0x80 | (code >> 6 & 0x3F));
+        *o++ = (unsigned char)(0x80 | (code & 0x3F));
+    }
+    return (char*)o;
+}
+
+size_t cpm_json_string_decode(const CPM_JsonToken* token, char* out) {
+    if (!token->escaped) {
+        memmove(out, token->start, token->length);
+        out[token->length] = '\0';
+        return token->length;
+    }
+    
+    // Escapes never decode to more bytes than they take
+    const char* p = token->start;
+    const char* end = p + token->length;
+    char* begin = out;
+    while (p < end) {
+        if (*p != '\\') {
+            *out++ = *p++;
+            continue;
+        }
+        p++;
+        switch (*p) {
+            case 'b': *out++ = '\b'; p++; break;
+            case 'f': *out++ = '\f'; p++; break;
+            case 'n': *out++ = '\n'; p++; break;
+            case 'r': *out++ = '\r'; p++; break;
+            case 't': *out++ = '\t'; p++; break;
+            case 'u': {
+                uint32_t code;
+                if (end - p < 5 || !read_hex4(p + 1, &code)) {
+                    // The reader rejects these; a hand-made token keeps it as written
+                    *out++ = '\\';
+                    break;
+                }
+                p += 5;
+                // A surrogate pair spells one code point
+                uint32_t low;
+                if (code >= 0xD800 && code < 0xDC00 && end - p >= 6 && p[0] == '\\' && p[1] == 'u' &&
+                    read_hex4(p + 2, &low) && low >= 0xDC00 && low < 0xE000) {
+                    code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                    p += 6;
+                }
+                out = utf8_append(out, code);
+                break;
+            }
+            default: *out++ = *p++; break;
+        }
+    }
+    *out = '\0';
+    return (size_t)(out - begin);
+}
+
+char* cpm_json_string_dup(const CPM_JsonToken* token) {
+    char* value = malloc(token->length + 1);
+    if (value) cpm_json_string_decode(token, value);
+    return value;
+}
+
+bool cpm_json_string_equals(const CPM_JsonToken* token, const char* text) {
+    if (!token->escaped) {
+        return strlen(text) == token->length && memcmp(token->start, text, token->length) == 0;
+    }
+    char* value = cpm_json_string_dup(token);
+    bool equal = value && strcmp(value, text) == 0;
+    free(value);
+    return equal;
+}
+
+bool cpm_json_int64(const CPM_JsonToken* token, int64_t* value) {
+    if (token->type != CPM_JSON_NUMBER) return false;
+    const char* p = token->start;
+    const char* end = p + token->length;
+    bool negative = p < end && *p == '-';
+    if (negative) p++;
+    if (p == end) return false;
+    
+    uint64_t magnitude = 0;
+    uint64_t limit = negative ? (uint64_t)INT64_MAX + 1 : (uint64_t)INT64_MAX;
+    for (; p < end; p++) {
+        if (*p < '0' || *p > '9') return false;
+        uint64_t digit = (uint64_t)(*p - '0');
+        if (magnitude > (limit - digit) / 10) return false;
+        magnitude = magnitude * 10 + digit;
+    }
+    *value = negative ? (int64_t)(0 - magnitude) : (int64_t)magnitude;
+    return true;
+}
+
+// --- Writing ---
+void cpm_json_write_string(FILE* f, const char* text) {
+    fputc('"', f);
+    for (const unsigned char* p = (const unsigned char*)text; *p; p++) {
+        switch (*p) {
+            case '"':  fputs("\\\"", f); break;
+            case '\\': fputs("\\\\", f); break;
+            case '\n': fputs("\\n", f); break;
+            case '\r': fputs("\\r", f); break;
+            case '\t': fputs("\\t", f); break;
+            default:
+                if (*p < 0x20) {
+                    fprintf(f, "\\u%04x", *p);
+                } else {
+                    fputc(*p, f);
+                }
+        }
+    }
+    fputc('"', f);
+}
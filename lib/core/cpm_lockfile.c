@@ -0,0 +1,792 @@
+/*
+ * File: lib/core/cpm_lockfile.c
+ * Description: cpm.lock reading and writing for CPM.
+ * Both forms encode the same model. The text form is one JSON document with a
+ * line per package, so lock changes review like code. The binary image is a
+ * header followed by fixed-size records, edge and install-order arrays and a
+ * string table, all addressed by offset so the file is used straight from mmap.
+ * Author: Dr. Q Josef Kurk Edwards
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "cpm_lockfile.h"
+#include "cpm_json.h"
+
+// Bumped whenever the image layout changes
+#define LOCK_IMAGE_MAGIC "CPMLOCK2"
+
+// --- Binary Image Layout ---
+// Offsets are from the start of the image; integers are in host byte order
+// (the image is a local cache, rebuilt from cpm.lock on any mismatch).
+typedef struct {
+    char magic[8];
+    uint32_t format_version;
+    uint32_t package_count;
+    uint64_t spec_hash;
+    uint64_t text_hash;         // Of the cpm.lock the image was built from
+    uint64_t checksum;          // Of everything after the header
+    uint32_t size;              // Whole image
+    uint32_t root_name;         // String offset
+    uint32_t root_edge_first;
+    uint32_t root_edge_count;
+    uint32_t specs_offset;      // String offsets of the spec's dependency strings
+    uint32_t spec_count;
+    uint32_t records_offset;
+    uint32_t edges_offset;
+    uint32_t edge_count;
+    uint32_t order_offset;      // Install order: package indices, level by level
+    uint32_t levels_offset;     // level_count + 1 offsets into the install order
+    uint32_t level_count;
+    uint32_t strings_offset;
+    uint32_t strings_size;
+} LockImageHeader;
+
+typedef struct {
+    uint32_t name;              // String offsets
+    uint32_t version;
+    uint32_t resolved;
+    uint32_t integrity;
+    uint32_t level;
+    uint32_t edge_first;
+    uint32_t edge_count;
+    uint32_t reserved;
+} LockImageRecord;
+
+struct CPM_Lockfile {
+    unsigned char* image;
+    size_t size;
+    bool mapped;                // mmap'd file rather than a heap buffer
+    const LockImageHeader* header;
+    const LockImageRecord* records;
+    const uint32_t* edges;
+    const uint32_t* order;
+    const uint32_t* levels;
+    const uint32_t* specs;
+    const char* strings;
+};
+
+// --- Lock Model ---
+typedef struct {
+    char* name;
+    char* version;
+    char* resolved;
+    char* integrity;
+    uint32_t level;
+    char** dependencies;        // Package names
+    size_t dependency_count;
+} LockPackage;
+
+typedef struct {
+    char* root_name;
+    char** root_dependencies;   // Spec strings, "name@constraint"
+    size_t root_dependency_count;
+    uint64_t spec_hash;
+    LockPackage* packages;      // Sorted by name
+    size_t package_count;
+} LockModel;
+
+static uint64_t lock_hash(const void* data, size_t size, uint64_t hash) {
+    const unsigned char* p = data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= p[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+#define LOCK_HASH_SEED 1469598103934665603ULL
+
+static char* lock_strdup(const char* str) {
+    return strdup(str ? str : "");
+}
+
+static void lock_string_list_free(char** list, size_t count) {
+    for (size_t i = 0; i < count; i++) free(list[i]);
+    free(list);
+}
+
+static void lock_model_free(LockModel* model) {
+    free(model->root_name);
+    lock_string_list_free(model->root_dependencies, model->root_dependency_count);
+    for (size_t i = 0; i < model->package_count; i++) {
+        LockPackage* pkg = &model->packages[i];
+        free(pkg->name);
+        free(pkg->version);
+        free(pkg->resolved);
+        free(pkg->integrity);
+        lock_string_list_free(pkg->dependencies, pkg->dependency_count);
+    }
+    free(model->packages);
+    memset(model, 0, sizeof(*model));
+}
+
+static int lock_package_compare(const void* a, const void* b) {
+    return strcmp(((const LockPackage*)a)->name, ((const LockPackage*)b)->name);
+}
+
+static int lock_string_compare(const void* a, const void* b) {
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+// Index of the named package in a name-sorted model, or -1
+static long lock_model_find(const LockModel* model, const char* name) {
+    size_t low = 0;
+    size_t high = model->package_count;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        int cmp = strcmp(model->packages[mid].name, name);
+        if (cmp == 0) return (long)mid;
+        if (cmp < 0) low = mid + 1;
+        else high = mid;
+    }
+    return -1;
+}
+
+// "name@constraint" -> length of the name part
+static size_t lock_spec_name_length(const char* spec) {
+    const char* at_sign = strchr(spec, '@');
+    return at_sign ? (size_t)(at_sign - spec) : strlen(spec);
+}
+
+// --- Spec Fingerprint ---
+uint64_t cpm_lockfile_spec_hash(const Package* package) {
+    uint64_t hash = LOCK_HASH_SEED;
+    if (!package || package->dep_count == 0) return hash;
+    
+    char** sorted = malloc(package->dep_count * sizeof(char*));
+    if (!sorted) return 0;
+    memcpy(sorted, package->dependencies, package->dep_count * sizeof(char*));
+    qsort(sorted, package->dep_count, sizeof(char*), lock_string_compare);
+    
+    for (size_t i = 0; i < package->dep_count; i++) {
+        hash = lock_hash(sorted[i], strlen(sorted[i]), hash);
+        hash = lock_hash("\n", 1, hash);
+    }
+    free(sorted);
+    return hash;
+}
+
+// --- Model From a Resolution ---
+static bool lock_model_from_resolution(LockModel* model, const DepResolution* resolution, const Package* root_package) {
+    memset(model, 0, sizeof(*model));
+    model->root_name = lock_strdup(root_package->name);
+    model->spec_hash = cpm_lockfile_spec_hash(root_package);
+    
+    model->root_dependencies = calloc(root_package->dep_count ? root_package->dep_count : 1, sizeof(char*));
+    model->packages = calloc(resolution->node_count ? resolution->node_count : 1, sizeof(LockPackage));
+    if (!model->root_name || !model->root_dependencies || !model->packages) return false;
+    
+    for (size_t i = 0; i < root_package->dep_count; i++) {
+        model->root_dependencies[model->root_dependency_count++] = lock_strdup(root_package->dependencies[i]);
+    }
+    
+    for (size_t i = 0; i < resolution->node_count; i++) {
+        const DepNode* node = resolution->nodes[i];
+        if (node == resolution->root) continue;
+        
+        LockPackage* pkg = &model->packages[model->package_count++];
+        pkg->name = lock_strdup(node->name);
+        pkg->version = node->version ? semver_to_string(node->version) : lock_strdup("");
+        pkg->resolved = lock_strdup(node->resolved_url);
+        pkg->integrity = lock_strdup(node->integrity);
+        pkg->level = (uint32_t)node->level;
+        pkg->dependencies = calloc(node->child_count ? node->child_count : 1, sizeof(char*));
+        if (!pkg->name || !pkg->version || !pkg->resolved || !pkg->integrity || !pkg->dependencies) return false;
+        
+        for (size_t c = 0; c < node->child_count; c++) {
+            pkg->dependencies[pkg->dependency_count++] = lock_strdup(node->children[c]->name);
+        }
+        qsort(pkg->dependencies, pkg->dependency_count, sizeof(char*), lock_string_compare);
+    }
+    
+    qsort(model->packages, model->package_count, sizeof(LockPackage), lock_package_compare);
+    return true;
+}
+
+// --- Text Form ---
+static void lock_write_string_array(FILE* f, char** values, size_t count) {
+    fprintf(f, "[");
+    for (size_t i = 0; i < count; i++) {
+        if (i) fprintf(f, ", ");
+        cpm_json_write_string(f, values[i]);
+    }
+    fprintf(f, "]");
+}
+
+static bool lock_write_text(const LockModel* model, FILE* f) {
+    fprintf(f, "{\n");
+    fprintf(f, "  \"lockfileVersion\": %d,\n", CPM_LOCKFILE_FORMAT_VERSION);
+    fprintf(f, "  \"name\": ");
+    cpm_json_write_string(f, model->root_name);
+    fprintf(f, ",\n");
+    fprintf(f, "  \"specHash\": \"%016llx\",\n", (unsigned long long)model->spec_hash);
+    fprintf(f, "  \"dependencies\": ");
+    lock_write_string_array(f, model->root_dependencies, model->root_dependency_count);
+    fprintf(f, ",\n");
+    fprintf(f, "  \"packages\": [\n");
+    
+    // One package per line keeps diffs readable and parsing trivial
+    for (size_t i = 0; i < model->package_count; i++) {
+        const LockPackage* pkg = &model->packages[i];
+        // Strings come from package specs and registry responses: escape them
+        fprintf(f, "    {\"name\": ");
+        cpm_json_write_string(f, pkg->name);
+        fprintf(f, ", \"version\": ");
+        cpm_json_write_string(f, pkg->version);
+        fprintf(f, ", \"resolved\": ");
+        cpm_json_write_string(f, pkg->resolved);
+        fprintf(f, ", \"integrity\": ");
+        cpm_json_write_string(f, pkg->integrity);
+        fprintf(f, ", \"level\": %u, \"dependencies\": ", pkg->level);
+        lock_write_string_array(f, pkg->dependencies, pkg->dependency_count);
+        fprintf(f, "}%s\n", i + 1 < model->package_count ? "," : "");
+    }
+    
+    fprintf(f, "  ]\n");
+    fprintf(f, "}\n");
+    return !ferror(f);
+}
+
+static bool lock_parse_text(LockModel* model, const char* text) {
+    memset(model, 0, sizeof(*model));
+    
+    int format_version = 0;
+    const char* version_pos = strstr(text, "\"lockfileVersion\":");
+    if (!version_pos || sscanf(version_pos, "\"lockfileVersion\": %d", &format_version) != 1 ||
+        format_version != CPM_LOCKFILE_FORMAT_VERSION) {
+        printf("[CPM Lock] Unsupported lockfile format, ignoring it\n");
+        return false;
+    }
+    
+    // The root's fields come before "packages", so the first match is the root's
+    model->root_name = extract_json_string_value(text, "name");
+    model->root_dependencies = extract_json_array_values(text, "dependencies", &model->root_dependency_count);
+    char* spec_hash = extract_json_string_value(text, "specHash");
+    if (spec_hash) model->spec_hash = strtoull(spec_hash, NULL, 16);
+    free(spec_hash);
+    
+    const char* p = strstr(text, "\"packages\":");
+    if (!model->root_name || !p) return false;
+    p = strchr(p, '\n');
+    
+    size_t capacity = 0;
+    while (p && *p) {
+        const char* line = p + 1;
+        p = strchr(line, '\n');
+        size_t length = p ? (size_t)(p - line) : strlen(line);
+        
+        const char* start = line;
+        while (start < line + length && (*start == ' ' || *start == '\t')) start++;
+        if (start == line + length || *start != '{') continue;
+        
+        char* entry = strndup(line, length);
+        if (!entry) return false;
+        
+        if (model->package_count == capacity) {
+            capacity = capacity ? capacity * 2 : 32;
+            LockPackage* grown = realloc(model->packages, capacity * sizeof(LockPackage));
+            if (!grown) {
+                free(entry);
+                return false;
+            }
+            model->packages = grown;
+        }
+        
+        LockPackage* pkg = &model->packages[model->package_count++];
+        memset(pkg, 0, sizeof(*pkg));
+        pkg->name = extract_json_string_value(entry, "name");
+        pkg->version = extract_json_string_value(entry, "version");
+        pkg->resolved = extract_json_string_value(entry, "resolved");
+        pkg->integrity = extract_json_string_value(entry, "integrity");
+        pkg->dependencies = extract_json_array_values(entry, "dependencies", &pkg->dependency_count);
+        const char* level = strstr(entry, "\"level\":");
+        pkg->level = level ? (uint32_t)strtoul(level + strlen("\"level\":"), NULL, 10) : 0;
+        free(entry);
+        
+        if (!pkg->name || !pkg->version) return false;
+        if (!pkg->resolved) pkg->resolved = lock_strdup("");
+        if (!pkg->integrity) pkg->integrity = lock_strdup("");
+    }
+    
+    qsort(model->packages, model->package_count, sizeof(LockPackage), lock_package_compare);
+    return true;
+}
+
+// --- Binary Form ---
+typedef struct {
+    char* data;
+    size_t size;
+    size_t capacity;
+} LockStrings;
+
+// Appends a string to the table; returns its offset (0 = "" on failure)
+static uint32_t lock_strings_add(LockStrings* strings, const char* value) {
+    size_t length = strlen(value) + 1;
+    if (length == 1) return 0;
+    if (strings->size + length > strings->capacity) {
+        size_t capacity = strings->capacity ? strings->capacity : 1024;
+        while (strings->size + length > capacity) capacity *= 2;
+        char* grown = realloc(strings->data, capacity);
+        if (!grown) return 0;
+        strings->data = grown;
+        strings->capacity = capacity;
+    }
+    memcpy(strings->data + strings->size, value, length);
+    strings->size += length;
+    return (uint32_t)(strings->size - length);
+}
+
+static size_t lock_align(size_t offset) {
+    return (offset + 7) & ~(size_t)7;
+}
+
+static unsigned char* lock_build_image(const LockModel* model, uint64_t text_hash, size_t* image_size) {
+    size_t n = model->package_count;
+    LockStrings strings = {0};
+    lock_strings_add(&strings, "x");
+    strings.data[0] = '\0';         // Offset 0 is the empty string
+    strings.size = 1;
+    
+    LockImageRecord* records = calloc(n ? n : 1, sizeof(LockImageRecord));
+    size_t edge_capacity = model->root_dependency_count;
+    for (size_t i = 0; i < n; i++) edge_capacity += model->packages[i].dependency_count;
+    uint32_t* edges = malloc((edge_capacity ? edge_capacity : 1) * sizeof(uint32_t));
+    uint32_t* order = malloc((n ? n : 1) * sizeof(uint32_t));
+    uint32_t level_count = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (model->packages[i].level + 1 > level_count) level_count = model->packages[i].level + 1;
+    }
+    uint32_t* levels = calloc(level_count + 2, sizeof(uint32_t));
+    uint32_t* specs = calloc(model->root_dependency_count + 1, sizeof(uint32_t));
+    unsigned char* image = NULL;
+    size_t edge_count = 0;
+    
+    if (!records || !edges || !order || !levels || !specs || !strings.data) goto done;
+    
+    // Records and dependency edges, in name order
+    for (size_t i = 0; i < n; i++) {
+        const LockPackage* pkg = &model->packages[i];
+        LockImageRecord* record = &records[i];
+        record->name = lock_strings_add(&strings, pkg->name);
+        record->version = lock_strings_add(&strings, pkg->version);
+        record->resolved = lock_strings_add(&strings, pkg->resolved);
+        record->integrity = lock_strings_add(&strings, pkg->integrity);
+        record->level = pkg->level;
+        record->edge_first = (uint32_t)edge_count;
+        for (size_t d = 0; d < pkg->dependency_count; d++) {
+            long target = lock_model_find(model, pkg->dependencies[d]);
+            if (target >= 0) edges[edge_count++] = (uint32_t)target;
+        }
+        record->edge_count = (uint32_t)(edge_count - record->edge_first);
+    }
+    
+    uint32_t root_edge_first = (uint32_t)edge_count;
+    for (size_t d = 0; d < model->root_dependency_count; d++) {
+        char* name = strndup(model->root_dependencies[d], lock_spec_name_length(model->root_dependencies[d]));
+        long target = name ? lock_model_find(model, name) : -1;
+        free(name);
+        if (target >= 0) edges[edge_count++] = (uint32_t)target;
+    }
+    uint32_t root_name = lock_strings_add(&strings, model->root_name);
+    for (size_t d = 0; d < model->root_dependency_count; d++) {
+        specs[d] = lock_strings_add(&strings, model->root_dependencies[d]);
+    }
+    
+    // Install order: a counting sort by level keeps name order within a level
+    for (size_t i = 0; i < n; i++) levels[model->packages[i].level + 1]++;
+    for (uint32_t l = 0; l < level_count; l++) levels[l + 1] += levels[l];
+    uint32_t* cursor = malloc((level_count + 1) * sizeof(uint32_t));
+    if (!cursor) goto done;
+    memcpy(cursor, levels, (level_count + 1) * sizeof(uint32_t));
+    for (size_t i = 0; i < n; i++) order[cursor[model->packages[i].level]++] = (uint32_t)i;
+    free(cursor);
+    
+    size_t records_offset = lock_align(sizeof(LockImageHeader));
+    size_t edges_offset = lock_align(records_offset + n * sizeof(LockImageRecord));
+    size_t order_offset = lock_align(edges_offset + edge_count * sizeof(uint32_t));
+    size_t levels_offset = lock_align(order_offset + n * sizeof(uint32_t));
+    size_t specs_offset = lock_align(levels_offset + (level_count + 1) * sizeof(uint32_t));
+    size_t strings_offset = lock_align(specs_offset + model->root_dependency_count * sizeof(uint32_t));
+    size_t size = strings_offset + strings.size;
+    if (size > UINT32_MAX) goto done;
+    
+    image = calloc(1, size);
+    if (!image) goto done;
+    
+    LockImageHeader* header = (LockImageHeader*)image;
+    memcpy(header->magic, LOCK_IMAGE_MAGIC, sizeof(header->magic));
+    header->format_version = CPM_LOCKFILE_FORMAT_VERSION;
+    header->package_count = (uint32_t)n;
+    header->spec_hash = model->spec_hash;
+    header->text_hash = text_hash;
+    header->size = (uint32_t)size;
+    header->root_name = root_name;
+    header->root_edge_first = root_edge_first;
+    header->root_edge_count = (uint32_t)(edge_count - root_edge_first);
+    header->specs_offset = (uint32_t)specs_offset;
+    header->spec_count = (uint32_t)model->root_dependency_count;
+    header->records_offset = (uint32_t)records_offset;
+    header->edges_offset = (uint32_t)edges_offset;
+    header->edge_count = (uint32_t)edge_count;
+    header->order_offset = (uint32_t)order_offset;
+    header->levels_offset = (uint32_t)levels_offset;
+    header->level_count = level_count;
+    header->strings_offset = (uint32_t)strings_offset;
+    header->strings_size = (uint32_t)strings.size;
+    
+    memcpy(image + records_offset, records, n * sizeof(LockImageRecord));
+    memcpy(image + edges_offset, edges, edge_count * sizeof(uint32_t));
+    memcpy(image + order_offset, order, n * sizeof(uint32_t));
+    memcpy(image + levels_offset, levels, (level_count + 1) * sizeof(uint32_t));
+    memcpy(image + specs_offset, specs, model->root_dependency_count * sizeof(uint32_t));
+    memcpy(image + strings_offset, strings.data, strings.size);
+    header->checksum = lock_hash(image + sizeof(LockImageHeader), size - sizeof(LockImageHeader), LOCK_HASH_SEED);
+    *image_size = size;
+
+done:
+    free(records);
+    free(edges);
+    free(order);
+    free(levels);
+    free(specs);
+    free(strings.data);
+    return image;
+}
+
+// Bounds-checks every offset so a truncated or corrupt image is rejected, never read past
+static bool lock_image_valid(const unsigned char* image, size_t size, uint64_t text_hash) {
+    if (size < sizeof(LockImageHeader)) return false;
+    const LockImageHeader* h = (const LockImageHeader*)image;
+    
+    if (memcmp(h->magic, LOCK_IMAGE_MAGIC, sizeof(h->magic)) != 0) return false;
+    if (h->format_version != CPM_LOCKFILE_FORMAT_VERSION || h->size != size) return false;
+    if (h->text_hash != text_hash) return false;
+    
+    uint64_t n = h->package_count;
+    if (h->records_offset + n * sizeof(LockImageRecord) > size) return false;
+    if (h->edges_offset + (uint64_t)h->edge_count * sizeof(uint32_t) > size) return false;
+    if (h->order_offset + n * sizeof(uint32_t) > size) return false;
+    if (h->levels_offset + ((uint64_t)h->level_count + 1) * sizeof(uint32_t) > size) return false;
+    if (h->specs_offset + (uint64_t)h->spec_count * sizeof(uint32_t) > size) return false;
+    if ((uint64_t)h->strings_offset + h->strings_size > size || h->strings_size == 0) return false;
+    if ((h->records_offset | h->edges_offset | h->order_offset | h->levels_offset | h->specs_offset) & 3) return false;
+    if (image[h->strings_offset + h->strings_size - 1] != '\0') return false;
+    
+    if (lock_hash(image + sizeof(LockImageHeader), size - sizeof(LockImageHeader), LOCK_HASH_SEED) != h->checksum) {
+        return false;
+    }
+    
+    const LockImageRecord* records = (const LockImageRecord*)(image + h->records_offset);
+    const uint32_t* edges = (const uint32_t*)(image + h->edges_offset);
+    const uint32_t* order = (const uint32_t*)(image + h->order_offset);
+    const uint32_t* levels = (const uint32_t*)(image + h->levels_offset);
+    const uint32_t* specs = (const uint32_t*)(image + h->specs_offset);
+    
+    for (uint64_t i = 0; i < n; i++) {
+        const LockImageRecord* r = &records[i];
+        if (r->name >= h->strings_size || r->version >= h->strings_size ||
+            r->resolved >= h->strings_size || r->integrity >= h->strings_size) return false;
+        if ((uint64_t)r->edge_first + r->edge_count > h->edge_count) return false;
+        if (order[i] >= n) return false;
+    }
+    for (uint32_t e = 0; e < h->edge_count; e++) {
+        if (edges[e] >= n) return false;
+    }
+    for (uint32_t l = 0; l <= h->level_count; l++) {
+        if (levels[l] > n || (l > 0 && levels[l] < levels[l - 1])) return false;
+    }
+    for (uint32_t d = 0; d < h->spec_count; d++) {
+        if (specs[d] >= h->strings_size) return false;
+    }
+    return h->root_name < h->strings_size && (uint64_t)h->root_edge_first + h->root_edge_count <= h->edge_count;
+}
+
+static CPM_Lockfile* lock_from_image(unsigned char* image, size_t size, bool mapped) {
+    CPM_Lockfile* lock = calloc(1, sizeof(CPM_Lockfile));
+    if (!lock) return NULL;
+    
+    lock->image = image;
+    lock->size = size;
+    lock->mapped = mapped;
+    lock->header = (const LockImageHeader*)image;
+    lock->records = (const LockImageRecord*)(image + lock->header->records_offset);
+    lock->edges = (const uint32_t*)(image + lock->header->edges_offset);
+    lock->order = (const uint32_t*)(image + lock->header->order_offset);
+    lock->levels = (const uint32_t*)(image + lock->header->levels_offset);
+    lock->specs = (const uint32_t*)(image + lock->header->specs_offset);
+    lock->strings = (const char*)(image + lock->header->strings_offset);
+    return lock;
+}
+
+// --- File Helpers ---
+static char* lock_read_file(const char* path, size_t* size) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return NULL;
+    
+    char* data = NULL;
+    if (fseek(f, 0, SEEK_END) == 0) {
+        long length = ftell(f);
+        if (length >= 0 && fseek(f, 0, SEEK_SET) == 0) {
+            data = malloc((size_t)length + 1);
+            if (data && fread(data, 1, (size_t)length, f) == (size_t)length) {
+                data[length] = '\0';
+                *size = (size_t)length;
+            } else {
+                free(data);
+                data = NULL;
+            }
+        }
+    }
+    fclose(f);
+    return data;
+}
+
+// Writes through a temporary file and renames it into place, so readers see old or new, never half
+static bool lock_write_atomic(const char* path, const void* data, size_t size) {
+    char tmp_path[4096];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp.%d", path, (int)getpid());
+    
+    FILE* f = fopen(tmp_path, "wb");
+    if (!f) return false;
+    bool ok = fwrite(data, 1, size, f) == size;
+    ok = fflush(f) == 0 && ok;
+    ok = fsync(fileno(f)) == 0 && ok;
+    ok = fclose(f) == 0 && ok;
+    
+    if (!ok || rename(tmp_path, path) != 0) {
+        unlink(tmp_path);
+        return false;
+    }
+    return true;
+}
+
+static char* lock_render_text(const LockModel* model, size_t* size) {
+    char* text = NULL;
+    FILE* f = open_memstream(&text, size);
+    if (!f) return NULL;
+    
+    bool ok = lock_write_text(model, f);
+    fclose(f);
+    if (!ok) {
+        free(text);
+        return NULL;
+    }
+    return text;
+}
+
+// --- Writing ---
+CPM_Result cpm_lockfile_write(const DepResolution* resolution, const Package* root_package,
+                              const char* lock_path, const char* binary_path) {
+    if (!resolution || !root_package || !lock_path) return CPM_RESULT_ERROR_INVALID_ARGS;
+    if (resolution->conflict_count > 0) return CPM_RESULT_ERROR_DEPENDENCY_RESOLUTION;
+    if (cpm_resolution_is_mocked(resolution)) {
+        // Pinning stand-in versions would keep them long after the registry is back
+        printf("[CPM Lock] Not writing %s: some packages were resolved without the registry\n", lock_path);
+        return CPM_RESULT_ERROR_NETWORK;
+    }
+    
+    LockModel model;
+    if (!lock_model_from_resolution(&model, resolution, root_package)) {
+        lock_model_free(&model);
+        return CPM_RESULT_ERROR_MEMORY_ALLOCATION;
+    }
+    
+    size_t text_size = 0;
+    char* text = lock_render_text(&model, &text_size);
+    if (!text || !lock_write_atomic(lock_path, text, text_size)) {
+        free(text);
+        lock_model_free(&model);
+        return CPM_RESULT_ERROR_FILE_OPERATION;
+    }
+    
+    if (binary_path) {
+        size_t image_size = 0;
+        unsigned char* image = lock_build_image(&model, lock_hash(text, text_size, LOCK_HASH_SEED), &image_size);
+        if (!image || !lock_write_atomic(binary_path, image, image_size)) {
+            // The text lock is what matters; the image is rebuilt on next load
+            printf("[CPM Lock] Warning: could not write %s\n", binary_path);
+        }
+        free(image);
+    }
+    
+    printf("[CPM Lock] Wrote %s (%zu packages)\n", lock_path, model.package_count);
+    free(text);
+    lock_model_free(&model);
+    return CPM_RESULT_SUCCESS;
+}
+
+// --- Loading ---
+CPM_Lockfile* cpm_lockfile_load(const char* lock_path, const char* binary_path) {
+    if (!lock_path) return NULL;
+    
+    size_t text_size = 0;
+    char* text = lock_read_file(lock_path, &text_size);
+    if (!text) return NULL;
+    uint64_t text_hash = lock_hash(text, text_size, LOCK_HASH_SEED);
+    
+    // Fast path: the image built from exactly this cpm.lock
+    int fd = binary_path ? open(binary_path, O_RDONLY | O_CLOEXEC) : -1;
+    if (fd >= 0) {
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(LockImageHeader)) {
+            void* map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (map != MAP_FAILED) {
+                if (lock_image_valid(map, (size_t)st.st_size, text_hash)) {
+                    close(fd);
+                    free(text);
+                    CPM_Lockfile* lock = lock_from_image(map, (size_t)st.st_size, true);
+                    if (!lock) munmap(map, (size_t)st.st_size);
+                    return lock;
+                }
+                munmap(map, (size_t)st.st_size);
+            }
+        }
+        close(fd);
+    }
+    
+    // Slow path: parse the text and refresh the image for next time
+    LockModel model;
+    if (!lock_parse_text(&model, text)) {
+        printf("[CPM Lock] Could not parse %s\n", lock_path);
+        lock_model_free(&model);
+        free(text);
+        return NULL;
+    }
+    free(text);
+    
+    size_t image_size = 0;
+    unsigned char* image = lock_build_image(&model, text_hash, &image_size);
+    lock_model_free(&model);
+    if (!image) return NULL;
+    
+    if (binary_path) lock_write_atomic(binary_path, image, image_size);
+    
+    CPM_Lockfile* lock = lock_from_image(image, image_size, false);
+    if (!lock) free(image);
+    return lock;
+}
+
+void cpm_lockfile_close(CPM_Lockfile* lock) {
+    if (!lock) return;
+    
+    if (lock->mapped) {
+        munmap(lock->image, lock->size);
+    } else {
+        free(lock->image);
+    }
+    free(lock);
+}
+
+bool cpm_lockfile_matches(const CPM_Lockfile* lock, const Package* package) {
+    return lock && package && lock->header->spec_hash == cpm_lockfile_spec_hash(package);
+}
+
+// --- Queries ---
+size_t cpm_lockfile_package_count(const CPM_Lockfile* lock) {
+    return lock ? lock->header->package_count : 0;
+}
+
+bool cpm_lockfile_entry(const CPM_Lockfile* lock, size_t index, CPM_LockEntry* entry) {
+    if (!lock || !entry || index >= lock->header->package_count) return false;
+    
+    const LockImageRecord* record = &lock->records[index];
+    entry->name = lock->strings + record->name;
+    entry->version = lock->strings + record->version;
+    entry->resolved = lock->strings + record->resolved;
+    entry->integrity = lock->strings + record->integrity;
+    entry->level = record->level;
+    entry->dependencies = lock->edges + record->edge_first;
+    entry->dependency_count = record->edge_count;
+    return true;
+}
+
+bool cpm_lockfile_find(const CPM_Lockfile* lock, const char* name, CPM_LockEntry* entry) {
+    if (!lock || !name) return false;
+    
+    size_t low = 0;
+    size_t high = lock->header->package_count;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        int cmp = strcmp(lock->strings + lock->records[mid].name, name);
+        if (cmp == 0) return cpm_lockfile_entry(lock, mid, entry);
+        if (cmp < 0) low = mid + 1;
+        else high = mid;
+    }
+    return false;
+}
+
+DepResolution* cpm_lockfile_to_resolution(const CPM_Lockfile* lock) {
+    if (!lock) return NULL;
+    
+    size_t n = lock->header->package_count;
+    DepResolution* resolution = calloc(1, sizeof(DepResolution));
+    if (!resolution) return NULL;
+    
+    resolution->nodes = calloc(n + 1, sizeof(DepNode*));
+    resolution->install_order = malloc((n ? n : 1) * sizeof(DepNode*));
+    resolution->level_offsets = malloc(((size_t)lock->header->level_count + 1) * sizeof(size_t));
+    resolution->root = cpm_depnode_create(lock->strings + lock->header->root_name, NULL);
+    if (!resolution->nodes || !resolution->install_order || !resolution->level_offsets || !resolution->root) {
+        cpm_depnode_free(resolution->root);
+        resolution->root = NULL;
+        cpm_resolution_free(resolution);
+        return NULL;
+    }
+    resolution->nodes[resolution->node_count++] = resolution->root;
+    
+    // Node i + 1 is lock package i
+    for (size_t i = 0; i < n; i++) {
+        CPM_LockEntry entry;
+        cpm_lockfile_entry(lock, i, &entry);
+        
+        SemVer* version = semver_parse(entry.version);
+        DepNode* node = cpm_depnode_create(entry.name, version);
+        semver_free(version);
+        if (!node) {
+            cpm_resolution_free(resolution);
+            return NULL;
+        }
+        node->resolved_url = entry.resolved[0] ? strdup(entry.resolved) : NULL;
+        node->integrity = entry.integrity[0] ? strdup(entry.integrity) : NULL;
+        node->level = (int)entry.level;
+        node->graph_index = resolution->node_count;
+        resolution->nodes[resolution->node_count++] = node;
+    }
+    
+    for (size_t i = 0; i < n; i++) {
+        const LockImageRecord* record = &lock->records[i];
+        for (uint32_t e = 0; e < record->edge_count; e++) {
+            cpm_depnode_add_child(resolution->nodes[i + 1], resolution->nodes[lock->edges[record->edge_first + e] + 1]);
+        }
+    }
+    for (uint32_t e = 0; e < lock->header->root_edge_count; e++) {
+        cpm_depnode_add_child(resolution->root, resolution->nodes[lock->edges[lock->header->root_edge_first + e] + 1]);
+    }
+    resolution->root->level = (int)lock->header->level_count;
+    
+    // The spec the lock was written for, so a changed spec can be diffed against it
+    for (uint32_t d = 0; d < lock->header->spec_count; d++) {
+        Dependency* dep = cpm_dependency_parse_spec(lock->strings + lock->specs[d]);
+        if (!dep) continue;
+        Dependency** tail = &resolution->root->dependencies;
+        while (*tail) tail = &(*tail)->next;
+        *tail = dep;
+    }
+    
+    for (size_t i = 0; i < n; i++) {
+        resolution->install_order[resolution->install_count++] = resolution->nodes[lock->order[i] + 1];
+    }
+    for (uint32_t l = 0; l <= lock->header->level_count; l++) {
+        resolution->level_offsets[l] = lock->levels[l];
+    }
+    resolution->level_count = lock->header->level_count;
+    return resolution;
+}
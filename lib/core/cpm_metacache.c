@@ -0,0 +1,146 @@
+/*
+ * File: lib/core/cpm_metacache.c
+ * Description: On-disk cache of registry metadata for CPM.
+ * Each entry is a single file: a "CPMMETA1 <etag>" header line followed by the
+ * response body. Writes go through a temporary file and rename() so readers in
+ * other cpm processes never see a partial document.
+ * Author: Dr. Q Josef Kurk Edwards
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "cpm_metacache.h"
+
+#define METACACHE_MAGIC "CPMMETA1"
+
+// --- Internal Helper Functions ---
+static void sanitize_component(char* out, size_t out_size, const char* in) {
+    size_t i = 0;
+    for (; in[i] && i < out_size - 1; i++) {
+        char c = in[i];
+        bool ok = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+                  (c >= '0' && c <= '9') || c == '.' || c == '-' || c == '_' || c == '+';
+        out[i] = ok ? c : '_';
+    }
+    out[i] = '\0';
+    // Never produce "." or ".." as a path component
+    if (strcmp(out, ".") == 0 || strcmp(out, "..") == 0) out[0] = '_';
+}
+
+static bool make_parent_directories(const char* path) {
+    char* copy = strdup(path);
+    if (!copy) return false;
+
+    for (char* p = copy + 1; *p; p++) {
+        if (*p != '/') continue;
+        *p = '\0';
+        if (mkdir(copy, 0755) != 0 && errno != EEXIST) {
+            free(copy);
+            return false;
+        }
+        *p = '/';
+    }
+
+    free(copy);
+    return true;
+}
+
+// --- Cache Paths ---
+char* cpm_metacache_path(const char* cache_dir, const char* package_name, const char* document) {
+    if (!cache_dir || !package_name || !document) return NULL;
+
+    char safe_name[256];
+    char safe_document[128];
+    sanitize_component(safe_name, sizeof(safe_name), package_name);
+    sanitize_component(safe_document, sizeof(safe_document), document);
+
+    size_t len = strlen(cache_dir) + strlen(safe_name) + strlen(safe_document) + 32;
+    char* path = malloc(len);
+    if (path) snprintf(path, len, "%s/metadata/%s/%s.json", cache_dir, safe_name, safe_document);
+    return path;
+}
+
+// --- Cache Access ---
+bool cpm_metacache_load(const char* path, char** body, char** etag, time_t* fetched_at) {
+    *body = NULL;
+    *etag = NULL;
+    if (!path) return false;
+
+    FILE* f = fopen(path, "rb");
+    if (!f) return false;
+
+    struct stat st;
+    if (fstat(fileno(f), &st) != 0) {
+        fclose(f);
+        return false;
+    }
+    if (fetched_at) *fetched_at = st.st_mtime;
+
+    char* data = malloc((size_t)st.st_size + 1);
+    if (!data) {
+        fclose(f);
+        return false;
+    }
+    size_t n = fread(data, 1, (size_t)st.st_size, f);
+    fclose(f);
+    data[n] = '\0';
+
+    char* newline = strchr(data, '\n');
+    size_t magic_len = strlen(METACACHE_MAGIC);
+    if (!newline || strncmp(data, METACACHE_MAGIC, magic_len) != 0) {
+        free(data);
+        return false;
+    }
+
+    *newline = '\0';
+    const char* tag = data + magic_len;
+    while (*tag == ' ') tag++;
+    if (*tag) *etag = strdup(tag);
+
+    *body = strdup(newline + 1);
+    free(data);
+
+    if (!*body) {
+        free(*etag);
+        *etag = NULL;
+        return false;
+    }
+    return true;
+}
+
+bool cpm_metacache_store(const char* path, const char* body, const char* etag) {
+    if (!path || !body) return false;
+    if (!make_parent_directories(path)) return false;
+
+    size_t tmp_len = strlen(path) + 32;
+    char* tmp_path = malloc(tmp_len);
+    if (!tmp_path) return false;
+    snprintf(tmp_path, tmp_len, "%s.%d.tmp", path, (int)getpid());
+
+    FILE* f = fopen(tmp_path, "wb");
+    if (!f) {
+        free(tmp_path);
+        return false;
+    }
+
+    // ETags are quoted tokens and never contain newlines
+    bool ok = fprintf(f, "%s %s\n", METACACHE_MAGIC, etag ? etag : "") > 0 &&
+              fputs(body, f) >= 0;
+    ok = (fclose(f) == 0) && ok;
+
+    if (ok && rename(tmp_path, path) != 0) ok = false;
+    if (!ok) unlink(tmp_path);
+
+    free(tmp_path);
+    return ok;
+}
+
+void cpm_metacache_touch(const char* path) {
+    if (path) utimensat(AT_FDCWD, path, NULL, 0);
+}
@@ -9,221 +9,290 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <unistd.h>
 #include "cpm_package.h"
+#include "cpm_json.h"
 #include "cpm_promise.h"
 #include "cpm_pmll.h"
 
-// --- Package Creation and Destruction ---
-Package* cpm_create_package(void) {
-    Package* pkg = (Package*)malloc(sizeof(Package));
+// --- Package Storage ---
+// A Package is one allocation: the struct, then pointer slots for its
+// dependencies and scripts, then the bytes its strings live in. Teardown is
+// one free.
+static Package* package_allocate(size_t slot_count, size_t text_size, char** text) {
+    Package* pkg = (Package*)malloc(sizeof(Package) + slot_count * sizeof(char*) + text_size);
     if (!pkg) {
         return NULL;
     }
     
     memset(pkg, 0, sizeof(Package));
+    *text = (char*)((char**)(pkg + 1) + slot_count);
     return pkg;
 }
 
 void cpm_free_package(Package* pkg) {
-    if (!pkg) return;
-    
-    free(pkg->name);
-    free(pkg->version);
-    free(pkg->description);
-    free(pkg->author);
-    free(pkg->license);
-    
-    // Free dependencies
-    for (size_t i = 0; i < pkg->dep_count; i++) {
-        free(pkg->dependencies[i]);
-    }
-    free(pkg->dependencies);
-    
-    // Free scripts
-    for (size_t i = 0; i < pkg->script_count; i++) {
-        free(pkg->scripts[i]);
-    }
-    free(pkg->scripts);
-    
-    free(pkg->build_command);
-    free(pkg->install_command);
-    free(pkg->test_command);
     free(pkg);
 }
 
-// --- Simple JSON-like Parser for cpm_package.spec ---
-// This is a simplified parser - in a real implementation, you'd use a proper JSON library
+// --- Spec Field Helpers ---
+// Positions reader just past the value of the first "key" member at any
+// depth, leaving that value in token; false if there is none
+static bool find_key_value(CPM_JsonReader* reader, const char* key, CPM_JsonToken* token) {
+    while (cpm_json_next(reader, token)) {
+        if (token->type == CPM_JSON_KEY && cpm_json_string_equals(token, key)) {
+            return cpm_json_next(reader, token);
+        }
+    }
+    return false;
+}
 
 char* extract_json_string_value(const char* json, const char* key) {
-    char search_pattern[256];
-    snprintf(search_pattern, sizeof(search_pattern), "\"%s\":", key);
-    
-    char* key_pos = strstr(json, search_pattern);
-    if (!key_pos) {
-        return NULL;
-    }
-    
-    // Move to after the key
-    key_pos += strlen(search_pattern);
+    CPM_JsonReader reader;
+    CPM_JsonToken token;
+    cpm_json_reader_init(&reader, json, strlen(json));
     
-    // Skip whitespace
-    while (*key_pos == ' ' || *key_pos == '\t' || *key_pos == '\n') {
-        key_pos++;
-    }
-    
-    // Expect opening quote
-    if (*key_pos != '"') {
+    if (!find_key_value(&reader, key, &token) || token.type != CPM_JSON_STRING) {
         return NULL;
     }
-    key_pos++; // Skip opening quote
-    
-    // Find closing quote
-    char* end_pos = strchr(key_pos, '"');
-    if (!end_pos) {
-        return NULL;
+    return cpm_json_string_dup(&token);
+}
+
+static bool string_list_append(char*** values, size_t* count, size_t* capacity, char* value) {
+    if (!value) return false;
+    if (*count == *capacity) {
+        size_t grown_capacity = *capacity ? *capacity * 2 : 4;
+        char** grown = (char**)realloc(*values, grown_capacity * sizeof(char*));
+        if (!grown) {
+            free(value);
+            return false;
+        }
+        *values = grown;
+        *capacity = grown_capacity;
     }
+    (*values)[(*count)++] = value;
+    return true;
+}
+
+// Reads the array whose start is in open as a list of string copies;
+// elements that are not strings are skipped. NULL when the list is empty.
+static char** read_string_list(CPM_JsonReader* reader, const CPM_JsonToken* open, size_t* count) {
+    char** values = NULL;
+    size_t capacity = 0;
+    CPM_JsonToken token;
+    *count = 0;
     
-    // Extract value
-    size_t value_len = end_pos - key_pos;
-    char* value = (char*)malloc(value_len + 1);
-    if (!value) {
-        return NULL;
+    while (cpm_json_next(reader, &token) && token.depth > open->depth) {
+        if (token.type != CPM_JSON_STRING) {
+            cpm_json_skip(reader, &token);
+            continue;
+        }
+        if (!string_list_append(&values, count, &capacity, cpm_json_string_dup(&token))) break;
     }
     
-    strncpy(value, key_pos, value_len);
-    value[value_len] = '\0';
-    
-    return value;
+    return values;
 }
 
 char** extract_json_array_values(const char* json, const char* key, size_t* count) {
+    CPM_JsonReader reader;
+    CPM_JsonToken token;
     *count = 0;
+    cpm_json_reader_init(&reader, json, strlen(json));
     
-    char search_pattern[256];
-    snprintf(search_pattern, sizeof(search_pattern), "\"%s\":", key);
-    
-    char* key_pos = strstr(json, search_pattern);
-    if (!key_pos) {
+    if (!find_key_value(&reader, key, &token) || token.type != CPM_JSON_ARRAY_START) {
         return NULL;
     }
-    
-    // Move to after the key
-    key_pos += strlen(search_pattern);
-    
-    // Skip whitespace
-    while (*key_pos == ' ' || *key_pos == '\t' || *key_pos == '\n') {
-        key_pos++;
-    }
-    
-    // Expect opening bracket
-    if (*key_pos != '[') {
-        return NULL;
+    return read_string_list(&reader, &token, count);
+}
+
+// --- cpm_package.spec Parsing ---
+// Spec members kept as strings
+static char** package_string_member(Package* pkg, const CPM_JsonToken* key) {
+    if (cpm_json_string_equals(key, "name")) return &pkg->name;
+    if (cpm_json_string_equals(key, "version")) return &pkg->version;
+    if (cpm_json_string_equals(key, "description")) return &pkg->description;
+    if (cpm_json_string_equals(key, "author")) return &pkg->author;
+    if (cpm_json_string_equals(key, "license")) return &pkg->license;
+    if (cpm_json_string_equals(key, "build")) return &pkg->build_command;
+    if (cpm_json_string_equals(key, "install")) return &pkg->install_command;
+    if (cpm_json_string_equals(key, "test")) return &pkg->test_command;
+    return NULL;
+}
+
+// Decodes a string token where it lies in the Package's copy of the spec
+static char* spec_string(const CPM_JsonToken* token) {
+    char* value = (char*)token->start;
+    cpm_json_string_decode(token, value);
+    return value;
+}
+
+// Reads the list whose start is in open, decoding it in place: array
+// elements as they are, object members as "<key><separator><value>". Entries
+// go to out[0], out[1], ... or, with step -1, out[0], out[-1], ...
+static size_t spec_list(CPM_JsonReader* reader, const CPM_JsonToken* open, const char* separator, char** out,
+                        ptrdiff_t step) {
+    size_t count = 0;
+    CPM_JsonToken token;
+    CPM_JsonToken key = { 0 };
+    
+    while (cpm_json_next(reader, &token) && token.depth > open->depth) {
+        if (token.type == CPM_JSON_KEY) {
+            key = token;
+            continue;
+        }
+        if (token.type != CPM_JSON_STRING) {
+            cpm_json_skip(reader, &token);
+            continue;
+        }
+        
+        char* entry;
+        if (open->type == CPM_JSON_OBJECT_START) {
+            // At least `":"` lies between the key and the value, room enough
+            // for the separator: the entry is rebuilt over the key
+            entry = (char*)key.start;
+            size_t key_len = cpm_json_string_decode(&key, entry);
+            size_t separator_len = strlen(separator);
+            memcpy(entry + key_len, separator, separator_len);
+            cpm_json_string_decode(&token, entry + key_len + separator_len);
+        } else {
+            entry = spec_string(&token);
+        }
+        out[(ptrdiff_t)count * step] = entry;
+        count++;
     }
-    key_pos++;
     
-    // Find closing bracket
-    char* end_pos = strchr(key_pos, ']');
-    if (!end_pos) {
-        return NULL;
+    return count;
+}
+
+// One pass over the top-level members of the spec text held in pkg's own
+// allocation, decoding strings in place; nested values are skipped whole.
+// Every list entry is a string, so slots (at least the text's string count)
+// hold both lists: dependencies from the front, scripts from the back.
+static bool spec_parse(Package* pkg, char* text, size_t length, char** slots, size_t slot_count) {
+    CPM_JsonReader reader;
+    CPM_JsonToken token;
+    cpm_json_reader_init(&reader, text, length);
+    if (!cpm_json_next(&reader, &token) || token.type != CPM_JSON_OBJECT_START) {
+        return false;
     }
     
-    // Simple array parsing - split by commas and extract quoted strings
-    char** values = NULL;
-    size_t capacity = 0;
-    
-    char* current = key_pos;
-    while (current < end_pos) {
-        // Skip whitespace
-        while (*current == ' ' || *current == '\t' || *current == '\n' || *current == ',') {
-            current++;
-        }
-        
-        if (current >= end_pos || *current != '"') {
-            break;
-        }
+    while (cpm_json_next(&reader, &token) && token.type == CPM_JSON_KEY) {
+        CPM_JsonToken key = token;
+        if (!cpm_json_next(&reader, &token)) break;
+        bool is_list = token.type == CPM_JSON_ARRAY_START || token.type == CPM_JSON_OBJECT_START;
         
-        current++; // Skip opening quote
-        char* value_end = strchr(current, '"');
-        if (!value_end || value_end > end_pos) {
-            break;
+        char** field = package_string_member(pkg, &key);
+        if (field && token.type == CPM_JSON_STRING) {
+            *field = spec_string(&token);
+        } else if (is_list && cpm_json_string_equals(&key, "dependencies")) {
+            // ["name@constraint", ...] or {"name": "constraint", ...}
+            pkg->dep_count = spec_list(&reader, &token, "@", slots, 1);
+        } else if (is_list && cpm_json_string_equals(&key, "scripts")) {
+            // ["name: command", ...] or {"name": "command", ...}
+            pkg->script_count = spec_list(&reader, &token, ": ", slots + slot_count - 1, -1);
+        } else {
+            cpm_json_skip(&reader, &token);
         }
-        
-        // Extract value
-        size_t value_len = value_end - current;
-        char* value = (char*)malloc(value_len + 1);
-        if (!value) {
-            break;
+    }
+    if (token.type != CPM_JSON_OBJECT_END || cpm_json_next(&reader, &token) || token.type != CPM_JSON_END) {
+        return false;
+    }
+    
+    pkg->dependencies = pkg->dep_count ? slots : NULL;
+    pkg->scripts = NULL;
+    if (pkg->script_count) {
+        // Scripts were filled backwards from the last slot
+        pkg->scripts = slots + slot_count - pkg->script_count;
+        for (size_t i = 0, j = pkg->script_count - 1; i < j; i++, j--) {
+            char* entry = pkg->scripts[i];
+            pkg->scripts[i] = pkg->scripts[j];
+            pkg->scripts[j] = entry;
         }
-        
-        strncpy(value, current, value_len);
-        value[value_len] = '\0';
-        
-        // Add to array
-        if (*count >= capacity) {
-            capacity = capacity == 0 ? 4 : capacity * 2;
-            values = (char**)realloc(values, capacity * sizeof(char*));
-            if (!values) {
-                free(value);
-                break;
-            }
+    }
+    return true;
+}
+
+// Command of the "name: command" script entry called name, or NULL
+static char* package_script_command(const Package* pkg, const char* name) {
+    size_t name_len = strlen(name);
+    for (size_t i = 0; i < pkg->script_count; i++) {
+        char* entry = pkg->scripts[i];
+        if (strncmp(entry, name, name_len) == 0 && entry[name_len] == ':') {
+            char* command = entry + name_len + 1;
+            while (*command == ' ') command++;
+            return command;
         }
-        
-        values[*count] = value;
-        (*count)++;
-        
-        current = value_end + 1;
     }
-    
-    return values;
+    return NULL;
 }
 
-Package* cpm_parse_package_file(const char* filepath) {
-    FILE* fp = fopen(filepath, "r");
-    if (!fp) {
-        printf("[CPM] Could not open package file: %s\n", filepath);
+Package* cpm_parse_package_spec(const char* content, size_t length) {
+    size_t slot_count = cpm_json_string_bound(content, length);
+    char* text;
+    Package* pkg = package_allocate(slot_count, length + 1, &text);
+    if (!pkg) {
         return NULL;
     }
+    memcpy(text, content, length);
+    text[length] = '\0';
     
-    // Read entire file
-    fseek(fp, 0, SEEK_END);
-    long file_size = ftell(fp);
-    fseek(fp, 0, SEEK_SET);
-    
-    char* content = (char*)malloc(file_size + 1);
-    if (!content) {
-        fclose(fp);
+    if (!spec_parse(pkg, text, length, (char**)(pkg + 1), slot_count)) {
+        cpm_free_package(pkg);
         return NULL;
     }
     
-    fread(content, 1, file_size, fp);
-    content[file_size] = '\0';
-    fclose(fp);
+    // Build, install and test commands may be given as scripts instead
+    if (!pkg->build_command) pkg->build_command = package_script_command(pkg, "build");
+    if (!pkg->install_command) pkg->install_command = package_script_command(pkg, "install");
+    if (!pkg->test_command) pkg->test_command = package_script_command(pkg, "test");
     
-    Package* pkg = cpm_create_package();
-    if (!pkg) {
-        free(content);
+    return pkg;
+}
+
+// The spec is read straight from the page cache into the Package's own copy
+static Package* package_parse_fd(int fd) {
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
         return NULL;
     }
     
-    // Parse JSON-like content
-    pkg->name = extract_json_string_value(content, "name");
-    pkg->version = extract_json_string_value(content, "version");
-    pkg->description = extract_json_string_value(content, "description");
-    pkg->author = extract_json_string_value(content, "author");
-    pkg->license = extract_json_string_value(content, "license");
-    pkg->build_command = extract_json_string_value(content, "build");
-    pkg->install_command = extract_json_string_value(content, "install");
-    pkg->test_command = extract_json_string_value(content, "test");
+    size_t length = (size_t)st.st_size;
+    void* map = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+        return NULL;
+    }
     
-    // Parse dependencies array
-    pkg->dependencies = extract_json_array_values(content, "dependencies", &pkg->dep_count);
+    Package* pkg = cpm_parse_package_spec(map, length);
+    munmap(map, length);
+    return pkg;
+}
+
+Package* cpm_read_package_spec(const char* filepath) {
+    int fd = open(filepath, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return NULL;
+    }
     
-    // Parse scripts array
-    pkg->scripts = extract_json_array_values(content, "scripts", &pkg->script_count);
+    Package* pkg = package_parse_fd(fd);
+    close(fd);
+    return pkg;
+}
+
+Package* cpm_parse_package_file(const char* filepath) {
+    int fd = open(filepath, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        printf("[CPM] Could not open package file: %s\n", filepath);
+        return NULL;
+    }
     
-    free(content);
+    Package* pkg = package_parse_fd(fd);
+    close(fd);
+    if (!pkg) {
+        printf("[CPM] Malformed package file: %s\n", filepath);
+        return NULL;
+    }
     
     printf("[CPM] Parsed package: %s@%s\n", 
            pkg->name ? pkg->name : "unknown", 
@@ -327,6 +396,12 @@ bool cpm_package_spec_exists(const char* directory) {
     return (stat(spec_path, &st) == 0);
 }
 
+bool cpm_package_name_is_safe(const char* name) {
+    if (!name || name[0] == '\0') return false;
+    if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) return false;
+    return strchr(name, '/') == NULL;
+}
+
 // --- Asynchronous Package Operations ---
 typedef struct {
     Package* pkg;
@@ -346,6 +421,7 @@ PromiseValue package_install_operation(PromiseValue prev_result, void* user_data
     
     if (mkdir(pkg_dir, 0755) == -1) {
         char* error = strdup("Failed to create package directory");
+        pmll_operation_fail(error);
         promise_defer_reject(data->deferred, error);
         free(data->install_dir);
         free(data);
@@ -358,6 +434,7 @@ PromiseValue package_install_operation(PromiseValue prev_result, void* user_data
     
     if (cpm_save_package_file(data->pkg, spec_path) != CPM_RESULT_SUCCESS) {
         char* error = strdup("Failed to save package spec");
+        pmll_operation_fail(error);
         promise_defer_reject(data->deferred, error);
         free(data->install_dir);
         free(data);
@@ -372,7 +449,8 @@ PromiseValue package_install_operation(PromiseValue prev_result, void* user_data
         int result = system(install_cmd);
         if (result != 0) {
             char* error = strdup("Package install command failed");
-            promise_defer_reject(data->deferred, error);
+            pmll_operation_fail(error);
+        promise_defer_reject(data->deferred, error);
             free(data->install_dir);
             free(data);
             return error;
@@ -429,28 +507,35 @@ Package* cpm_package_resolve_remote(const char* package_spec, const char* regist
     printf("[CPM] Resolving package: %s from registry: %s\n", package_spec, registry_url);
     
     // Mock implementation - in real system would make HTTP requests
-    Package* pkg = cpm_create_package();
-    if (!pkg) return NULL;
+    static const char description[] = "Mock package from remote registry";
+    static const char author[] = "Unknown Author";
+    static const char license[] = "MIT";
     
     // Parse package_spec (name@version format)
-    char* at_pos = strchr(package_spec, '@');
-    if (at_pos) {
-        size_t name_len = at_pos - package_spec;
-        pkg->name = (char*)malloc(name_len + 1);
-        if (pkg->name) {
-            strncpy(pkg->name, package_spec, name_len);
-            pkg->name[name_len] = '\0';
-        }
-        pkg->version = strdup(at_pos + 1);
-    } else {
-        pkg->name = strdup(package_spec);
-        pkg->version = strdup("latest");
-    }
+    const char* at_pos = strchr(package_spec, '@');
+    size_t name_len = at_pos ? (size_t)(at_pos - package_spec) : strlen(package_spec);
+    const char* version = at_pos ? at_pos + 1 : "latest";
+    size_t version_len = strlen(version);
+    
+    char* text;
+    size_t text_size = name_len + 1 + version_len + 1 + sizeof(description) + sizeof(author) + sizeof(license);
+    Package* pkg = package_allocate(0, text_size, &text);
+    if (!pkg) return NULL;
+    
+    pkg->name = text;
+    memcpy(text, package_spec, name_len);
+    text += name_len;
+    *text++ = '\0';
+    pkg->version = text;
+    memcpy(text, version, version_len + 1);
+    text += version_len + 1;
     
     // Mock metadata
-    pkg->description = strdup("Mock package from remote registry");
-    pkg->author = strdup("Unknown Author");
-    pkg->license = strdup("MIT");
+    pkg->description = memcpy(text, description, sizeof(description));
+    text += sizeof(description);
+    pkg->author = memcpy(text, author, sizeof(author));
+    text += sizeof(author);
+    pkg->license = memcpy(text, license, sizeof(license));
     
     return pkg;
 }
@@ -473,7 +558,8 @@ PromiseValue package_build_operation(PromiseValue prev_result, void* user_data)
         int result = system(build_cmd);
         if (result != 0) {
             char* error = strdup("Package build command failed");
-            promise_defer_reject(data->deferred, error);
+            pmll_operation_fail(error);
+        promise_defer_reject(data->deferred, error);
             free(data->package_dir);
             free(data);
             return error;
@@ -0,0 +1,297 @@
+/*
+ * File: lib/core/cpm_pipeline.c
+ * Description: Staged work pipeline for CPM.
+ * One mutex guards the whole schedule; each stage has a ring queue, a condition
+ * variable and its worker threads. A finished item is handed to the next stage
+ * (or parked until its prerequisites catch up), so the stages run concurrently
+ * and throughput is bounded by the slowest one rather than their sum.
+ * Author: Dr. Q Josef Kurk Edwards
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include "cpm_pipeline.h"
+
+typedef struct {
+    size_t* dependents;         // Items that list this one as a prerequisite
+    size_t dependent_count;
+    size_t dependent_capacity;
+    size_t waiting[CPM_PIPELINE_MAX_STAGES];    // Prerequisites yet to complete each ordered stage
+    size_t stage;               // Stage the item is queued for, running or parked at
+    bool parked;                // Done with the previous stage, blocked on prerequisites
+} PipelineItem;
+
+typedef struct {
+    size_t* ring;               // Capacity item_count: an item is queued at most once
+    size_t head;
+    size_t count;
+    pthread_cond_t ready;
+} PipelineQueue;
+
+typedef struct {
+    CPM_Pipeline* pipeline;
+    size_t stage;
+} PipelineWorker;
+
+struct CPM_Pipeline {
+    CPM_PipelineStage stages[CPM_PIPELINE_MAX_STAGES];
+    size_t stage_count;
+    PipelineItem* items;
+    size_t item_count;
+    void* context;
+    
+    pthread_mutex_t lock;
+    pthread_cond_t finished;
+    PipelineQueue queues[CPM_PIPELINE_MAX_STAGES];
+    size_t running;             // Items inside a stage function right now
+    size_t done_count;          // Items through every stage
+    bool stopping;
+    bool failed;
+    CPM_Result result;
+    CPM_PipelineStats stats;
+};
+
+static uint64_t pipeline_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// --- Pipeline Lifecycle ---
+CPM_Pipeline* cpm_pipeline_create(const CPM_PipelineStage* stages, size_t stage_count,
+                                  size_t item_count, void* context) {
+    if (!stages || stage_count == 0 || stage_count > CPM_PIPELINE_MAX_STAGES) return NULL;
+    
+    CPM_Pipeline* pipeline = calloc(1, sizeof(CPM_Pipeline));
+    if (!pipeline) return NULL;
+    
+    memcpy(pipeline->stages, stages, stage_count * sizeof(CPM_PipelineStage));
+    pipeline->stage_count = stage_count;
+    pipeline->item_count = item_count;
+    pipeline->context = context;
+    pipeline->items = calloc(item_count ? item_count : 1, sizeof(PipelineItem));
+    
+    bool ok = pipeline->items != NULL;
+    for (size_t s = 0; s < stage_count; s++) {
+        if (pipeline->stages[s].workers == 0) pipeline->stages[s].workers = 1;
+        pipeline->queues[s].ring = malloc((item_count ? item_count : 1) * sizeof(size_t));
+        ok = ok && pipeline->queues[s].ring && pipeline->stages[s].run;
+        pthread_cond_init(&pipeline->queues[s].ready, NULL);
+    }
+    pthread_mutex_init(&pipeline->lock, NULL);
+    pthread_cond_init(&pipeline->finished, NULL);
+    
+    if (!ok) {
+        cpm_pipeline_free(pipeline);
+        return NULL;
+    }
+    return pipeline;
+}
+
+void cpm_pipeline_free(CPM_Pipeline* pipeline) {
+    if (!pipeline) return;
+    
+    for (size_t i = 0; pipeline->items && i < pipeline->item_count; i++) {
+        free(pipeline->items[i].dependents);
+    }
+    free(pipeline->items);
+    for (size_t s = 0; s < pipeline->stage_count; s++) {
+        free(pipeline->queues[s].ring);
+        pthread_cond_destroy(&pipeline->queues[s].ready);
+    }
+    pthread_mutex_destroy(&pipeline->lock);
+    pthread_cond_destroy(&pipeline->finished);
+    free(pipeline);
+}
+
+CPM_Result cpm_pipeline_add_prerequisite(CPM_Pipeline* pipeline, size_t item, size_t prerequisite) {
+    if (!pipeline || item >= pipeline->item_count || prerequisite >= pipeline->item_count || item == prerequisite) {
+        return CPM_RESULT_ERROR_INVALID_ARGS;
+    }
+    
+    PipelineItem* before = &pipeline->items[prerequisite];
+    if (before->dependent_count == before->dependent_capacity) {
+        size_t capacity = before->dependent_capacity ? before->dependent_capacity * 2 : 4;
+        size_t* grown = realloc(before->dependents, capacity * sizeof(size_t));
+        if (!grown) return CPM_RESULT_ERROR_MEMORY_ALLOCATION;
+        before->dependents = grown;
+        before->dependent_capacity = capacity;
+    }
+    before->dependents[before->dependent_count++] = item;
+    
+    for (size_t s = 0; s < pipeline->stage_count; s++) {
+        if (pipeline->stages[s].ordered) pipeline->items[item].waiting[s]++;
+    }
+    return CPM_RESULT_SUCCESS;
+}
+
+// --- Scheduling (pipeline->lock held) ---
+static void pipeline_push(CPM_Pipeline* pipeline, size_t stage, size_t item) {
+    PipelineQueue* queue = &pipeline->queues[stage];
+    queue->ring[(queue->head + queue->count) % pipeline->item_count] = item;
+    queue->count++;
+    if (queue->count > pipeline->stats.stages[stage].max_queued) {
+        pipeline->stats.stages[stage].max_queued = queue->count;
+    }
+    pthread_cond_signal(&queue->ready);
+}
+
+// Queues the item for its current stage, or parks it behind its prerequisites
+static void pipeline_enter_stage(CPM_Pipeline* pipeline, size_t item) {
+    PipelineItem* entry = &pipeline->items[item];
+    if (pipeline->stages[entry->stage].ordered && entry->waiting[entry->stage] > 0) {
+        entry->parked = true;
+    } else {
+        pipeline_push(pipeline, entry->stage, item);
+    }
+}
+
+static void pipeline_complete_stage(CPM_Pipeline* pipeline, size_t item, size_t stage) {
+    PipelineItem* entry = &pipeline->items[item];
+    
+    if (pipeline->stages[stage].ordered) {
+        for (size_t d = 0; d < entry->dependent_count; d++) {
+            PipelineItem* dependent = &pipeline->items[entry->dependents[d]];
+            if (--dependent->waiting[stage] == 0 && dependent->parked && dependent->stage == stage) {
+                dependent->parked = false;
+                pipeline_push(pipeline, stage, entry->dependents[d]);
+            }
+        }
+    }
+    
+    if (stage + 1 == pipeline->stage_count) {
+        pipeline->done_count++;
+    } else {
+        entry->stage = stage + 1;
+        pipeline_enter_stage(pipeline, item);
+    }
+}
+
+// Once nothing is running and nothing is queued, no more progress is possible:
+// everything is done, the run failed, or the remaining items wait on a cycle.
+static void pipeline_check_finished(CPM_Pipeline* pipeline) {
+    if (pipeline->running > 0) return;
+    for (size_t s = 0; s < pipeline->stage_count; s++) {
+        if (pipeline->queues[s].count > 0) return;
+    }
+    
+    pipeline->stopping = true;
+    for (size_t s = 0; s < pipeline->stage_count; s++) {
+        pthread_cond_broadcast(&pipeline->queues[s].ready);
+    }
+    pthread_cond_broadcast(&pipeline->finished);
+}
+
+// --- Workers ---
+static void* pipeline_worker(void* arg) {
+    PipelineWorker* worker = arg;
+    CPM_Pipeline* pipeline = worker->pipeline;
+    size_t stage = worker->stage;
+    PipelineQueue* queue = &pipeline->queues[stage];
+    
+    pthread_mutex_lock(&pipeline->lock);
+    for (;;) {
+        while (queue->count == 0 && !pipeline->stopping) {
+            pthread_cond_wait(&queue->ready, &pipeline->lock);
+        }
+        if (queue->count == 0) break;
+        
+        size_t item = queue->ring[queue->head];
+        queue->head = (queue->head + 1) % pipeline->item_count;
+        queue->count--;
+        pipeline->running++;
+        pthread_mutex_unlock(&pipeline->lock);
+        
+        uint64_t start = pipeline_now_ns();
+        CPM_Result result = pipeline->stages[stage].run(pipeline->context, item);
+        uint64_t elapsed = pipeline_now_ns() - start;
+        
+        pthread_mutex_lock(&pipeline->lock);
+        pipeline->running--;
+        CPM_PipelineStageStats* stats = &pipeline->stats.stages[stage];
+        stats->busy_ns += elapsed;
+        if (elapsed > stats->max_item_ns) stats->max_item_ns = elapsed;
+        
+        if (result != CPM_RESULT_SUCCESS) {
+            if (!pipeline->failed) {
+                pipeline->failed = true;
+                pipeline->result = result;
+                pipeline->stats.failed_item = item;
+            }
+            // Let in-flight work finish, start nothing new
+            for (size_t s = 0; s < pipeline->stage_count; s++) pipeline->queues[s].count = 0;
+        } else if (!pipeline->failed) {
+            stats->completed++;
+            pipeline_complete_stage(pipeline, item, stage);
+        }
+        pipeline_check_finished(pipeline);
+    }
+    pthread_mutex_unlock(&pipeline->lock);
+    return NULL;
+}
+
+// --- Running ---
+CPM_Result cpm_pipeline_run(CPM_Pipeline* pipeline, CPM_PipelineStats* stats) {
+    if (!pipeline) return CPM_RESULT_ERROR_INVALID_ARGS;
+    
+    size_t thread_count = 0;
+    for (size_t s = 0; s < pipeline->stage_count; s++) thread_count += pipeline->stages[s].workers;
+    
+    pthread_t* threads = calloc(thread_count, sizeof(pthread_t));
+    PipelineWorker* workers = calloc(pipeline->stage_count, sizeof(PipelineWorker));
+    if (!threads || !workers) {
+        free(threads);
+        free(workers);
+        return CPM_RESULT_ERROR_MEMORY_ALLOCATION;
+    }
+    
+    uint64_t start = pipeline_now_ns();
+    
+    pthread_mutex_lock(&pipeline->lock);
+    for (size_t i = 0; i < pipeline->item_count; i++) pipeline_enter_stage(pipeline, i);
+    pipeline_check_finished(pipeline);
+    pthread_mutex_unlock(&pipeline->lock);
+    
+    size_t started = 0;
+    bool staffed = true;
+    for (size_t s = 0; s < pipeline->stage_count; s++) {
+        workers[s].pipeline = pipeline;
+        workers[s].stage = s;
+        size_t stage_started = 0;
+        for (size_t w = 0; w < pipeline->stages[s].workers; w++) {
+            if (pthread_create(&threads[started], NULL, pipeline_worker, &workers[s]) == 0) {
+                started++;
+                stage_started++;
+            }
+        }
+        staffed = staffed && stage_started > 0;
+    }
+    
+    pthread_mutex_lock(&pipeline->lock);
+    if (!staffed && !pipeline->failed) {
+        // A stage without workers would strand every item that reaches it
+        pipeline->failed = true;
+        pipeline->result = CPM_RESULT_ERROR_INITIALIZATION_FAILED;
+        for (size_t s = 0; s < pipeline->stage_count; s++) pipeline->queues[s].count = 0;
+        pipeline_check_finished(pipeline);
+    }
+    while (!pipeline->stopping) {
+        pthread_cond_wait(&pipeline->finished, &pipeline->lock);
+    }
+    pthread_mutex_unlock(&pipeline->lock);
+    
+    for (size_t t = 0; t < started; t++) pthread_join(threads[t], NULL);
+    free(threads);
+    free(workers);
+    
+    pipeline->stats.wall_ns = pipeline_now_ns() - start;
+    if (stats) *stats = pipeline->stats;
+    
+    if (pipeline->failed) return pipeline->result;
+    if (pipeline->done_count < pipeline->item_count) return CPM_RESULT_ERROR_DEPENDENCY_RESOLUTION;
+    return CPM_RESULT_SUCCESS;
+}
@@ -0,0 +1,492 @@
+/*
+ * File: lib/core/cpm_pmem.c
+ * Description: Persistent memory contexts for PMLL.
+ * An mmap'd region of fixed-size, cache-line aligned slots, each recording the
+ * settlement of one persistent promise. Writes are ordered with cache-line
+ * flushes and fences so a crash never leaves a torn slot marked as settled.
+ * Author: Dr. Q Josef Kurk Edwards
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "cpm_pmem.h"
+#include "cpm_digest.h"
+
+// --- On-Media Layout ---
+#define PMEM_MAGIC   0x314d504c4c4d5043ULL /* "CPMLLPM1" */
+#define PMEM_VERSION 2
+
+typedef enum {
+    PMEM_SLOT_FREE = 0,
+    PMEM_SLOT_CLAIMED = 1,   // Key written, promise still pending
+    PMEM_SLOT_FULFILLED = 2,
+    PMEM_SLOT_REJECTED = 3
+} PMEMSlotState;
+
+#define PMEM_SLOT_FLAG_NULL_VALUE 0x1u
+
+typedef struct {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t slot_count;
+    uint64_t generation;
+    uint8_t reserved[PMEM_CACHE_LINE - 24];
+} PMEMRegionHeader;
+
+typedef struct {
+    uint32_t state;       // Commit point: written last, after everything else is persisted
+    uint32_t value_len;   // Value bytes are not NUL-terminated on media
+    uint32_t flags;
+    uint32_t checksum;
+    char key[PMEM_SLOT_KEY_MAX];
+    char value[PMEM_SLOT_VALUE_MAX];
+} PMEMSlot;
+
+_Static_assert(sizeof(PMEMRegionHeader) == PMEM_CACHE_LINE, "PMEM header must fill one cache line");
+_Static_assert(sizeof(PMEMSlot) % PMEM_CACHE_LINE == 0, "PMEM slots must be cache-line multiples");
+
+// --- Context Structure ---
+typedef struct {
+    char* path;
+    int fd;
+    void* base;
+    size_t mapped_size;
+    bool is_dax;
+    PMEMRegionHeader* header;
+    PMEMSlot* slots;
+    size_t slot_count;
+    size_t recovered_count;
+    pthread_mutex_t lock;   // Threads of this process; the region's flock covers other processes
+} PMEMContext;
+
+// --- Internal Helper Functions ---
+static uint32_t pmem_checksum(const PMEMSlot* slot, uint32_t state) {
+    // FNV-1a over the state, length, flags, key and value bytes
+    uint32_t hash = 2166136261u;
+    const uint32_t fields[3] = { state, slot->value_len, slot->flags };
+    const unsigned char* bytes = (const unsigned char*)fields;
+    for (size_t i = 0; i < sizeof(fields); i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    for (size_t i = 0; i < PMEM_SLOT_KEY_MAX && slot->key[i]; i++) {
+        hash = (hash ^ (unsigned char)slot->key[i]) * 16777619u;
+    }
+    for (size_t i = 0; i < slot->value_len && i < PMEM_SLOT_VALUE_MAX; i++) {
+        hash = (hash ^ (unsigned char)slot->value[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static uint32_t pmem_key_hash(const char* key) {
+    uint32_t hash = 2166136261u;
+    for (const unsigned char* p = (const unsigned char*)key; *p; p++) {
+        hash = (hash ^ *p) * 16777619u;
+    }
+    return hash;
+}
+
+// Keys that don't fit a slot are stored by their SHA-256, so long operation ids still get a stable slot
+static void pmem_slot_key(const char* key, char out[PMEM_SLOT_KEY_MAX]) {
+    size_t len = strlen(key);
+    if (len < PMEM_SLOT_KEY_MAX) {
+        memcpy(out, key, len + 1);
+        return;
+    }
+
+    unsigned char digest[CPM_SHA256_DIGEST_SIZE];
+    cpm_sha256(key, len, digest);
+    int written = snprintf(out, PMEM_SLOT_KEY_MAX, "sha256:");
+    for (size_t i = 0; i < CPM_SHA256_DIGEST_SIZE; i++) {
+        written += snprintf(out + written, PMEM_SLOT_KEY_MAX - written, "%02x", digest[i]);
+    }
+}
+
+static void pmem_flush_cache_lines(const void* addr, size_t len) {
+#if defined(__x86_64__) || defined(__i386__)
+    uintptr_t line = (uintptr_t)addr & ~(uintptr_t)(PMEM_CACHE_LINE - 1);
+    uintptr_t end = (uintptr_t)addr + len;
+    for (; line < end; line += PMEM_CACHE_LINE) {
+        __builtin_ia32_clflush((const void*)line);
+    }
+    __builtin_ia32_sfence();
+#else
+    (void)addr;
+    (void)len;
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+#endif
+}
+
+// Every process using the region maps the same file: claims, resets, initialization
+// and recovery take an exclusive flock on it as well as the process-local mutex
+static void pmem_flock(int fd, int operation) {
+    while (flock(fd, operation) != 0 && errno == EINTR) {
+    }
+}
+
+static void pmem_region_lock(PMEMContext* ctx) {
+    pthread_mutex_lock(&ctx->lock);
+    pmem_flock(ctx->fd, LOCK_EX);
+}
+
+static void pmem_region_unlock(PMEMContext* ctx) {
+    pmem_flock(ctx->fd, LOCK_UN);
+    pthread_mutex_unlock(&ctx->lock);
+}
+
+static bool make_directories(const char* path) {
+    char buffer[1024];
+    snprintf(buffer, sizeof(buffer), "%s", path);
+
+    for (char* p = buffer + 1; *p; p++) {
+        if (*p == '/') {
+            *p = '\0';
+            if (mkdir(buffer, 0755) == -1 && errno != EEXIST) return false;
+            *p = '/';
+        }
+    }
+    return mkdir(buffer, 0755) == 0 || errno == EEXIST;
+}
+
+// --- Persistence Primitives ---
+void pmem_persist(PMEMContextHandle handle, const void* addr, size_t len) {
+    PMEMContext* ctx = (PMEMContext*)handle;
+    if (!ctx || !addr || len == 0) return;
+
+    pmem_flush_cache_lines(addr, len);
+
+    if (!ctx->is_dax) {
+        // Page cache backed mapping: cache-line flushes order the stores, msync makes them durable
+        long page_size = sysconf(_SC_PAGESIZE);
+        uintptr_t start = (uintptr_t)addr & ~(uintptr_t)(page_size - 1);
+        uintptr_t end = (uintptr_t)addr + len;
+        msync((void*)start, end - start, MS_SYNC);
+    }
+}
+
+// --- Recovery ---
+static void pmem_context_recover(PMEMContext* ctx) {
+    size_t torn = 0;
+    ctx->recovered_count = 0;
+
+    for (size_t i = 0; i < ctx->slot_count; i++) {
+        PMEMSlot* slot = &ctx->slots[i];
+
+        switch (slot->state) {
+            case PMEM_SLOT_FREE:
+            case PMEM_SLOT_CLAIMED:
+                break;
+
+            case PMEM_SLOT_FULFILLED:
+            case PMEM_SLOT_REJECTED:
+                if (slot->value_len <= PMEM_SLOT_VALUE_MAX &&
+                    slot->checksum == pmem_checksum(slot, slot->state)) {
+                    ctx->recovered_count++;
+                } else {
+                    // Settlement was interrupted: the promise is still pending
+                    slot->state = PMEM_SLOT_CLAIMED;
+                    pmem_persist(ctx, &slot->state, sizeof(slot->state));
+                    torn++;
+                }
+                break;
+
+            default:
+                memset(slot, 0, sizeof(PMEMSlot));
+                pmem_persist(ctx, slot, sizeof(PMEMSlot));
+                torn++;
+                break;
+        }
+    }
+
+    if (ctx->recovered_count > 0 || torn > 0) {
+        printf("[PMLL] Recovered %zu settled promise(s) from %s (%zu torn slot(s) discarded)\n",
+               ctx->recovered_count, ctx->path, torn);
+    }
+}
+
+// --- Context Lifecycle ---
+PMEMContextHandle pmem_context_open(const char* path, size_t slot_count) {
+    if (!path) return NULL;
+    if (slot_count == 0) slot_count = PMEM_DEFAULT_SLOT_COUNT;
+
+    PMEMContext* ctx = calloc(1, sizeof(PMEMContext));
+    if (!ctx) {
+        perror("Failed to allocate PMEMContext");
+        return NULL;
+    }
+
+    ctx->path = strdup(path);
+    ctx->fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (!ctx->path || ctx->fd < 0) {
+        printf("[PMLL] Could not open persistent memory region %s: %s\n", path, strerror(errno));
+        free(ctx->path);
+        if (ctx->fd >= 0) close(ctx->fd);
+        free(ctx);
+        return NULL;
+    }
+
+    // Held until the region is initialized or recovered; closing the fd on failure drops it
+    pmem_flock(ctx->fd, LOCK_EX);
+
+    struct stat st;
+    fstat(ctx->fd, &st);
+
+    // An existing region keeps its own geometry
+    bool fresh = (size_t)st.st_size < sizeof(PMEMRegionHeader);
+    if (!fresh) {
+        PMEMRegionHeader existing;
+        if (pread(ctx->fd, &existing, sizeof(existing), 0) == (ssize_t)sizeof(existing) &&
+            existing.magic == PMEM_MAGIC && existing.version == PMEM_VERSION &&
+            (size_t)st.st_size >= sizeof(PMEMRegionHeader) + existing.slot_count * sizeof(PMEMSlot)) {
+            slot_count = existing.slot_count;
+        } else {
+            printf("[PMLL] Persistent memory region %s is not a PMLL region, reinitializing\n", path);
+            fresh = true;
+        }
+    }
+
+    ctx->slot_count = slot_count;
+    ctx->mapped_size = sizeof(PMEMRegionHeader) + slot_count * sizeof(PMEMSlot);
+
+    if (fresh && ftruncate(ctx->fd, (off_t)ctx->mapped_size) != 0) {
+        printf("[PMLL] Could not size persistent memory region %s: %s\n", path, strerror(errno));
+        close(ctx->fd);
+        free(ctx->path);
+        free(ctx);
+        return NULL;
+    }
+
+    ctx->base = MAP_FAILED;
+#ifdef MAP_SYNC
+    // DAX mounts accept MAP_SYNC: cache-line flushes alone are then sufficient for durability
+    ctx->base = mmap(NULL, ctx->mapped_size, PROT_READ | PROT_WRITE,
+                     MAP_SHARED_VALIDATE | MAP_SYNC, ctx->fd, 0);
+    ctx->is_dax = (ctx->base != MAP_FAILED);
+#endif
+    if (ctx->base == MAP_FAILED) {
+        ctx->base = mmap(NULL, ctx->mapped_size, PROT_READ | PROT_WRITE, MAP_SHARED, ctx->fd, 0);
+    }
+    if (ctx->base == MAP_FAILED) {
+        printf("[PMLL] Could not map persistent memory region %s: %s\n", path, strerror(errno));
+        close(ctx->fd);
+        free(ctx->path);
+        free(ctx);
+        return NULL;
+    }
+
+    ctx->header = (PMEMRegionHeader*)ctx->base;
+    ctx->slots = (PMEMSlot*)((char*)ctx->base + sizeof(PMEMRegionHeader));
+    pthread_mutex_init(&ctx->lock, NULL);
+
+    if (fresh) {
+        memset(ctx->base, 0, ctx->mapped_size);
+        pmem_persist(ctx, ctx->slots, slot_count * sizeof(PMEMSlot));
+        ctx->header->version = PMEM_VERSION;
+        ctx->header->slot_count = (uint32_t)slot_count;
+        ctx->header->generation = 1;
+        pmem_persist(ctx, ctx->header, sizeof(PMEMRegionHeader));
+        // Magic goes last so a half-initialized region is never trusted
+        ctx->header->magic = PMEM_MAGIC;
+        pmem_persist(ctx, &ctx->header->magic, sizeof(ctx->header->magic));
+    } else {
+        ctx->header->generation++;
+        pmem_persist(ctx, &ctx->header->generation, sizeof(ctx->header->generation));
+        pmem_context_recover(ctx);
+    }
+    pmem_flock(ctx->fd, LOCK_UN);
+
+    return ctx;
+}
+
+void pmem_context_close(PMEMContextHandle handle) {
+    PMEMContext* ctx = (PMEMContext*)handle;
+    if (!ctx) return;
+
+    munmap(ctx->base, ctx->mapped_size);
+    close(ctx->fd);
+    pthread_mutex_destroy(&ctx->lock);
+    free(ctx->path);
+    free(ctx);
+}
+
+void pmem_context_reset(PMEMContextHandle handle) {
+    PMEMContext* ctx = (PMEMContext*)handle;
+    if (!ctx) return;
+
+    pmem_region_lock(ctx);
+    memset(ctx->slots, 0, ctx->slot_count * sizeof(PMEMSlot));
+    pmem_persist(ctx, ctx->slots, ctx->slot_count * sizeof(PMEMSlot));
+    ctx->recovered_count = 0;
+    pmem_region_unlock(ctx);
+}
+
+size_t pmem_context_recovered_count(PMEMContextHandle handle) {
+    PMEMContext* ctx = (PMEMContext*)handle;
+    return ctx ? ctx->recovered_count : 0;
+}
+
+char* pmem_context_path_for_resource(const char* resource_id) {
+    if (!resource_id) return NULL;
+
+    const char* dir = getenv("CPM_PMEM_DIR");
+    if (!dir || dir[0] == '\0') dir = "/tmp/cpm/pmem";
+
+    if (!make_directories(dir)) {
+        printf("[PMLL] Could not create persistent memory directory %s\n", dir);
+        return NULL;
+    }
+
+    // Resource ids may contain path separators; keep the file name flat
+    char safe_id[256];
+    size_t i = 0;
+    for (; resource_id[i] && i < sizeof(safe_id) - 1; i++) {
+        char c = resource_id[i];
+        bool ok = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+                  (c >= '0' && c <= '9') || c == '.' || c == '-' || c == '_';
+        safe_id[i] = ok ? c : '_';
+    }
+    safe_id[i] = '\0';
+
+    size_t len = strlen(dir) + strlen(safe_id) + 7;
+    char* path = malloc(len);
+    if (path) snprintf(path, len, "%s/%s.pmem", dir, safe_id);
+    return path;
+}
+
+// --- Slot Access ---
+// Caller holds ctx->lock. Returns the slot recorded for slot_key, claiming a free one if create is set.
+static int pmem_find_slot(PMEMContext* ctx, const char* slot_key, bool create) {
+    // Open addressing with linear probing; slots are never individually released
+    size_t start = pmem_key_hash(slot_key) % ctx->slot_count;
+    for (size_t probe = 0; probe < ctx->slot_count; probe++) {
+        size_t index = (start + probe) % ctx->slot_count;
+        PMEMSlot* slot = &ctx->slots[index];
+
+        if (slot->state == PMEM_SLOT_FREE) {
+            if (!create) return -1;
+            memset(slot, 0, sizeof(PMEMSlot));
+            strcpy(slot->key, slot_key);
+            pmem_persist(ctx, slot->key, sizeof(slot->key));
+            slot->state = PMEM_SLOT_CLAIMED;
+            pmem_persist(ctx, &slot->state, sizeof(slot->state));
+            return (int)index;
+        }
+
+        if (strncmp(slot->key, slot_key, PMEM_SLOT_KEY_MAX) == 0) {
+            return (int)index;
+        }
+    }
+    return -1;
+}
+
+int pmem_context_acquire_slot(PMEMContextHandle handle, const char* key) {
+    PMEMContext* ctx = (PMEMContext*)handle;
+    if (!ctx || !key || !*key) return -1;
+
+    char slot_key[PMEM_SLOT_KEY_MAX];
+    pmem_slot_key(key, slot_key);
+
+    pmem_region_lock(ctx);
+    int index = pmem_find_slot(ctx, slot_key, true);
+    pmem_region_unlock(ctx);
+
+    if (index < 0) {
+        printf("[PMLL] Persistent memory region %s is full, promise will not be persisted\n", ctx->path);
+    }
+    return index;
+}
+
+bool pmem_context_rearm_slot(PMEMContextHandle handle, const char* key) {
+    PMEMContext* ctx = (PMEMContext*)handle;
+    if (!ctx || !key || !*key) return false;
+
+    char slot_key[PMEM_SLOT_KEY_MAX];
+    pmem_slot_key(key, slot_key);
+
+    pmem_region_lock(ctx);
+    int index = pmem_find_slot(ctx, slot_key, false);
+    if (index >= 0) {
+        PMEMSlot* slot = &ctx->slots[index];
+        __atomic_store_n(&slot->state, PMEM_SLOT_CLAIMED, __ATOMIC_RELEASE);
+        pmem_persist(ctx, &slot->state, sizeof(slot->state));
+    }
+    pmem_region_unlock(ctx);
+    return index >= 0;
+}
+
+bool pmem_context_store_settlement(PMEMContextHandle handle, int slot_index, PromiseState state,
+                                   const void* value, size_t length) {
+    PMEMContext* ctx = (PMEMContext*)handle;
+    if (!ctx || slot_index < 0 || (size_t)slot_index >= ctx->slot_count || state == PROMISE_PENDING) {
+        return false;
+    }
+
+    if (value && length > PMEM_SLOT_VALUE_MAX) {
+        // Never record a truncated value: leave the slot pending so a rerun redoes the work
+        printf("[PMLL] Settlement of %zu bytes does not fit a slot in %s, promise will not be persisted\n",
+               length, ctx->path);
+        return false;
+    }
+
+    pmem_region_lock(ctx);
+    PMEMSlot* slot = &ctx->slots[slot_index];
+    if (slot->state == PMEM_SLOT_FREE) {
+        pmem_region_unlock(ctx);
+        return false; // Region was reset underneath this promise
+    }
+    uint32_t new_state = (state == PROMISE_FULFILLED) ? PMEM_SLOT_FULFILLED : PMEM_SLOT_REJECTED;
+
+    // 1. Payload
+    if (value) {
+        memcpy(slot->value, value, length);
+        slot->value_len = (uint32_t)length;
+        slot->flags = 0;
+    } else {
+        slot->value_len = 0;
+        slot->flags = PMEM_SLOT_FLAG_NULL_VALUE;
+    }
+    slot->checksum = pmem_checksum(slot, new_state);
+    pmem_persist(ctx, slot, sizeof(PMEMSlot));
+
+    // 2. Commit point: the state word only becomes settled once the payload is durable
+    __atomic_store_n(&slot->state, new_state, __ATOMIC_RELEASE);
+    pmem_persist(ctx, &slot->state, sizeof(slot->state));
+    pmem_region_unlock(ctx);
+    return true;
+}
+
+bool pmem_context_load_settlement(PMEMContextHandle handle, int slot_index, PromiseState* state,
+                                  void** value, size_t* length) {
+    PMEMContext* ctx = (PMEMContext*)handle;
+    if (!ctx || slot_index < 0 || (size_t)slot_index >= ctx->slot_count) return false;
+
+    PMEMSlot* slot = &ctx->slots[slot_index];
+    uint32_t slot_state = __atomic_load_n(&slot->state, __ATOMIC_ACQUIRE);
+    if (slot_state != PMEM_SLOT_FULFILLED && slot_state != PMEM_SLOT_REJECTED) {
+        return false;
+    }
+
+    size_t value_len = slot->value_len;
+    void* copy = NULL;
+    if (value && !(slot->flags & PMEM_SLOT_FLAG_NULL_VALUE)) {
+        // One spare byte keeps string values usable as C strings
+        copy = malloc(value_len + 1);
+        if (!copy) return false;
+        memcpy(copy, slot->value, value_len);
+        ((char*)copy)[value_len] = '\0';
+    }
+
+    if (state) *state = (slot_state == PMEM_SLOT_FULFILLED) ? PROMISE_FULFILLED : PROMISE_REJECTED;
+    if (value) *value = copy;
+    if (length) *length = copy ? value_len : 0;
+    return true;
+}
@@ -11,19 +11,192 @@
 #include <string.h>
 #include <pthread.h>
 #include <unistd.h>
+#include <time.h>
 #include "cpm_pmll.h"
 #include "cpm_promise.h"
+#include "cpm_pmem.h"
+#include "cpm_journal.h"
+#include "cpm_proclock.h"
+
+// Cross-process lock failures other than a dead owner may be transient:
+// attempts are retried with exponential backoff before the batch is failed
+#define PMLL_PROCESS_LOCK_ATTEMPTS   5
+#define PMLL_PROCESS_LOCK_BACKOFF_MS 10
 
 // --- Global PMLL State ---
 static struct {
     bool initialized;
     PMLL_HardenedResourceQueue* default_file_queue;
     pthread_mutex_t global_lock;
-} pmll_global = {0};
+    // Every live queue, for pmll_dump_stats()
+    pthread_mutex_t registry_lock;
+    PMLL_HardenedResourceQueue** queues;
+    size_t queue_count;
+    size_t queue_slots;
+} pmll_global = { .registry_lock = PTHREAD_MUTEX_INITIALIZER };
+
+// --- Hardened Operation Node ---
+// One pending operation. Operations wait in the queue's pending list until a
+// drainer picks them up; no per-operation promise chaining is involved.
+struct PMLL_HardenedOp {
+    on_fulfilled_callback op_fn;
+    on_rejected_callback error_fn;
+    on_rejected_callback undo_fn;
+    void (*discard_fn)(void* op_user_data);
+    void* user_data;
+    char* op_key;
+    char* coalesce_key;
+    bool failed;
+    PromiseValue failure_reason;
+    PromiseDeferred* deferred;
+    int priority;
+    uint64_t enqueued_ns;
+    uint64_t deadline_ns;   // Absolute CLOCK_MONOTONIC time; 0 = none
+    struct PMLL_HardenedOp* superseded; // Earlier writers coalesced into this operation
+    struct PMLL_HardenedOp* next;
+};
+
+typedef struct PMLL_HardenedOp PMLL_HardenedOp;
+
+// The operation currently executing on this thread, for pmll_operation_fail()
+static _Thread_local PMLL_HardenedOp* pmll_current_operation = NULL;
+
+static void hardened_op_free(PMLL_HardenedOp* op) {
+    free(op->op_key);
+    free(op->coalesce_key);
+    free(op);
+}
+
+// A caller waiting for pmll_queue_when_space_available()
+typedef struct PMLL_SpaceWaiter {
+    PromiseDeferred* deferred;
+    struct PMLL_SpaceWaiter* next;
+} PMLL_SpaceWaiter;
+
+static void pmll_queue_drain(PMLL_HardenedResourceQueue* hq);
+static bool pmll_queue_lock_process(PMLL_HardenedResourceQueue* hq, bool* owner_died);
+static Promise* pmll_queue_submit(
+    PMLL_HardenedResourceQueue* hq,
+    const PMLL_OperationOptions* options,
+    on_fulfilled_callback operation_fn,
+    on_rejected_callback error_fn,
+    void* op_user_data,
+    bool wait_for_space);
+
+static uint64_t pmll_monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static bool pmll_queue_is_full(const PMLL_HardenedResourceQueue* hq) {
+    return hq->capacity > 0 && hq->depth >= hq->capacity;
+}
+
+// --- Queue Statistics ---
+// Bucket i counts samples in [2^i, 2^(i+1)) ns; the last bucket is open-ended.
+static int pmll_histogram_bucket(uint64_t ns) {
+    int bucket = 0;
+    while (ns > 1 && bucket < PMLL_HISTOGRAM_BUCKETS - 1) {
+        ns >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+// Upper bound of the bucket holding the given percentile (0-100)
+static uint64_t pmll_histogram_percentile(const uint64_t* histogram, uint64_t samples, unsigned int percentile) {
+    if (samples == 0) return 0;
+    uint64_t rank = (samples * percentile + 99) / 100;
+    uint64_t seen = 0;
+    for (int i = 0; i < PMLL_HISTOGRAM_BUCKETS; i++) {
+        seen += histogram[i];
+        if (seen >= rank) return 1ULL << (i + 1);
+    }
+    return 1ULL << PMLL_HISTOGRAM_BUCKETS;
+}
+
+// Timing of one executed operation, recorded when its capacity is released
+typedef struct {
+    bool failed;
+    bool expired;               // Failed because its deadline passed before it ran
+    uint64_t wait_ns;
+    uint64_t exec_ns;
+} PMLL_OpTiming;
+
+static void pmll_registry_add(PMLL_HardenedResourceQueue* hq) {
+    pthread_mutex_lock(&pmll_global.registry_lock);
+    if (pmll_global.queue_count == pmll_global.queue_slots) {
+        size_t slots = pmll_global.queue_slots ? pmll_global.queue_slots * 2 : 8;
+        PMLL_HardenedResourceQueue** queues = (PMLL_HardenedResourceQueue**)realloc(
+            pmll_global.queues, slots * sizeof(PMLL_HardenedResourceQueue*));
+        if (!queues) {
+            pthread_mutex_unlock(&pmll_global.registry_lock);
+            return; // Still usable, just not listed by pmll_dump_stats()
+        }
+        pmll_global.queues = queues;
+        pmll_global.queue_slots = slots;
+    }
+    pmll_global.queues[pmll_global.queue_count++] = hq;
+    pthread_mutex_unlock(&pmll_global.registry_lock);
+}
+
+static void pmll_registry_remove(PMLL_HardenedResourceQueue* hq) {
+    pthread_mutex_lock(&pmll_global.registry_lock);
+    for (size_t i = 0; i < pmll_global.queue_count; i++) {
+        if (pmll_global.queues[i] == hq) {
+            pmll_global.queues[i] = pmll_global.queues[--pmll_global.queue_count];
+            break;
+        }
+    }
+    if (pmll_global.queue_count == 0) {
+        free(pmll_global.queues);
+        pmll_global.queues = NULL;
+        pmll_global.queue_slots = 0;
+    }
+    pthread_mutex_unlock(&pmll_global.registry_lock);
+}
+
+// --- Pending Operation Ordering ---
+// Higher priority first; within a priority, earliest deadline first (operations
+// with a deadline ahead of those without); otherwise submission order.
+static bool pmll_op_runs_before(const PMLL_HardenedOp* a, const PMLL_HardenedOp* b) {
+    if (a->priority != b->priority) return a->priority > b->priority;
+    if (a->deadline_ns != b->deadline_ns) {
+        if (!a->deadline_ns) return false;
+        if (!b->deadline_ns) return true;
+        return a->deadline_ns < b->deadline_ns;
+    }
+    return false;
+}
+
+// Called with queue_lock held
+static void pmll_queue_insert_pending(PMLL_HardenedResourceQueue* hq, PMLL_HardenedOp* op) {
+    op->next = NULL;
+    hq->pending_count++;
+    
+    // Common case: nothing queued runs after it, so it goes at the tail
+    if (!hq->pending_tail || !pmll_op_runs_before(op, hq->pending_tail)) {
+        if (hq->pending_tail) {
+            hq->pending_tail->next = op;
+        } else {
+            hq->pending_head = op;
+        }
+        hq->pending_tail = op;
+        return;
+    }
+    
+    PMLL_HardenedOp** link = &hq->pending_head;
+    while (*link && !pmll_op_runs_before(op, *link)) {
+        link = &(*link)->next;
+    }
+    op->next = *link;
+    *link = op;
+}
 
 // --- PMLL Hardened Resource Queue Implementation ---
 PMLL_HardenedResourceQueue* pmll_queue_create(const char* resource_id, bool persistent_queue) {
-    PMLL_HardenedResourceQueue* hq = (PMLL_HardenedResourceQueue*)malloc(sizeof(PMLL_HardenedResourceQueue));
+    PMLL_HardenedResourceQueue* hq = (PMLL_HardenedResourceQueue*)calloc(1, sizeof(PMLL_HardenedResourceQueue));
     if (!hq) {
         perror("Failed to allocate PMLL_HardenedResourceQueue");
         return NULL;
@@ -35,34 +208,33 @@ PMLL_HardenedResourceQueue* pmll_queue_create(const char* resource_id, bool pers
         return NULL;
     }
     
-    // Initialize the operation queue with a resolved promise
+    // Persistent queues record the outcome of each operation that has an op_key in a PMEM
+    // region keyed by it, so a restarted run can skip completed steps
     if (persistent_queue) {
-        // For persistent queue, we would initialize with persistent memory context
-        // hq->pmem_queue_ctx = get_or_create_persistent_context_for_queue(resource_id);
-        // hq->operation_queue_promise = promise_create_persistent(hq->pmem_queue_ctx, &hq->queue_lock);
-        hq->pmem_queue_ctx = NULL; // Placeholder
-        hq->operation_queue_promise = promise_create();
-    } else {
-        hq->pmem_queue_ctx = NULL;
-        hq->operation_queue_promise = promise_create();
+        char* region_path = pmem_context_path_for_resource(resource_id);
+        hq->pmem_queue_ctx = pmem_context_open(region_path, PMEM_DEFAULT_SLOT_COUNT);
+        free(region_path);
+        if (!hq->pmem_queue_ctx) {
+            printf("[PMLL] Falling back to a volatile queue for resource: %s\n", resource_id);
+        }
     }
     
-    if (!hq->operation_queue_promise) {
+    if (pthread_mutex_init(&hq->queue_lock, NULL) != 0) {
+        pmem_context_close(hq->pmem_queue_ctx);
         free((void*)hq->resource_id);
         free(hq);
         return NULL;
     }
     
-    if (pthread_mutex_init(&hq->queue_lock, NULL) != 0) {
-        promise_free(hq->operation_queue_promise);
+    if (pthread_cond_init(&hq->space_available, NULL) != 0) {
+        pthread_mutex_destroy(&hq->queue_lock);
+        pmem_context_close(hq->pmem_queue_ctx);
         free((void*)hq->resource_id);
         free(hq);
         return NULL;
     }
     
-    // Start with a resolved promise to begin the queue
-    promise_resolve(hq->operation_queue_promise, NULL);
-    
+    pmll_registry_add(hq);
     printf("[PMLL] Created hardened queue for resource: %s\n", resource_id);
     return hq;
 }
@@ -71,68 +243,360 @@ void pmll_queue_free(PMLL_HardenedResourceQueue* hq) {
     if (!hq) return;
     
     printf("[PMLL] Destroying hardened queue for resource: %s\n", hq->resource_id);
+    pmll_registry_remove(hq);
     
+    // Run whatever is still queued (e.g. a batch that was never ended)
+    pthread_mutex_lock(&hq->queue_lock);
+    hq->batch_depth = 0;
+    if (hq->pending_head && !hq->draining) {
+        hq->draining = true;
+        pmll_queue_drain(hq);
+    } else {
+        pthread_mutex_unlock(&hq->queue_lock);
+    }
+    
+    // Nothing is queued any more, so every space waiter can proceed
+    for (PMLL_SpaceWaiter* waiter = hq->space_waiters; waiter; ) {
+        PMLL_SpaceWaiter* next = waiter->next;
+        promise_defer_resolve(waiter->deferred, NULL);
+        promise_defer_free(waiter->deferred);
+        free(waiter);
+        waiter = next;
+    }
+    
+    pmll_process_lock_close(hq->process_lock);
+    pthread_cond_destroy(&hq->space_available);
     pthread_mutex_destroy(&hq->queue_lock);
-    promise_free(hq->operation_queue_promise);
+    pmem_context_close(hq->pmem_queue_ctx);
+    pmll_journal_close(hq->journal);
     free((void*)hq->resource_id);
     free(hq);
 }
 
+bool pmll_queue_enable_journal(PMLL_HardenedResourceQueue* hq, const char* journal_path) {
+    if (!hq) return false;
+    if (hq->journal) return true;
+    
+    char* default_path = journal_path ? NULL : pmll_journal_path_for_resource(hq->resource_id);
+    PMLL_Journal* journal = pmll_journal_open(journal_path ? journal_path : default_path);
+    free(default_path);
+    if (!journal) return false;
+    
+    pthread_mutex_lock(&hq->queue_lock);
+    hq->journal = journal;
+    pthread_mutex_unlock(&hq->queue_lock);
+    return true;
+}
+
+bool pmll_queue_enable_pmem(PMLL_HardenedResourceQueue* hq, const char* region_path) {
+    if (!hq || !region_path) return false;
+    
+    pthread_mutex_lock(&hq->queue_lock);
+    bool already = hq->pmem_queue_ctx != NULL;
+    pthread_mutex_unlock(&hq->queue_lock);
+    if (already) return true;
+    
+    PMEMContextHandle ctx = pmem_context_open(region_path, PMEM_DEFAULT_SLOT_COUNT);
+    if (!ctx) return false;
+    
+    pthread_mutex_lock(&hq->queue_lock);
+    hq->pmem_queue_ctx = ctx;
+    pthread_mutex_unlock(&hq->queue_lock);
+    return true;
+}
+
+bool pmll_queue_is_committed(PMLL_HardenedResourceQueue* hq, const char* op_key) {
+    if (!hq || !hq->journal || !op_key) return false;
+    return pmll_journal_status(hq->journal, op_key) == PMLL_JOURNAL_COMMITTED;
+}
+
+void pmll_queue_checkpoint(PMLL_HardenedResourceQueue* hq) {
+    if (!hq || (!hq->pmem_queue_ctx && !hq->journal)) return;
+    
+    bool process_locked = false;
+    if (hq->process_lock) {
+        process_locked = pmll_queue_lock_process(hq, NULL);
+        if (!process_locked) {
+            // Another process may still need the recorded work
+            printf("[PMLL] Could not lock resource %s against other processes; not checkpointing\n", hq->resource_id);
+            return;
+        }
+    }
+    pthread_mutex_lock(&hq->queue_lock);
+    if (hq->pmem_queue_ctx) pmem_context_reset(hq->pmem_queue_ctx);
+    if (hq->journal) pmll_journal_truncate(hq->journal);
+    pthread_mutex_unlock(&hq->queue_lock);
+    if (process_locked) pmll_process_lock_release(hq->process_lock);
+    
+    printf("[PMLL] Checkpointed queue for resource: %s\n", hq->resource_id);
+}
+
+bool pmll_queue_enable_cross_process(PMLL_HardenedResourceQueue* hq, const char* lock_key) {
+    if (!hq) return false;
+    if (hq->process_lock) return true;
+    
+    PMLL_ProcessLock* process_lock = pmll_process_lock_open(lock_key ? lock_key : hq->resource_id);
+    if (!process_lock) return false;
+    
+    pthread_mutex_lock(&hq->queue_lock);
+    hq->process_lock = process_lock;
+    pthread_mutex_unlock(&hq->queue_lock);
+    
+    if (pmll_process_lock_recoveries(process_lock) > 0) {
+        printf("[PMLL] Cross-process lock for resource %s has been recovered %llu time(s)\n",
+               hq->resource_id, (unsigned long long)pmll_process_lock_recoveries(process_lock));
+    }
+    return true;
+}
+
 // --- Hardened Operation Execution ---
-typedef struct {
-    on_fulfilled_callback user_op_fn;
-    on_rejected_callback user_error_fn;
-    void* user_op_data;
-    PromiseDeferred* specific_deferred;
-    PMLL_HardenedResourceQueue* queue;
-} HardenedOpWrapperData;
-
-PromiseValue hardened_operation_wrapper(PromiseValue prev_result, void* user_data) {
-    HardenedOpWrapperData* wd = (HardenedOpWrapperData*)user_data;
+void pmll_operation_fail(PromiseValue reason) {
+    if (!pmll_current_operation) return;
+    pmll_current_operation->failed = true;
+    pmll_current_operation->failure_reason = reason;
+}
+
+// Settles an operation along with every writer coalesced into it, releasing
+// their user data when `discard` is set; returns the number of operations settled
+static size_t hardened_op_settle(PMLL_HardenedOp* op, bool failed, PromiseValue value, bool discard) {
+    size_t settled = 1;
+    
+    // Last writer wins: superseded writers observe the surviving write's outcome
+    for (PMLL_HardenedOp* loser = op->superseded; loser; ) {
+        PMLL_HardenedOp* next = loser->superseded;
+        if (failed) {
+            promise_defer_reject(loser->deferred, value);
+        } else {
+            promise_defer_resolve(loser->deferred, value);
+        }
+        if (loser->discard_fn) loser->discard_fn(loser->user_data);
+        promise_defer_free(loser->deferred);
+        hardened_op_free(loser);
+        loser = next;
+        settled++;
+    }
+    
+    if (failed) {
+        promise_defer_reject(op->deferred, value);
+    } else {
+        promise_defer_resolve(op->deferred, value);
+    }
+    if (discard && op->discard_fn) op->discard_fn(op->user_data);
+    promise_defer_free(op->deferred);
+    hardened_op_free(op);
+    return settled;
+}
+
+// Runs one operation and settles its promise along with every writer coalesced into it.
+// Returns the number of admitted operations settled.
+static size_t hardened_op_execute(PMLL_HardenedResourceQueue* hq, PMLL_HardenedOp* op, PMLL_OpTiming* timing) {
     PromiseValue op_result = NULL;
+    uint64_t start_ns = pmll_monotonic_ns();
+    timing->wait_ns = start_ns - op->enqueued_ns;
+    timing->exec_ns = 0;
+    timing->failed = false;
+    timing->expired = false;
+    
+    // Its deadline passed while it waited: running it late is of no use to the caller.
+    // Counted by pmll_queue_release, under the queue lock
+    if (op->deadline_ns && start_ns > op->deadline_ns) {
+        timing->failed = true;
+        timing->expired = true;
+        return hardened_op_settle(op, true, strdup("Operation deadline expired"), true);
+    }
+    PMLL_Journal* journal = op->op_key ? hq->journal : NULL;
+    
+    if (journal) {
+        // Another process sharing the journal may have done this work since it was queued
+        PMLL_JournalStatus status = pmll_journal_status(journal, op->op_key);
+        if (status == PMLL_JOURNAL_COMMITTED) {
+            return hardened_op_settle(op, false, strdup("Operation already committed"), true);
+        }
+        
+        // An interrupted attempt may have left partial effects behind: roll them back first
+        if (status == PMLL_JOURNAL_BEGUN && op->undo_fn) {
+            printf("[PMLL] Rolling back interrupted operation %s on resource: %s\n", op->op_key, hq->resource_id);
+            op->undo_fn(NULL, op->user_data);
+        }
+        pmll_journal_begin(journal, op->op_key);
+    }
     
-    printf("[PMLL] Executing hardened operation on resource: %s\n", wd->queue->resource_id);
+    // PMLL: If the operation needs locking, or if it's on persistent memory,
+    // the op_fn must be PMLL/PMEM aware.
+    // The previous result could be data loaded from PMEM by a previous step.
+    PMLL_HardenedOp* outer_operation = pmll_current_operation;
+    pmll_current_operation = op;
+    op_result = op->op_fn(hq->last_result, op->user_data);
+    pmll_current_operation = outer_operation;
+    timing->exec_ns = pmll_monotonic_ns() - start_ns;
+    timing->failed = op->failed;
     
-    // Execute the user's operation function
-    if (wd->user_op_fn) {
-        // PMLL: If the operation needs locking, or if it's on persistent memory,
-        // the user_op_fn must be PMLL/PMEM aware.
-        // The prev_result could be data loaded from PMEM by a previous step.
-        op_result = wd->user_op_fn(prev_result, wd->user_op_data);
+    PromiseValue rejection = NULL;
+    if (op->failed) {
+        rejection = op->failure_reason ? op->failure_reason : op_result;
+        if (op->error_fn) {
+            PromiseValue recovered = op->error_fn(rejection, op->user_data);
+            if (recovered) rejection = recovered;
+        }
     }
     
-    // Resolve the specific deferred for this operation with the result
-    if (wd->specific_deferred) {
-        promise_defer_resolve(wd->specific_deferred, op_result);
+    if (journal) {
+        if (op->failed) {
+            pmll_journal_abort(journal, op->op_key);
+        } else {
+            pmll_journal_commit(journal, op->op_key);
+        }
     }
     
-    // Clean up wrapper data
-    free(wd);
+    hq->last_result = op_result;
     
-    // Return result for the next operation in the queue
-    return op_result;
+    return hardened_op_settle(op, op->failed, op->failed ? rejection : op_result, false);
 }
 
-PromiseValue hardened_operation_error_wrapper(PromiseValue prev_error, void* user_data) {
-    HardenedOpWrapperData* wd = (HardenedOpWrapperData*)user_data;
-    PromiseValue error_result = NULL;
+// Gives back `settled` units of capacity, records the executed operation's
+// timing (if any) and wakes whoever was waiting for space
+static void pmll_queue_release(PMLL_HardenedResourceQueue* hq, size_t settled, const PMLL_OpTiming* timing) {
+    PMLL_SpaceWaiter* ready = NULL;
+    PMLL_SpaceWaiter** ready_tail = &ready;
     
-    printf("[PMLL] Handling error in hardened operation on resource: %s\n", wd->queue->resource_id);
-    
-    if (wd->user_error_fn) {
-        error_result = wd->user_error_fn(prev_error, wd->user_op_data);
+    pthread_mutex_lock(&hq->queue_lock);
+    hq->depth -= settled;
+    if (timing) {
+        // Coalesced writers complete along with the operation that superseded them
+        if (timing->failed) {
+            hq->failed_count += settled;
+        } else {
+            hq->completed_count += settled;
+        }
+        if (timing->expired) hq->expired_count++;
+        hq->total_wait_ns += timing->wait_ns;
+        hq->total_exec_ns += timing->exec_ns;
+        hq->wait_histogram[pmll_histogram_bucket(timing->wait_ns)]++;
+        hq->exec_histogram[pmll_histogram_bucket(timing->exec_ns)]++;
+    }
+    if (hq->capacity > 0) {
+        pthread_cond_broadcast(&hq->space_available);
+        // Promise-based waiters are woken in FIFO order, one per free slot. Depth
+        // may exceed a capacity lowered since those operations were admitted
+        size_t free_slots = hq->depth < hq->capacity ? hq->capacity - hq->depth : 0;
+        while (hq->space_waiters && free_slots-- > 0) {
+            PMLL_SpaceWaiter* waiter = hq->space_waiters;
+            hq->space_waiters = waiter->next;
+            waiter->next = NULL;
+            *ready_tail = waiter;
+            ready_tail = &waiter->next;
+        }
     }
+    pthread_mutex_unlock(&hq->queue_lock);
     
-    // Reject the specific deferred for this operation
-    if (wd->specific_deferred) {
-        promise_defer_reject(wd->specific_deferred, error_result ? error_result : prev_error);
+    // Settle outside the lock: the continuation will typically submit again
+    while (ready) {
+        PMLL_SpaceWaiter* next = ready->next;
+        promise_defer_resolve(ready->deferred, NULL);
+        promise_defer_free(ready->deferred);
+        free(ready);
+        ready = next;
     }
+}
+
+static bool pmll_queue_lock_process(PMLL_HardenedResourceQueue* hq, bool* owner_died) {
+    useconds_t backoff_us = PMLL_PROCESS_LOCK_BACKOFF_MS * 1000;
+    for (int attempt = 1; ; attempt++) {
+        if (pmll_process_lock_acquire(hq->process_lock, owner_died)) return true;
+        if (attempt == PMLL_PROCESS_LOCK_ATTEMPTS) return false;
+        usleep(backoff_us);
+        backoff_us *= 2;
+    }
+}
+
+// Rejects everything pending without running it: used when the work cannot be serialized
+// with other processes. Called without queue_lock held; returns the number of operations failed.
+static size_t pmll_queue_fail_pending(PMLL_HardenedResourceQueue* hq, const char* reason) {
+    size_t failed = 0;
+    pthread_mutex_lock(&hq->queue_lock);
+    PMLL_HardenedOp* op = hq->pending_head;
+    hq->pending_head = NULL;
+    hq->pending_tail = NULL;
+    hq->pending_count = 0;
+    pthread_mutex_unlock(&hq->queue_lock);
     
-    // Clean up wrapper data
-    free(wd);
+    while (op) {
+        PMLL_HardenedOp* next = op->next;
+        op->next = NULL;
+        PMLL_OpTiming timing = { .failed = true, .wait_ns = pmll_monotonic_ns() - op->enqueued_ns };
+        size_t settled = hardened_op_settle(op, true, strdup(reason), true);
+        pmll_queue_release(hq, settled, &timing);
+        failed += settled;
+        op = next;
+    }
+    return failed;
+}
+
+// Called with queue_lock held and hq->draining set; returns with the lock released.
+// Everything queued so far is detached and run as one batch, outside the lock, so
+// producers can keep enqueueing (and coalescing) while the batch executes.
+static void pmll_queue_drain(PMLL_HardenedResourceQueue* hq) {
+    hq->drainer = pthread_self();
+    while (hq->pending_head && hq->batch_depth == 0) {
+        pthread_mutex_unlock(&hq->queue_lock);
+        
+        // Cross-process mode: other cpm processes sharing the resource run their
+        // batches under the same lock, and may have journaled work meanwhile
+        bool process_locked = false;
+        if (hq->process_lock) {
+            bool owner_died = false;
+            process_locked = pmll_queue_lock_process(hq, &owner_died);
+            if (!process_locked) {
+                // Running the batch unlocked would race the other processes on this resource
+                size_t failed = pmll_queue_fail_pending(hq, "Could not acquire the cross-process lock");
+                printf("[PMLL] Could not lock resource %s against other processes; failed %zu operation(s)\n",
+                       hq->resource_id, failed);
+                pthread_mutex_lock(&hq->queue_lock);
+                continue;
+            }
+            if (owner_died) {
+                printf("[PMLL] Previous owner of resource %s died mid-batch; replaying its journal\n", hq->resource_id);
+            }
+            if (process_locked && hq->journal) {
+                pmll_journal_refresh(hq->journal);
+            }
+        }
+        
+        // Operations are taken one at a time from the head of the (ordered) pending
+        // list, so a more urgent one submitted mid-batch runs next
+        size_t batch_size = 0;
+        pthread_mutex_lock(&hq->queue_lock);
+        while (hq->pending_head && hq->batch_depth == 0) {
+            PMLL_HardenedOp* op = hq->pending_head;
+            hq->pending_head = op->next;
+            if (!hq->pending_head) hq->pending_tail = NULL;
+            hq->pending_count--;
+            op->next = NULL;
+            pthread_mutex_unlock(&hq->queue_lock);
+            
+            PMLL_OpTiming timing;
+            size_t settled = hardened_op_execute(hq, op, &timing);
+            pmll_queue_release(hq, settled, &timing);
+            batch_size++;
+            
+            pthread_mutex_lock(&hq->queue_lock);
+        }
+        pthread_mutex_unlock(&hq->queue_lock);
+        
+        if (process_locked) {
+            // Other processes read the journal through the page cache, so handing over the
+            // lock needs no fsync: the batch's records follow the usual group-commit rules
+            if (hq->journal) pmll_journal_flush(hq->journal);
+            pmll_process_lock_release(hq->process_lock);
+        }
+        
+        pthread_mutex_lock(&hq->queue_lock);
+        hq->batch_count++;
+        if (batch_size > hq->max_batch_size) hq->max_batch_size = batch_size;
+    }
     
-    // Continue the queue with error recovery
-    return error_result;
+    hq->draining = false;
+    pthread_mutex_unlock(&hq->queue_lock);
 }
 
 Promise* pmll_execute_hardened_operation(
@@ -140,59 +604,327 @@ Promise* pmll_execute_hardened_operation(
     on_fulfilled_callback operation_fn,
     on_rejected_callback error_fn,
     void* op_user_data) {
+    return pmll_execute_hardened_operation_ex(hq, NULL, operation_fn, error_fn, op_user_data);
+}
+
+Promise* pmll_execute_hardened_operation_ex(
+    PMLL_HardenedResourceQueue* hq,
+    const PMLL_OperationOptions* options,
+    on_fulfilled_callback operation_fn,
+    on_rejected_callback error_fn,
+    void* op_user_data) {
+    return pmll_queue_submit(hq, options, operation_fn, error_fn, op_user_data, true);
+}
+
+Promise* pmll_try_execute(
+    PMLL_HardenedResourceQueue* hq,
+    const PMLL_OperationOptions* options,
+    on_fulfilled_callback operation_fn,
+    on_rejected_callback error_fn,
+    void* op_user_data) {
+    return pmll_queue_submit(hq, options, operation_fn, error_fn, op_user_data, false);
+}
+
+static Promise* pmll_queue_submit(
+    PMLL_HardenedResourceQueue* hq,
+    const PMLL_OperationOptions* options,
+    on_fulfilled_callback operation_fn,
+    on_rejected_callback error_fn,
+    void* op_user_data,
+    bool wait_for_space) {
     
     if (!hq || !operation_fn) {
         return NULL;
     }
     
+    const char* op_key = options ? options->op_key : NULL;
+    const char* coalesce_key = options ? options->coalesce_key : NULL;
+    void (*discard_fn)(void*) = options ? options->discard_fn : NULL;
+    
     pthread_mutex_lock(&hq->queue_lock);
     
-    // Create a deferred for this specific operation's outcome
-    PromiseDeferred* operation_specific_deferred = promise_defer_create();
+    // Committed by an earlier run according to the journal: nothing to redo
+    if (op_key && hq->journal && pmll_journal_status(hq->journal, op_key) == PMLL_JOURNAL_COMMITTED) {
+        pthread_mutex_unlock(&hq->queue_lock);
+        printf("[PMLL] Skipping operation %s already committed on resource: %s\n", op_key, hq->resource_id);
+        if (discard_fn) discard_fn(op_user_data);
+        Promise* committed = promise_create();
+        promise_resolve(committed, strdup("Operation already committed"));
+        return committed;
+    }
+    
+    // Admission control. Blocking callers wait for the queue to drain below capacity,
+    // except the drainer itself and callers inside an open batch: nothing would drain for them.
+    if (pmll_queue_is_full(hq)) {
+        bool can_wait = wait_for_space && hq->batch_depth == 0 &&
+                        !(hq->draining && pthread_equal(hq->drainer, pthread_self()));
+        if (!can_wait) {
+            if (!wait_for_space) {
+                hq->rejected_count++;
+                pthread_mutex_unlock(&hq->queue_lock);
+                return NULL;
+            }
+        } else {
+            uint64_t wait_start = pmll_monotonic_ns();
+            while (pmll_queue_is_full(hq)) {
+                pthread_cond_wait(&hq->space_available, &hq->queue_lock);
+            }
+            uint64_t waited = pmll_monotonic_ns() - wait_start;
+            hq->admission_waits++;
+            hq->admission_wait_ns += waited;
+            if (waited > hq->max_admission_wait_ns) hq->max_admission_wait_ns = waited;
+        }
+    }
+    
+    // Create a deferred for this specific operation's outcome. Only operations with an
+    // identity get a PMEM slot: the op_key is how a restarted run finds it again.
+    bool persistent_op = hq->pmem_queue_ctx && op_key;
+    PromiseDeferred* operation_specific_deferred = persistent_op
+        ? promise_defer_create_persistent_keyed(hq->pmem_queue_ctx, NULL, op_key)
+        : promise_defer_create();
     if (!operation_specific_deferred) {
         pthread_mutex_unlock(&hq->queue_lock);
         return NULL;
     }
     
-    // Create wrapper data for this operation
-    HardenedOpWrapperData* wrapper_data = (HardenedOpWrapperData*)malloc(sizeof(HardenedOpWrapperData));
-    if (!wrapper_data) {
+    // A step that failed in an earlier run is retried, not replayed. With a journal, only a
+    // COMMITTED record (handled above) proves the work is done: the PMEM region may describe
+    // a tree that has since been deleted, so a settlement the journal doesn't back is stale.
+    Promise* operation_promise = promise_defer_get_promise(operation_specific_deferred);
+    PromiseState recovered_state = promise_get_state(operation_promise);
+    if (persistent_op && recovered_state != PROMISE_PENDING &&
+        (recovered_state == PROMISE_REJECTED || hq->journal)) {
+        if (recovered_state == PROMISE_FULFILLED) {
+            printf("[PMLL] Ignoring stale persistent memory record for %s: not committed in the journal\n", op_key);
+        }
+        promise_free(operation_promise);
+        promise_defer_free(operation_specific_deferred);
+        pmem_context_rearm_slot(hq->pmem_queue_ctx, op_key);
+        operation_specific_deferred = promise_defer_create_persistent_keyed(hq->pmem_queue_ctx, NULL, op_key);
+        if (!operation_specific_deferred) {
+            pthread_mutex_unlock(&hq->queue_lock);
+            return NULL;
+        }
+        operation_promise = promise_defer_get_promise(operation_specific_deferred);
+    }
+    
+    // Already completed by an interrupted run: don't redo the step
+    if (promise_get_state(operation_promise) != PROMISE_PENDING) {
+        pthread_mutex_unlock(&hq->queue_lock);
+        printf("[PMLL] Skipping operation %s recovered from persistent memory on resource: %s\n", op_key, hq->resource_id);
+        if (discard_fn) discard_fn(op_user_data);
+        promise_defer_free(operation_specific_deferred);
+        return operation_promise;
+    }
+    
+    PMLL_HardenedOp* op = (PMLL_HardenedOp*)calloc(1, sizeof(PMLL_HardenedOp));
+    if (!op) {
         promise_defer_free(operation_specific_deferred);
         pthread_mutex_unlock(&hq->queue_lock);
         return NULL;
     }
     
-    wrapper_data->user_op_fn = operation_fn;
-    wrapper_data->user_error_fn = error_fn;
-    wrapper_data->user_op_data = op_user_data;
-    wrapper_data->specific_deferred = operation_specific_deferred;
-    wrapper_data->queue = hq;
+    op->op_fn = operation_fn;
+    op->error_fn = error_fn;
+    op->undo_fn = options ? options->undo_fn : NULL;
+    op->discard_fn = discard_fn;
+    op->user_data = op_user_data;
+    op->op_key = op_key ? strdup(op_key) : NULL;
+    op->coalesce_key = coalesce_key ? strdup(coalesce_key) : NULL;
+    op->deferred = operation_specific_deferred;
+    op->priority = options ? options->priority : PMLL_PRIORITY_NORMAL;
+    op->enqueued_ns = pmll_monotonic_ns();
+    op->deadline_ns = (options && options->deadline_ms > 0)
+        ? op->enqueued_ns + (uint64_t)options->deadline_ms * 1000000ULL
+        : 0;
     
-    // Chain this operation onto the existing queue
-    Promise* new_queue_promise = promise_then(
-        hq->operation_queue_promise,
-        hardened_operation_wrapper,    // Success handler
-        hardened_operation_error_wrapper, // Error handler
-        wrapper_data                   // User data
-    );
+    // Coalesce with a not-yet-started write to the same target: this one supersedes it
+    if (op->coalesce_key) {
+        PMLL_HardenedOp* prev = NULL;
+        for (PMLL_HardenedOp* pending = hq->pending_head; pending; prev = pending, pending = pending->next) {
+            if (pending->coalesce_key && strcmp(pending->coalesce_key, op->coalesce_key) == 0) {
+                if (prev) prev->next = pending->next;
+                else hq->pending_head = pending->next;
+                if (hq->pending_tail == pending) hq->pending_tail = prev;
+                hq->pending_count--;
+                
+                pending->next = NULL;
+                op->superseded = pending;
+                hq->coalesced_count++;
+                
+                // The survivor carries the superseded writer's urgency
+                if (pending->priority > op->priority) op->priority = pending->priority;
+                if (pending->deadline_ns && (!op->deadline_ns || pending->deadline_ns < op->deadline_ns)) {
+                    op->deadline_ns = pending->deadline_ns;
+                }
+                break;
+            }
+        }
+    }
     
-    if (!new_queue_promise) {
-        free(wrapper_data);
-        promise_defer_free(operation_specific_deferred);
+    pmll_queue_insert_pending(hq, op);
+    hq->enqueued_count++;
+    hq->depth++;
+    if (hq->depth > hq->max_depth) hq->max_depth = hq->depth;
+    
+    if (hq->draining || hq->batch_depth > 0) {
+        // Another caller (or an open batch) will run it
+        pthread_mutex_unlock(&hq->queue_lock);
+    } else {
+        hq->draining = true;
+        pmll_queue_drain(hq);
+    }
+    
+    // Return the promise for this specific operation
+    return operation_promise;
+}
+
+// --- Capacity & Backpressure ---
+void pmll_queue_set_capacity(PMLL_HardenedResourceQueue* hq, size_t capacity) {
+    if (!hq) return;
+    
+    pthread_mutex_lock(&hq->queue_lock);
+    hq->capacity = capacity;
+    pthread_mutex_unlock(&hq->queue_lock);
+    
+    // A larger (or removed) limit may have freed room for waiters
+    pmll_queue_release(hq, 0, NULL);
+}
+
+Promise* pmll_queue_when_space_available(PMLL_HardenedResourceQueue* hq) {
+    if (!hq) return NULL;
+    
+    PromiseDeferred* deferred = promise_defer_create();
+    if (!deferred) return NULL;
+    Promise* space_promise = promise_defer_get_promise(deferred);
+    
+    pthread_mutex_lock(&hq->queue_lock);
+    if (!pmll_queue_is_full(hq)) {
+        pthread_mutex_unlock(&hq->queue_lock);
+        promise_defer_resolve(deferred, NULL);
+        promise_defer_free(deferred);
+        return space_promise;
+    }
+    
+    PMLL_SpaceWaiter* waiter = (PMLL_SpaceWaiter*)calloc(1, sizeof(PMLL_SpaceWaiter));
+    if (!waiter) {
         pthread_mutex_unlock(&hq->queue_lock);
+        promise_defer_free(deferred);
         return NULL;
     }
+    waiter->deferred = deferred;
     
-    // Update the queue tail to point to the new promise
-    promise_free(hq->operation_queue_promise);
-    hq->operation_queue_promise = new_queue_promise;
+    PMLL_SpaceWaiter** tail = &hq->space_waiters;
+    while (*tail) tail = &(*tail)->next;
+    *tail = waiter;
+    pthread_mutex_unlock(&hq->queue_lock);
+    
+    return space_promise;
+}
+
+size_t pmll_queue_get_depth(PMLL_HardenedResourceQueue* hq) {
+    if (!hq) return 0;
+    
+    pthread_mutex_lock(&hq->queue_lock);
+    size_t depth = hq->depth;
+    pthread_mutex_unlock(&hq->queue_lock);
+    return depth;
+}
+
+void pmll_queue_get_metrics(PMLL_HardenedResourceQueue* hq, PMLL_QueueMetrics* metrics) {
+    if (!hq || !metrics) return;
     
+    pthread_mutex_lock(&hq->queue_lock);
+    metrics->depth = hq->depth;
+    metrics->max_depth = hq->max_depth;
+    metrics->capacity = hq->capacity;
+    metrics->coalesced = hq->coalesced_count;
+    metrics->rejected = hq->rejected_count;
+    metrics->admission_waits = hq->admission_waits;
+    metrics->admission_wait_ns = hq->admission_wait_ns;
+    metrics->max_admission_wait_ns = hq->max_admission_wait_ns;
+    metrics->enqueued = hq->enqueued_count;
+    metrics->completed = hq->completed_count;
+    metrics->failed = hq->failed_count;
+    metrics->batches = hq->batch_count;
+    metrics->expired = hq->expired_count;
+    metrics->max_batch_size = hq->max_batch_size;
+    metrics->total_wait_ns = hq->total_wait_ns;
+    metrics->total_exec_ns = hq->total_exec_ns;
+    memcpy(metrics->wait_histogram, hq->wait_histogram, sizeof(metrics->wait_histogram));
+    memcpy(metrics->exec_histogram, hq->exec_histogram, sizeof(metrics->exec_histogram));
     pthread_mutex_unlock(&hq->queue_lock);
+}
+
+// --- Statistics Dump ---
+void pmll_dump_stats(void) {
+    pthread_mutex_lock(&pmll_global.registry_lock);
     
-    printf("[PMLL] Queued hardened operation on resource: %s\n", hq->resource_id);
+    printf("[PMLL] Queue statistics (%zu queue(s))\n", pmll_global.queue_count);
+    printf("  %-32s %9s %9s %7s %9s %6s %11s %11s %11s %11s %9s\n",
+           "resource", "enqueued", "completed", "failed", "coalesced", "depth",
+           "wait avg", "wait p99", "exec avg", "exec p99", "busy ms");
     
-    // Return the promise for this specific operation
-    return promise_defer_get_promise(operation_specific_deferred);
+    const char* bottleneck = NULL;
+    uint64_t bottleneck_ns = 0;
+    
+    for (size_t i = 0; i < pmll_global.queue_count; i++) {
+        PMLL_HardenedResourceQueue* hq = pmll_global.queues[i];
+        PMLL_QueueMetrics m;
+        pmll_queue_get_metrics(hq, &m);
+        
+        uint64_t executed = 0;
+        for (int b = 0; b < PMLL_HISTOGRAM_BUCKETS; b++) executed += m.exec_histogram[b];
+        
+        printf("  %-32s %9llu %9llu %7llu %9zu %6zu %9lluns %9lluns %9lluns %9lluns %9.1f\n",
+               hq->resource_id,
+               (unsigned long long)m.enqueued,
+               (unsigned long long)m.completed,
+               (unsigned long long)m.failed,
+               m.coalesced,
+               m.depth,
+               (unsigned long long)(executed ? m.total_wait_ns / executed : 0),
+               (unsigned long long)pmll_histogram_percentile(m.wait_histogram, executed, 99),
+               (unsigned long long)(executed ? m.total_exec_ns / executed : 0),
+               (unsigned long long)pmll_histogram_percentile(m.exec_histogram, executed, 99),
+               (double)m.total_exec_ns / 1e6);
+        
+        // The queue whose callers spent the longest serialized behind it
+        if (m.total_wait_ns + m.total_exec_ns > bottleneck_ns) {
+            bottleneck_ns = m.total_wait_ns + m.total_exec_ns;
+            bottleneck = hq->resource_id;
+        }
+    }
+    
+    if (bottleneck) {
+        printf("[PMLL] Most serialized resource: %s (%.1f ms waiting + executing)\n",
+               bottleneck, (double)bottleneck_ns / 1e6);
+    }
+    
+    pthread_mutex_unlock(&pmll_global.registry_lock);
+}
+
+// --- Explicit Batching ---
+void pmll_queue_begin_batch(PMLL_HardenedResourceQueue* hq) {
+    if (!hq) return;
+    
+    pthread_mutex_lock(&hq->queue_lock);
+    hq->batch_depth++;
+    pthread_mutex_unlock(&hq->queue_lock);
+}
+
+void pmll_queue_end_batch(PMLL_HardenedResourceQueue* hq) {
+    if (!hq) return;
+    
+    pthread_mutex_lock(&hq->queue_lock);
+    if (hq->batch_depth > 0) hq->batch_depth--;
+    
+    if (hq->batch_depth == 0 && hq->pending_head && !hq->draining) {
+        hq->draining = true;
+        pmll_queue_drain(hq);
+    } else {
+        pthread_mutex_unlock(&hq->queue_lock);
+    }
 }
 
 // --- Global PMLL Management ---
@@ -205,7 +937,8 @@ bool pmll_init_global_system(void) {
         return false;
     }
     
-    // Create default file operations queue
+    // Create default file operations queue. Its PMEM region and journal are attached per
+    // project (see pmll_queue_enable_pmem), never shared between unrelated trees
     pmll_global.default_file_queue = pmll_queue_create("global_file_operations", false);
     if (!pmll_global.default_file_queue) {
         pthread_mutex_destroy(&pmll_global.global_lock);
@@ -222,6 +955,12 @@ void pmll_shutdown_global_system(void) {
         return;
     }
     
+    // CPM_PMLL_STATS=1 prints per-resource queue statistics on exit
+    const char* stats_env = getenv("CPM_PMLL_STATS");
+    if (stats_env && *stats_env && strcmp(stats_env, "0") != 0) {
+        pmll_dump_stats();
+    }
+    
     pthread_mutex_lock(&pmll_global.global_lock);
     
     if (pmll_global.default_file_queue) {
@@ -248,43 +987,32 @@ PMLL_HardenedResourceQueue* pmll_get_default_file_queue(void) {
 typedef struct {
     char* filepath;
     char* content;
-    PromiseDeferred* op_deferred;
 } PMMLFileWriteData;
 
+static void pmll_file_write_data_free(void* user_data) {
+    PMMLFileWriteData* data = (PMMLFileWriteData*)user_data;
+    free(data->filepath);
+    free(data->content);
+    free(data);
+}
+
 PromiseValue pmll_file_write_operation(PromiseValue prev_result, void* user_data) {
+    (void)prev_result;
     PMMLFileWriteData* data = (PMMLFileWriteData*)user_data;
-    
-    printf("[PMLL] Serialized file write: %s\n", data->filepath);
+    PromiseValue result;
     
     FILE* fp = fopen(data->filepath, "w");
     if (fp) {
         fputs(data->content, fp);
         fclose(fp);
-        
-        char* result = strdup("File write successful");
-        if (data->op_deferred) {
-            promise_defer_resolve(data->op_deferred, result);
-        }
-        
-        // Clean up
-        free(data->filepath);
-        free(data->content);
-        free(data);
-        
-        return result;
+        result = strdup("File write successful");
     } else {
-        char* error = strdup("File write failed");
-        if (data->op_deferred) {
-            promise_defer_reject(data->op_deferred, error);
-        }
-        
-        // Clean up
-        free(data->filepath);
-        free(data->content);
-        free(data);
-        
-        return error;
+        result = strdup("File write failed");
+        pmll_operation_fail(result);
     }
+    
+    pmll_file_write_data_free(data);
+    return result;
 }
 
 Promise* pmll_write_file_serialized(const char* filepath, const char* content) {
@@ -300,22 +1028,22 @@ Promise* pmll_write_file_serialized(const char* filepath, const char* content) {
     
     data->filepath = strdup(filepath);
     data->content = strdup(content);
-    data->op_deferred = promise_defer_create();
     
-    if (!data->filepath || !data->content || !data->op_deferred) {
-        free(data->filepath);
-        free(data->content);
-        if (data->op_deferred) promise_defer_free(data->op_deferred);
-        free(data);
+    if (!data->filepath || !data->content) {
+        pmll_file_write_data_free(data);
         return NULL;
     }
     
-    Promise* operation_promise = pmll_execute_hardened_operation(
+    // Queued writes to the same path collapse into the latest one
+    PMLL_OperationOptions options = {0};
+    options.coalesce_key = filepath;
+    options.discard_fn = pmll_file_write_data_free;
+    
+    return pmll_execute_hardened_operation_ex(
         file_queue,
+        &options,
         pmll_file_write_operation,
         NULL, // No specific error handler
         data
     );
-    
-    return operation_promise;
-}
\ No newline at end of file
+}
@@ -0,0 +1,249 @@
+/*
+ * File: lib/core/cpm_proclock.c
+ * Description: Cross-process PMLL locks.
+ * Each key maps to a shm_open() segment holding a PTHREAD_PROCESS_SHARED,
+ * PTHREAD_MUTEX_ROBUST mutex. The segment is initialized once under flock() so
+ * concurrent first openers cannot race, and EOWNERDEAD is turned back into a
+ * usable lock with pthread_mutex_consistent().
+ * Author: Dr. Q Josef Kurk Edwards
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "cpm_proclock.h"
+
+// --- Shared Segment Layout ---
+#define PROCLOCK_MAGIC   "CPMPLCK1"
+#define PROCLOCK_VERSION 1
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    pthread_mutex_t mutex;
+    pid_t owner_pid;
+    uint64_t acquisitions;
+    uint64_t recoveries;
+} ProcessLockSegment;
+
+struct PMLL_ProcessLock {
+    char* key;
+    char* shm_name;
+    ProcessLockSegment* segment;
+    int refcount;
+
+    // Per-process recursion tracking for the owning thread
+    pthread_t owner_thread;
+    int owner_depth;
+
+    struct PMLL_ProcessLock* next;
+};
+
+// Open handles, shared by key within this process
+static pthread_mutex_t proclock_registry_lock = PTHREAD_MUTEX_INITIALIZER;
+static PMLL_ProcessLock* proclock_registry = NULL;
+
+// --- Internal Helper Functions ---
+// shm names are a single path component: a readable prefix of the key plus its hash
+static char* proclock_shm_name(const char* key) {
+    uint64_t hash = 1469598103934665603ULL;
+    for (const char* p = key; *p; p++) {
+        hash ^= (unsigned char)*p;
+        hash *= 1099511628211ULL;
+    }
+
+    // Keep the tail of the key: for paths it is the most specific part
+    size_t key_len = strlen(key);
+    const char* tail = key_len > 48 ? key + key_len - 48 : key;
+
+    char safe[49];
+    size_t i = 0;
+    for (; tail[i]; i++) {
+        char c = tail[i];
+        bool ok = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+                  (c >= '0' && c <= '9') || c == '.' || c == '-' || c == '_';
+        safe[i] = ok ? c : '_';
+    }
+    safe[i] = '\0';
+
+    char* name = malloc(96);
+    if (name) snprintf(name, 96, "/cpm-pmll-%s-%016llx", safe, (unsigned long long)hash);
+    return name;
+}
+
+static bool proclock_init_segment(ProcessLockSegment* segment) {
+    pthread_mutexattr_t attr;
+    if (pthread_mutexattr_init(&attr) != 0) return false;
+
+    bool ok = pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED) == 0 &&
+              pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST) == 0 &&
+              pthread_mutex_init(&segment->mutex, &attr) == 0;
+    pthread_mutexattr_destroy(&attr);
+    if (!ok) return false;
+
+    segment->version = PROCLOCK_VERSION;
+    segment->owner_pid = 0;
+    segment->acquisitions = 0;
+    segment->recoveries = 0;
+    // Magic last: a segment without it is (re)initialized by the next opener
+    memcpy(segment->magic, PROCLOCK_MAGIC, 8);
+    return true;
+}
+
+static ProcessLockSegment* proclock_map_segment(const char* shm_name) {
+    int fd = shm_open(shm_name, O_RDWR | O_CREAT, 0666);
+    if (fd < 0) {
+        printf("[PMLL] Could not open shared lock %s: %s\n", shm_name, strerror(errno));
+        return NULL;
+    }
+
+    // Serialize first-time initialization between processes
+    if (flock(fd, LOCK_EX) != 0) {
+        close(fd);
+        return NULL;
+    }
+
+    struct stat st;
+    bool fresh = fstat(fd, &st) == 0 && (size_t)st.st_size < sizeof(ProcessLockSegment);
+    if (fresh && ftruncate(fd, sizeof(ProcessLockSegment)) != 0) {
+        flock(fd, LOCK_UN);
+        close(fd);
+        return NULL;
+    }
+
+    ProcessLockSegment* segment = mmap(NULL, sizeof(ProcessLockSegment),
+                                       PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (segment == MAP_FAILED) {
+        flock(fd, LOCK_UN);
+        close(fd);
+        return NULL;
+    }
+
+    bool valid = memcmp(segment->magic, PROCLOCK_MAGIC, 8) == 0 && segment->version == PROCLOCK_VERSION;
+    if (!valid && !proclock_init_segment(segment)) {
+        munmap(segment, sizeof(ProcessLockSegment));
+        segment = NULL;
+    }
+
+    flock(fd, LOCK_UN);
+    close(fd);
+    return segment;
+}
+
+// --- Lock Lifecycle ---
+PMLL_ProcessLock* pmll_process_lock_open(const char* key) {
+    if (!key || !*key) return NULL;
+
+    pthread_mutex_lock(&proclock_registry_lock);
+
+    for (PMLL_ProcessLock* existing = proclock_registry; existing; existing = existing->next) {
+        if (strcmp(existing->key, key) == 0) {
+            existing->refcount++;
+            pthread_mutex_unlock(&proclock_registry_lock);
+            return existing;
+        }
+    }
+
+    PMLL_ProcessLock* lock = calloc(1, sizeof(PMLL_ProcessLock));
+    if (!lock) {
+        pthread_mutex_unlock(&proclock_registry_lock);
+        return NULL;
+    }
+
+    lock->key = strdup(key);
+    lock->shm_name = proclock_shm_name(key);
+    lock->segment = (lock->key && lock->shm_name) ? proclock_map_segment(lock->shm_name) : NULL;
+    if (!lock->segment) {
+        free(lock->key);
+        free(lock->shm_name);
+        free(lock);
+        pthread_mutex_unlock(&proclock_registry_lock);
+        return NULL;
+    }
+
+    lock->refcount = 1;
+    lock->next = proclock_registry;
+    proclock_registry = lock;
+
+    pthread_mutex_unlock(&proclock_registry_lock);
+    return lock;
+}
+
+void pmll_process_lock_close(PMLL_ProcessLock* lock) {
+    if (!lock) return;
+
+    pthread_mutex_lock(&proclock_registry_lock);
+    if (--lock->refcount > 0) {
+        pthread_mutex_unlock(&proclock_registry_lock);
+        return;
+    }
+
+    for (PMLL_ProcessLock** link = &proclock_registry; *link; link = &(*link)->next) {
+        if (*link == lock) {
+            *link = lock->next;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&proclock_registry_lock);
+
+    // The segment itself is left in place for other processes
+    munmap(lock->segment, sizeof(ProcessLockSegment));
+    free(lock->key);
+    free(lock->shm_name);
+    free(lock);
+}
+
+// --- Locking ---
+bool pmll_process_lock_acquire(PMLL_ProcessLock* lock, bool* owner_died) {
+    if (owner_died) *owner_died = false;
+    if (!lock) return false;
+
+    // Only the owning thread can observe itself as owner with a non-zero depth
+    if (__atomic_load_n(&lock->owner_depth, __ATOMIC_ACQUIRE) > 0 &&
+        pthread_equal(lock->owner_thread, pthread_self())) {
+        lock->owner_depth++;
+        return true;
+    }
+
+    int rc = pthread_mutex_lock(&lock->segment->mutex);
+    if (rc == EOWNERDEAD) {
+        printf("[PMLL] Recovered lock %s from dead owner (pid %d)\n",
+               lock->key, (int)lock->segment->owner_pid);
+        pthread_mutex_consistent(&lock->segment->mutex);
+        lock->segment->recoveries++;
+        if (owner_died) *owner_died = true;
+    } else if (rc != 0) {
+        printf("[PMLL] Could not acquire lock %s: %s\n", lock->key, strerror(rc));
+        return false;
+    }
+
+    lock->segment->owner_pid = getpid();
+    lock->segment->acquisitions++;
+    lock->owner_thread = pthread_self();
+    __atomic_store_n(&lock->owner_depth, 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+void pmll_process_lock_release(PMLL_ProcessLock* lock) {
+    if (!lock || lock->owner_depth == 0) return;
+
+    if (--lock->owner_depth > 0) return;
+
+    __atomic_store_n(&lock->owner_depth, 0, __ATOMIC_RELEASE);
+    lock->segment->owner_pid = 0;
+    pthread_mutex_unlock(&lock->segment->mutex);
+}
+
+// --- Diagnostics ---
+uint64_t pmll_process_lock_recoveries(PMLL_ProcessLock* lock) {
+    return lock ? lock->segment->recoveries : 0;
+}
@@ -11,6 +11,7 @@
 #include <stdbool.h>
 #include <pthread.h>
 #include "cpm_promise.h"
+#include "cpm_pmem.h"
 
 // --- Promise Callback Structure ---
 typedef struct {
@@ -38,6 +39,8 @@ struct Promise {
     // PMLL/Hardening Fields
     bool is_persistent_backed;
     PMEMContextHandle pmem_handle;
+    int pmem_slot; // -1 when the promise has no slot of its own (e.g. chained promises)
+    bool owns_value; // value is a settlement recovered from PMEM, freed with the promise
     PMLL_Lock* resource_lock;
 };
 
@@ -106,23 +109,49 @@ Promise* promise_create_internal(bool is_persistent, PMEMContextHandle pmem_ctx,
     
     p->is_persistent_backed = is_persistent;
     p->pmem_handle = pmem_ctx;
+    p->pmem_slot = -1;
+    p->owns_value = false;
     p->resource_lock = lock;
     return p;
 }
 
+// Binds a persistent promise to its slot, restoring a settlement recovered from a previous run
+static Promise* promise_attach_pmem_slot(Promise* p, int slot) {
+    if (!p || slot < 0) return p;
+    
+    p->pmem_slot = slot;
+    
+    PromiseState recovered_state;
+    PromiseValue recovered_value;
+    if (pmem_context_load_settlement(p->pmem_handle, slot, &recovered_state, &recovered_value, NULL)) {
+        p->state = recovered_state;
+        p->value = recovered_value;
+        p->owns_value = (recovered_value != NULL);
+    }
+    return p;
+}
+
 Promise* promise_create(void) {
     return promise_create_internal(false, NULL, NULL);
 }
 
 Promise* promise_create_persistent(PMEMContextHandle pmem_ctx, PMLL_Lock* lock) {
+    // Without a key a later run could never find this promise again: it is not given a slot
     return promise_create_internal(true, pmem_ctx, lock);
 }
 
+Promise* promise_create_persistent_keyed(PMEMContextHandle pmem_ctx, PMLL_Lock* lock, const char* key) {
+    Promise* p = promise_create_internal(true, pmem_ctx, lock);
+    if (!p || !pmem_ctx || !key) return p;
+    return promise_attach_pmem_slot(p, pmem_context_acquire_slot(pmem_ctx, key));
+}
+
 void promise_free(Promise* p) {
     if (!p) return;
     
     free_callback_queue(&p->fulfillment_callbacks);
     free_callback_queue(&p->rejection_callbacks);
+    if (p->owns_value) free(p->value);
     free(p);
 }
 
@@ -145,8 +174,9 @@ void promise_resolve_internal(Promise* p, PromiseValue value, bool via_deferred)
     p->state = PROMISE_FULFILLED;
     p->value = value;
     
-    if (p->is_persistent_backed) {
-        printf("[PMLL] Conceptual: Persisted fulfillment value for promise tied to handle %p\n", p->pmem_handle);
+    if (p->is_persistent_backed && p->pmem_slot >= 0) {
+        pmem_context_store_settlement(p->pmem_handle, p->pmem_slot, PROMISE_FULFILLED,
+                                      value, value ? strlen((const char*)value) : 0);
     }
     
     if (p->resource_lock) pthread_mutex_unlock(p->resource_lock);
@@ -164,8 +194,9 @@ void promise_reject_internal(Promise* p, PromiseValue reason, bool via_deferred)
     p->state = PROMISE_REJECTED;
     p->value = reason;
     
-    if (p->is_persistent_backed) {
-        printf("[PMLL] Conceptual: Persisted rejection reason for promise tied to handle %p\n", p->pmem_handle);
+    if (p->is_persistent_backed && p->pmem_slot >= 0) {
+        pmem_context_store_settlement(p->pmem_handle, p->pmem_slot, PROMISE_REJECTED,
+                                      reason, reason ? strlen((const char*)reason) : 0);
     }
     
     if (p->resource_lock) pthread_mutex_unlock(p->resource_lock);
@@ -298,6 +329,17 @@ PromiseDeferred* promise_defer_create_persistent(PMEMContextHandle pmem_ctx, PML
     return d;
 }
 
+PromiseDeferred* promise_defer_create_persistent_keyed(PMEMContextHandle pmem_ctx, PMLL_Lock* lock, const char* key) {
+    PromiseDeferred* d = (PromiseDeferred*)malloc(sizeof(PromiseDeferred));
+    if (!d) return NULL;
+    d->promise = promise_create_persistent_keyed(pmem_ctx, lock, key);
+    if (!d->promise) {
+        free(d);
+        return NULL;
+    }
+    return d;
+}
+
 void promise_defer_resolve(PromiseDeferred* deferred, PromiseValue value) {
     if (!deferred || !deferred->promise) return;
     promise_resolve_internal(deferred->promise, value, true);
@@ -0,0 +1,433 @@
+/*
+ * File: lib/core/cpm_registry.c
+ * Description: Shared registry HTTP client for CPM.
+ * Easy handles are pooled and all attached to one CURLSH, so whichever thread
+ * (or multi handle) runs a transfer, it finds the same DNS entries, TLS
+ * sessions and open connections. Async GETs are queued to a client thread
+ * that drives them on a multi handle with HTTP/2 multiplexing enabled.
+ * Author: Dr. Q Josef Kurk Edwards
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <pthread.h>
+#include "cpm_registry.h"
+
+#define REGISTRY_IDLE_HANDLES 16
+#define REGISTRY_POLL_MS 1000
+
+typedef struct RegistryRequest {
+    CURL* curl;
+    Promise* promise;
+    CPM_RegistryResponse* response;
+    struct curl_slist* headers;
+    struct RegistryRequest* next;
+} RegistryRequest;
+
+typedef struct {
+    CURLSH* share;
+    pthread_mutex_t share_locks[CURL_LOCK_DATA_LAST];
+    CURLM* multi;
+    pthread_t thread;
+    bool thread_running;
+    size_t in_flight;           // Owned by the client thread
+    
+    pthread_mutex_t lock;       // Guards everything below
+    RegistryRequest* queue_head;
+    RegistryRequest* queue_tail;
+    bool stopping;
+    CURL* idle[REGISTRY_IDLE_HANDLES];
+    size_t idle_count;
+    CPM_RegistryStats stats;
+} RegistryClient;
+
+static RegistryClient* registry_client = NULL;
+static pthread_mutex_t registry_client_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Request promises settle under this lock (recursive: settling runs callbacks
+// that settle chained promises), so a waiter can tell when it is finished.
+static pthread_mutex_t registry_promise_lock;
+static pthread_once_t registry_once = PTHREAD_ONCE_INIT;
+
+static void registry_init_once(void) {
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&registry_promise_lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+}
+
+// --- Responses ---
+void cpm_registry_response_free(CPM_RegistryResponse* response) {
+    if (!response) return;
+    free(response->body);
+    free(response->etag);
+    free(response);
+}
+
+static size_t registry_write_body(char* data, size_t size, size_t nmemb, void* userdata) {
+    CPM_RegistryResponse* response = userdata;
+    size_t total = size * nmemb;
+    
+    char* grown = realloc(response->body, response->size + total + 1);
+    if (!grown) return 0;
+    response->body = grown;
+    memcpy(response->body + response->size, data, total);
+    response->size += total;
+    response->body[response->size] = '\0';
+    return total;
+}
+
+static size_t registry_write_header(char* buffer, size_t size, size_t nitems, void* userdata) {
+    CPM_RegistryResponse* response = userdata;
+    size_t total = size * nitems;
+    
+    if (total > 5 && strncasecmp(buffer, "ETag:", 5) == 0) {
+        const char* value = buffer + 5;
+        const char* end = buffer + total;
+        while (value < end && isspace((unsigned char)*value)) value++;
+        while (end > value && isspace((unsigned char)end[-1])) end--;
+        free(response->etag);
+        response->etag = strndup(value, (size_t)(end - value));
+    }
+    return total;
+}
+
+// --- Client ---
+static void registry_share_lock(CURL* curl, curl_lock_data data, curl_lock_access access, void* userptr) {
+    (void)curl;
+    (void)access;
+    RegistryClient* client = userptr;
+    pthread_mutex_lock(&client->share_locks[data]);
+}
+
+static void registry_share_unlock(CURL* curl, curl_lock_data data, void* userptr) {
+    (void)curl;
+    RegistryClient* client = userptr;
+    pthread_mutex_unlock(&client->share_locks[data]);
+}
+
+static RegistryClient* registry_client_create(void) {
+    RegistryClient* client = calloc(1, sizeof(RegistryClient));
+    if (!client) return NULL;
+    
+    for (size_t i = 0; i < CURL_LOCK_DATA_LAST; i++) pthread_mutex_init(&client->share_locks[i], NULL);
+    pthread_mutex_init(&client->lock, NULL);
+    
+    client->share = curl_share_init();
+    client->multi = curl_multi_init();
+    if (!client->share || !client->multi) {
+        curl_share_cleanup(client->share);
+        curl_multi_cleanup(client->multi);
+        free(client);
+        return NULL;
+    }
+    
+    curl_share_setopt(client->share, CURLSHOPT_LOCKFUNC, registry_share_lock);
+    curl_share_setopt(client->share, CURLSHOPT_UNLOCKFUNC, registry_share_unlock);
+    curl_share_setopt(client->share, CURLSHOPT_USERDATA, client);
+    curl_share_setopt(client->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(client->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+    curl_share_setopt(client->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+    
+    curl_multi_setopt(client->multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+    return client;
+}
+
+static RegistryClient* registry_client_get(void) {
+    pthread_once(&registry_once, registry_init_once);
+    
+    pthread_mutex_lock(&registry_client_lock);
+    if (!registry_client) registry_client = registry_client_create();
+    RegistryClient* client = registry_client;
+    pthread_mutex_unlock(&registry_client_lock);
+    return client;
+}
+
+// --- Handle Pool ---
+static void registry_configure_handle(RegistryClient* client, CURL* curl) {
+    curl_easy_setopt(curl, CURLOPT_SHARE, client->share);
+    curl_easy_setopt(curl, CURLOPT_USERAGENT, CPM_REGISTRY_USER_AGENT);
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+    // h2 where TLS lets the server agree to it; plain http stays on 1.1
+    curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, (long)CURL_HTTP_VERSION_2TLS);
+}
+
+static CURL* registry_acquire(RegistryClient* client) {
+    CURL* curl = NULL;
+    pthread_mutex_lock(&client->lock);
+    if (client->idle_count > 0) curl = client->idle[--client->idle_count];
+    pthread_mutex_unlock(&client->lock);
+    
+    if (!curl) curl = curl_easy_init();
+    if (curl) registry_configure_handle(client, curl);
+    return curl;
+}
+
+static void registry_release(RegistryClient* client, CURL* curl) {
+    long status = 0;
+    long connects = 0;
+    long version = 0;
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+    curl_easy_getinfo(curl, CURLINFO_NUM_CONNECTS, &connects);
+    curl_easy_getinfo(curl, CURLINFO_HTTP_VERSION, &version);
+    
+    // Reset drops the options (and the share); the pooled connections stay in the share
+    curl_easy_reset(curl);
+    
+    pthread_mutex_lock(&client->lock);
+    if (status > 0 || connects > 0) {
+        client->stats.requests++;
+        client->stats.connections += (size_t)connects;
+        if (version >= CURL_HTTP_VERSION_2_0) client->stats.http2++;
+    }
+    if (client->idle_count < REGISTRY_IDLE_HANDLES) {
+        client->idle[client->idle_count++] = curl;
+        curl = NULL;
+    }
+    pthread_mutex_unlock(&client->lock);
+    
+    if (curl) curl_easy_cleanup(curl);
+}
+
+CURL* cpm_registry_handle_acquire(void) {
+    RegistryClient* client = registry_client_get();
+    return client ? registry_acquire(client) : NULL;
+}
+
+void cpm_registry_handle_release(CURL* curl) {
+    if (!curl) return;
+    
+    pthread_mutex_lock(&registry_client_lock);
+    RegistryClient* client = registry_client;
+    pthread_mutex_unlock(&registry_client_lock);
+    
+    if (client) {
+        registry_release(client, curl);
+    } else {
+        curl_easy_cleanup(curl);
+    }
+}
+
+// --- Client Thread ---
+static void registry_settle(RegistryRequest* request) {
+    pthread_mutex_lock(&registry_promise_lock);
+    if (request->response->result == CURLE_OK) {
+        promise_resolve(request->promise, request->response);
+    } else {
+        promise_reject(request->promise, request->response);
+    }
+    pthread_mutex_unlock(&registry_promise_lock);
+}
+
+static void registry_finish(RegistryClient* client, RegistryRequest* request, CURLcode result) {
+    request->response->result = result;
+    curl_easy_getinfo(request->curl, CURLINFO_RESPONSE_CODE, &request->response->status);
+    
+    curl_multi_remove_handle(client->multi, request->curl);
+    registry_release(client, request->curl);
+    curl_slist_free_all(request->headers);
+    
+    registry_settle(request);
+    free(request);
+}
+
+static void* registry_worker(void* arg) {
+    RegistryClient* client = arg;
+    
+    for (;;) {
+        pthread_mutex_lock(&client->lock);
+        RegistryRequest* queued = client->queue_head;
+        client->queue_head = NULL;
+        client->queue_tail = NULL;
+        bool stopping = client->stopping;
+        pthread_mutex_unlock(&client->lock);
+        
+        while (queued) {
+            RegistryRequest* request = queued;
+            queued = queued->next;
+            if (curl_multi_add_handle(client->multi, request->curl) == CURLM_OK) {
+                client->in_flight++;
+            } else {
+                registry_finish(client, request, CURLE_FAILED_INIT);
+            }
+        }
+        if (stopping && client->in_flight == 0) break;
+        
+        int running = 0;
+        curl_multi_perform(client->multi, &running);
+        
+        CURLMsg* msg;
+        int remaining;
+        while ((msg = curl_multi_info_read(client->multi, &remaining))) {
+            if (msg->msg != CURLMSG_DONE) continue;
+            
+            RegistryRequest* request = NULL;
+            curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char**)&request);
+            CURLcode result = msg->data.result;
+            registry_finish(client, request, result);
+            client->in_flight--;
+        }
+        
+        // New requests and shutdown interrupt the wait via curl_multi_wakeup
+        curl_multi_poll(client->multi, NULL, 0, REGISTRY_POLL_MS, NULL);
+    }
+    return NULL;
+}
+
+static bool registry_client_start(RegistryClient* client) {
+    pthread_mutex_lock(&client->lock);
+    if (!client->thread_running && !client->stopping) {
+        client->thread_running = pthread_create(&client->thread, NULL, registry_worker, client) == 0;
+    }
+    bool running = client->thread_running;
+    pthread_mutex_unlock(&client->lock);
+    return running;
+}
+
+// --- Async Requests ---
+Promise* registry_get_async(const char* url, const CPM_RegistryRequestOptions* options) {
+    RegistryClient* client = registry_client_get();
+    
+    // A lock-guarded promise: it is settled on the client thread
+    Promise* promise = promise_create_persistent(NULL, &registry_promise_lock);
+    CPM_RegistryResponse* response = calloc(1, sizeof(CPM_RegistryResponse));
+    RegistryRequest* request = calloc(1, sizeof(RegistryRequest));
+    if (!promise || !response || !request) {
+        promise_free(promise);
+        free(response);
+        free(request);
+        return NULL;
+    }
+    response->result = CURLE_FAILED_INIT;
+    request->promise = promise;
+    request->response = response;
+    
+    request->curl = client && url ? registry_acquire(client) : NULL;
+    if (!request->curl || !registry_client_start(client)) {
+        if (request->curl) registry_release(client, request->curl);
+        free(request);
+        promise_reject(promise, response);
+        return promise;
+    }
+    
+    long timeout = options && options->timeout_seconds > 0 ? options->timeout_seconds : CPM_REGISTRY_DEFAULT_TIMEOUT;
+    for (size_t i = 0; options && options->headers && options->headers[i]; i++) {
+        request->headers = curl_slist_append(request->headers, options->headers[i]);
+    }
+    
+    CURL* curl = request->curl;
+    curl_easy_setopt(curl, CURLOPT_URL, url);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, registry_write_body);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, response);
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, registry_write_header);
+    curl_easy_setopt(curl, CURLOPT_HEADERDATA, response);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, timeout);
+    curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, "");
+    // Wait for a multiplexed stream rather than open another connection. Only
+    // safe here: the wait is woken by the multi handle that owns the connection.
+    curl_easy_setopt(curl, CURLOPT_PIPEWAIT, 1L);
+    curl_easy_setopt(curl, CURLOPT_PRIVATE, request);
+    if (request->headers) curl_easy_setopt(curl, CURLOPT_HTTPHEADER, request->headers);
+    
+    pthread_mutex_lock(&client->lock);
+    if (client->queue_tail) {
+        client->queue_tail->next = request;
+    } else {
+        client->queue_head = request;
+    }
+    client->queue_tail = request;
+    pthread_mutex_unlock(&client->lock);
+    
+    curl_multi_wakeup(client->multi);
+    return promise;
+}
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t settled_cond;
+    bool settled;
+    CPM_RegistryResponse* response;
+} RegistryWaiter;
+
+static PromiseValue registry_waiter_settle(PromiseValue value, void* user_data) {
+    RegistryWaiter* waiter = user_data;
+    pthread_mutex_lock(&waiter->lock);
+    waiter->response = value;
+    waiter->settled = true;
+    pthread_cond_signal(&waiter->settled_cond);
+    pthread_mutex_unlock(&waiter->lock);
+    return value;
+}
+
+CPM_RegistryResponse* registry_await(Promise* promise) {
+    if (!promise) return NULL;
+    pthread_once(&registry_once, registry_init_once);
+    
+    RegistryWaiter waiter = { .settled = false, .response = NULL };
+    pthread_mutex_init(&waiter.lock, NULL);
+    pthread_cond_init(&waiter.settled_cond, NULL);
+    
+    Promise* chained = promise_then(promise, registry_waiter_settle, registry_waiter_settle, &waiter);
+    
+    pthread_mutex_lock(&waiter.lock);
+    while (!waiter.settled) pthread_cond_wait(&waiter.settled_cond, &waiter.lock);
+    pthread_mutex_unlock(&waiter.lock);
+    
+    // The client thread holds this until the settlement that woke us has
+    // finished with both promises
+    pthread_mutex_lock(&registry_promise_lock);
+    pthread_mutex_unlock(&registry_promise_lock);
+    
+    promise_free(chained);
+    pthread_cond_destroy(&waiter.settled_cond);
+    pthread_mutex_destroy(&waiter.lock);
+    return waiter.response;
+}
+
+// --- Statistics ---
+void cpm_registry_stats(CPM_RegistryStats* stats) {
+    if (!stats) return;
+    memset(stats, 0, sizeof(*stats));
+    
+    pthread_mutex_lock(&registry_client_lock);
+    RegistryClient* client = registry_client;
+    if (client) {
+        pthread_mutex_lock(&client->lock);
+        *stats = client->stats;
+        pthread_mutex_unlock(&client->lock);
+    }
+    pthread_mutex_unlock(&registry_client_lock);
+}
+
+// --- Lifecycle ---
+void cpm_registry_client_shutdown(void) {
+    pthread_mutex_lock(&registry_client_lock);
+    RegistryClient* client = registry_client;
+    registry_client = NULL;
+    pthread_mutex_unlock(&registry_client_lock);
+    if (!client) return;
+    
+    pthread_mutex_lock(&client->lock);
+    client->stopping = true;
+    bool running = client->thread_running;
+    pthread_mutex_unlock(&client->lock);
+    
+    if (running) {
+        curl_multi_wakeup(client->multi);
+        pthread_join(client->thread, NULL);
+    }
+    
+    for (size_t i = 0; i < client->idle_count; i++) curl_easy_cleanup(client->idle[i]);
+    curl_multi_cleanup(client->multi);
+    curl_share_cleanup(client->share);
+    for (size_t i = 0; i < CURL_LOCK_DATA_LAST; i++) pthread_mutex_destroy(&client->share_locks[i]);
+    pthread_mutex_destroy(&client->lock);
+    free(client);
+}
@@ -0,0 +1,982 @@
+/*
+ * File: lib/core/cpm_search_index.c
+ * Description: Full-text package search index for CPM.
+ * File layout (host byte order, every section 8-byte aligned):
+ *   header
+ *   documents[doc_count]      string offsets and downloads
+ *   popular[doc_count]        documents by downloads, for queries without tokens
+ *   terms[term_count]         sorted bytewise, so prefixes are contiguous ranges
+ *   postings[]                per term, by document: the BM25F term frequency,
+ *                             field weights and length normalization applied
+ *   grams[gram_count]         sorted trigrams of the vocabulary
+ *   gram_terms[]              per trigram, the terms containing it
+ *   strings                   NUL-terminated, referenced by offset
+ * Author: Dr. Q Josef Kurk Edwards
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "cpm_search_index.h"
+
+#define INDEX_MAGIC "CPMSIDX"
+#define INDEX_VERSION 1
+#define INDEX_BYTE_ORDER 0x01020304u
+#define INDEX_TOKEN_MAX 64
+#define INDEX_QUERY_TOKENS 16
+
+// Fields, and how much a match in each counts (BM25F)
+enum { FIELD_NAME, FIELD_DESCRIPTION, FIELD_AUTHOR, FIELD_COUNT };
+static const double field_weight[FIELD_COUNT] = { 3.0, 1.0, 0.5 };
+#define BM25_K1 1.2
+#define BM25_B 0.75
+
+// How a query token may match a term, and what that match is worth
+#define MATCH_PREFIX_MIN 1          // Even one letter completes to the best terms
+#define MATCH_PREFIX_MAX 64         // Completions kept per token, most frequent first
+#define MATCH_GRAM_MIN 3            // Infix and typo matching need one trigram
+#define MATCH_FUZZY_MAX 32
+#define MATCH_TYPO_SIMILARITY 0.7   // Dice coefficient over trigrams
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t stamp;
+    uint64_t file_size;
+    uint32_t doc_count;
+    uint32_t term_count;
+    uint32_t gram_count;
+    uint32_t reserved;
+    uint64_t posting_count;
+    uint64_t gram_term_count;
+    uint64_t documents;
+    uint64_t popular;
+    uint64_t terms;
+    uint64_t postings;
+    uint64_t grams;
+    uint64_t gram_terms;
+    uint64_t strings;
+    uint64_t strings_size;
+} IndexHeader;
+
+typedef struct {
+    uint64_t downloads;
+    uint32_t name;
+    uint32_t version;
+    uint32_t description;
+    uint32_t author;
+    uint32_t homepage;
+    uint32_t reserved;
+} IndexDocument;
+
+typedef struct {
+    uint32_t text;
+    uint32_t postings;
+    uint32_t count;
+    uint16_t length;
+    uint16_t reserved;
+} IndexTerm;
+
+typedef struct {
+    uint32_t doc;
+    float tf;
+} IndexPosting;
+
+typedef struct {
+    uint32_t gram;
+    uint32_t terms;
+    uint32_t count;
+} IndexGram;
+
+// --- Tokenizing ---
+static bool token_char(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || (unsigned char)c >= 0x80;
+}
+
+// Next lowercased run of letters and digits; runs longer than INDEX_TOKEN_MAX are cut
+static bool next_token(const char** pos, char token[INDEX_TOKEN_MAX + 1], size_t* length) {
+    const char* p = *pos;
+    while (*p && !token_char(*p)) p++;
+    if (!*p) {
+        *pos = p;
+        return false;
+    }
+    
+    size_t n = 0;
+    for (; token_char(*p); p++) {
+        if (n < INDEX_TOKEN_MAX) token[n++] = (*p >= 'A' && *p <= 'Z') ? (char)(*p - 'A' + 'a') : *p;
+    }
+    token[n] = '\0';
+    *length = n;
+    *pos = p;
+    return true;
+}
+
+static uint32_t gram_at(const char* text) {
+    return (uint32_t)(unsigned char)text[0] << 16 | (uint32_t)(unsigned char)text[1] << 8 | (unsigned char)text[2];
+}
+
+// --- Builder ---
+typedef struct {
+    uint32_t doc;
+    uint8_t tf[FIELD_COUNT];
+} BuildPosting;
+
+typedef struct {
+    char* text;
+    size_t length;
+    BuildPosting* postings;
+    size_t count;
+    size_t capacity;
+} BuildTerm;
+
+typedef struct {
+    char* fields[5];            // name, version, description, author, homepage
+    uint64_t downloads;
+    uint16_t length[FIELD_COUNT];
+} BuildDocument;
+
+struct CPM_SearchIndexBuilder {
+    BuildDocument* documents;
+    size_t doc_count;
+    size_t doc_capacity;
+    
+    BuildTerm** slots;          // Open addressing by term text
+    size_t slot_count;
+    size_t term_count;
+};
+
+static uint64_t hash_text(const char* text, size_t length) {
+    uint64_t hash = 1469598103934665603ULL;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char)text[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static bool builder_grow_terms(CPM_SearchIndexBuilder* builder) {
+    size_t count = builder->slot_count ? builder->slot_count * 2 : 1024;
+    BuildTerm** slots = calloc(count, sizeof(BuildTerm*));
+    if (!slots) return false;
+    
+    for (size_t i = 0; i < builder->slot_count; i++) {
+        BuildTerm* term = builder->slots[i];
+        if (!term) continue;
+        size_t slot = hash_text(term->text, term->length) & (count - 1);
+        while (slots[slot]) slot = (slot + 1) & (count - 1);
+        slots[slot] = term;
+    }
+    free(builder->slots);
+    builder->slots = slots;
+    builder->slot_count = count;
+    return true;
+}
+
+static BuildTerm* builder_term(CPM_SearchIndexBuilder* builder, const char* text, size_t length) {
+    if ((builder->term_count + 1) * 2 > builder->slot_count && !builder_grow_terms(builder)) return NULL;
+    
+    size_t slot = hash_text(text, length) & (builder->slot_count - 1);
+    for (BuildTerm* term; (term = builder->slots[slot]); slot = (slot + 1) & (builder->slot_count - 1)) {
+        if (term->length == length && memcmp(term->text, text, length) == 0) return term;
+    }
+    
+    BuildTerm* term = calloc(1, sizeof(BuildTerm));
+    if (!term || !(term->text = strndup(text, length))) {
+        free(term);
+        return NULL;
+    }
+    term->length = length;
+    builder->slots[slot] = term;
+    builder->term_count++;
+    return term;
+}
+
+static bool builder_index_field(CPM_SearchIndexBuilder* builder, uint32_t doc, int field, const char* text,
+                                uint16_t* length) {
+    char token[INDEX_TOKEN_MAX + 1];
+    size_t token_length;
+    size_t tokens = 0;
+    
+    while (next_token(&text, token, &token_length)) {
+        BuildTerm* term = builder_term(builder, token, token_length);
+        if (!term) return false;
+        
+        // Documents arrive in order, so this document's posting is the last one if any
+        if (term->count == 0 || term->postings[term->count - 1].doc != doc) {
+            if (term->count == term->capacity) {
+                size_t capacity = term->capacity ? term->capacity * 2 : 4;
+                BuildPosting* grown = realloc(term->postings, capacity * sizeof(BuildPosting));
+                if (!grown) return false;
+                term->postings = grown;
+                term->capacity = capacity;
+            }
+            memset(&term->postings[term->count], 0, sizeof(BuildPosting));
+            term->postings[term->count++].doc = doc;
+        }
+        uint8_t* tf = &term->postings[term->count - 1].tf[field];
+        if (*tf < UINT8_MAX) (*tf)++;
+        tokens++;
+    }
+    *length = tokens < UINT16_MAX ? (uint16_t)tokens : UINT16_MAX;
+    return true;
+}
+
+CPM_SearchIndexBuilder* cpm_search_index_builder_create(void) {
+    return calloc(1, sizeof(CPM_SearchIndexBuilder));
+}
+
+bool cpm_search_index_builder_add(CPM_SearchIndexBuilder* builder, const CPM_SearchDocument* document) {
+    if (!builder || !document || builder->doc_count >= UINT32_MAX) return false;
+    
+    if (builder->doc_count == builder->doc_capacity) {
+        size_t capacity = builder->doc_capacity ? builder->doc_capacity * 2 : 256;
+        BuildDocument* grown = realloc(builder->documents, capacity * sizeof(BuildDocument));
+        if (!grown) return false;
+        builder->documents = grown;
+        builder->doc_capacity = capacity;
+    }
+    
+    BuildDocument* doc = &builder->documents[builder->doc_count];
+    memset(doc, 0, sizeof(*doc));
+    const char* fields[5] = { document->name, document->version, document->description, document->author, document->homepage };
+    for (size_t i = 0; i < 5; i++) {
+        doc->fields[i] = strdup(fields[i] ? fields[i] : "");
+        if (!doc->fields[i]) {
+            for (size_t j = 0; j < i; j++) free(doc->fields[j]);
+            return false;
+        }
+    }
+    doc->downloads = document->downloads;
+    
+    uint32_t id = (uint32_t)builder->doc_count++;
+    return builder_index_field(builder, id, FIELD_NAME, doc->fields[0], &doc->length[FIELD_NAME]) &&
+           builder_index_field(builder, id, FIELD_DESCRIPTION, doc->fields[2], &doc->length[FIELD_DESCRIPTION]) &&
+           builder_index_field(builder, id, FIELD_AUTHOR, doc->fields[3], &doc->length[FIELD_AUTHOR]);
+}
+
+void cpm_search_index_builder_free(CPM_SearchIndexBuilder* builder) {
+    if (!builder) return;
+    for (size_t i = 0; i < builder->doc_count; i++) {
+        for (size_t f = 0; f < 5; f++) free(builder->documents[i].fields[f]);
+    }
+    free(builder->documents);
+    for (size_t i = 0; i < builder->slot_count; i++) {
+        BuildTerm* term = builder->slots[i];
+        if (!term) continue;
+        free(term->text);
+        free(term->postings);
+        free(term);
+    }
+    free(builder->slots);
+    free(builder);
+}
+
+// --- Writing ---
+typedef struct {
+    char* data;
+    size_t size;
+    size_t capacity;
+} StringBlob;
+
+static uint32_t blob_add(StringBlob* blob, const char* text, size_t length, bool* ok) {
+    if (blob->size + length + 1 > blob->capacity) {
+        size_t capacity = blob->capacity ? blob->capacity : 65536;
+        while (capacity < blob->size + length + 1) capacity *= 2;
+        char* grown = realloc(blob->data, capacity);
+        if (!grown) {
+            *ok = false;
+            return 0;
+        }
+        blob->data = grown;
+        blob->capacity = capacity;
+    }
+    if (blob->size + length + 1 > UINT32_MAX) {
+        *ok = false;
+        return 0;
+    }
+    uint32_t offset = (uint32_t)blob->size;
+    memcpy(blob->data + blob->size, text, length);
+    blob->data[blob->size + length] = '\0';
+    blob->size += length + 1;
+    return offset;
+}
+
+static int compare_terms(const void* a, const void* b) {
+    const BuildTerm* x = *(BuildTerm* const*)a;
+    const BuildTerm* y = *(BuildTerm* const*)b;
+    return strcmp(x->text, y->text);
+}
+
+// (gram << 32 | term) sorts by trigram, then term
+static int compare_u64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+static int compare_popular(const void* a, const void* b, void* context) {
+    const CPM_SearchIndexBuilder* builder = context;
+    const BuildDocument* x = &builder->documents[*(const uint32_t*)a];
+    const BuildDocument* y = &builder->documents[*(const uint32_t*)b];
+    if (x->downloads != y->downloads) return x->downloads > y->downloads ? -1 : 1;
+    return strcmp(x->fields[0], y->fields[0]);
+}
+
+static uint64_t align8(uint64_t offset) {
+    return (offset + 7) & ~(uint64_t)7;
+}
+
+static bool write_section(FILE* f, const void* data, size_t size, uint64_t offset) {
+    static const char zeros[8] = {0};
+    long position = ftell(f);
+    if (position < 0 || (uint64_t)position > offset) return false;
+    if (fwrite(zeros, 1, offset - (uint64_t)position, f) != offset - (uint64_t)position) return false;
+    return size == 0 || fwrite(data, 1, size, f) == size;
+}
+
+CPM_Result cpm_search_index_builder_write(CPM_SearchIndexBuilder* builder, const char* path, uint64_t stamp) {
+    if (!builder || !path) return CPM_RESULT_ERROR_INVALID_ARGS;
+    
+    size_t doc_count = builder->doc_count;
+    size_t term_count = builder->term_count;
+    BuildTerm** sorted = malloc((term_count ? term_count : 1) * sizeof(BuildTerm*));
+    IndexDocument* documents = calloc(doc_count ? doc_count : 1, sizeof(IndexDocument));
+    IndexTerm* terms = calloc(term_count ? term_count : 1, sizeof(IndexTerm));
+    StringBlob blob = {0};
+    uint64_t* gram_pairs = NULL;
+    IndexPosting* postings = NULL;
+    IndexGram* grams = NULL;
+    uint32_t* gram_terms = NULL;
+    CPM_Result result = CPM_RESULT_ERROR_MEMORY_ALLOCATION;
+    bool ok = sorted && documents && terms;
+    
+    // Documents, and the average field lengths BM25 normalizes by
+    IndexHeader header = {0};
+    double total_length[FIELD_COUNT] = {0};
+    double average_length[FIELD_COUNT];
+    for (size_t i = 0; ok && i < doc_count; i++) {
+        const BuildDocument* doc = &builder->documents[i];
+        uint32_t* offsets[5] = { &documents[i].name, &documents[i].version, &documents[i].description,
+                                 &documents[i].author, &documents[i].homepage };
+        for (size_t f = 0; f < 5 && ok; f++) *offsets[f] = blob_add(&blob, doc->fields[f], strlen(doc->fields[f]), &ok);
+        documents[i].downloads = doc->downloads;
+        for (int f = 0; f < FIELD_COUNT; f++) total_length[f] += doc->length[f];
+    }
+    for (int f = 0; f < FIELD_COUNT; f++) {
+        average_length[f] = doc_count && total_length[f] > 0 ? total_length[f] / (double)doc_count : 1.0;
+    }
+    
+    // Most downloaded first, ties by name, as queries rank equal scores
+    uint32_t* popular = malloc((doc_count ? doc_count : 1) * sizeof(uint32_t));
+    ok = ok && popular;
+    for (size_t i = 0; ok && i < doc_count; i++) popular[i] = (uint32_t)i;
+    if (ok) qsort_r(popular, doc_count, sizeof(uint32_t), compare_popular, builder);
+    
+    // Terms in byte order, postings laid out in the same order
+    size_t posting_count = 0;
+    size_t gram_pair_count = 0;
+    if (ok) {
+        size_t n = 0;
+        for (size_t i = 0; i < builder->slot_count; i++) {
+            if (builder->slots[i]) sorted[n++] = builder->slots[i];
+        }
+        qsort(sorted, term_count, sizeof(BuildTerm*), compare_terms);
+        for (size_t i = 0; i < term_count; i++) {
+            posting_count += sorted[i]->count;
+            if (sorted[i]->length >= 3) gram_pair_count += sorted[i]->length - 2;
+        }
+        postings = malloc((posting_count ? posting_count : 1) * sizeof(IndexPosting));
+        gram_pairs = malloc((gram_pair_count ? gram_pair_count : 1) * sizeof(uint64_t));
+        ok = postings && gram_pairs && posting_count <= UINT32_MAX;
+    }
+    
+    size_t next_posting = 0;
+    size_t pairs = 0;
+    for (size_t i = 0; ok && i < term_count; i++) {
+        const BuildTerm* term = sorted[i];
+        terms[i].text = blob_add(&blob, term->text, term->length, &ok);
+        terms[i].length = (uint16_t)term->length;
+        terms[i].postings = (uint32_t)next_posting;
+        terms[i].count = (uint32_t)term->count;
+        for (size_t p = 0; p < term->count; p++) {
+            const BuildPosting* posting = &term->postings[p];
+            const BuildDocument* doc = &builder->documents[posting->doc];
+            double tf = 0;
+            for (int f = 0; f < FIELD_COUNT; f++) {
+                if (!posting->tf[f]) continue;
+                tf += field_weight[f] * posting->tf[f] / (1.0 - BM25_B + BM25_B * doc->length[f] / average_length[f]);
+            }
+            postings[next_posting + p] = (IndexPosting){ posting->doc, (float)tf };
+        }
+        next_posting += term->count;
+        for (size_t g = 0; g + 3 <= term->length; g++) {
+            gram_pairs[pairs++] = (uint64_t)gram_at(term->text + g) << 32 | (uint32_t)i;
+        }
+    }
+    
+    // Trigram -> terms, each term listed once per trigram
+    size_t gram_count = 0;
+    size_t gram_term_count = 0;
+    if (ok) {
+        qsort(gram_pairs, pairs, sizeof(uint64_t), compare_u64);
+        grams = malloc((pairs ? pairs : 1) * sizeof(IndexGram));
+        gram_terms = malloc((pairs ? pairs : 1) * sizeof(uint32_t));
+        ok = grams && gram_terms;
+    }
+    for (size_t i = 0; ok && i < pairs; i++) {
+        if (i > 0 && gram_pairs[i] == gram_pairs[i - 1]) continue;
+        uint32_t gram = (uint32_t)(gram_pairs[i] >> 32);
+        if (gram_count == 0 || grams[gram_count - 1].gram != gram) {
+            grams[gram_count].gram = gram;
+            grams[gram_count].terms = (uint32_t)gram_term_count;
+            grams[gram_count].count = 0;
+            gram_count++;
+        }
+        gram_terms[gram_term_count++] = (uint32_t)gram_pairs[i];
+        grams[gram_count - 1].count++;
+    }
+    
+    if (ok) {
+        memcpy(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+        header.version = INDEX_VERSION;
+        header.byte_order = INDEX_BYTE_ORDER;
+        header.stamp = stamp;
+        header.doc_count = (uint32_t)doc_count;
+        header.term_count = (uint32_t)term_count;
+        header.gram_count = (uint32_t)gram_count;
+        header.posting_count = posting_count;
+        header.gram_term_count = gram_term_count;
+        header.documents = align8(sizeof(IndexHeader));
+        header.popular = align8(header.documents + doc_count * sizeof(IndexDocument));
+        header.terms = align8(header.popular + doc_count * sizeof(uint32_t));
+        header.postings = align8(header.terms + term_count * sizeof(IndexTerm));
+        header.grams = align8(header.postings + posting_count * sizeof(IndexPosting));
+        header.gram_terms = align8(header.grams + gram_count * sizeof(IndexGram));
+        header.strings = align8(header.gram_terms + gram_term_count * sizeof(uint32_t));
+        header.strings_size = blob.size;
+        header.file_size = header.strings + blob.size;
+        
+        char* temp = NULL;
+        result = CPM_RESULT_ERROR_FILE_OPERATION;
+        if (asprintf(&temp, "%s.tmp.%ld", path, (long)getpid()) >= 0) {
+            FILE* f = fopen(temp, "wb");
+            bool written = f &&
+                write_section(f, &header, sizeof(header), 0) &&
+                write_section(f, documents, doc_count * sizeof(IndexDocument), header.documents) &&
+                write_section(f, popular, doc_count * sizeof(uint32_t), header.popular) &&
+                write_section(f, terms, term_count * sizeof(IndexTerm), header.terms) &&
+                write_section(f, postings, posting_count * sizeof(IndexPosting), header.postings) &&
+                write_section(f, grams, gram_count * sizeof(IndexGram), header.grams) &&
+                write_section(f, gram_terms, gram_term_count * sizeof(uint32_t), header.gram_terms) &&
+                write_section(f, blob.data, blob.size, header.strings);
+            if (f && fclose(f) != 0) written = false;
+            if (written && rename(temp, path) == 0) {
+                result = CPM_RESULT_SUCCESS;
+            } else {
+                unlink(temp);
+            }
+            free(temp);
+        }
+    }
+    
+    free(sorted);
+    free(documents);
+    free(popular);
+    free(terms);
+    free(postings);
+    free(gram_pairs);
+    free(grams);
+    free(gram_terms);
+    free(blob.data);
+    return result;
+}
+
+// --- Opening ---
+struct CPM_SearchIndex {
+    void* map;
+    size_t size;
+    const IndexHeader* header;
+    const IndexDocument* documents;
+    const uint32_t* popular;
+    const IndexTerm* terms;
+    const IndexPosting* postings;
+    const IndexGram* grams;
+    const uint32_t* gram_terms;
+    const char* strings;
+};
+
+static bool section_fits(const IndexHeader* h, uint64_t offset, uint64_t count, size_t size) {
+    return offset % 8 == 0 && offset <= h->file_size && count <= (h->file_size - offset) / size;
+}
+
+// Every offset the queries follow must stay inside the mapping
+static bool index_validate(const CPM_SearchIndex* index) {
+    const IndexHeader* h = index->header;
+    if (memcmp(h->magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0 || h->version != INDEX_VERSION ||
+        h->byte_order != INDEX_BYTE_ORDER || h->file_size != index->size) return false;
+    if (!section_fits(h, h->documents, h->doc_count, sizeof(IndexDocument)) ||
+        !section_fits(h, h->popular, h->doc_count, sizeof(uint32_t)) ||
+        !section_fits(h, h->terms, h->term_count, sizeof(IndexTerm)) ||
+        !section_fits(h, h->postings, h->posting_count, sizeof(IndexPosting)) ||
+        !section_fits(h, h->grams, h->gram_count, sizeof(IndexGram)) ||
+        !section_fits(h, h->gram_terms, h->gram_term_count, sizeof(uint32_t)) ||
+        h->strings > h->file_size || h->strings_size != h->file_size - h->strings) return false;
+    if (h->strings_size > 0 && index->strings[h->strings_size - 1] != '\0') return false;
+    
+    for (uint32_t i = 0; i < h->doc_count; i++) {
+        const IndexDocument* d = &index->documents[i];
+        if (d->name >= h->strings_size || d->version >= h->strings_size || d->description >= h->strings_size ||
+            d->author >= h->strings_size || d->homepage >= h->strings_size) return false;
+        if (index->popular[i] >= h->doc_count) return false;
+    }
+    for (uint32_t i = 0; i < h->term_count; i++) {
+        const IndexTerm* t = &index->terms[i];
+        if (t->text >= h->strings_size || t->length > h->strings_size - t->text - 1 ||
+            t->postings > h->posting_count || t->count > h->posting_count - t->postings) return false;
+    }
+    for (uint64_t i = 0; i < h->posting_count; i++) {
+        if (index->postings[i].doc >= h->doc_count || !(index->postings[i].tf >= 0)) return false;
+    }
+    for (uint32_t i = 0; i < h->gram_count; i++) {
+        const IndexGram* g = &index->grams[i];
+        if (g->terms > h->gram_term_count || g->count > h->gram_term_count - g->terms) return false;
+    }
+    for (uint64_t i = 0; i < h->gram_term_count; i++) {
+        if (index->gram_terms[i] >= h->term_count) return false;
+    }
+    return true;
+}
+
+CPM_SearchIndex* cpm_search_index_open(const char* path) {
+    int fd = path ? open(path, O_RDONLY | O_CLOEXEC) : -1;
+    if (fd < 0) return NULL;
+    
+    struct stat st;
+    CPM_SearchIndex* index = NULL;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(IndexHeader)) {
+        void* map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (map != MAP_FAILED) {
+            index = calloc(1, sizeof(CPM_SearchIndex));
+            if (index) {
+                const char* base = map;
+                const IndexHeader* h = map;
+                index->map = map;
+                index->size = (size_t)st.st_size;
+                index->header = h;
+                index->documents = (const IndexDocument*)(base + (h->documents < index->size ? h->documents : 0));
+                index->popular = (const uint32_t*)(base + (h->popular < index->size ? h->popular : 0));
+                index->terms = (const IndexTerm*)(base + (h->terms < index->size ? h->terms : 0));
+                index->postings = (const IndexPosting*)(base + (h->postings < index->size ? h->postings : 0));
+                index->grams = (const IndexGram*)(base + (h->grams < index->size ? h->grams : 0));
+                index->gram_terms = (const uint32_t*)(base + (h->gram_terms < index->size ? h->gram_terms : 0));
+                index->strings = base + (h->strings <= index->size ? h->strings : 0);
+            }
+            if (!index || !index_validate(index)) {
+                munmap(map, (size_t)st.st_size);
+                free(index);
+                index = NULL;
+            }
+        }
+    }
+    close(fd);
+    return index;
+}
+
+void cpm_search_index_close(CPM_SearchIndex* index) {
+    if (!index) return;
+    munmap(index->map, index->size);
+    free(index);
+}
+
+uint64_t cpm_search_index_stamp(const CPM_SearchIndex* index) {
+    return index ? index->header->stamp : 0;
+}
+
+size_t cpm_search_index_document_count(const CPM_SearchIndex* index) {
+    return index ? index->header->doc_count : 0;
+}
+
+// --- Matching ---
+typedef struct {
+    uint32_t term;
+    double weight;
+} TermMatch;
+
+typedef struct {
+    TermMatch* items;
+    size_t count;
+    size_t capacity;            // Fixed; when full, a better match replaces the worst
+    size_t worst;
+} MatchList;
+
+static void match_offer(MatchList* list, uint32_t term, double weight) {
+    if (list->count < list->capacity) {
+        if (list->count == 0 || weight < list->items[list->worst].weight) list->worst = list->count;
+        list->items[list->count++] = (TermMatch){ term, weight };
+        return;
+    }
+    if (weight <= list->items[list->worst].weight) return;
+    list->items[list->worst] = (TermMatch){ term, weight };
+    for (size_t i = 0; i < list->count; i++) {
+        if (list->items[i].weight < list->items[list->worst].weight) list->worst = i;
+    }
+}
+
+static const char* term_text(const CPM_SearchIndex* index, uint32_t term) {
+    return index->strings + index->terms[term].text;
+}
+
+// First term not ordered before token
+static uint32_t term_lower_bound(const CPM_SearchIndex* index, const char* token) {
+    uint32_t lo = 0, hi = index->header->term_count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (strcmp(term_text(index, mid), token) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+static const IndexGram* gram_find(const CPM_SearchIndex* index, uint32_t gram) {
+    uint32_t lo = 0, hi = index->header->gram_count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (index->grams[mid].gram < gram) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo < index->header->gram_count && index->grams[lo].gram == gram ? &index->grams[lo] : NULL;
+}
+
+// True if one insertion, deletion, substitution or adjacent swap turns a
+// into b: what is left after their common prefix and suffix is that edit
+static bool within_one_typo(const char* a, size_t a_length, const char* b, size_t b_length) {
+    size_t shorter = a_length < b_length ? a_length : b_length;
+    size_t head = 0;
+    while (head < shorter && a[head] == b[head]) head++;
+    size_t tail = 0;
+    while (tail < shorter - head && a[a_length - 1 - tail] == b[b_length - 1 - tail]) tail++;
+    size_t a_rest = a_length - head - tail;
+    size_t b_rest = b_length - head - tail;
+    if (a_rest <= 1 && b_rest <= 1) return true;
+    return a_rest == 2 && b_rest == 2 && a[head] == b[head + 1] && a[head + 1] == b[head];
+}
+
+// Exact term, then completions of the token, then terms containing it or a
+// typo away from it. shared is per-term scratch, all zero on entry and exit.
+static void match_token(const CPM_SearchIndex* index, const char* token, size_t length, uint8_t* shared,
+                        uint32_t* touched, TermMatch* out, size_t* out_count) {
+    TermMatch prefix_items[MATCH_PREFIX_MAX];
+    TermMatch fuzzy_items[MATCH_FUZZY_MAX];
+    MatchList prefix = { prefix_items, 0, MATCH_PREFIX_MAX, 0 };
+    MatchList fuzzy = { fuzzy_items, 0, MATCH_FUZZY_MAX, 0 };
+    *out_count = 0;
+    
+    uint32_t first = term_lower_bound(index, token);
+    uint32_t exact = UINT32_MAX;
+    if (first < index->header->term_count && strcmp(term_text(index, first), token) == 0) {
+        exact = first;
+        out[(*out_count)++] = (TermMatch){ first, 1.0 };
+    }
+    
+    // Completions: a contiguous run of terms; shorter ones are closer to what was typed
+    uint32_t prefix_end = first;
+    if (length >= MATCH_PREFIX_MIN) {
+        for (uint32_t t = first; t < index->header->term_count && strncmp(term_text(index, t), token, length) == 0; t++) {
+            prefix_end = t + 1;
+            if (t == exact) continue;
+            double closeness = (double)length / index->terms[t].length;
+            match_offer(&prefix, t, (0.4 + 0.4 * closeness) * (1.0 + log1p(index->terms[t].count) / 32.0));
+        }
+    }
+    
+    if (length >= MATCH_GRAM_MIN) {
+        // Count the token's distinct trigrams in every term that has any
+        size_t grams = 0;
+        size_t touched_count = 0;
+        uint32_t seen[INDEX_TOKEN_MAX];
+        for (size_t g = 0; g + 3 <= length; g++) {
+            uint32_t gram = gram_at(token + g);
+            bool repeat = false;
+            for (size_t s = 0; s < grams && !repeat; s++) repeat = seen[s] == gram;
+            if (repeat) continue;
+            seen[grams++] = gram;
+            
+            const IndexGram* entry = gram_find(index, gram);
+            for (uint32_t i = 0; entry && i < entry->count; i++) {
+                uint32_t t = index->gram_terms[entry->terms + i];
+                if (shared[t]++ == 0) touched[touched_count++] = t;
+            }
+        }
+        
+        for (size_t i = 0; i < touched_count; i++) {
+            uint32_t t = touched[i];
+            size_t common = shared[t];
+            shared[t] = 0;
+            if (t == exact || (t >= first && t < prefix_end)) continue;
+            
+            size_t term_grams = index->terms[t].length - 2;
+            if (common == grams && strstr(term_text(index, t), token)) {
+                match_offer(&fuzzy, t, 0.5 * (double)length / index->terms[t].length + 0.2);
+                continue;
+            }
+            double similarity = 2.0 * (double)common / (double)(grams + term_grams);
+            if (similarity < MATCH_TYPO_SIMILARITY) {
+                // A typo mid-word breaks most trigrams of a short word; check the edit itself
+                size_t term_length = index->terms[t].length;
+                size_t diff = term_length > length ? term_length - length : length - term_length;
+                // Only for tokens that are not terms themselves; one edit
+                // touches at most three of the token's trigrams
+                if (exact != UINT32_MAX || diff > 1 || common + 3 < grams ||
+                    !within_one_typo(token, length, term_text(index, t), term_length)) continue;
+                similarity = MATCH_TYPO_SIMILARITY;
+            }
+            match_offer(&fuzzy, t, 0.45 * similarity);
+        }
+    }
+    
+    memcpy(out + *out_count, prefix.items, prefix.count * sizeof(TermMatch));
+    *out_count += prefix.count;
+    memcpy(out + *out_count, fuzzy.items, fuzzy.count * sizeof(TermMatch));
+    *out_count += fuzzy.count;
+}
+
+// --- Ranking ---
+typedef struct {
+    uint32_t doc;
+    double score;
+} Ranked;
+
+// Better first: score, then downloads, then name
+static bool ranked_before(const CPM_SearchIndex* index, const Ranked* a, const Ranked* b) {
+    if (a->score != b->score) return a->score > b->score;
+    const IndexDocument* x = &index->documents[a->doc];
+    const IndexDocument* y = &index->documents[b->doc];
+    if (x->downloads != y->downloads) return x->downloads > y->downloads;
+    return strcmp(index->strings + x->name, index->strings + y->name) < 0;
+}
+
+// heap[0] is the worst of the best `limit` seen so far
+static void heap_offer(const CPM_SearchIndex* index, Ranked* heap, size_t* count, size_t limit, Ranked item) {
+    if (limit == 0) return;
+    size_t i;
+    if (*count < limit) {
+        i = (*count)++;
+        while (i > 0 && ranked_before(index, &heap[(i - 1) / 2], &item)) {
+            heap[i] = heap[(i - 1) / 2];
+            i = (i - 1) / 2;
+        }
+        heap[i] = item;
+        return;
+    }
+    if (!ranked_before(index, &item, &heap[0])) return;
+    i = 0;
+    for (;;) {
+        size_t child = 2 * i + 1;
+        if (child >= *count) break;
+        if (child + 1 < *count && ranked_before(index, &heap[child], &heap[child + 1])) child++;
+        if (!ranked_before(index, &item, &heap[child])) break;
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = item;
+}
+
+static void hit_fill(const CPM_SearchIndex* index, CPM_SearchHit* hit, uint32_t doc, double score) {
+    const IndexDocument* d = &index->documents[doc];
+    hit->document = (CPM_SearchDocument){
+        .name = index->strings + d->name,
+        .version = index->strings + d->version,
+        .description = index->strings + d->description,
+        .author = index->strings + d->author,
+        .homepage = index->strings + d->homepage,
+        .downloads = d->downloads,
+    };
+    hit->score = score;
+}
+
+// Per-thread buffers sized to the largest index queried; between queries
+// scores, best, hit_mask and shared are all zero
+typedef struct {
+    size_t doc_capacity;
+    size_t term_capacity;
+    float* scores;              // Per document: summed over query tokens
+    float* best;                // Per document: best term of the current token
+    uint16_t* hit_mask;         // Per document: query tokens that matched
+    uint32_t* docs;             // Documents with any match
+    uint32_t* token_docs;       // Documents the current token matched
+    uint8_t* shared;            // Per term: trigrams shared with the current token
+    uint32_t* touched_terms;
+} QueryScratch;
+
+static pthread_key_t scratch_key;
+static pthread_once_t scratch_once = PTHREAD_ONCE_INIT;
+static bool scratch_key_ready = false;
+
+static void scratch_free(void* data) {
+    QueryScratch* scratch = data;
+    if (!scratch) return;
+    free(scratch->scores);
+    free(scratch->best);
+    free(scratch->hit_mask);
+    free(scratch->docs);
+    free(scratch->token_docs);
+    free(scratch->shared);
+    free(scratch->touched_terms);
+    free(scratch);
+}
+
+static void scratch_key_create(void) {
+    scratch_key_ready = pthread_key_create(&scratch_key, scratch_free) == 0;
+}
+
+static QueryScratch* scratch_get(size_t doc_count, size_t term_count) {
+    pthread_once(&scratch_once, scratch_key_create);
+    if (!scratch_key_ready) return NULL;
+    
+    QueryScratch* scratch = pthread_getspecific(scratch_key);
+    if (scratch && scratch->doc_capacity >= doc_count && scratch->term_capacity >= term_count) return scratch;
+    
+    // Grown buffers start zeroed, keeping the invariant
+    scratch_free(scratch);
+    pthread_setspecific(scratch_key, NULL);
+    scratch = calloc(1, sizeof(QueryScratch));
+    if (!scratch) return NULL;
+    size_t docs = doc_count ? doc_count : 1;
+    size_t terms = term_count ? term_count : 1;
+    scratch->doc_capacity = docs;
+    scratch->term_capacity = terms;
+    scratch->scores = calloc(docs, sizeof(float));
+    scratch->best = calloc(docs, sizeof(float));
+    scratch->hit_mask = calloc(docs, sizeof(uint16_t));
+    scratch->docs = malloc(docs * sizeof(uint32_t));
+    scratch->token_docs = malloc(docs * sizeof(uint32_t));
+    scratch->shared = calloc(terms, 1);
+    scratch->touched_terms = malloc(terms * sizeof(uint32_t));
+    if (!scratch->scores || !scratch->best || !scratch->hit_mask || !scratch->docs || !scratch->token_docs ||
+        !scratch->shared || !scratch->touched_terms || pthread_setspecific(scratch_key, scratch) != 0) {
+        scratch_free(scratch);
+        return NULL;
+    }
+    return scratch;
+}
+
+// Fills `heap` with the best `limit` documents any query token matched
+static size_t query_tokens(const CPM_SearchIndex* index, QueryScratch* scratch,
+                           char tokens[][INDEX_TOKEN_MAX + 1], const size_t* lengths, size_t token_count,
+                           Ranked* heap, size_t* heap_count, size_t limit) {
+    const IndexHeader* h = index->header;
+    TermMatch matches[1 + MATCH_PREFIX_MAX + MATCH_FUZZY_MAX];
+    size_t matched = 0;
+    
+    for (size_t q = 0; q < token_count; q++) {
+        size_t match_count = 0;
+        match_token(index, tokens[q], lengths[q], scratch->shared, scratch->touched_terms, matches, &match_count);
+        
+        // A document counts its best matching term per token, not their sum
+        size_t token_doc_count = 0;
+        for (size_t m = 0; m < match_count; m++) {
+            const IndexTerm* term = &index->terms[matches[m].term];
+            double df = term->count;
+            double idf = log(1.0 + (h->doc_count - df + 0.5) / (df + 0.5));
+            float factor = (float)(matches[m].weight * idf * (BM25_K1 + 1.0));
+            const IndexPosting* posting = &index->postings[term->postings];
+            for (uint32_t i = 0; i < term->count; i++, posting++) {
+                float score = factor * posting->tf / (posting->tf + (float)BM25_K1);
+                float* best = &scratch->best[posting->doc];
+                if (*best == 0) scratch->token_docs[token_doc_count++] = posting->doc;
+                if (score > *best) *best = score;
+            }
+        }
+        for (size_t i = 0; i < token_doc_count; i++) {
+            uint32_t d = scratch->token_docs[i];
+            if (scratch->hit_mask[d] == 0) scratch->docs[matched++] = d;
+            scratch->scores[d] += scratch->best[d];
+            scratch->hit_mask[d] |= (uint16_t)(1u << q);
+            scratch->best[d] = 0;
+        }
+    }
+    
+    // Documents matching more of the query rank higher (coordination)
+    for (size_t i = 0; i < matched; i++) {
+        uint32_t d = scratch->docs[i];
+        double coverage = (double)__builtin_popcount(scratch->hit_mask[d]) / (double)token_count;
+        heap_offer(index, heap, heap_count, limit, (Ranked){ d, scratch->scores[d] * coverage * coverage });
+        scratch->scores[d] = 0;
+        scratch->hit_mask[d] = 0;
+    }
+    return matched;
+}
+
+size_t cpm_search_index_query(const CPM_SearchIndex* index, const char* query, CPM_SearchHit* hits, size_t limit,
+                              size_t* total) {
+    if (total) *total = 0;
+    if (!index || !hits) return 0;
+    const IndexHeader* h = index->header;
+    
+    char tokens[INDEX_QUERY_TOKENS][INDEX_TOKEN_MAX + 1];
+    size_t lengths[INDEX_QUERY_TOKENS];
+    size_t token_count = 0;
+    const char* p = query ? query : "";
+    while (token_count < INDEX_QUERY_TOKENS && next_token(&p, tokens[token_count], &lengths[token_count])) {
+        bool repeat = false;
+        for (size_t i = 0; i < token_count && !repeat; i++) repeat = strcmp(tokens[i], tokens[token_count]) == 0;
+        if (!repeat) token_count++;
+    }
+    
+    // Nothing to match: the most downloaded, precomputed
+    if (token_count == 0) {
+        size_t count = limit < h->doc_count ? limit : h->doc_count;
+        for (size_t i = 0; i < count; i++) {
+            hit_fill(index, &hits[i], index->popular[i], 0);
+        }
+        if (total) *total = h->doc_count;
+        return count;
+    }
+    
+    QueryScratch* scratch = scratch_get(h->doc_count, h->term_count);
+    Ranked* heap = malloc((limit ? limit : 1) * sizeof(Ranked));
+    if (!scratch || !heap) {
+        free(heap);
+        return 0;
+    }
+    size_t heap_count = 0;
+    size_t matched = query_tokens(index, scratch, tokens, lengths, token_count, heap, &heap_count, limit);
+    
+    // Heap order to best-first
+    for (size_t n = heap_count; n > 1; n--) {
+        Ranked worst = heap[0];
+        size_t remaining = n - 1;
+        Ranked last = heap[remaining];
+        size_t i = 0;
+        for (;;) {
+            size_t child = 2 * i + 1;
+            if (child >= remaining) break;
+            if (child + 1 < remaining && ranked_before(index, &heap[child], &heap[child + 1])) child++;
+            if (!ranked_before(index, &last, &heap[child])) break;
+            heap[i] = heap[child];
+            i = child;
+        }
+        heap[i] = last;
+        heap[remaining] = worst;
+    }
+    
+    for (size_t i = 0; i < heap_count; i++) hit_fill(index, &hits[i], heap[i].doc, heap[i].score);
+    free(heap);
+    if (total) *total = matched;
+    return heap_count;
+}
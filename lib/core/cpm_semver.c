@@ -277,6 +277,42 @@ bool semver_satisfies(const SemVer* version, const VersionConstraint* constraint
     return false;
 }
 
+char* semver_constraint_to_string(const VersionConstraint* constraint) {
+    if (!constraint) return NULL;
+    if (constraint->type == CONSTRAINT_ANY) return strdup("*");
+    
+    char* version = semver_to_string(constraint->version);
+    if (!version) return NULL;
+    
+    char* result = malloc(520);
+    if (!result) {
+        free(version);
+        return NULL;
+    }
+    
+    const char* prefix = "";
+    switch (constraint->type) {
+        case CONSTRAINT_COMPATIBLE: prefix = "^"; break;
+        case CONSTRAINT_TILDE:      prefix = "~"; break;
+        case CONSTRAINT_GREATER:    prefix = ">"; break;
+        case CONSTRAINT_GREATER_EQ: prefix = ">="; break;
+        case CONSTRAINT_LESS:       prefix = "<"; break;
+        case CONSTRAINT_LESS_EQ:    prefix = "<="; break;
+        default: break;
+    }
+    
+    if (constraint->type == CONSTRAINT_RANGE) {
+        char* version_max = semver_to_string(constraint->version_max);
+        snprintf(result, 520, "%s - %s", version, version_max ? version_max : "?");
+        free(version_max);
+    } else {
+        snprintf(result, 520, "%s%s", prefix, version);
+    }
+    
+    free(version);
+    return result;
+}
+
 // --- Version Utilities ---
 bool semver_is_valid(const char* version_string) {
     SemVer* version = semver_parse(version_string);
@@ -0,0 +1,1023 @@
+/*
+ * File: lib/core/cpm_solver.c
+ * Description: Conflict-driven version solver for CPM (PubGrub-style).
+ * Every package's known versions form a finite domain, so a term ("libfoo is
+ * 1.2.0 or 1.3.0", "libfoo is not ^2.0.0") is a bitset over that domain plus
+ * one extra bit for "not selected". The solver alternates unit propagation over
+ * incompatibilities with decisions (newest allowed version of the most
+ * constrained package); each conflict is resolved into a new incompatibility
+ * that is kept for the rest of the search and lets it backjump past every
+ * decision that played no part.
+ * Author: Dr. Q Josef Kurk Edwards
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include "cpm_solver.h"
+
+// Search budget: a graph this hard is reported as unsolvable rather than spun on
+#define SOLVER_MAX_CONFLICTS 100000
+// Version sets this small are spelled out in explanations
+#define SOLVER_MAX_LISTED_VERSIONS 3
+
+// --- Solver State ---
+typedef struct {
+    char* name;
+    SemVer** versions;          // Newest first, borrowed from the provider
+    size_t version_count;
+    size_t words;               // Bitset words: one bit per version plus the "not selected" bit
+    uint64_t* accumulated;      // Intersection of every assignment to this package
+    uint64_t* expanded;         // Versions whose dependencies were turned into incompatibilities
+    int* incompats;             // Incompatibilities mentioning this package
+    size_t incompat_count;
+    size_t incompat_capacity;
+    int decision;               // Decided version index, -1 if undecided
+} SolverPackage;
+
+typedef struct {
+    int package;
+    uint64_t* set;
+} Term;
+
+typedef enum {
+    INCOMPAT_ROOT,              // The root package must be selected
+    INCOMPAT_DEPENDENCY,        // A package version depends on a constraint
+    INCOMPAT_UNAVAILABLE,       // A package has no usable versions
+    INCOMPAT_DERIVED            // Learned from two others during conflict resolution
+} IncompatKind;
+
+// "These terms can't all be true at once"
+typedef struct {
+    Term* terms;
+    size_t term_count;
+    IncompatKind kind;
+    char* description;          // External incompatibilities only
+    int cause1;                 // Derived incompatibilities only
+    int cause2;
+} Incompat;
+
+typedef struct {
+    int package;
+    uint64_t* set;
+    int level;                  // Decision level it was made at
+    int cause;                  // Incompatibility it was derived from, -1 for decisions
+    bool decision;
+} Assignment;
+
+typedef struct {
+    const SolverProvider* provider;
+    SolverResult* result;
+    
+    SolverPackage* packages;
+    size_t package_count;
+    size_t package_capacity;
+    int* index;                 // Open addressing name -> package, -1 = empty
+    size_t index_capacity;      // Power of two
+    
+    Incompat* incompats;
+    size_t incompat_count;
+    size_t incompat_capacity;
+    
+    Assignment* assignments;    // The partial solution, in assignment order
+    size_t assignment_count;
+    size_t assignment_capacity;
+    int level;
+    
+    int failure;                // Incompatibility proving there is no solution
+} Solver;
+
+typedef enum {
+    RELATION_SATISFIED,
+    RELATION_CONTRADICTED,
+    RELATION_INCONCLUSIVE
+} Relation;
+
+// --- Version Bitsets ---
+static bool bits_test(const uint64_t* set, size_t bit) {
+    return (set[bit / 64] >> (bit % 64)) & 1;
+}
+
+static void bits_set(uint64_t* set, size_t bit) {
+    set[bit / 64] |= 1ULL << (bit % 64);
+}
+
+static void bits_fill(const SolverPackage* pkg, uint64_t* set) {
+    size_t bits = pkg->version_count + 1;
+    for (size_t w = 0; w < pkg->words; w++) set[w] = ~0ULL;
+    if (bits % 64) set[pkg->words - 1] = (1ULL << (bits % 64)) - 1;
+}
+
+static uint64_t* bits_full(const SolverPackage* pkg) {
+    uint64_t* set = malloc(pkg->words * sizeof(uint64_t));
+    if (set) bits_fill(pkg, set);
+    return set;
+}
+
+static uint64_t* bits_copy(const SolverPackage* pkg, const uint64_t* src) {
+    uint64_t* set = malloc(pkg->words * sizeof(uint64_t));
+    if (set) memcpy(set, src, pkg->words * sizeof(uint64_t));
+    return set;
+}
+
+// Everything in the package's domain that is not in src
+static uint64_t* bits_complement(const SolverPackage* pkg, const uint64_t* src) {
+    uint64_t* set = bits_full(pkg);
+    if (set) {
+        for (size_t w = 0; w < pkg->words; w++) set[w] &= ~src[w];
+    }
+    return set;
+}
+
+static bool bits_subset(const uint64_t* a, const uint64_t* b, size_t words) {
+    for (size_t w = 0; w < words; w++) {
+        if (a[w] & ~b[w]) return false;
+    }
+    return true;
+}
+
+static bool bits_disjoint(const uint64_t* a, const uint64_t* b, size_t words) {
+    for (size_t w = 0; w < words; w++) {
+        if (a[w] & b[w]) return false;
+    }
+    return true;
+}
+
+static bool bits_empty(const uint64_t* set, size_t words) {
+    for (size_t w = 0; w < words; w++) {
+        if (set[w]) return false;
+    }
+    return true;
+}
+
+static bool bits_is_full(const SolverPackage* pkg, const uint64_t* set) {
+    size_t bits = pkg->version_count + 1;
+    for (size_t w = 0; w + 1 < pkg->words; w++) {
+        if (set[w] != ~0ULL) return false;
+    }
+    uint64_t last = (bits % 64) ? (1ULL << (bits % 64)) - 1 : ~0ULL;
+    return set[pkg->words - 1] == last;
+}
+
+static size_t bits_count_versions(const SolverPackage* pkg, const uint64_t* set) {
+    size_t count = 0;
+    for (size_t w = 0; w < pkg->words; w++) count += (size_t)__builtin_popcountll(set[w]);
+    return count - (bits_test(set, pkg->version_count) ? 1 : 0);
+}
+
+// A positive term requires the package to be selected
+static bool term_is_positive(const SolverPackage* pkg, const uint64_t* set) {
+    return !bits_test(set, pkg->version_count);
+}
+
+static Relation term_relation(const SolverPackage* pkg, const uint64_t* accumulated, const uint64_t* term) {
+    if (bits_subset(accumulated, term, pkg->words)) return RELATION_SATISFIED;
+    if (bits_disjoint(accumulated, term, pkg->words)) return RELATION_CONTRADICTED;
+    return RELATION_INCONCLUSIVE;
+}
+
+// --- Packages ---
+static uint64_t solver_hash(const char* key) {
+    uint64_t hash = 1469598103934665603ULL;
+    for (const unsigned char* p = (const unsigned char*)key; *p; p++) {
+        hash ^= *p;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static size_t solver_index_slot(const Solver* s, const int* index, size_t capacity, const char* name) {
+    size_t i = (size_t)solver_hash(name) & (capacity - 1);
+    while (index[i] >= 0 && strcmp(s->packages[index[i]].name, name) != 0) {
+        i = (i + 1) & (capacity - 1);
+    }
+    return i;
+}
+
+static bool solver_index_grow(Solver* s) {
+    size_t capacity = s->index_capacity ? s->index_capacity * 2 : 64;
+    int* index = malloc(capacity * sizeof(int));
+    if (!index) return false;
+    for (size_t i = 0; i < capacity; i++) index[i] = -1;
+    
+    for (size_t p = 0; p < s->package_count; p++) {
+        index[solver_index_slot(s, index, capacity, s->packages[p].name)] = (int)p;
+    }
+    free(s->index);
+    s->index = index;
+    s->index_capacity = capacity;
+    return true;
+}
+
+static int solver_add_package(Solver* s, const char* name, SemVer** versions, size_t version_count) {
+    if ((s->package_count + 1) * 2 > s->index_capacity && !solver_index_grow(s)) return -1;
+    if (s->package_count == s->package_capacity) {
+        size_t capacity = s->package_capacity ? s->package_capacity * 2 : 32;
+        SolverPackage* grown = realloc(s->packages, capacity * sizeof(SolverPackage));
+        if (!grown) return -1;
+        s->packages = grown;
+        s->package_capacity = capacity;
+    }
+    
+    SolverPackage* pkg = &s->packages[s->package_count];
+    memset(pkg, 0, sizeof(*pkg));
+    pkg->name = strdup(name);
+    pkg->versions = versions;
+    pkg->version_count = versions ? version_count : 0;
+    pkg->words = (pkg->version_count + 1 + 63) / 64;
+    pkg->accumulated = bits_full(pkg);
+    pkg->expanded = calloc(pkg->words, sizeof(uint64_t));
+    pkg->decision = -1;
+    if (!pkg->name || !pkg->accumulated || !pkg->expanded) {
+        free(pkg->name);
+        free(pkg->accumulated);
+        free(pkg->expanded);
+        return -1;
+    }
+    
+    int id = (int)s->package_count++;
+    s->index[solver_index_slot(s, s->index, s->index_capacity, name)] = id;
+    return id;
+}
+
+// Looks a package up, asking the provider for its versions the first time
+static int solver_package(Solver* s, const char* name) {
+    size_t slot = solver_index_slot(s, s->index, s->index_capacity, name);
+    if (s->index[slot] >= 0) return s->index[slot];
+    
+    size_t count = 0;
+    SemVer** versions = s->provider->get_versions(s->provider->context, name, &count);
+    return solver_add_package(s, name, versions, count);
+}
+
+// --- Incompatibilities ---
+// Terms are copied; terms on the same package are intersected. Returns -1 when
+// the incompatibility can never be satisfied and so carries no information.
+static int solver_add_incompat(Solver* s, const Term* terms, size_t term_count, IncompatKind kind,
+                               char* description, int cause1, int cause2) {
+    Term* merged = calloc(term_count ? term_count : 1, sizeof(Term));
+    size_t merged_count = 0;
+    bool vacuous = false;
+    if (!merged) {
+        free(description);
+        return -1;
+    }
+    
+    for (size_t i = 0; i < term_count; i++) {
+        const SolverPackage* pkg = &s->packages[terms[i].package];
+        size_t j = 0;
+        while (j < merged_count && merged[j].package != terms[i].package) j++;
+        
+        if (j == merged_count) {
+            merged[merged_count].package = terms[i].package;
+            merged[merged_count].set = bits_copy(pkg, terms[i].set);
+            if (!merged[merged_count++].set) vacuous = true;
+        } else {
+            for (size_t w = 0; w < pkg->words; w++) merged[j].set[w] &= terms[i].set[w];
+        }
+    }
+    
+    // A term nothing satisfies makes the whole incompatibility unsatisfiable;
+    // a term everything satisfies adds nothing to it
+    size_t kept = 0;
+    for (size_t i = 0; i < merged_count; i++) {
+        const SolverPackage* pkg = &s->packages[merged[i].package];
+        if (!merged[i].set || bits_empty(merged[i].set, pkg->words)) vacuous = true;
+        if (merged[i].set && bits_is_full(pkg, merged[i].set)) {
+            free(merged[i].set);
+            continue;
+        }
+        merged[kept++] = merged[i];
+    }
+    
+    if (!vacuous && s->incompat_count == s->incompat_capacity) {
+        size_t capacity = s->incompat_capacity ? s->incompat_capacity * 2 : 64;
+        Incompat* grown = realloc(s->incompats, capacity * sizeof(Incompat));
+        if (grown) {
+            s->incompats = grown;
+            s->incompat_capacity = capacity;
+        } else {
+            vacuous = true;
+        }
+    }
+    
+    if (vacuous) {
+        for (size_t i = 0; i < kept; i++) free(merged[i].set);
+        free(merged);
+        free(description);
+        return -1;
+    }
+    
+    int id = (int)s->incompat_count++;
+    s->incompats[id] = (Incompat){ merged, kept, kind, description, cause1, cause2 };
+    
+    for (size_t i = 0; i < kept; i++) {
+        SolverPackage* pkg = &s->packages[merged[i].package];
+        if (pkg->incompat_count == pkg->incompat_capacity) {
+            size_t capacity = pkg->incompat_capacity ? pkg->incompat_capacity * 2 : 8;
+            int* grown = realloc(pkg->incompats, capacity * sizeof(int));
+            if (!grown) continue;
+            pkg->incompats = grown;
+            pkg->incompat_capacity = capacity;
+        }
+        pkg->incompats[pkg->incompat_count++] = id;
+    }
+    return id;
+}
+
+// SATISFIED if the partial solution satisfies every term, CONTRADICTED if it
+// contradicts any; otherwise INCONCLUSIVE, with *open_term set to the only
+// term not yet satisfied (-1 if there are several).
+static Relation incompat_relation(const Solver* s, const Incompat* inc, int* open_term) {
+    *open_term = -1;
+    int open = 0;
+    
+    for (size_t i = 0; i < inc->term_count; i++) {
+        const SolverPackage* pkg = &s->packages[inc->terms[i].package];
+        Relation relation = term_relation(pkg, pkg->accumulated, inc->terms[i].set);
+        if (relation == RELATION_CONTRADICTED) return RELATION_CONTRADICTED;
+        if (relation == RELATION_INCONCLUSIVE) {
+            open++;
+            *open_term = (int)i;
+        }
+    }
+    
+    if (open == 0) return RELATION_SATISFIED;
+    if (open > 1) *open_term = -1;
+    return RELATION_INCONCLUSIVE;
+}
+
+// No terms, or only "the root package is selected": nothing can be solved
+static bool incompat_is_failure(const Incompat* inc) {
+    if (inc->term_count == 0) return true;
+    return inc->term_count == 1 && inc->terms[0].package == 0 && !bits_test(inc->terms[0].set, 1);
+}
+
+// --- Partial Solution ---
+static bool solver_assign(Solver* s, int package, uint64_t* set, int cause, bool decision) {
+    if (!set) return false;
+    if (s->assignment_count == s->assignment_capacity) {
+        size_t capacity = s->assignment_capacity ? s->assignment_capacity * 2 : 64;
+        Assignment* grown = realloc(s->assignments, capacity * sizeof(Assignment));
+        if (!grown) {
+            free(set);
+            return false;
+        }
+        s->assignments = grown;
+        s->assignment_capacity = capacity;
+    }
+    
+    s->assignments[s->assignment_count++] = (Assignment){ package, set, s->level, cause, decision };
+    
+    SolverPackage* pkg = &s->packages[package];
+    for (size_t w = 0; w < pkg->words; w++) pkg->accumulated[w] &= set[w];
+    return true;
+}
+
+// Derives the negation of an incompatibility's last open term
+static bool solver_derive(Solver* s, int incompat, int term_index) {
+    const Term* term = &s->incompats[incompat].terms[term_index];
+    return solver_assign(s, term->package, bits_complement(&s->packages[term->package], term->set), incompat, false);
+}
+
+// Undoes every assignment made above the given decision level
+static void solver_backtrack(Solver* s, int level) {
+    if (level >= s->level) return;
+    
+    while (s->assignment_count > 0 && s->assignments[s->assignment_count - 1].level > level) {
+        Assignment* a = &s->assignments[--s->assignment_count];
+        if (a->decision) s->packages[a->package].decision = -1;
+        free(a->set);
+    }
+    s->level = level;
+    
+    for (size_t p = 0; p < s->package_count; p++) bits_fill(&s->packages[p], s->packages[p].accumulated);
+    for (size_t i = 0; i < s->assignment_count; i++) {
+        const Assignment* a = &s->assignments[i];
+        SolverPackage* pkg = &s->packages[a->package];
+        for (size_t w = 0; w < pkg->words; w++) pkg->accumulated[w] &= a->set[w];
+    }
+}
+
+// --- Conflict Resolution ---
+// Applies assignment `a` to the per-term accumulators; true once all terms are satisfied
+static bool conflict_accumulate(const Solver* s, const Incompat* inc, uint64_t** acc, const Assignment* a) {
+    bool satisfied = true;
+    for (size_t t = 0; t < inc->term_count; t++) {
+        const SolverPackage* pkg = &s->packages[inc->terms[t].package];
+        if (a && inc->terms[t].package == a->package) {
+            for (size_t w = 0; w < pkg->words; w++) acc[t][w] &= a->set[w];
+        }
+        if (!bits_subset(acc[t], inc->terms[t].set, pkg->words)) satisfied = false;
+    }
+    return satisfied;
+}
+
+static void conflict_reset(const Solver* s, const Incompat* inc, uint64_t** acc) {
+    for (size_t t = 0; t < inc->term_count; t++) bits_fill(&s->packages[inc->terms[t].package], acc[t]);
+}
+
+// Resolves a satisfied incompatibility into one that, after backjumping, is
+// almost satisfied. Returns it, or -1 if the conflict proves there is no solution.
+static int solver_resolve_conflict(Solver* s, int incompat) {
+    bool learned = false;
+    
+    for (;;) {
+        const Incompat* inc = &s->incompats[incompat];
+        if (incompat_is_failure(inc)) {
+            s->failure = incompat;
+            return -1;
+        }
+        
+        uint64_t** acc = calloc(inc->term_count, sizeof(uint64_t*));
+        bool ok = acc != NULL;
+        for (size_t t = 0; ok && t < inc->term_count; t++) {
+            acc[t] = bits_full(&s->packages[inc->terms[t].package]);
+            ok = acc[t] != NULL;
+        }
+        if (!ok) {
+            if (acc) for (size_t t = 0; t < inc->term_count; t++) free(acc[t]);
+            free(acc);
+            s->failure = incompat;
+            return -1;
+        }
+        
+        // Satisfier: the assignment after which the partial solution first satisfies the incompatibility
+        size_t satisfier = 0;
+        while (satisfier < s->assignment_count &&
+               !conflict_accumulate(s, inc, acc, &s->assignments[satisfier])) {
+            satisfier++;
+        }
+        if (satisfier == s->assignment_count) satisfier--;
+        const Assignment* sat = &s->assignments[satisfier];
+        
+        size_t term_index = 0;
+        while (term_index < inc->term_count && inc->terms[term_index].package != sat->package) term_index++;
+        
+        // Previous satisfier: the earliest assignment that, together with the satisfier, does the same
+        int previous_level = 1;
+        conflict_reset(s, inc, acc);
+        if (!conflict_accumulate(s, inc, acc, sat)) {
+            for (size_t j = 0; j < satisfier; j++) {
+                if (conflict_accumulate(s, inc, acc, &s->assignments[j])) {
+                    previous_level = s->assignments[j].level;
+                    break;
+                }
+            }
+        }
+        for (size_t t = 0; t < inc->term_count; t++) free(acc[t]);
+        free(acc);
+        
+        if (sat->decision || previous_level != sat->level) {
+            if (learned) s->result->learned++;
+            solver_backtrack(s, previous_level);
+            return incompat;
+        }
+        
+        // Resolve against the incompatibility that forced the satisfier
+        const Incompat* cause = &s->incompats[sat->cause];
+        const SolverPackage* pkg = &s->packages[sat->package];
+        Term* terms = malloc((inc->term_count + cause->term_count + 1) * sizeof(Term));
+        if (!terms) {
+            s->failure = incompat;
+            return -1;
+        }
+        
+        size_t count = 0;
+        for (size_t t = 0; t < inc->term_count; t++) {
+            if (inc->terms[t].package != sat->package) terms[count++] = inc->terms[t];
+        }
+        for (size_t t = 0; t < cause->term_count; t++) {
+            if (cause->terms[t].package != sat->package) terms[count++] = cause->terms[t];
+        }
+        
+        // Whatever part of the satisfier the term didn't cover survives the resolution
+        uint64_t* remainder = NULL;
+        const uint64_t* term = term_index < inc->term_count ? inc->terms[term_index].set : NULL;
+        if (term && !bits_subset(sat->set, term, pkg->words)) {
+            remainder = bits_complement(pkg, sat->set);
+            if (remainder) {
+                for (size_t w = 0; w < pkg->words; w++) remainder[w] |= term[w];
+                terms[count++] = (Term){ sat->package, remainder };
+            }
+        }
+        
+        int derived = solver_add_incompat(s, terms, count, INCOMPAT_DERIVED, NULL, incompat, sat->cause);
+        free(remainder);
+        free(terms);
+        if (derived < 0) {
+            s->failure = incompat;
+            return -1;
+        }
+        
+        incompat = derived;
+        learned = true;
+    }
+}
+
+// --- Unit Propagation ---
+static bool solver_propagate(Solver* s, int start) {
+    size_t capacity = 16;
+    size_t count = 0;
+    int* changed = malloc(capacity * sizeof(int));
+    if (!changed) return false;
+    changed[count++] = start;
+    
+    while (count > 0) {
+        int package = changed[--count];
+        
+        // Newest incompatibilities first: learned ones tend to be the most useful
+        for (size_t k = s->packages[package].incompat_count; k-- > 0;) {
+            int incompat = s->packages[package].incompats[k];
+            int open_term = -1;
+            Relation relation = incompat_relation(s, &s->incompats[incompat], &open_term);
+            
+            if (relation == RELATION_SATISFIED) {
+                s->result->conflicts++;
+                if (s->result->conflicts > SOLVER_MAX_CONFLICTS) {
+                    s->failure = -1;
+                    free(changed);
+                    return false;
+                }
+                
+                int learned = solver_resolve_conflict(s, incompat);
+                if (learned < 0 ||
+                    incompat_relation(s, &s->incompats[learned], &open_term) != RELATION_INCONCLUSIVE ||
+                    open_term < 0 || !solver_derive(s, learned, open_term)) {
+                    if (learned >= 0) s->failure = learned;
+                    free(changed);
+                    return false;
+                }
+                
+                changed[0] = s->incompats[learned].terms[open_term].package;
+                count = 1;
+                break;
+            }
+            
+            if (relation == RELATION_INCONCLUSIVE && open_term >= 0) {
+                if (!solver_derive(s, incompat, open_term)) {
+                    free(changed);
+                    return false;
+                }
+                if (count == capacity) {
+                    capacity *= 2;
+                    int* grown = realloc(changed, capacity * sizeof(int));
+                    if (!grown) {
+                        free(changed);
+                        return false;
+                    }
+                    changed = grown;
+                }
+                changed[count++] = s->incompats[incompat].terms[open_term].package;
+            }
+        }
+    }
+    
+    free(changed);
+    return true;
+}
+
+// --- Decisions ---
+// The undecided, required package with the fewest remaining candidates
+static int solver_choose_package(const Solver* s) {
+    int best = -1;
+    size_t best_count = 0;
+    
+    for (size_t p = 0; p < s->package_count; p++) {
+        const SolverPackage* pkg = &s->packages[p];
+        if (pkg->decision >= 0 || !term_is_positive(pkg, pkg->accumulated)) continue;
+        
+        size_t count = bits_count_versions(pkg, pkg->accumulated);
+        if (best < 0 || count < best_count) {
+            best = (int)p;
+            best_count = count;
+        }
+    }
+    return best;
+}
+
+static int solver_choose_version(const Solver* s, int package) {
+    const SolverPackage* pkg = &s->packages[package];
+    
+    if (package != 0 && s->provider->preferred_version) {
+        const SemVer* preferred = s->provider->preferred_version(s->provider->context, pkg->name);
+        for (size_t i = 0; preferred && i < pkg->version_count; i++) {
+            if (bits_test(pkg->accumulated, i) && semver_equals(pkg->versions[i], preferred)) return (int)i;
+        }
+    }
+    
+    for (size_t i = 0; i < pkg->version_count; i++) {
+        if (bits_test(pkg->accumulated, i)) return (int)i;
+    }
+    return -1;
+}
+
+// Turns the dependencies of package@version into incompatibilities (once per version)
+static void solver_add_dependencies(Solver* s, int package, int version, const Dependency* deps) {
+    if (bits_test(s->packages[package].expanded, (size_t)version)) return;
+    bits_set(s->packages[package].expanded, (size_t)version);
+    
+    for (const Dependency* dep = deps; dep; dep = dep->next) {
+        if (!dep->name || (package != 0 && dep->is_dev_dependency)) continue;
+        
+        int target = solver_package(s, dep->name);
+        if (target < 0) continue;
+        
+        // The package array may have grown
+        const SolverPackage* pkg = &s->packages[package];
+        const SolverPackage* dep_pkg = &s->packages[target];
+        
+        uint64_t* allowed = calloc(dep_pkg->words, sizeof(uint64_t));
+        uint64_t* selected = calloc(pkg->words, sizeof(uint64_t));
+        if (!allowed || !selected) {
+            free(allowed);
+            free(selected);
+            continue;
+        }
+        for (size_t i = 0; i < dep_pkg->version_count; i++) {
+            if (!dep->constraint || semver_satisfies(dep_pkg->versions[i], dep->constraint)) bits_set(allowed, i);
+        }
+        bits_set(selected, (size_t)version);
+        
+        char* constraint = dep->constraint ? semver_constraint_to_string(dep->constraint) : strdup("*");
+        char* version_str = semver_to_string(pkg->versions[version]);
+        const char* note = "";
+        if (dep_pkg->version_count == 0) {
+            note = ", which doesn't exist";
+        } else if (bits_empty(allowed, dep_pkg->words)) {
+            note = ", which matches no available version";
+        }
+        
+        char* description = NULL;
+        if (package == 0) {
+            if (asprintf(&description, "%s depends on %s %s%s", pkg->name, dep->name,
+                         constraint ? constraint : "*", note) < 0) description = NULL;
+        } else {
+            if (asprintf(&description, "%s %s depends on %s %s%s", pkg->name, version_str ? version_str : "?",
+                         dep->name, constraint ? constraint : "*", note) < 0) description = NULL;
+        }
+        free(constraint);
+        free(version_str);
+        
+        // "package@version and not (dep satisfying constraint)" can't both hold
+        Term terms[2] = {
+            { package, selected },
+            { target, bits_complement(dep_pkg, allowed) }
+        };
+        if (terms[1].set) {
+            solver_add_incompat(s, terms, 2, INCOMPAT_DEPENDENCY, description, -1, -1);
+        } else {
+            free(description);
+        }
+        free(terms[1].set);
+        free(allowed);
+        free(selected);
+    }
+}
+
+// True if deciding package@version right now would satisfy one of the given incompatibilities
+static bool solver_decision_conflicts(const Solver* s, int package, int version, size_t first_incompat) {
+    for (size_t k = first_incompat; k < s->incompat_count; k++) {
+        const Incompat* inc = &s->incompats[k];
+        bool satisfied = true;
+        
+        for (size_t t = 0; t < inc->term_count && satisfied; t++) {
+            const Term* term = &inc->terms[t];
+            const SolverPackage* pkg = &s->packages[term->package];
+            if (term->package == package) {
+                satisfied = bits_test(term->set, (size_t)version);
+            } else {
+                satisfied = bits_subset(pkg->accumulated, term->set, pkg->words);
+            }
+        }
+        if (satisfied) return true;
+    }
+    return false;
+}
+
+// --- Explanations ---
+typedef struct {
+    char* data;
+    size_t length;
+    size_t capacity;
+} TextBuffer;
+
+static void text_append(TextBuffer* text, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    int needed = vsnprintf(NULL, 0, format, args);
+    va_end(args);
+    if (needed < 0) return;
+    
+    if (text->length + (size_t)needed + 1 > text->capacity) {
+        size_t capacity = text->capacity ? text->capacity : 64;
+        while (text->length + (size_t)needed + 1 > capacity) capacity *= 2;
+        char* grown = realloc(text->data, capacity);
+        if (!grown) return;
+        text->data = grown;
+        text->capacity = capacity;
+    }
+    
+    va_start(args, format);
+    vsnprintf(text->data + text->length, text->capacity - text->length, format, args);
+    va_end(args);
+    text->length += (size_t)needed;
+}
+
+// Describes the selected versions in `set` ("libfoo 1.2.0 or 1.3.0")
+static void text_append_versions(const Solver* s, TextBuffer* text, int package, const uint64_t* set) {
+    const SolverPackage* pkg = &s->packages[package];
+    size_t count = bits_count_versions(pkg, set);
+    
+    if (package == 0) {
+        text_append(text, "%s", pkg->name);
+    } else if (count == pkg->version_count) {
+        text_append(text, "every version of %s", pkg->name);
+    } else if (count == 0) {
+        text_append(text, "no version of %s", pkg->name);
+    } else if (count <= SOLVER_MAX_LISTED_VERSIONS) {
+        text_append(text, "%s ", pkg->name);
+        size_t listed = 0;
+        for (size_t i = pkg->version_count; i-- > 0;) {
+            if (!bits_test(set, i)) continue;
+            char* version = semver_to_string(pkg->versions[i]);
+            listed++;
+            text_append(text, "%s%s", version ? version : "?",
+                        listed + 1 == count ? " or " : (listed < count ? ", " : ""));
+            free(version);
+        }
+    } else {
+        // Newest first, so the lowest index is the newest version
+        size_t newest = 0;
+        size_t oldest = 0;
+        for (size_t i = 0; i < pkg->version_count; i++) {
+            if (!bits_test(set, i)) continue;
+            if (!bits_test(set, newest)) newest = i;
+            oldest = i;
+        }
+        char* low = semver_to_string(pkg->versions[oldest]);
+        char* high = semver_to_string(pkg->versions[newest]);
+        text_append(text, "%s %s through %s (%zu of %zu versions)", pkg->name,
+                    low ? low : "?", high ? high : "?", count, pkg->version_count);
+        free(low);
+        free(high);
+    }
+}
+
+// Appends "<a> and <b>" over the positive (or, inverted, the negative) terms of an incompatibility
+static void text_append_terms(const Solver* s, TextBuffer* text, const Incompat* inc, bool positive,
+                              bool skip_root, const char* joiner) {
+    bool first = true;
+    for (size_t t = 0; t < inc->term_count; t++) {
+        const SolverPackage* pkg = &s->packages[inc->terms[t].package];
+        if (term_is_positive(pkg, inc->terms[t].set) != positive) continue;
+        if (skip_root && inc->terms[t].package == 0) continue;
+        
+        if (!first) text_append(text, " %s ", joiner);
+        first = false;
+        
+        if (positive) {
+            text_append_versions(s, text, inc->terms[t].package, inc->terms[t].set);
+        } else {
+            uint64_t* required = bits_complement(pkg, inc->terms[t].set);
+            if (required) text_append_versions(s, text, inc->terms[t].package, required);
+            free(required);
+        }
+    }
+}
+
+static void text_append_incompat(const Solver* s, TextBuffer* text, const Incompat* inc) {
+    if (inc->kind != INCOMPAT_DERIVED && inc->description) {
+        text_append(text, "%s", inc->description);
+        return;
+    }
+    if (incompat_is_failure(inc)) {
+        text_append(text, "version solving failed");
+        return;
+    }
+    
+    size_t positives = 0;
+    bool has_root = false;
+    for (size_t t = 0; t < inc->term_count; t++) {
+        if (term_is_positive(&s->packages[inc->terms[t].package], inc->terms[t].set)) positives++;
+        if (inc->terms[t].package == 0) has_root = true;
+    }
+    
+    if (positives == inc->term_count && has_root) {
+        text_append(text, "%s forbids ", s->packages[0].name);
+        text_append_terms(s, text, inc, true, true, "and");
+    } else if (positives == inc->term_count) {
+        text_append_terms(s, text, inc, true, false, "and");
+        text_append(text, inc->term_count == 1 ? " is forbidden" : " are incompatible");
+    } else if (positives == 0) {
+        text_append_terms(s, text, inc, false, false, "or");
+        text_append(text, " is required");
+    } else {
+        text_append_terms(s, text, inc, true, false, "and");
+        text_append(text, " requires ");
+        text_append_terms(s, text, inc, false, false, "or");
+    }
+}
+
+static void explanation_add(SolverResult* result, char* line) {
+    if (!line) return;
+    char** grown = realloc(result->explanation, (result->explanation_count + 1) * sizeof(char*));
+    if (!grown) {
+        free(line);
+        return;
+    }
+    result->explanation = grown;
+    result->explanation[result->explanation_count++] = line;
+}
+
+// One numbered line per derived incompatibility, causes before conclusions
+static void solver_explain(const Solver* s, int incompat, int* line_numbers) {
+    const Incompat* inc = &s->incompats[incompat];
+    int causes[2] = { inc->cause1, inc->cause2 };
+    
+    for (int c = 0; c < 2; c++) {
+        if (s->incompats[causes[c]].kind == INCOMPAT_DERIVED && line_numbers[causes[c]] == 0) {
+            solver_explain(s, causes[c], line_numbers);
+        }
+    }
+    
+    TextBuffer text = {0};
+    text_append(&text, "(%zu) Because ", s->result->explanation_count + 1);
+    for (int c = 0; c < 2; c++) {
+        if (c == 1) text_append(&text, " and ");
+        text_append_incompat(s, &text, &s->incompats[causes[c]]);
+        if (line_numbers[causes[c]] > 0) text_append(&text, " (%d)", line_numbers[causes[c]]);
+    }
+    text_append(&text, ", ");
+    text_append_incompat(s, &text, inc);
+    text_append(&text, ".");
+    
+    explanation_add(s->result, text.data);
+    line_numbers[incompat] = (int)s->result->explanation_count;
+}
+
+static void solver_build_explanation(const Solver* s) {
+    if (s->failure < 0) {
+        char* line = NULL;
+        if (asprintf(&line, "Gave up after %zu conflicts without finding a solution.", s->result->conflicts) >= 0) {
+            explanation_add(s->result, line);
+        }
+        return;
+    }
+    
+    const Incompat* failure = &s->incompats[s->failure];
+    if (failure->kind != INCOMPAT_DERIVED) {
+        TextBuffer text = {0};
+        text_append(&text, "Because ");
+        text_append_incompat(s, &text, failure);
+        text_append(&text, ", version solving failed.");
+        explanation_add(s->result, text.data);
+        return;
+    }
+    
+    int* line_numbers = calloc(s->incompat_count, sizeof(int));
+    if (!line_numbers) return;
+    solver_explain(s, s->failure, line_numbers);
+    free(line_numbers);
+}
+
+// --- Solving ---
+static int assignment_compare_name(const void* a, const void* b) {
+    return strcmp(((const SolverAssignment*)a)->name, ((const SolverAssignment*)b)->name);
+}
+
+static void solver_collect(const Solver* s) {
+    SolverResult* result = s->result;
+    result->assignments = calloc(s->package_count ? s->package_count : 1, sizeof(SolverAssignment));
+    if (!result->assignments) return;
+    
+    for (size_t p = 1; p < s->package_count; p++) {
+        const SolverPackage* pkg = &s->packages[p];
+        if (pkg->decision < 0) continue;
+        result->assignments[result->assignment_count].name = strdup(pkg->name);
+        result->assignments[result->assignment_count++].version = pkg->versions[pkg->decision];
+    }
+    qsort(result->assignments, result->assignment_count, sizeof(SolverAssignment), assignment_compare_name);
+}
+
+static void solver_cleanup(Solver* s) {
+    for (size_t p = 0; p < s->package_count; p++) {
+        free(s->packages[p].name);
+        free(s->packages[p].accumulated);
+        free(s->packages[p].expanded);
+        free(s->packages[p].incompats);
+    }
+    for (size_t i = 0; i < s->incompat_count; i++) {
+        for (size_t t = 0; t < s->incompats[i].term_count; t++) free(s->incompats[i].terms[t].set);
+        free(s->incompats[i].terms);
+        free(s->incompats[i].description);
+    }
+    for (size_t i = 0; i < s->assignment_count; i++) free(s->assignments[i].set);
+    free(s->packages);
+    free(s->index);
+    free(s->incompats);
+    free(s->assignments);
+}
+
+SolverResult* cpm_solver_solve(const char* root_name, const SemVer* root_version,
+                               const Dependency* root_dependencies, const SolverProvider* provider) {
+    if (!root_name || !provider || !provider->get_versions || !provider->get_dependencies) return NULL;
+    
+    SolverResult* result = calloc(1, sizeof(SolverResult));
+    if (!result) return NULL;
+    
+    Solver s = {0};
+    s.provider = provider;
+    s.result = result;
+    s.failure = -1;
+    
+    // The root is a package with exactly one version that must be selected
+    SemVer placeholder = {0};
+    SemVer* root_versions[1] = { root_version ? (SemVer*)root_version : &placeholder };
+    if (solver_add_package(&s, root_name, root_versions, 1) != 0) {
+        solver_cleanup(&s);
+        free(result);
+        return NULL;
+    }
+    
+    uint64_t not_selected = 1ULL << 1;
+    Term root_term = { 0, &not_selected };
+    solver_add_incompat(&s, &root_term, 1, INCOMPAT_ROOT, NULL, -1, -1);
+    
+    int next = 0;
+    bool solved = false;
+    for (;;) {
+        if (!solver_propagate(&s, next)) break;
+        
+        int package = solver_choose_package(&s);
+        if (package < 0) {
+            solved = true;
+            break;
+        }
+        
+        int version = solver_choose_version(&s, package);
+        if (version < 0) {
+            // Required but nothing left to pick from
+            uint64_t* set = bits_copy(&s.packages[package], s.packages[package].accumulated);
+            Term term = { package, set };
+            char* description = NULL;
+            if (asprintf(&description, "no versions of %s are available", s.packages[package].name) < 0) description = NULL;
+            if (!set || solver_add_incompat(&s, &term, 1, INCOMPAT_UNAVAILABLE, description, -1, -1) < 0) {
+                free(set);
+                break;
+            }
+            free(set);
+            next = package;
+            continue;
+        }
+        
+        size_t first_new = s.incompat_count;
+        const Dependency* deps = package == 0 ? root_dependencies :
+            provider->get_dependencies(provider->context, s.packages[package].name, s.packages[package].versions[version]);
+        solver_add_dependencies(&s, package, version, deps);
+        
+        // A version whose own dependencies already conflict is left to propagation to rule out
+        if (!solver_decision_conflicts(&s, package, version, first_new)) {
+            uint64_t* set = calloc(s.packages[package].words, sizeof(uint64_t));
+            if (!set) break;
+            bits_set(set, (size_t)version);
+            s.level++;
+            if (!solver_assign(&s, package, set, -1, true)) break;
+            s.packages[package].decision = version;
+            result->decisions++;
+        }
+        next = package;
+    }
+    
+    result->success = solved;
+    if (solved) {
+        solver_collect(&s);
+    } else {
+        solver_build_explanation(&s);
+    }
+    
+    solver_cleanup(&s);
+    return result;
+}
+
+const SemVer* cpm_solver_result_find(const SolverResult* result, const char* name) {
+    if (!result || !name || result->assignment_count == 0) return NULL;
+    
+    SolverAssignment key = { name, NULL };
+    const SolverAssignment* found = bsearch(&key, result->assignments, result->assignment_count,
+                                            sizeof(SolverAssignment), assignment_compare_name);
+    return found ? found->version : NULL;
+}
+
+void cpm_solver_result_free(SolverResult* result) {
+    if (!result) return;
+    
+    for (size_t i = 0; i < result->assignment_count; i++) free((char*)result->assignments[i].name);
+    free(result->assignments);
+    for (size_t i = 0; i < result->explanation_count; i++) free(result->explanation[i]);
+    free(result->explanation);
+    free(result);
+}
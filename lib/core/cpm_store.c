@@ -0,0 +1,381 @@
+/*
+ * File: lib/core/cpm_store.c
+ * Description: Content-addressable package store for CPM.
+ * Trees are immutable once renamed into trees/, so concurrent
+ * cpm processes only ever race on the rename, and the loser discards its copy.
+ * Author: Dr. Q Josef Kurk Edwards
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <ftw.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <linux/fs.h>
+#include "cpm_store.h"
+#include "cpm_digest.h"
+
+#define STORE_DIR "store"
+#define STORE_TREES_DIR "trees"
+#define STORE_TMP_DIR "tmp"
+#define STORE_PARTIAL_DIR "partial"
+#define STORE_ALIASES_DIR "aliases"
+#define STORE_KEY_LENGTH (CPM_SHA256_DIGEST_SIZE * 2)
+
+struct CPM_Store {
+    char* root;
+    atomic_int link_method;     // Cheapest CPM_StoreLinkMethod not yet seen to fail
+    atomic_uint temp_counter;
+};
+
+// --- Internal Helper Functions ---
+static char* store_path(const CPM_Store* store, const char* dir, const char* key, const char* suffix) {
+    char* path = NULL;
+    if (asprintf(&path, "%s/%s/%s%s", store->root, dir, key, suffix) < 0) return NULL;
+    return path;
+}
+
+static bool store_key_valid(const char* key) {
+    if (!key || strlen(key) != STORE_KEY_LENGTH) return false;
+    for (const char* p = key; *p; p++) {
+        if (!((*p >= '0' && *p <= '9') || (*p >= 'a' && *p <= 'f'))) return false;
+    }
+    return true;
+}
+
+static bool make_directory(const char* path) {
+    return mkdir(path, 0755) == 0 || errno == EEXIST;
+}
+
+static bool make_directories(const char* path) {
+    char* copy = strdup(path);
+    if (!copy) return false;
+    
+    bool ok = true;
+    for (char* p = copy + 1; *p && ok; p++) {
+        if (*p != '/') continue;
+        *p = '\0';
+        ok = make_directory(copy);
+        *p = '/';
+    }
+    ok = ok && make_directory(copy);
+    free(copy);
+    return ok;
+}
+
+static int remove_entry(const char* path, const struct stat* st, int type, struct FTW* walk) {
+    (void)st;
+    (void)walk;
+    int removed = type == FTW_DP || type == FTW_DNR ? rmdir(path) : unlink(path);
+    return removed == 0 || errno == ENOENT ? 0 : -1;
+}
+
+// Children before their directory (FTW_DEPTH); symlinks are removed, not followed (FTW_PHYS)
+bool cpm_store_remove_tree(const char* path) {
+    if (!path || path[0] == '\0') return false;
+    if (nftw(path, remove_entry, 16, FTW_DEPTH | FTW_PHYS) == 0) return true;
+    return errno == ENOENT;
+}
+
+// --- Store Lifecycle ---
+CPM_Store* cpm_store_open(const char* cache_dir) {
+    if (!cache_dir) return NULL;
+    
+    CPM_Store* store = calloc(1, sizeof(CPM_Store));
+    if (!store) return NULL;
+    if (asprintf(&store->root, "%s/%s", cache_dir, STORE_DIR) < 0) {
+        free(store);
+        return NULL;
+    }
+    atomic_init(&store->link_method, CPM_STORE_LINK_REFLINK);
+    atomic_init(&store->temp_counter, 0);
+    
+    const char* dirs[] = { STORE_TREES_DIR, STORE_TMP_DIR, STORE_PARTIAL_DIR, STORE_ALIASES_DIR };
+    bool ok = make_directories(store->root);
+    for (size_t i = 0; ok && i < sizeof(dirs) / sizeof(dirs[0]); i++) {
+        char path[1100];
+        snprintf(path, sizeof(path), "%s/%s", store->root, dirs[i]);
+        ok = make_directory(path);
+    }
+    if (!ok) {
+        cpm_store_close(store);
+        return NULL;
+    }
+    return store;
+}
+
+void cpm_store_close(CPM_Store* store) {
+    if (!store) return;
+    free(store->root);
+    free(store);
+}
+
+// --- Keys ---
+char* cpm_store_key_from_integrity(const char* integrity) {
+    unsigned char digest[CPM_SHA256_DIGEST_SIZE];
+    if (!cpm_integrity_sha256(integrity, digest)) return NULL;
+    return cpm_digest_to_hex(digest, sizeof(digest));
+}
+
+char* cpm_store_key_of_file(const char* path) {
+    unsigned char digest[CPM_SHA256_DIGEST_SIZE];
+    if (!path || !cpm_sha256_file(path, digest)) return NULL;
+    return cpm_digest_to_hex(digest, sizeof(digest));
+}
+
+// "sha512-<hex>" for a sha512 integrity; false for anything else
+static bool store_alias_name(const char* integrity, char* name, size_t size) {
+    CPM_IntegrityHash hash;
+    if (!cpm_integrity_parse(integrity, &hash) || hash.algorithm != CPM_INTEGRITY_SHA512) return false;
+    char* hex = cpm_digest_to_hex(hash.digest, hash.size);
+    if (!hex) return false;
+    snprintf(name, size, "sha512-%s", hex);
+    free(hex);
+    return true;
+}
+
+char* cpm_store_lookup_integrity(const CPM_Store* store, const char* integrity) {
+    char* key = cpm_store_key_from_integrity(integrity);
+    if (key || !store) return key;
+    
+    char name[160];
+    if (!store_alias_name(integrity, name, sizeof(name))) return NULL;
+    char* alias = store_path(store, STORE_ALIASES_DIR, name, "");
+    if (!alias) return NULL;
+    
+    char target[STORE_KEY_LENGTH + 2];
+    ssize_t n = readlink(alias, target, sizeof(target) - 1);
+    free(alias);
+    if (n < 0) return NULL;
+    target[n] = '\0';
+    return store_key_valid(target) ? strdup(target) : NULL;
+}
+
+bool cpm_store_add_alias(CPM_Store* store, const char* integrity, const char* key) {
+    char name[160];
+    if (!store || !store_key_valid(key)) return false;
+    if (!store_alias_name(integrity, name, sizeof(name))) return true;
+    
+    // Built under tmp/ and renamed, so readers never see a half-made link
+    char* alias = store_path(store, STORE_ALIASES_DIR, name, "");
+    char* temp = cpm_store_temp_path(store, name);
+    bool ok = alias && temp && symlink(key, temp) == 0 && rename(temp, alias) == 0;
+    if (!ok && temp) unlink(temp);
+    free(alias);
+    free(temp);
+    return ok;
+}
+
+// --- Entries ---
+char* cpm_store_tree_path(const CPM_Store* store, const char* key) {
+    if (!store || !store_key_valid(key)) return NULL;
+    return store_path(store, STORE_TREES_DIR, key, "");
+}
+
+char* cpm_store_temp_path(CPM_Store* store, const char* hint) {
+    if (!store) return NULL;
+    
+    char name[512];
+    unsigned int n = atomic_fetch_add(&store->temp_counter, 1);
+    snprintf(name, sizeof(name), "%s.%ld.%u", hint ? hint : "entry", (long)getpid(), n);
+    for (char* p = name; *p; p++) {
+        if (*p == '/') *p = '_';
+    }
+    return store_path(store, STORE_TMP_DIR, name, "");
+}
+
+char* cpm_store_partial_path(const CPM_Store* store, const char* key) {
+    if (!store || !store_key_valid(key)) return NULL;
+    return store_path(store, STORE_PARTIAL_DIR, key, "");
+}
+
+bool cpm_store_has_tree(const CPM_Store* store, const char* key) {
+    char* path = cpm_store_tree_path(store, key);
+    struct stat st;
+    bool exists = path && stat(path, &st) == 0;
+    free(path);
+    return exists;
+}
+
+CPM_Result cpm_store_add_tree(CPM_Store* store, const char* key, const char* staged_dir) {
+    char* tree = cpm_store_tree_path(store, key);
+    if (!tree || !staged_dir) {
+        free(tree);
+        return CPM_RESULT_ERROR_INVALID_ARGS;
+    }
+    
+    CPM_Result result = CPM_RESULT_SUCCESS;
+    if (rename(staged_dir, tree) != 0) {
+        // Lost the race to another install of the same archive
+        if (errno == EEXIST || errno == ENOTEMPTY) {
+            cpm_store_remove_tree(staged_dir);
+        } else {
+            result = CPM_RESULT_ERROR_FILE_OPERATION;
+        }
+    }
+    free(tree);
+    return result;
+}
+
+// --- Materializing ---
+static bool copy_file_contents(int in, int out, uint64_t* bytes) {
+    for (;;) {
+        ssize_t n = copy_file_range(in, NULL, out, NULL, 1 << 30, 0);
+        if (n == 0) return true;
+        if (n > 0) {
+            *bytes += (uint64_t)n;
+            continue;
+        }
+        if (errno != EXDEV && errno != ENOSYS && errno != EOPNOTSUPP && errno != EINVAL) return false;
+        break;
+    }
+    
+    // Fallback for filesystems copy_file_range doesn't handle
+    char buffer[65536];
+    ssize_t n;
+    while ((n = read(in, buffer, sizeof(buffer))) > 0) {
+        for (ssize_t off = 0; off < n;) {
+            ssize_t w = write(out, buffer + off, (size_t)(n - off));
+            if (w < 0) return false;
+            off += w;
+        }
+        *bytes += (uint64_t)n;
+    }
+    return n == 0;
+}
+
+// "This filesystem can't do that" as opposed to a failure of this one file
+static bool link_unsupported(int error) {
+    return error == EOPNOTSUPP || error == ENOTTY || error == EXDEV || error == EINVAL ||
+           error == ENOSYS || error == EPERM || error == EMLINK;
+}
+
+// A private copy never shares an inode with the store: reflinked extents are
+// copied on write, but a hardlinked file is the store's own file
+static bool store_link_file(CPM_Store* store, const char* source, const char* dest, mode_t mode,
+                            bool private_copy, CPM_StoreLinkStats* stats) {
+    int method = atomic_load(&store->link_method);
+    
+    if (method == CPM_STORE_LINK_HARDLINK && !private_copy) {
+        if (link(source, dest) == 0) {
+            stats->hardlinked++;
+            return true;
+        }
+        if (!link_unsupported(errno)) return false;
+        atomic_store(&store->link_method, CPM_STORE_LINK_COPY);
+    }
+    
+    int in = open(source, O_RDONLY | O_CLOEXEC);
+    if (in < 0) return false;
+    int out = open(dest, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, mode & 07777);
+    if (out < 0) {
+        close(in);
+        return false;
+    }
+    
+    bool ok = false;
+#ifdef FICLONE
+    if (method == CPM_STORE_LINK_REFLINK) {
+        if (ioctl(out, FICLONE, in) == 0) {
+            stats->reflinked++;
+            ok = true;
+        } else if (link_unsupported(errno)) {
+            // Fall back to hardlinks; the empty file created above is in the way
+            atomic_store(&store->link_method, CPM_STORE_LINK_HARDLINK);
+            if (!private_copy) {
+                close(in);
+                close(out);
+                unlink(dest);
+                return store_link_file(store, source, dest, mode, private_copy, stats);
+            }
+        }
+    }
+#else
+    if (method == CPM_STORE_LINK_REFLINK) {
+        atomic_store(&store->link_method, CPM_STORE_LINK_HARDLINK);
+        if (!private_copy) {
+            close(in);
+            close(out);
+            unlink(dest);
+            return store_link_file(store, source, dest, mode, private_copy, stats);
+        }
+    }
+#endif
+
+    if (!ok && copy_file_contents(in, out, &stats->copied_bytes)) {
+        stats->copied++;
+        ok = true;
+    }
+    close(in);
+    if (close(out) != 0) ok = false;
+    return ok;
+}
+
+static bool store_materialize_dir(CPM_Store* store, const char* source, const char* dest, mode_t mode,
+                                  bool private_copy, CPM_StoreLinkStats* stats) {
+    if (mkdir(dest, (mode & 07777) | 0700) != 0) return false;
+    
+    DIR* dir = opendir(source);
+    if (!dir) return false;
+    
+    bool ok = true;
+    struct dirent* entry;
+    while (ok && (entry = readdir(dir)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+        
+        char* from = NULL;
+        char* to = NULL;
+        if (asprintf(&from, "%s/%s", source, entry->d_name) < 0) from = NULL;
+        if (asprintf(&to, "%s/%s", dest, entry->d_name) < 0) to = NULL;
+        
+        struct stat st;
+        if (!from || !to || lstat(from, &st) != 0) {
+            ok = false;
+        } else if (S_ISDIR(st.st_mode)) {
+            ok = store_materialize_dir(store, from, to, st.st_mode, private_copy, stats);
+        } else if (S_ISLNK(st.st_mode)) {
+            char target[4096];
+            ssize_t length = readlink(from, target, sizeof(target) - 1);
+            if (length >= 0) target[length] = '\0';
+            ok = length >= 0 && symlink(target, to) == 0;
+        } else if (S_ISREG(st.st_mode)) {
+            ok = store_link_file(store, from, to, st.st_mode, private_copy, stats);
+        }
+        // Devices, FIFOs and sockets have no place in a package and are skipped
+        
+        free(from);
+        free(to);
+    }
+    closedir(dir);
+    return ok;
+}
+
+CPM_Result cpm_store_materialize(CPM_Store* store, const char* key, const char* dest_dir, bool private_copy,
+                                 CPM_StoreLinkStats* stats) {
+    char* tree = cpm_store_tree_path(store, key);
+    if (!tree || !dest_dir) {
+        free(tree);
+        return CPM_RESULT_ERROR_INVALID_ARGS;
+    }
+    
+    CPM_StoreLinkStats local = {0};
+    struct stat st;
+    bool ok = stat(tree, &st) == 0 && S_ISDIR(st.st_mode) &&
+              store_materialize_dir(store, tree, dest_dir, st.st_mode, private_copy, &local);
+    free(tree);
+    
+    if (stats) {
+        stats->reflinked += local.reflinked;
+        stats->hardlinked += local.hardlinked;
+        stats->copied += local.copied;
+        stats->copied_bytes += local.copied_bytes;
+    }
+    return ok ? CPM_RESULT_SUCCESS : CPM_RESULT_ERROR_FILE_OPERATION;
+}
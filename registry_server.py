@@ -7,6 +7,7 @@ HTTP server that handles package publishing, searching, and downloading
 import os
 import sys
 import json
+import hashlib
 import tarfile
 import tempfile
 import shutil
@@ -168,10 +169,7 @@ class CPMRegistryHandler(BaseHTTPRequestHandler):
             'versions': versions
         }
         
-        self.send_response(200)
-        self.send_header('Content-Type', 'application/json')
-        self.end_headers()
-        self.wfile.write(json.dumps(response, indent=2).encode())
+        self.send_cacheable_json(response)
     
     def handle_download(self, package_name, version):
         """Handle package download requests"""
@@ -193,10 +191,24 @@ class CPMRegistryHandler(BaseHTTPRequestHandler):
             'status': 'available'
         }
         
+        self.send_cacheable_json(package_info)
+    
+    def send_cacheable_json(self, payload):
+        """Send JSON with an ETag, answering 304 when the client's copy is current"""
+        body = json.dumps(payload, indent=2).encode()
+        etag = '"%s"' % hashlib.sha1(body).hexdigest()
+        
+        if self.headers.get('If-None-Match') == etag:
+            self.send_response(304)
+            self.send_header('ETag', etag)
+            self.end_headers()
+            return
+        
         self.send_response(200)
         self.send_header('Content-Type', 'application/json')
+        self.send_header('ETag', etag)
         self.end_headers()
-        self.wfile.write(json.dumps(package_info, indent=2).encode())
+        self.wfile.write(body)
     
     def handle_upload(self):
         """Handle package upload requests"""
@@ -104,10 +104,111 @@ run_test "Clean Script" "/app/bin/cpm run-script clean"
 echo -e "\n${BLUE}=== Testing Registry Server ===${NC}"
 run_test "Registry Server Check" "curl http://localhost:8080/packages/search?q=math"
 
-# 8. Test Search Command (known to potentially segfault)
+# 8. Test Search Command parses the registry's results
 echo -e "\n${BLUE}=== Testing Search Functionality ===${NC}"
-echo -e "${YELLOW}Note: The search command is known to potentially segfault${NC}"
-run_test "Search Command" "/app/bin/cpm search math" "139" # 139 is segfault exit code
+run_test "Search Command" "/app/bin/cpm search math"
+run_test "Search Lists libmath" "/app/bin/cpm search math | grep -E '^libmath +[0-9]+\\.[0-9]+\\.[0-9]+ '"
+
+# 9. Test archive extraction stays inside its destination
+echo -e "\n${BLUE}=== Testing Archive Extraction ===${NC}"
+run_test "Build Test Helper" "make -C /app test-helper"
+EXTRACT_DIR="$TEST_DIR/extract"
+rm -rf "$EXTRACT_DIR" "$TEST_DIR/victim"
+mkdir -p "$EXTRACT_DIR"
+# sub -> ., sub/esc -> ../victim, then esc/payload through the second link
+run_test "Symlink Traversal Archive Rejected" "/app/bin/cpm-test-helper extract /app/tests/data/symlink_escape.tgz $EXTRACT_DIR/pkg" "1"
+run_test "Nothing Written Outside Destination" "test ! -e $TEST_DIR/victim && test ! -e $EXTRACT_DIR/victim"
+
+# 10. Test an install with the registry unreachable fails
+echo -e "\n${BLUE}=== Testing Offline Install ===${NC}"
+OFFLINE_DIR="$TEST_DIR/offline"
+rm -rf "$OFFLINE_DIR"
+mkdir -p "$OFFLINE_DIR"
+cat > "$OFFLINE_DIR/cpm_package.spec" << 'EOF'
+{
+  "name": "offline-app",
+  "version": "1.0.0",
+  "dependencies": { "libzz": "^1.0.0" }
+}
+EOF
+# Nothing listens on the discard port
+OFFLINE_ENV="CPM_REGISTRY=http://127.0.0.1:9 CPM_CACHE_DIR=$OFFLINE_DIR/cache"
+run_test "Offline Install Fails" "cd $OFFLINE_DIR && $OFFLINE_ENV /app/bin/cpm install" "1"
+run_test "Offline Install Leaves No Package" "test ! -e $OFFLINE_DIR/cpm_modules/libzz"
+run_test "Offline Install Writes No Lock" "test ! -e $OFFLINE_DIR/cpm.lock"
+
+# 11. Test a damaged installed package is repaired
+echo -e "\n${BLUE}=== Testing Installed Package Repair ===${NC}"
+REPAIR_DIR="$TEST_DIR/repair"
+rm -rf "$REPAIR_DIR"
+mkdir -p "$REPAIR_DIR"
+cat > "$REPAIR_DIR/cpm_package.spec" << 'EOF'
+{
+  "name": "repair-app",
+  "version": "1.0.0",
+  "dependencies": { "libmath": "^1.0.0" }
+}
+EOF
+REPAIR_ENV="CPM_REGISTRY=http://localhost:8080 CPM_CACHE_DIR=$REPAIR_DIR/cache"
+run_test "Install Before Damage" "cd $REPAIR_DIR && $REPAIR_ENV /app/bin/cpm install"
+rm -f "$REPAIR_DIR/cpm_modules/libmath/cpm_package.spec"
+run_test "Install Repairs Damage" "cd $REPAIR_DIR && $REPAIR_ENV /app/bin/cpm install"
+run_test "Damaged Package Restored" "test -f $REPAIR_DIR/cpm_modules/libmath/cpm_package.spec"
+
+# 12. Test the JSON tokenizer accepts only valid documents
+echo -e "\n${BLUE}=== Testing JSON Tokenizer ===${NC}"
+VALID_JSON=('0' '-12' '1.5e+3' '2E-2' '"caf\u00e9"' '"\ud83d\ude00"' '"a\/b\n"' '{"a":[1,true,null]}' ' [] ')
+INVALID_JSON=('1.' '1+' '2ee' '01' '-' '.5' '"v\q"' $'"a\nb"' $'"\t"' '"\uu0e9"' '"\u00e"' '"\ud800"'
+              '"\udc00"' '"\ud800\u0041"' '"open' '[1,]' '{"a" 1}' 'tru')
+for doc in "${VALID_JSON[@]}"; do
+    if /app/bin/cpm-test-helper json "$doc" > /dev/null; then
+        printf "${GREEN}✓ accepted: %q${NC}\n" "$doc"
+        TESTS_PASSED=$((TESTS_PASSED + 1))
+    else
+        printf "${RED}✗ rejected valid JSON: %q${NC}\n" "$doc"
+        TESTS_FAILED=$((TESTS_FAILED + 1))
+    fi
+    TESTS_TOTAL=$((TESTS_TOTAL + 1))
+done
+for doc in "${INVALID_JSON[@]}"; do
+    if /app/bin/cpm-test-helper json "$doc" > /dev/null; then
+        printf "${RED}✗ accepted malformed JSON: %q${NC}\n" "$doc"
+        TESTS_FAILED=$((TESTS_FAILED + 1))
+    else
+        printf "${GREEN}✓ rejected: %q${NC}\n" "$doc"
+        TESTS_PASSED=$((TESTS_PASSED + 1))
+    fi
+    TESTS_TOTAL=$((TESTS_TOTAL + 1))
+done
+
+# 13. Test SHA-256 and SHA-512 against the FIPS 180-4 known answers
+echo -e "\n${BLUE}=== Testing SHA-256 / SHA-512 ===${NC}"
+DIGEST_448='abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq'
+DIGEST_896='abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmnhijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu'
+DIGEST_VECTORS=(
+    "sha256||1|e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855"
+    "sha256|abc|1|ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"
+    "sha256|$DIGEST_448|1|248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1"
+    "sha256|$DIGEST_896|1|cf5b16a778af8380036ce59e7b0492370b249b11e8f07a51afac45037afee9d1"
+    "sha256|a|1000000|cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0"
+    "sha512||1|cf83e1357eefb8bdf1542850d66d8007d620e4050b5715dc83f4a921d36ce9ce47d0d13c5d85f2b0ff8318d2877eec2f63b931bd47417a81a538327af927da3e"
+    "sha512|abc|1|ddaf35a193617abacc417349ae20413112e6fa4e89a97ea20a9eeee64b55d39a2192992a274fc1a836ba3c23a3feebbd454d4423643ce80e2a9ac94fa54ca49f"
+    "sha512|$DIGEST_448|1|204a8fc6dda82f0a0ced7beb8e08a41657c16ef468b228a8279be331a703c33596fd15c13b1b07f9aa1d3bea57789ca031ad85c7a71dd70354ec631238ca3445"
+    "sha512|$DIGEST_896|1|8e959b75dae313da8cf4f72814fc143f8f7779c6eb9f7fa17299aeadb6889018501d289e4900f7e4331b99dec4b5433ac7d329eeb6dd26545e96e55b874be909"
+    "sha512|a|1000000|e718483d0ce769644e2e42c7bc15b4638e1f98b13b2044285632a803afa973ebde0ff244877ea60a4cb0432ce577c31beb009c5c2c49aa2e4eadb217ad8cc09b"
+)
+for vector in "${DIGEST_VECTORS[@]}"; do
+    IFS='|' read -r algorithm text repeat expected <<< "$vector"
+    actual=$(/app/bin/cpm-test-helper "$algorithm" "$text" "$repeat")
+    if [ "$actual" = "$expected" ]; then
+        echo -e "${GREEN}✓ $algorithm of ${#text}-byte input x$repeat${NC}"
+        TESTS_PASSED=$((TESTS_PASSED + 1))
+    else
+        echo -e "${RED}✗ $algorithm of ${#text}-byte input x$repeat: got $actual${NC}"
+        TESTS_FAILED=$((TESTS_FAILED + 1))
+    fi
+    TESTS_TOTAL=$((TESTS_TOTAL + 1))
+done
 
 # Print summary
 echo -e "\n${BLUE}=== Test Summary ===${NC}"
@@ -0,0 +1,106 @@
+/*
+ * File: tests/cpm_test_helper.c
+ * Description: cpm-test-helper, drives single CPM library routines from
+ * tests/cpm_test.sh so they can be checked without a registry or a network.
+ * Each subcommand exits 0 on success and 1 on failure.
+ * Author: Dr. Q Josef Kurk Edwards
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cpm_types.h"
+#include "cpm_archive.h"
+#include "cpm_digest.h"
+#include "cpm_json.h"
+
+static void usage(void) {
+    fprintf(stderr, "Usage: cpm-test-helper <command> [args]\n");
+    fprintf(stderr, "  extract <archive.tgz> <dest>   Unpack an archive through cpm_archive\n");
+    fprintf(stderr, "  json <text>                    Tokenize text as one JSON document\n");
+    fprintf(stderr, "  sha256|sha512 <text> [repeat]  Hex digest of text repeated `repeat` times\n");
+}
+
+static int helper_extract(const char* archive, const char* dest) {
+    CPM_Result result = cpm_archive_extract_file(archive, dest);
+    if (result != CPM_RESULT_SUCCESS) {
+        printf("extract failed: %d\n", result);
+        return 1;
+    }
+    printf("extracted %s\n", archive);
+    return 0;
+}
+
+static int helper_json(const char* text) {
+    CPM_JsonReader reader;
+    CPM_JsonToken token;
+    cpm_json_reader_init(&reader, text, strlen(text));
+    size_t tokens = 0;
+    while (cpm_json_next(&reader, &token)) tokens++;
+    if (token.type != CPM_JSON_END) {
+        printf("invalid at byte %zu\n", (size_t)(token.start - text));
+        return 1;
+    }
+    printf("valid, %zu tokens\n", tokens);
+    return 0;
+}
+
+// Streams text `repeat` times through the hash. SHA-256 is run with every block
+// function this CPU supports, and the digests must agree.
+static int helper_digest(const char* algorithm, const char* text, long repeat) {
+    size_t length = strlen(text);
+    unsigned char digest[CPM_SHA512_DIGEST_SIZE];
+    size_t digest_size;
+    
+    if (strcmp(algorithm, "sha512") == 0) {
+        CPM_SHA512 ctx;
+        cpm_sha512_init(&ctx);
+        for (long i = 0; i < repeat; i++) cpm_sha512_update(&ctx, text, length);
+        cpm_sha512_final(&ctx, digest);
+        digest_size = CPM_SHA512_DIGEST_SIZE;
+    } else {
+        const CPM_SHA256Impl impls[] = { CPM_SHA256_IMPL_PORTABLE, CPM_SHA256_IMPL_SHANI };
+        CPM_SHA256Impl chosen = cpm_sha256_implementation();
+        bool first = true;
+        for (size_t n = 0; n < sizeof(impls) / sizeof(impls[0]); n++) {
+            if (!cpm_sha256_select(impls[n])) continue;
+            unsigned char impl_digest[CPM_SHA256_DIGEST_SIZE];
+            CPM_SHA256 ctx;
+            cpm_sha256_init(&ctx);
+            for (long i = 0; i < repeat; i++) cpm_sha256_update(&ctx, text, length);
+            cpm_sha256_final(&ctx, impl_digest);
+            if (!first && memcmp(digest, impl_digest, sizeof(impl_digest)) != 0) {
+                printf("%s disagrees with %s\n", cpm_sha256_implementation_name(impls[n]),
+                       cpm_sha256_implementation_name(impls[0]));
+                return 1;
+            }
+            memcpy(digest, impl_digest, sizeof(impl_digest));
+            first = false;
+        }
+        cpm_sha256_select(chosen);
+        digest_size = CPM_SHA256_DIGEST_SIZE;
+    }
+    
+    char* hex = cpm_digest_to_hex(digest, digest_size);
+    if (!hex) return 1;
+    printf("%s\n", hex);
+    free(hex);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc == 4 && strcmp(argv[1], "extract") == 0) {
+        return helper_extract(argv[2], argv[3]);
+    }
+    if (argc == 3 && strcmp(argv[1], "json") == 0) {
+        return helper_json(argv[2]);
+    }
+    if ((argc == 3 || argc == 4) && (strcmp(argv[1], "sha256") == 0 || strcmp(argv[1], "sha512") == 0)) {
+        long repeat = argc == 4 ? strtol(argv[3], NULL, 10) : 1;
+        return helper_digest(argv[1], argv[2], repeat);
+    }
+    
+    usage();
+    return 2;
+}
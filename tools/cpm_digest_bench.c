@@ -0,0 +1,141 @@
+/*
+ * File: tools/cpm_digest_bench.c
+ * Description: cpm-bench-digest, throughput of CPM's archive digests.
+ * Hashes a buffer through every SHA-256 implementation this CPU can run and
+ * through SHA-512, fed in pieces the size curl hands to a write callback, so
+ * the numbers are what inline verification costs a download.
+ * Author: Dr. Q Josef Kurk Edwards
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <getopt.h>
+#include <time.h>
+#include "cpm_digest.h"
+
+#define BENCH_DEFAULT_MB 64
+#define BENCH_DEFAULT_ROUNDS 5
+#define BENCH_WRITE_SIZE 16384      // CURL_MAX_WRITE_SIZE
+
+typedef enum {
+    BENCH_SHA256,
+    BENCH_SHA512
+} BenchAlgorithm;
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+// Best of rounds, in MB/s; digest receives the last result
+static double bench_run(BenchAlgorithm algorithm, const unsigned char* data, size_t size, int rounds,
+                        unsigned char digest[CPM_DIGEST_MAX_SIZE]) {
+    double best = 0;
+    for (int r = 0; r < rounds; r++) {
+        double start = now_seconds();
+        if (algorithm == BENCH_SHA256) {
+            CPM_SHA256 ctx;
+            cpm_sha256_init(&ctx);
+            for (size_t off = 0; off < size; off += BENCH_WRITE_SIZE) {
+                cpm_sha256_update(&ctx, data + off, size - off < BENCH_WRITE_SIZE ? size - off : BENCH_WRITE_SIZE);
+            }
+            cpm_sha256_final(&ctx, digest);
+        } else {
+            CPM_SHA512 ctx;
+            cpm_sha512_init(&ctx);
+            for (size_t off = 0; off < size; off += BENCH_WRITE_SIZE) {
+                cpm_sha512_update(&ctx, data + off, size - off < BENCH_WRITE_SIZE ? size - off : BENCH_WRITE_SIZE);
+            }
+            cpm_sha512_final(&ctx, digest);
+        }
+        double elapsed = now_seconds() - start;
+        double rate = (double)size / (1024.0 * 1024.0) / (elapsed > 0 ? elapsed : 1e-9);
+        if (rate > best) best = rate;
+    }
+    return best;
+}
+
+static void print_usage(const char* program) {
+    printf("Usage: %s [options]\n", program);
+    printf("  -s, --size <MB>      Bytes hashed per round (default: %d)\n", BENCH_DEFAULT_MB);
+    printf("  -r, --rounds <n>     Rounds per implementation; the best counts (default: %d)\n", BENCH_DEFAULT_ROUNDS);
+    printf("  -h, --help           Show this help\n");
+}
+
+int main(int argc, char** argv) {
+    long size_mb = BENCH_DEFAULT_MB;
+    int rounds = BENCH_DEFAULT_ROUNDS;
+    
+    static const struct option options[] = {
+        { "size", required_argument, NULL, 's' },
+        { "rounds", required_argument, NULL, 'r' },
+        { "help", no_argument, NULL, 'h' },
+        { NULL, 0, NULL, 0 }
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "s:r:h", options, NULL)) != -1) {
+        switch (opt) {
+            case 's': size_mb = atol(optarg); break;
+            case 'r': rounds = atoi(optarg); break;
+            case 'h': print_usage(argv[0]); return 0;
+            default: print_usage(argv[0]); return 1;
+        }
+    }
+    if (size_mb <= 0 || rounds <= 0) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    
+    size_t size = (size_t)size_mb << 20;
+    unsigned char* data = malloc(size);
+    if (!data) {
+        fprintf(stderr, "[CPM Bench] Cannot allocate %ld MB\n", size_mb);
+        return 1;
+    }
+    uint64_t x = 0x9e3779b97f4a7c15ULL;
+    for (size_t i = 0; i < size; i++) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        data[i] = (unsigned char)x;
+    }
+    
+    CPM_SHA256Impl detected = cpm_sha256_implementation();
+    printf("[CPM Bench] %ld MB in %d-byte writes, best of %d rounds; SHA-256 uses %s by default\n",
+           size_mb, BENCH_WRITE_SIZE, rounds, cpm_sha256_implementation_name(detected));
+    
+    // Every implementation must agree with the portable one
+    unsigned char reference[CPM_DIGEST_MAX_SIZE];
+    unsigned char digest[CPM_DIGEST_MAX_SIZE];
+    double portable = 0;
+    bool agree = true;
+    const CPM_SHA256Impl impls[] = { CPM_SHA256_IMPL_PORTABLE, CPM_SHA256_IMPL_SHANI };
+    for (size_t i = 0; i < sizeof(impls) / sizeof(impls[0]); i++) {
+        const char* name = cpm_sha256_implementation_name(impls[i]);
+        if (!cpm_sha256_select(impls[i])) {
+            printf("  sha256 %-10s not supported on this CPU\n", name);
+            continue;
+        }
+        double rate = bench_run(BENCH_SHA256, data, size, rounds, i == 0 ? reference : digest);
+        if (i == 0) {
+            portable = rate;
+            printf("  sha256 %-10s %9.1f MB/s\n", name, rate);
+        } else {
+            bool same = memcmp(reference, digest, CPM_SHA256_DIGEST_SIZE) == 0;
+            agree = agree && same;
+            printf("  sha256 %-10s %9.1f MB/s  %.2fx portable%s\n", name, rate, portable > 0 ? rate / portable : 0,
+                   same ? "" : "  DIGEST MISMATCH");
+        }
+    }
+    cpm_sha256_select(detected);
+    
+    printf("  sha512 %-10s %9.1f MB/s\n", "portable", bench_run(BENCH_SHA512, data, size, rounds, digest));
+    
+    free(data);
+    return agree ? 0 : 1;
+}
@@ -0,0 +1,1037 @@
+/*
+ * File: tools/cpm_registry_server.c
+ * Description: cpm-registry, a local stand-in for the CPM registry.
+ * Serves package metadata, search and tarballs from cpm_registry.db (the same
+ * SQLite `packages` table registry_server.py uses) so the resolver and the
+ * installer can be benchmarked and tested without a network. Every response
+ * can be delayed (--latency) and its body throttled (--bandwidth) to model a
+ * remote registry reproducibly.
+ *
+ * Endpoints:
+ *   GET /packages/search?q=<query>&limit=<n>
+ *                                      ranked by a full-text index kept
+ *                                      in <db>.idx and rebuilt when
+ *                                      packages are added
+ *   GET /packages/<name>/versions
+ *   GET /packages/<name>/<version>     dependencies come from an optional
+ *                                      `dependencies` column (JSON text)
+ *   GET /tarballs/<name>-<version>.tgz from --packages; advertised with an
+ *                                      integrity hash when the file exists.
+ *                                      Single byte ranges and If-Range are
+ *                                      honored; --drop-after cuts responses
+ *                                      short to model a flaky link.
+ * Connections are HTTP/1.1 keep-alive, one thread each.
+ * Author: Dr. Q Josef Kurk Edwards
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sqlite3.h>
+#include "cpm_digest.h"
+#include "cpm_search_index.h"
+
+#define REGISTRY_REQUEST_MAX 16384
+#define REGISTRY_IDLE_TIMEOUT 30
+#define REGISTRY_SHAPE_CHUNK 4096
+#define REGISTRY_SEARCH_LIMIT 20
+#define REGISTRY_SEARCH_LIMIT_MAX 250
+
+// --- Configuration ---
+typedef struct {
+    const char* host;
+    int port;
+    const char* db_path;
+    const char* packages_dir;
+    long latency_ms;            // Added before every response
+    long bandwidth;             // Bytes per second per response body, 0 = unlimited
+    long drop_after;            // Cut tarball responses after this many bytes, 0 = never
+    bool quiet;
+    bool reindex;               // Rebuild the search index at startup even if current
+    bool has_dependencies;      // packages.dependencies column present
+} ServerConfig;
+
+static ServerConfig server = {
+    .host = "127.0.0.1",
+    .port = 8080,
+    .db_path = "cpm_registry.db",
+    .packages_dir = "packages",
+};
+
+static const char* schema_sql =
+    "CREATE TABLE IF NOT EXISTS packages ("
+    " id INTEGER PRIMARY KEY AUTOINCREMENT,"
+    " name TEXT NOT NULL,"
+    " version TEXT NOT NULL,"
+    " description TEXT,"
+    " author TEXT,"
+    " homepage TEXT,"
+    " repository TEXT,"
+    " license TEXT,"
+    " created_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP,"
+    " downloads INTEGER DEFAULT 0,"
+    " UNIQUE(name, version))";
+
+// --- Buffers ---
+typedef struct {
+    char* data;
+    size_t len;
+    size_t cap;
+} Buffer;
+
+static bool buf_reserve(Buffer* buf, size_t extra) {
+    if (buf->len + extra + 1 <= buf->cap) return true;
+    size_t cap = buf->cap ? buf->cap : 256;
+    while (cap < buf->len + extra + 1) cap *= 2;
+    char* grown = realloc(buf->data, cap);
+    if (!grown) return false;
+    buf->data = grown;
+    buf->cap = cap;
+    return true;
+}
+
+static void buf_append(Buffer* buf, const char* data, size_t len) {
+    if (!buf_reserve(buf, len)) return;
+    memcpy(buf->data + buf->len, data, len);
+    buf->len += len;
+    buf->data[buf->len] = '\0';
+}
+
+static void buf_puts(Buffer* buf, const char* str) {
+    buf_append(buf, str, strlen(str));
+}
+
+static void buf_printf(Buffer* buf, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    int needed = vsnprintf(NULL, 0, format, args);
+    va_end(args);
+    if (needed < 0 || !buf_reserve(buf, (size_t)needed)) return;
+    
+    va_start(args, format);
+    vsnprintf(buf->data + buf->len, (size_t)needed + 1, format, args);
+    va_end(args);
+    buf->len += (size_t)needed;
+}
+
+// Appends a JSON string literal (null for NULL)
+static void buf_json_string(Buffer* buf, const char* str) {
+    if (!str) {
+        buf_puts(buf, "null");
+        return;
+    }
+    buf_puts(buf, "\"");
+    for (const unsigned char* p = (const unsigned char*)str; *p; p++) {
+        switch (*p) {
+            case '"':  buf_puts(buf, "\\\""); break;
+            case '\\': buf_puts(buf, "\\\\"); break;
+            case '\n': buf_puts(buf, "\\n"); break;
+            case '\r': buf_puts(buf, "\\r"); break;
+            case '\t': buf_puts(buf, "\\t"); break;
+            default:
+                if (*p < 0x20) {
+                    buf_printf(buf, "\\u%04x", *p);
+                } else {
+                    buf_append(buf, (const char*)p, 1);
+                }
+        }
+    }
+    buf_puts(buf, "\"");
+}
+
+static void buf_free(Buffer* buf) {
+    free(buf->data);
+    buf->data = NULL;
+    buf->len = buf->cap = 0;
+}
+
+static const char* column_text(sqlite3_stmt* stmt, int column) {
+    return (const char*)sqlite3_column_text(stmt, column);
+}
+
+// --- Integrity Cache ---
+// Hashing a tarball on every metadata request would dominate a benchmark, so
+// digests are kept until the file's size or mtime changes.
+typedef struct IntegrityEntry {
+    char* path;
+    off_t size;
+    struct timespec mtime;
+    char* integrity;
+    struct IntegrityEntry* next;
+} IntegrityEntry;
+
+static IntegrityEntry* integrity_cache = NULL;
+static pthread_mutex_t integrity_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static char* integrity_lookup(const char* path, const struct stat* st) {
+    char* result = NULL;
+    pthread_mutex_lock(&integrity_lock);
+    for (IntegrityEntry* e = integrity_cache; e; e = e->next) {
+        if (strcmp(e->path, path) != 0) continue;
+        if (e->size == st->st_size && e->mtime.tv_sec == st->st_mtim.tv_sec && e->mtime.tv_nsec == st->st_mtim.tv_nsec) {
+            result = strdup(e->integrity);
+        }
+        break;
+    }
+    pthread_mutex_unlock(&integrity_lock);
+    if (result) return result;
+    
+    result = cpm_integrity_of_file(path);
+    if (!result) return NULL;
+    
+    pthread_mutex_lock(&integrity_lock);
+    IntegrityEntry* entry = integrity_cache;
+    while (entry && strcmp(entry->path, path) != 0) entry = entry->next;
+    if (!entry && (entry = calloc(1, sizeof(IntegrityEntry)))) {
+        entry->path = strdup(path);
+        entry->next = integrity_cache;
+        integrity_cache = entry;
+    }
+    if (entry) {
+        free(entry->integrity);
+        entry->integrity = strdup(result);
+        entry->size = st->st_size;
+        entry->mtime = st->st_mtim;
+    }
+    pthread_mutex_unlock(&integrity_lock);
+    return result;
+}
+
+// --- HTTP ---
+typedef struct {
+    int fd;
+    sqlite3* db;
+    char buffer[REGISTRY_REQUEST_MAX];
+    size_t used;
+} Connection;
+
+typedef struct {
+    char method[16];
+    char target[2048];
+    char if_none_match[256];
+    char range[128];
+    char if_range[256];
+    size_t content_length;
+    bool keep_alive;
+} Request;
+
+static const char* status_text(int status) {
+    switch (status) {
+        case 200: return "OK";
+        case 206: return "Partial Content";
+        case 304: return "Not Modified";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 416: return "Range Not Satisfiable";
+        case 500: return "Internal Server Error";
+        case 501: return "Not Implemented";
+        default:  return "Unknown";
+    }
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void sleep_seconds(double seconds) {
+    if (seconds <= 0) return;
+    struct timespec ts = { (time_t)seconds, (long)((seconds - (double)(time_t)seconds) * 1e9) };
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {}
+}
+
+static bool send_all(int fd, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+// Paces a response body to server.bandwidth bytes/second from its first byte
+typedef struct {
+    double start;
+    uint64_t sent;
+} Shaper;
+
+static bool send_shaped(int fd, const char* data, size_t len, Shaper* shaper) {
+    if (server.bandwidth <= 0) {
+        shaper->sent += len;
+        return send_all(fd, data, len);
+    }
+    
+    while (len > 0) {
+        size_t chunk = len < REGISTRY_SHAPE_CHUNK ? len : REGISTRY_SHAPE_CHUNK;
+        double due = (double)(shaper->sent + chunk) / (double)server.bandwidth;
+        sleep_seconds(due - (now_seconds() - shaper->start));
+        if (!send_all(fd, data, chunk)) return false;
+        shaper->sent += chunk;
+        data += chunk;
+        len -= chunk;
+    }
+    return true;
+}
+
+// extra: further header lines, each ending in CRLF
+static bool send_head(Connection* conn, const Request* req, int status, const char* content_type,
+                      size_t content_length, const char* etag, const char* extra) {
+    sleep_seconds((double)server.latency_ms / 1000.0);
+    
+    Buffer head = {0};
+    buf_printf(&head, "HTTP/1.1 %d %s\r\nServer: cpm-registry\r\nContent-Length: %zu\r\n",
+               status, status_text(status), content_length);
+    if (content_type) buf_printf(&head, "Content-Type: %s\r\n", content_type);
+    if (etag) buf_printf(&head, "ETag: %s\r\n", etag);
+    if (extra) buf_puts(&head, extra);
+    buf_puts(&head, req->keep_alive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n");
+    
+    bool ok = head.data && send_all(conn->fd, head.data, head.len);
+    buf_free(&head);
+    return ok;
+}
+
+static bool send_body(Connection* conn, const Request* req, int status, const char* content_type,
+                      const char* body, size_t len) {
+    if (!send_head(conn, req, status, content_type, len, NULL, NULL)) return false;
+    Shaper shaper = { now_seconds(), 0 };
+    return send_shaped(conn->fd, body, len, &shaper);
+}
+
+static bool send_error(Connection* conn, const Request* req, int status, const char* message) {
+    Buffer body = {0};
+    buf_puts(&body, "{\"error\": ");
+    buf_json_string(&body, message);
+    buf_puts(&body, "}");
+    bool ok = send_body(conn, req, status, "application/json", body.data, body.len);
+    buf_free(&body);
+    return ok;
+}
+
+// Sends a JSON document with an ETag, answering 304 when the client's copy is current
+static bool send_cacheable_json(Connection* conn, const Request* req, const Buffer* body) {
+    unsigned char digest[CPM_SHA256_DIGEST_SIZE];
+    cpm_sha256(body->data, body->len, digest);
+    char* hex = cpm_digest_to_hex(digest, 20);
+    char etag[64];
+    snprintf(etag, sizeof(etag), "\"%s\"", hex ? hex : "");
+    free(hex);
+    
+    if (strcmp(req->if_none_match, etag) == 0) {
+        return send_head(conn, req, 304, NULL, 0, etag, NULL);
+    }
+    if (!send_head(conn, req, 200, "application/json", body->len, etag, NULL)) return false;
+    Shaper shaper = { now_seconds(), 0 };
+    return send_shaped(conn->fd, body->data, body->len, &shaper);
+}
+
+// Decodes %XX and '+' in place
+static void url_decode(char* str) {
+    char* out = str;
+    for (char* p = str; *p; p++) {
+        if (*p == '%' && isxdigit((unsigned char)p[1]) && isxdigit((unsigned char)p[2])) {
+            char hex[3] = { p[1], p[2], '\0' };
+            *out++ = (char)strtol(hex, NULL, 16);
+            p += 2;
+        } else if (*p == '+') {
+            *out++ = ' ';
+        } else {
+            *out++ = *p;
+        }
+    }
+    *out = '\0';
+}
+
+// --- Search Index ---
+// Queries run against a mapped snapshot of the index. A search that finds the
+// table has grown since the snapshot was built rebuilds it while the others
+// keep using the old one; the last search holding a snapshot closes it.
+typedef struct {
+    CPM_SearchIndex* index;
+    int refs;
+} SearchSnapshot;
+
+static SearchSnapshot* search_current = NULL;
+static pthread_mutex_t search_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t search_build_lock = PTHREAD_MUTEX_INITIALIZER;
+static char* search_index_path = NULL;
+static uint64_t search_failed_stamp = UINT64_MAX;  // Not retried until the table changes
+
+static SearchSnapshot* search_acquire(void) {
+    pthread_mutex_lock(&search_lock);
+    SearchSnapshot* snapshot = search_current;
+    if (snapshot) snapshot->refs++;
+    pthread_mutex_unlock(&search_lock);
+    return snapshot;
+}
+
+static void search_release(SearchSnapshot* snapshot) {
+    if (!snapshot) return;
+    pthread_mutex_lock(&search_lock);
+    bool last = --snapshot->refs == 0;
+    pthread_mutex_unlock(&search_lock);
+    if (last) {
+        cpm_search_index_close(snapshot->index);
+        free(snapshot);
+    }
+}
+
+static void search_publish(CPM_SearchIndex* index) {
+    SearchSnapshot* snapshot = calloc(1, sizeof(SearchSnapshot));
+    if (!snapshot) {
+        cpm_search_index_close(index);
+        return;
+    }
+    snapshot->index = index;
+    snapshot->refs = 1;
+    pthread_mutex_lock(&search_lock);
+    SearchSnapshot* old = search_current;
+    search_current = snapshot;
+    pthread_mutex_unlock(&search_lock);
+    search_release(old);
+}
+
+// Rows only ever get added (ids are AUTOINCREMENT), so the newest id tells
+// whether an index is current. Download counts are as of the last rebuild.
+static uint64_t search_stamp(sqlite3* db) {
+    sqlite3_stmt* stmt = NULL;
+    uint64_t stamp = 0;
+    if (sqlite3_prepare_v2(db, "SELECT MAX(id) FROM packages", -1, &stmt, NULL) == SQLITE_OK &&
+        sqlite3_step(stmt) == SQLITE_ROW) {
+        stamp = (uint64_t)sqlite3_column_int64(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    return stamp;
+}
+
+static bool search_rebuild(sqlite3* db, uint64_t stamp) {
+    double start = now_seconds();
+    sqlite3_stmt* stmt = NULL;
+    if (sqlite3_prepare_v2(db,
+            "SELECT name, MAX(version), description, author, homepage, SUM(downloads) FROM packages GROUP BY name",
+            -1, &stmt, NULL) != SQLITE_OK) {
+        fprintf(stderr, "[CPM Registry] Cannot index packages: %s\n", sqlite3_errmsg(db));
+        search_failed_stamp = stamp;
+        return false;
+    }
+    
+    CPM_SearchIndexBuilder* builder = cpm_search_index_builder_create();
+    bool ok = builder != NULL;
+    while (ok && sqlite3_step(stmt) == SQLITE_ROW) {
+        sqlite3_int64 downloads = sqlite3_column_int64(stmt, 5);
+        CPM_SearchDocument document = {
+            .name = column_text(stmt, 0),
+            .version = column_text(stmt, 1),
+            .description = column_text(stmt, 2),
+            .author = column_text(stmt, 3),
+            .homepage = column_text(stmt, 4),
+            .downloads = downloads > 0 ? (uint64_t)downloads : 0,
+        };
+        ok = cpm_search_index_builder_add(builder, &document);
+    }
+    sqlite3_finalize(stmt);
+    
+    ok = ok && cpm_search_index_builder_write(builder, search_index_path, stamp) == CPM_RESULT_SUCCESS;
+    cpm_search_index_builder_free(builder);
+    CPM_SearchIndex* index = ok ? cpm_search_index_open(search_index_path) : NULL;
+    if (!index) {
+        fprintf(stderr, "[CPM Registry] Cannot write search index %s\n", search_index_path);
+        search_failed_stamp = stamp;
+        return false;
+    }
+    if (!server.quiet) {
+        printf("[CPM Registry] Indexed %zu packages into %s in %.0f ms\n", cpm_search_index_document_count(index),
+               search_index_path, (now_seconds() - start) * 1000.0);
+    }
+    search_publish(index);
+    return true;
+}
+
+// The current snapshot, rebuilt first if the table has grown. Searches that
+// arrive during a rebuild use the previous snapshot when there is one.
+static SearchSnapshot* search_snapshot(sqlite3* db) {
+    uint64_t stamp = search_stamp(db);
+    SearchSnapshot* snapshot = search_acquire();
+    if (snapshot && cpm_search_index_stamp(snapshot->index) == stamp) return snapshot;
+    
+    if (snapshot && pthread_mutex_trylock(&search_build_lock) != 0) return snapshot;
+    if (!snapshot) pthread_mutex_lock(&search_build_lock);
+    search_release(snapshot);
+    snapshot = search_acquire();
+    if ((!snapshot || cpm_search_index_stamp(snapshot->index) != stamp) && stamp != search_failed_stamp) {
+        search_release(snapshot);
+        search_rebuild(db, stamp);
+        snapshot = search_acquire();
+    }
+    pthread_mutex_unlock(&search_build_lock);
+    return snapshot;
+}
+
+// --- Handlers ---
+static void buf_search_hit(Buffer* buf, bool first, const CPM_SearchDocument* document) {
+    buf_puts(buf, first ? "{\"name\": " : ", {\"name\": ");
+    buf_json_string(buf, document->name);
+    buf_puts(buf, ", \"version\": ");
+    buf_json_string(buf, document->version);
+    buf_puts(buf, ", \"description\": ");
+    buf_json_string(buf, document->description);
+    buf_puts(buf, ", \"author\": ");
+    buf_json_string(buf, document->author);
+    buf_puts(buf, ", \"homepage\": ");
+    buf_json_string(buf, document->homepage);
+    buf_printf(buf, ", \"downloads\": %llu}", (unsigned long long)document->downloads);
+}
+
+// Without an index (e.g. the database directory is read-only) the original
+// substring match still answers, most downloaded first
+static size_t search_table(sqlite3* db, const char* q, size_t limit, Buffer* body) {
+    sqlite3_stmt* stmt = NULL;
+    if (sqlite3_prepare_v2(db,
+            "SELECT name, MAX(version), description, author, homepage, SUM(downloads) FROM packages "
+            "WHERE ?1 = '' OR name LIKE '%' || ?1 || '%' OR description LIKE '%' || ?1 || '%' "
+            "GROUP BY name ORDER BY SUM(downloads) DESC, name", -1, &stmt, NULL) != SQLITE_OK) {
+        return 0;
+    }
+    sqlite3_bind_text(stmt, 1, q, -1, SQLITE_TRANSIENT);
+    size_t total = 0;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        if (total++ >= limit) continue;
+        sqlite3_int64 downloads = sqlite3_column_int64(stmt, 5);
+        CPM_SearchDocument document = {
+            column_text(stmt, 0), column_text(stmt, 1), column_text(stmt, 2),
+            column_text(stmt, 3), column_text(stmt, 4), downloads > 0 ? (uint64_t)downloads : 0
+        };
+        buf_search_hit(body, total == 1, &document);
+    }
+    sqlite3_finalize(stmt);
+    return total;
+}
+
+static bool handle_search(Connection* conn, const Request* req, const char* query, size_t limit) {
+    char* q = strdup(query ? query : "");
+    CPM_SearchHit* hits = malloc((limit ? limit : 1) * sizeof(CPM_SearchHit));
+    if (!q || !hits) {
+        free(q);
+        free(hits);
+        return send_error(conn, req, 500, "out of memory");
+    }
+    url_decode(q);
+    
+    Buffer body = {0};
+    buf_puts(&body, "{\"query\": ");
+    buf_json_string(&body, q);
+    buf_puts(&body, ", \"packages\": [");
+    size_t total = 0;
+    SearchSnapshot* snapshot = search_snapshot(conn->db);
+    if (snapshot) {
+        size_t count = cpm_search_index_query(snapshot->index, q, hits, limit, &total);
+        for (size_t i = 0; i < count; i++) buf_search_hit(&body, i == 0, &hits[i].document);
+        search_release(snapshot);
+    } else {
+        total = search_table(conn->db, q, limit, &body);
+    }
+    buf_printf(&body, "], \"total\": %zu}", total);
+    free(hits);
+    free(q);
+    
+    bool ok = body.data ? send_body(conn, req, 200, "application/json", body.data, body.len)
+                        : send_error(conn, req, 500, "out of memory");
+    buf_free(&body);
+    return ok;
+}
+
+static bool handle_versions(Connection* conn, const Request* req, const char* name) {
+    sqlite3_stmt* stmt = NULL;
+    if (sqlite3_prepare_v2(conn->db, "SELECT version, created_at FROM packages WHERE name = ? ORDER BY created_at DESC, id DESC",
+                           -1, &stmt, NULL) != SQLITE_OK) {
+        return send_error(conn, req, 500, sqlite3_errmsg(conn->db));
+    }
+    sqlite3_bind_text(stmt, 1, name, -1, SQLITE_STATIC);
+    
+    Buffer body = {0};
+    buf_puts(&body, "{\"package\": ");
+    buf_json_string(&body, name);
+    buf_puts(&body, ", \"versions\": [");
+    size_t count = 0;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        buf_puts(&body, count ? ", {\"version\": " : "{\"version\": ");
+        buf_json_string(&body, column_text(stmt, 0));
+        buf_puts(&body, ", \"created_at\": ");
+        buf_json_string(&body, column_text(stmt, 1));
+        buf_puts(&body, "}");
+        count++;
+    }
+    buf_puts(&body, "]}");
+    sqlite3_finalize(stmt);
+    
+    bool ok;
+    if (count == 0) {
+        ok = send_error(conn, req, 404, "package not found");
+    } else {
+        ok = body.data ? send_cacheable_json(conn, req, &body) : send_error(conn, req, 500, "out of memory");
+    }
+    buf_free(&body);
+    return ok;
+}
+
+static bool handle_package(Connection* conn, const Request* req, const char* name, const char* version) {
+    const char* sql = server.has_dependencies
+        ? "SELECT description, author, license, dependencies FROM packages WHERE name = ? AND version = ?"
+        : "SELECT description, author, license, NULL FROM packages WHERE name = ? AND version = ?";
+    sqlite3_stmt* stmt = NULL;
+    if (sqlite3_prepare_v2(conn->db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+        return send_error(conn, req, 500, sqlite3_errmsg(conn->db));
+    }
+    sqlite3_bind_text(stmt, 1, name, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, version, -1, SQLITE_STATIC);
+    
+    if (sqlite3_step(stmt) != SQLITE_ROW) {
+        sqlite3_finalize(stmt);
+        return send_error(conn, req, 404, "version not found");
+    }
+    
+    Buffer body = {0};
+    buf_puts(&body, "{\"name\": ");
+    buf_json_string(&body, name);
+    buf_puts(&body, ", \"version\": ");
+    buf_json_string(&body, version);
+    buf_puts(&body, ", \"description\": ");
+    buf_json_string(&body, column_text(stmt, 0));
+    buf_puts(&body, ", \"author\": ");
+    buf_json_string(&body, column_text(stmt, 1));
+    buf_puts(&body, ", \"license\": ");
+    buf_json_string(&body, column_text(stmt, 2));
+    
+    // Stored as JSON text, either {"name": "constraint"} or ["name@constraint"]
+    const char* dependencies = column_text(stmt, 3);
+    buf_puts(&body, ", \"dependencies\": ");
+    buf_puts(&body, dependencies && *dependencies ? dependencies : "[]");
+    
+    char file[512];
+    char path[1024];
+    struct stat st;
+    snprintf(file, sizeof(file), "%s-%s.tgz", name, version);
+    snprintf(path, sizeof(path), "%s/%s", server.packages_dir, file);
+    if (!strchr(file, '/') && stat(path, &st) == 0 && S_ISREG(st.st_mode)) {
+        char* integrity = integrity_lookup(path, &st);
+        buf_puts(&body, ", \"download_url\": ");
+        Buffer url = {0};
+        buf_printf(&url, "/tarballs/%s", file);
+        buf_json_string(&body, url.data);
+        buf_free(&url);
+        if (integrity) {
+            buf_puts(&body, ", \"integrity\": ");
+            buf_json_string(&body, integrity);
+            free(integrity);
+        }
+    }
+    buf_puts(&body, "}");
+    sqlite3_finalize(stmt);
+    
+    bool ok = body.data ? send_cacheable_json(conn, req, &body) : send_error(conn, req, 500, "out of memory");
+    buf_free(&body);
+    return ok;
+}
+
+static bool handle_tarball(Connection* conn, const Request* req, const char* file) {
+    size_t len = strlen(file);
+    if (len < 5 || strchr(file, '/') || file[0] == '.' || strcmp(file + len - 4, ".tgz") != 0) {
+        return send_error(conn, req, 404, "not found");
+    }
+    
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/%s", server.packages_dir, file);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        if (fd >= 0) close(fd);
+        return send_error(conn, req, 404, "tarball not found");
+    }
+    
+    // A single byte range, honored unless If-Range names another version of the file
+    char etag[64];
+    snprintf(etag, sizeof(etag), "\"%llx-%llx\"", (unsigned long long)st.st_size,
+             (unsigned long long)st.st_mtim.tv_sec * 1000000000ULL + (unsigned long long)st.st_mtim.tv_nsec);
+    uint64_t size = (uint64_t)st.st_size;
+    uint64_t first = 0;
+    uint64_t last = size ? size - 1 : 0;
+    bool ranged = false;
+    if (req->range[0] && (!req->if_range[0] || strcmp(req->if_range, etag) == 0)) {
+        unsigned long long a, b;
+        int fields = sscanf(req->range, "bytes=%llu-%llu", &a, &b);
+        if (fields >= 1 && !strchr(req->range, ',')) {
+            if (a >= size || (fields == 2 && b < a)) {
+                close(fd);
+                char extra[96];
+                snprintf(extra, sizeof(extra), "Content-Range: bytes */%llu\r\n", (unsigned long long)size);
+                return send_head(conn, req, 416, NULL, 0, etag, extra);
+            }
+            first = a;
+            if (fields == 2 && b < last) last = b;
+            ranged = true;
+        }
+    }
+    
+    // Resumed transfers and later chunks are not new downloads
+    if (first == 0) {
+        sqlite3_stmt* stmt = NULL;
+        if (sqlite3_prepare_v2(conn->db, "UPDATE packages SET downloads = downloads + 1 WHERE name || '-' || version || '.tgz' = ?",
+                               -1, &stmt, NULL) == SQLITE_OK) {
+            sqlite3_bind_text(stmt, 1, file, -1, SQLITE_STATIC);
+            sqlite3_step(stmt);
+        }
+        sqlite3_finalize(stmt);
+    }
+    
+    char extra[160] = "Accept-Ranges: bytes\r\n";
+    if (ranged) {
+        snprintf(extra, sizeof(extra), "Accept-Ranges: bytes\r\nContent-Range: bytes %llu-%llu/%llu\r\n",
+                 (unsigned long long)first, (unsigned long long)last, (unsigned long long)size);
+    }
+    size_t length = size ? (size_t)(last - first + 1) : 0;
+    bool ok = send_head(conn, req, ranged ? 206 : 200, "application/gzip", length, etag, extra) &&
+              (first == 0 || lseek(fd, (off_t)first, SEEK_SET) == (off_t)first);
+    
+    // --drop-after models a flaky link: the connection dies mid-body
+    Shaper shaper = { now_seconds(), 0 };
+    char chunk[65536];
+    while (ok && length > 0) {
+        ssize_t n = read(fd, chunk, length < sizeof(chunk) ? length : sizeof(chunk));
+        if (n <= 0) {
+            ok = false;
+            break;
+        }
+        size_t send_len = (size_t)n;
+        bool drop = server.drop_after > 0 && shaper.sent + send_len > (uint64_t)server.drop_after;
+        if (drop) send_len = (size_t)((uint64_t)server.drop_after - shaper.sent);
+        ok = send_shaped(conn->fd, chunk, send_len, &shaper) && !drop;
+        length -= (size_t)n;
+    }
+    close(fd);
+    return ok;
+}
+
+static bool dispatch(Connection* conn, const Request* req) {
+    char target[sizeof(req->target)];
+    snprintf(target, sizeof(target), "%s", req->target);
+    char* query = strchr(target, '?');
+    if (query) *query++ = '\0';
+    
+    // Split the path into at most three decoded segments
+    char* segments[4] = {0};
+    size_t count = 0;
+    char* save = NULL;
+    for (char* seg = strtok_r(target, "/", &save); seg; seg = strtok_r(NULL, "/", &save)) {
+        if (count == 4) return send_error(conn, req, 404, "not found");
+        url_decode(seg);
+        segments[count++] = seg;
+    }
+    
+    bool is_get = strcmp(req->method, "GET") == 0;
+    if (count == 2 && strcmp(segments[0], "packages") == 0 && strcmp(segments[1], "upload") == 0) {
+        return send_error(conn, req, 501, "cpm-registry is read-only; publish to registry_server.py");
+    }
+    if (!is_get) return send_error(conn, req, 405, "only GET is supported");
+    
+    if (count == 2 && strcmp(segments[0], "packages") == 0 && strcmp(segments[1], "search") == 0) {
+        const char* q = "";
+        long limit = REGISTRY_SEARCH_LIMIT;
+        for (char* param = query ? strtok_r(query, "&", &save) : NULL; param; param = strtok_r(NULL, "&", &save)) {
+            if (strncmp(param, "q=", 2) == 0) q = param + 2;
+            if (strncmp(param, "limit=", 6) == 0) limit = atol(param + 6);
+        }
+        if (limit < 0) limit = 0;
+        if (limit > REGISTRY_SEARCH_LIMIT_MAX) limit = REGISTRY_SEARCH_LIMIT_MAX;
+        return handle_search(conn, req, q, (size_t)limit);
+    }
+    if (count == 3 && strcmp(segments[0], "packages") == 0) {
+        if (strcmp(segments[2], "versions") == 0) return handle_versions(conn, req, segments[1]);
+        return handle_package(conn, req, segments[1], segments[2]);
+    }
+    if (count == 2 && strcmp(segments[0], "tarballs") == 0) {
+        return handle_tarball(conn, req, segments[1]);
+    }
+    return send_error(conn, req, 404, "not found");
+}
+
+// Reads the next request head; false on EOF, timeout or a malformed request
+static bool read_request(Connection* conn, Request* req, size_t* head_len) {
+    char* end;
+    while (!(end = memmem(conn->buffer, conn->used, "\r\n\r\n", 4))) {
+        if (conn->used == sizeof(conn->buffer)) return false;
+        ssize_t n = recv(conn->fd, conn->buffer + conn->used, sizeof(conn->buffer) - conn->used, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        conn->used += (size_t)n;
+    }
+    *end = '\0';
+    *head_len = (size_t)(end - conn->buffer) + 4;
+    
+    memset(req, 0, sizeof(*req));
+    char version[16] = "";
+    if (sscanf(conn->buffer, "%15s %2047s %15s", req->method, req->target, version) != 3) return false;
+    req->keep_alive = strcmp(version, "HTTP/1.1") == 0;
+    
+    char* save = NULL;
+    strtok_r(conn->buffer, "\r\n", &save);
+    for (char* line = strtok_r(NULL, "\r\n", &save); line; line = strtok_r(NULL, "\r\n", &save)) {
+        char* colon = strchr(line, ':');
+        if (!colon) continue;
+        *colon = '\0';
+        char* value = colon + 1;
+        while (*value == ' ' || *value == '\t') value++;
+        
+        if (strcasecmp(line, "Content-Length") == 0) {
+            req->content_length = strtoul(value, NULL, 10);
+        } else if (strcasecmp(line, "If-None-Match") == 0) {
+            snprintf(req->if_none_match, sizeof(req->if_none_match), "%s", value);
+        } else if (strcasecmp(line, "Range") == 0) {
+            snprintf(req->range, sizeof(req->range), "%s", value);
+        } else if (strcasecmp(line, "If-Range") == 0) {
+            snprintf(req->if_range, sizeof(req->if_range), "%s", value);
+        } else if (strcasecmp(line, "Connection") == 0) {
+            if (strcasecmp(value, "close") == 0) req->keep_alive = false;
+            if (strcasecmp(value, "keep-alive") == 0) req->keep_alive = true;
+        }
+    }
+    return true;
+}
+
+// Drops the request head and body from the buffer, keeping pipelined bytes
+static bool consume_request(Connection* conn, size_t head_len, size_t body_len) {
+    size_t buffered = conn->used - head_len;
+    if (body_len <= buffered) {
+        memmove(conn->buffer, conn->buffer + head_len + body_len, buffered - body_len);
+        conn->used = buffered - body_len;
+        return true;
+    }
+    
+    conn->used = 0;
+    size_t remaining = body_len - buffered;
+    char sink[8192];
+    while (remaining > 0) {
+        ssize_t n = recv(conn->fd, sink, remaining < sizeof(sink) ? remaining : sizeof(sink), 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        remaining -= (size_t)n;
+    }
+    return true;
+}
+
+static void* serve_connection(void* arg) {
+    Connection* conn = arg;
+    
+    struct timeval idle = { REGISTRY_IDLE_TIMEOUT, 0 };
+    setsockopt(conn->fd, SOL_SOCKET, SO_RCVTIMEO, &idle, sizeof(idle));
+    int one = 1;
+    setsockopt(conn->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    
+    if (sqlite3_open_v2(server.db_path, &conn->db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_NOMUTEX, NULL) != SQLITE_OK) {
+        fprintf(stderr, "[CPM Registry] Cannot open %s: %s\n", server.db_path, sqlite3_errmsg(conn->db));
+    } else {
+        sqlite3_busy_timeout(conn->db, 2000);
+        
+        Request req;
+        size_t head_len;
+        while (read_request(conn, &req, &head_len)) {
+            if (!server.quiet) printf("[CPM Registry] %s %s\n", req.method, req.target);
+            size_t body_len = req.content_length;
+            bool ok = dispatch(conn, &req);
+            if (!ok || !req.keep_alive || !consume_request(conn, head_len, body_len)) break;
+        }
+    }
+    
+    sqlite3_close(conn->db);
+    close(conn->fd);
+    free(conn);
+    return NULL;
+}
+
+// --- Database ---
+// Creates the schema (seeded like registry_server.py) if the file is new, and
+// checks for the optional dependencies column.
+static bool prepare_database(void) {
+    sqlite3* db = NULL;
+    if (sqlite3_open_v2(server.db_path, &db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, NULL) != SQLITE_OK) {
+        fprintf(stderr, "[CPM Registry] Cannot open %s: %s\n", server.db_path, sqlite3_errmsg(db));
+        sqlite3_close(db);
+        return false;
+    }
+    
+    sqlite3_stmt* stmt = NULL;
+    bool exists = false;
+    if (sqlite3_prepare_v2(db, "SELECT 1 FROM sqlite_master WHERE type = 'table' AND name = 'packages'", -1, &stmt, NULL) == SQLITE_OK) {
+        exists = sqlite3_step(stmt) == SQLITE_ROW;
+    }
+    sqlite3_finalize(stmt);
+    
+    if (!exists) {
+        char* error = NULL;
+        int rc = sqlite3_exec(db, schema_sql, NULL, NULL, &error);
+        if (rc == SQLITE_OK) {
+            rc = sqlite3_exec(db,
+                "INSERT OR IGNORE INTO packages (name, version, description, author, homepage, repository, license) VALUES "
+                "('libmath', '1.0.0', 'Mathematical library for C', 'Math Team', 'https://github.com/mathteam/libmath', '', 'MIT'),"
+                "('libmath', '1.1.0', 'Mathematical library for C (updated)', 'Math Team', 'https://github.com/mathteam/libmath', '', 'MIT'),"
+                "('libutils', '2.0.1', 'Utility functions for C development', 'Utils Team', 'https://github.com/utilsteam/libutils', '', 'Apache-2.0'),"
+                "('libnetwork', '0.9.5', 'Network programming utilities', 'Network Group', 'https://github.com/netgroup/libnetwork', '', 'BSD-3-Clause')",
+                NULL, NULL, &error);
+        }
+        if (rc != SQLITE_OK) {
+            fprintf(stderr, "[CPM Registry] Cannot create schema: %s\n", error ? error : "unknown error");
+            sqlite3_free(error);
+            sqlite3_close(db);
+            return false;
+        }
+    }
+    
+    if (sqlite3_prepare_v2(db, "SELECT 1 FROM pragma_table_info('packages') WHERE name = 'dependencies'", -1, &stmt, NULL) == SQLITE_OK) {
+        server.has_dependencies = sqlite3_step(stmt) == SQLITE_ROW;
+    }
+    sqlite3_finalize(stmt);
+    
+    // Readers on other connections then never wait for the download counter
+    sqlite3_exec(db, "PRAGMA journal_mode=WAL", NULL, NULL, NULL);
+    
+    // Reuse the index from the last run if nothing was added since
+    if (asprintf(&search_index_path, "%s%s", server.db_path, CPM_SEARCH_INDEX_SUFFIX) < 0) search_index_path = NULL;
+    CPM_SearchIndex* index = search_index_path && !server.reindex ? cpm_search_index_open(search_index_path) : NULL;
+    uint64_t stamp = search_stamp(db);
+    if (index && cpm_search_index_stamp(index) == stamp) {
+        search_publish(index);
+    } else {
+        cpm_search_index_close(index);
+        if (search_index_path) search_rebuild(db, stamp);
+    }
+    sqlite3_close(db);
+    return true;
+}
+
+// --- Main ---
+static void print_usage(const char* program) {
+    printf("Usage: %s [options]\n", program);
+    printf("Serves package metadata, search and tarballs from a CPM registry database.\n\n");
+    printf("  -H, --host <addr>        Address to listen on (default: 127.0.0.1)\n");
+    printf("  -p, --port <port>        Port to listen on (default: 8080)\n");
+    printf("  -d, --db <file>          SQLite database (default: cpm_registry.db)\n");
+    printf("  -P, --packages <dir>     Directory of <name>-<version>.tgz tarballs (default: packages)\n");
+    printf("  -l, --latency <ms>       Delay before every response (default: 0)\n");
+    printf("  -b, --bandwidth <KB/s>   Per-response body throughput (default: unlimited)\n");
+    printf("  -x, --drop-after <KB>    Cut every tarball response after this much (default: never)\n");
+    printf("  -r, --reindex            Rebuild the search index (<db>%s) at startup\n", CPM_SEARCH_INDEX_SUFFIX);
+    printf("  -q, --quiet              Don't log requests\n");
+    printf("  -h, --help               Show this help\n");
+}
+
+int main(int argc, char* argv[]) {
+    static const struct option options[] = {
+        { "host", required_argument, NULL, 'H' },
+        { "port", required_argument, NULL, 'p' },
+        { "db", required_argument, NULL, 'd' },
+        { "packages", required_argument, NULL, 'P' },
+        { "latency", required_argument, NULL, 'l' },
+        { "bandwidth", required_argument, NULL, 'b' },
+        { "drop-after", required_argument, NULL, 'x' },
+        { "reindex", no_argument, NULL, 'r' },
+        { "quiet", no_argument, NULL, 'q' },
+        { "help", no_argument, NULL, 'h' },
+        { NULL, 0, NULL, 0 }
+    };
+    
+    int opt;
+    while ((opt = getopt_long(argc, argv, "H:p:d:P:l:b:x:rqh", options, NULL)) != -1) {
+        switch (opt) {
+            case 'H': server.host = optarg; break;
+            case 'p': server.port = atoi(optarg); break;
+            case 'd': server.db_path = optarg; break;
+            case 'P': server.packages_dir = optarg; break;
+            case 'l': server.latency_ms = atol(optarg); break;
+            case 'b': server.bandwidth = atol(optarg) * 1024; break;
+            case 'x': server.drop_after = atol(optarg) * 1024; break;
+            case 'r': server.reindex = true; break;
+            case 'q': server.quiet = true; break;
+            case 'h': print_usage(argv[0]); return EXIT_SUCCESS;
+            default: print_usage(argv[0]); return EXIT_FAILURE;
+        }
+    }
+    if (server.port <= 0 || server.port > 65535 || server.latency_ms < 0 || server.bandwidth < 0 || server.drop_after < 0) {
+        fprintf(stderr, "[CPM Registry] Invalid port, latency or bandwidth\n");
+        return EXIT_FAILURE;
+    }
+    
+    if (!prepare_database()) return EXIT_FAILURE;
+    signal(SIGPIPE, SIG_IGN);
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons((uint16_t)server.port) };
+    if (inet_pton(AF_INET, server.host, &addr.sin_addr) != 1) {
+        fprintf(stderr, "[CPM Registry] Invalid listen address: %s\n", server.host);
+        return EXIT_FAILURE;
+    }
+    
+    int listener = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    int one = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (listener < 0 || bind(listener, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(listener, 128) != 0) {
+        fprintf(stderr, "[CPM Registry] Cannot listen on %s:%d: %s\n", server.host, server.port, strerror(errno));
+        return EXIT_FAILURE;
+    }
+    
+    printf("[CPM Registry] Listening on http://%s:%d\n", server.host, server.port);
+    printf("[CPM Registry] Database: %s%s, tarballs: %s\n", server.db_path,
+           server.has_dependencies ? " (with dependencies)" : "", server.packages_dir);
+    if (server.latency_ms || server.bandwidth) {
+        printf("[CPM Registry] Shaping: %ld ms latency, %ld KB/s per response (0 = unlimited)\n",
+               server.latency_ms, server.bandwidth / 1024);
+    }
+    if (server.drop_after) {
+        printf("[CPM Registry] Dropping tarball responses after %ld KB\n", server.drop_after / 1024);
+    }
+    
+    for (;;) {
+        int fd = accept4(listener, NULL, NULL, SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            fprintf(stderr, "[CPM Registry] accept failed: %s\n", strerror(errno));
+            break;
+        }
+        
+        Connection* conn = calloc(1, sizeof(Connection));
+        pthread_t thread;
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        if (!conn || (conn->fd = fd, pthread_create(&thread, &attr, serve_connection, conn) != 0)) {
+            close(fd);
+            free(conn);
+        }
+        pthread_attr_destroy(&attr);
+    }
+    
+    close(listener);
+    return EXIT_FAILURE;
+}
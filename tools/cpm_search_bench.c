@@ -0,0 +1,217 @@
+/*
+ * File: tools/cpm_search_bench.c
+ * Description: cpm-bench-search, build and query latency of the search index.
+ * Generates a synthetic registry (pseudo-word names, descriptions drawn with
+ * a Zipf-like skew, a pool of authors), writes its index, maps it back and
+ * times exact, prefix, infix, typo and multi-word queries against it.
+ * Author: Dr. Q Josef Kurk Edwards
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <getopt.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "cpm_search_index.h"
+
+#define BENCH_DEFAULT_PACKAGES 100000
+#define BENCH_DEFAULT_RUNS 200
+#define BENCH_VOCABULARY 40000
+#define BENCH_AUTHORS 2000
+#define BENCH_HITS 20
+
+static const char* syllables[] = {
+    "ar", "ba", "co", "de", "el", "fi", "ga", "hu", "io", "ja", "ka", "lo", "mi", "no", "or", "pa",
+    "qu", "ri", "sa", "te", "ul", "vi", "wo", "xy", "yo", "ze", "net", "math", "str", "json", "log", "io"
+};
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static uint64_t rng_state = 0x2545f4914f6cdd1dULL;
+
+static uint64_t rng_next(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+// Skewed toward the front of the vocabulary, like real descriptions
+static size_t rng_zipf(size_t n) {
+    double u = (double)(rng_next() % 1000000) / 1000000.0;
+    return (size_t)((double)n * u * u * u) % n;
+}
+
+static char* make_word(void) {
+    char word[32] = "";
+    size_t parts = 2 + rng_next() % 3;
+    for (size_t i = 0; i < parts; i++) {
+        strcat(word, syllables[rng_next() % (sizeof(syllables) / sizeof(syllables[0]))]);
+    }
+    return strdup(word);
+}
+
+static int compare_double(const void* a, const void* b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return x < y ? -1 : x > y;
+}
+
+static void print_usage(const char* program) {
+    printf("Usage: %s [options]\n", program);
+    printf("  -n, --packages <n>   Packages in the synthetic registry (default: %d)\n", BENCH_DEFAULT_PACKAGES);
+    printf("  -r, --runs <n>       Runs per query (default: %d)\n", BENCH_DEFAULT_RUNS);
+    printf("  -o, --output <path>  Where to write the index (default: a temporary file)\n");
+    printf("  -h, --help           Show this help\n");
+}
+
+int main(int argc, char** argv) {
+    long packages = BENCH_DEFAULT_PACKAGES;
+    int runs = BENCH_DEFAULT_RUNS;
+    char path[256];
+    snprintf(path, sizeof(path), "/tmp/cpm-bench-search.%ld%s", (long)getpid(), CPM_SEARCH_INDEX_SUFFIX);
+    bool keep = false;
+    
+    static const struct option options[] = {
+        { "packages", required_argument, NULL, 'n' },
+        { "runs", required_argument, NULL, 'r' },
+        { "output", required_argument, NULL, 'o' },
+        { "help", no_argument, NULL, 'h' },
+        { NULL, 0, NULL, 0 }
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "n:r:o:h", options, NULL)) != -1) {
+        switch (opt) {
+            case 'n': packages = atol(optarg); break;
+            case 'r': runs = atoi(optarg); break;
+            case 'o': snprintf(path, sizeof(path), "%s", optarg); keep = true; break;
+            case 'h': print_usage(argv[0]); return 0;
+            default: print_usage(argv[0]); return 1;
+        }
+    }
+    if (packages <= 0 || runs <= 0) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    
+    char** words = malloc(BENCH_VOCABULARY * sizeof(char*));
+    char** authors = malloc(BENCH_AUTHORS * sizeof(char*));
+    if (!words || !authors) return 1;
+    for (size_t i = 0; i < BENCH_VOCABULARY; i++) words[i] = make_word();
+    for (size_t i = 0; i < BENCH_AUTHORS; i++) {
+        char* first = make_word();
+        char* last = make_word();
+        if (asprintf(&authors[i], "%c%s %c%s", first[0] - 32, first + 1, last[0] - 32, last + 1) < 0) return 1;
+        free(first);
+        free(last);
+    }
+    
+    // --- Build ---
+    double start = now_seconds();
+    CPM_SearchIndexBuilder* builder = cpm_search_index_builder_create();
+    char* sample_name = NULL;
+    for (long i = 0; i < packages && builder; i++) {
+        char name[96];
+        char description[512] = "";
+        snprintf(name, sizeof(name), "lib%s-%s%ld", words[rng_next() % BENCH_VOCABULARY],
+                 words[rng_next() % BENCH_VOCABULARY], i % 97);
+        size_t length = 6 + rng_next() % 14;
+        for (size_t w = 0; w < length; w++) {
+            strcat(description, words[rng_zipf(BENCH_VOCABULARY)]);
+            strcat(description, w + 1 < length ? " " : ".");
+        }
+        CPM_SearchDocument doc = {
+            .name = name,
+            .version = "1.0.0",
+            .description = description,
+            .author = authors[rng_next() % BENCH_AUTHORS],
+            .homepage = "",
+            .downloads = rng_next() % 100000,
+        };
+        if (!cpm_search_index_builder_add(builder, &doc)) {
+            fprintf(stderr, "[CPM Bench] Out of memory while indexing\n");
+            return 1;
+        }
+        if (i == packages / 2) sample_name = strdup(name);
+    }
+    CPM_Result written = cpm_search_index_builder_write(builder, path, 1);
+    cpm_search_index_builder_free(builder);
+    double build_time = now_seconds() - start;
+    if (written != CPM_RESULT_SUCCESS) {
+        fprintf(stderr, "[CPM Bench] Could not write %s\n", path);
+        return 1;
+    }
+    
+    struct stat st;
+    stat(path, &st);
+    start = now_seconds();
+    CPM_SearchIndex* index = cpm_search_index_open(path);
+    double open_time = now_seconds() - start;
+    if (!index) {
+        fprintf(stderr, "[CPM Bench] Could not open %s\n", path);
+        return 1;
+    }
+    printf("[CPM Bench] %ld packages indexed in %.0f ms; %s is %.1f MB, validated and mapped in %.1f ms\n",
+           packages, build_time * 1000.0, path, (double)st.st_size / (1024.0 * 1024.0), open_time * 1000.0);
+    
+    // --- Queries ---
+    char exact[96], prefix[16], infix[16], typo[64], multi[160];
+    snprintf(exact, sizeof(exact), "%s", sample_name ? sample_name : "libnet");
+    const char* frequent = words[0];
+    snprintf(prefix, sizeof(prefix), "%.3s", words[5]);
+    snprintf(infix, sizeof(infix), "%s", words[7] + 1);
+    snprintf(typo, sizeof(typo), "%s", words[3]);
+    typo[strlen(typo) / 2] = typo[strlen(typo) / 2] == 'z' ? 'a' : 'z';
+    snprintf(multi, sizeof(multi), "%s %s %s", words[1], words[2], authors[0]);
+    const struct {
+        const char* kind;
+        const char* query;
+    } queries[] = {
+        { "exact name", exact },
+        { "frequent word", frequent },
+        { "prefix", prefix },
+        { "infix", infix },
+        { "typo", typo },
+        { "multi-word", multi },
+        { "empty", "" },
+    };
+    
+    printf("  %-14s %-28s %8s %10s %10s %10s\n", "QUERY", "TEXT", "MATCHES", "P50 us", "P99 us", "MAX us");
+    double* samples = malloc((size_t)runs * sizeof(double));
+    CPM_SearchHit hits[BENCH_HITS];
+    bool fast = true;
+    for (size_t q = 0; q < sizeof(queries) / sizeof(queries[0]) && samples; q++) {
+        size_t total = 0;
+        for (int r = 0; r < runs; r++) {
+            double t = now_seconds();
+            cpm_search_index_query(index, queries[q].query, hits, BENCH_HITS, &total);
+            samples[r] = (now_seconds() - t) * 1e6;
+        }
+        qsort(samples, (size_t)runs, sizeof(double), compare_double);
+        double p50 = samples[runs / 2];
+        double p99 = samples[(size_t)((double)(runs - 1) * 0.99)];
+        fast = fast && p50 < 1000.0;
+        printf("  %-14s %-28.28s %8zu %10.1f %10.1f %10.1f\n", queries[q].kind, queries[q].query, total, p50, p99,
+               samples[runs - 1]);
+    }
+    printf("[CPM Bench] Median query latency %s 1 ms\n", fast ? "under" : "OVER");
+    
+    free(samples);
+    free(sample_name);
+    cpm_search_index_close(index);
+    if (!keep) unlink(path);
+    for (size_t i = 0; i < BENCH_VOCABULARY; i++) free(words[i]);
+    for (size_t i = 0; i < BENCH_AUTHORS; i++) free(authors[i]);
+    free(words);
+    free(authors);
+    return fast ? 0 : 1;
+}